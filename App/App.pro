@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -25,11 +25,35 @@ DEFINES += QT_DEPRECATED_WARNINGS
 CONFIG += c++17
 
 SOURCES += \
+        alarmrecipients.cpp \
+        displayserver.cpp \
+        eventloopwatchdog.cpp \
+        gatewayclient.cpp \
+        gatewayingest.cpp \
         main.cpp \
-        mainwindow.cpp
+        mainwindow.cpp \
+        memorymonitor.cpp \
+        replicationlink.cpp \
+        residencycontroller.cpp \
+        responder.cpp \
+        rosterimporter.cpp
 
 HEADERS += \
-        mainwindow.h
+        alarmrecipients.h \
+        codecs.h \
+        displayserver.h \
+        eventloopwatchdog.h \
+        gatewayclient.h \
+        gatewayingest.h \
+        mainwindow.h \
+        memorymonitor.h \
+        replicationlink.h \
+        residencycontroller.h \
+        responder.h \
+        rosterimporter.h
+
+INCLUDEPATH += $$PWD/../Base
+DEPENDPATH += $$PWD/../Base
 
 FORMS += \
         mainwindow.ui
@@ -0,0 +1,62 @@
+#include "alarmrecipients.h"
+
+#include "field.h"
+
+bool RecipientCriteria::matches(const Responder& responder) const {
+    if (availableOnly &&
+        responder.availability() != Availability::Available) {
+        return false;
+    }
+    if (requiredQualifications != NoQualifications &&
+        (responder.qualifications().isEmpty() ||
+         (responder.qualifications().value() & requiredQualifications) !=
+             requiredQualifications)) {
+        return false;
+    }
+    if (!stations.empty() && (responder.station().isEmpty() ||
+                              stations.count(responder.station().value()) ==
+                                  0)) {
+        return false;
+    }
+    if (area && (responder.position().isEmpty() ||
+                 responder.position().value().distanceTo(*area) >
+                     maxDistance)) {
+        return false;
+    }
+    return true;
+}
+
+AlarmRecipientSelector::AlarmRecipientSelector(
+    Base::Model::Collection<QString, Responder>& responders)
+    : _selection(responders,
+                 [this](const QString& alarmType, const Responder& responder) {
+                     return matches(alarmType, responder);
+                 }) {
+    _selection.watch(FIELD(Responder, availability));
+    _selection.watch(FIELD(Responder, qualifications));
+    _selection.watch(FIELD(Responder, station));
+    _selection.watch(FIELD(Responder, position));
+}
+
+void AlarmRecipientSelector::setCriteria(const QString& alarmType,
+                                         const RecipientCriteria& criteria) {
+    _criteria[alarmType] = criteria;
+    _selection.invalidate(alarmType);
+    _selection.warm(alarmType);
+}
+
+void AlarmRecipientSelector::removeCriteria(const QString& alarmType) {
+    _criteria.erase(alarmType);
+    _selection.invalidate(alarmType);
+}
+
+std::vector<QString> const&
+AlarmRecipientSelector::recipients(const QString& alarmType) {
+    return _selection.select(alarmType);
+}
+
+bool AlarmRecipientSelector::matches(const QString& alarmType,
+                                     const Responder& responder) const {
+    auto criteria = _criteria.find(alarmType);
+    return criteria != _criteria.end() && criteria->second.matches(responder);
+}
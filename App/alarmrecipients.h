@@ -0,0 +1,69 @@
+#ifndef ALARMRECIPIENTS_H
+#define ALARMRECIPIENTS_H
+
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
+
+#include <QString>
+
+#include "model.h"
+#include "responder.h"
+#include "selection.h"
+
+/**
+ * @brief Describes which responders are alerted for an alarm type.
+ */
+struct RecipientCriteria {
+    // Only alert responders that are currently available
+    bool availableOnly = true;
+    // Qualifications that every recipient must have
+    Qualifications requiredQualifications = NoQualifications;
+    // Stations whose responders are alerted, all stations if empty
+    std::set<QString> stations;
+    // Only alert responders within maxDistance kilometres of the area
+    std::optional<GeoPosition> area;
+    double maxDistance = 0;
+
+    bool matches(const Responder& responder) const;
+};
+
+/**
+ * @brief Keeps the recipient list of every alarm type ready before the alarm
+ * arrives. The lists are cached per alarm type and kept up to date as
+ * responders are added, removed or change their availability, qualifications,
+ * station or position, so that the first SMS can go out as soon as the alarm
+ * has been received.
+ */
+class AlarmRecipientSelector {
+  public:
+    explicit AlarmRecipientSelector(
+        Base::Model::Collection<QString, Responder>& responders);
+
+    /**
+     * @brief Sets the criteria of the given alarm type and computes its
+     * recipient list.
+     */
+    void setCriteria(const QString& alarmType,
+                     const RecipientCriteria& criteria);
+
+    /**
+     * @brief Removes the given alarm type.
+     */
+    void removeCriteria(const QString& alarmType);
+
+    /**
+     * @brief Returns the IDs of the responders to alert for the given alarm
+     * type. Unknown alarm types have no recipients.
+     */
+    std::vector<QString> const& recipients(const QString& alarmType);
+
+  private:
+    bool matches(const QString& alarmType, const Responder& responder) const;
+
+    std::map<QString, RecipientCriteria> _criteria;
+    Base::Model::Selection<QString, Responder, QString> _selection;
+};
+
+#endif // ALARMRECIPIENTS_H
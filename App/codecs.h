@@ -0,0 +1,41 @@
+#ifndef CODECS_H
+#define CODECS_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "codec.h"
+#include "responder.h"
+
+namespace Base::Serialization {
+
+template <> struct Codec<QString> {
+    static void encode(Writer& writer, const QString& value) {
+        auto utf8 = value.toUtf8();
+        writer.writeVarint(static_cast<uint64_t>(utf8.size()));
+        writer.writeBytes(utf8.constData(), static_cast<size_t>(utf8.size()));
+    }
+    static QString decode(Reader& reader) {
+        auto size = reader.readVarint();
+        auto bytes = reader.readBytes(size);
+        return QString::fromUtf8(reinterpret_cast<const char*>(bytes),
+                                 static_cast<int>(size));
+    }
+};
+
+template <> struct Codec<GeoPosition> {
+    static void encode(Writer& writer, const GeoPosition& value) {
+        writer.write(value.latitude);
+        writer.write(value.longitude);
+    }
+    static GeoPosition decode(Reader& reader) {
+        GeoPosition position;
+        position.latitude = reader.read<double>();
+        position.longitude = reader.read<double>();
+        return position;
+    }
+};
+
+} // namespace Base::Serialization
+
+#endif // CODECS_H
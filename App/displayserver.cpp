@@ -0,0 +1,59 @@
+#include "displayserver.h"
+
+#include <QTimer>
+
+using namespace Base::Push;
+
+DisplayServer::DisplayServer(Base::Replication::DeltaLog& log, quint16 port,
+                             int flushInterval, QObject* parent)
+    : QObject(parent), _batcher(log), _work(_context.get_executor()),
+      _server(_context, port,
+              [this](std::function<void(Buffer)> done) {
+                  // Snapshots are taken on the thread that owns the models
+                  QMetaObject::invokeMethod(
+                      this, [this, done]() { done(_batcher.snapshot()); },
+                      Qt::QueuedConnection);
+              }),
+      _flushTimer(new QTimer(this)),
+      _batchHandler([this](DeltaBatcher& batcher, const Buffer& batch) {
+          onBatchReady(batcher, batch);
+      }) {
+    _batchHandler.connect(_batcher.batchReadyEvent());
+    _flushTimer->setInterval(flushInterval);
+    connect(_flushTimer, &QTimer::timeout, this,
+            [this]() { _batcher.flush(); });
+}
+
+DisplayServer::~DisplayServer() { stop(); }
+
+bool DisplayServer::start() {
+    if (_thread.joinable()) {
+        return true;
+    }
+    if (!_server.listen()) {
+        return false;
+    }
+    _thread = std::thread([this]() { _context.run(); });
+    _flushTimer->start();
+    return true;
+}
+
+void DisplayServer::stop() {
+    _flushTimer->stop();
+    if (!_thread.joinable()) {
+        return;
+    }
+    boost::asio::post(_context, [this]() {
+        _server.stop();
+        _context.stop();
+    });
+    _thread.join();
+}
+
+QString DisplayServer::errorString() const {
+    return QString::fromStdString(_server.errorString());
+}
+
+void DisplayServer::onBatchReady(DeltaBatcher&, const Buffer& batch) {
+    _server.broadcast(batch);
+}
@@ -0,0 +1,73 @@
+#ifndef DISPLAYSERVER_H
+#define DISPLAYSERVER_H
+
+#include <memory>
+#include <thread>
+
+#include <QObject>
+#include <QString>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include "deltapush.h"
+#include "event.h"
+#include "replication.h"
+#include "websocketpush.h"
+
+class QTimer;
+
+/**
+ * @brief Serves browser based status screens over WebSocket.
+ *
+ * The models replicated into the given DeltaLog are batched on the thread of
+ * this object and pushed to the displays by a Base::Push::WebSocketPushServer
+ * running on a thread of its own, so slow displays never hold up the event
+ * loop. The log should only be used for displays; see
+ * Base::Push::DeltaBatcher.
+ */
+class DisplayServer : public QObject {
+    Q_OBJECT
+
+  public:
+    /**
+     * @brief Creates a new DisplayServer.
+     *
+     * @param log the log that the displayed models are replicated into.
+     * @param port the TCP port for the WebSocket connections.
+     * @param flushInterval how often changes are pushed, in milliseconds.
+     */
+    explicit DisplayServer(Base::Replication::DeltaLog& log, quint16 port,
+                           int flushInterval = 100, QObject* parent = nullptr);
+
+    ~DisplayServer() override;
+
+    /**
+     * @brief Starts accepting displays.
+     *
+     * @return true on success, false if the port could not be opened. See
+     * errorString().
+     */
+    bool start();
+
+    void stop();
+
+    QString errorString() const;
+
+  private:
+    void onBatchReady(Base::Push::DeltaBatcher& batcher,
+                      const Base::Push::Buffer& batch);
+
+    Base::Push::DeltaBatcher _batcher;
+    boost::asio::io_context _context;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+        _work;
+    Base::Push::WebSocketPushServer _server;
+    std::thread _thread;
+    QTimer* _flushTimer;
+    Base::Event::SingleEventHandler<Base::Push::DeltaBatcher&,
+                                    const Base::Push::Buffer&>
+        _batchHandler;
+};
+
+#endif // DISPLAYSERVER_H
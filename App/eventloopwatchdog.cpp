@@ -0,0 +1,64 @@
+#include "eventloopwatchdog.h"
+
+#include <QDebug>
+#include <QMetaObject>
+#include <QTimer>
+
+using namespace Base::Diagnostics;
+
+EventLoopWatchdog::EventLoopWatchdog(const QString& name, int interval,
+                                     int stallThreshold, QObject* parent)
+    : QObject(parent),
+      _monitor(name.toStdString(), std::chrono::milliseconds(interval),
+               std::chrono::milliseconds(stallThreshold)),
+      _timer(new QTimer(this)) {
+    _timer->setTimerType(Qt::PreciseTimer);
+    _timer->setSingleShot(true);
+    _timer->setInterval(interval);
+    connect(_timer, &QTimer::timeout, this, &EventLoopWatchdog::onTick);
+    _monitor.setStallHandler(
+        [this](const LoopStall& stall) { onStall(stall); });
+}
+
+EventLoopWatchdog::~EventLoopWatchdog() {
+    // The stall handler must not run while the object is being destroyed
+    _monitor.stop();
+}
+
+void EventLoopWatchdog::start() {
+    _monitor.start();
+    _timer->start();
+}
+
+void EventLoopWatchdog::stop() {
+    _timer->stop();
+    _monitor.stop();
+}
+
+QString EventLoopWatchdog::report() const {
+    return QString::fromStdString(_monitor.name() + ": " +
+                                  _monitor.lag().summary());
+}
+
+void EventLoopWatchdog::onTick() {
+    _monitor.tick();
+    _timer->start();
+}
+
+void EventLoopWatchdog::onStall(const LoopStall& stall) {
+    // Called on the watchdog thread while the loop is still blocked
+    auto activity = QString::fromStdString(stall.activity);
+    QStringList stack;
+    for (const auto& frame : stall.stack) {
+        stack.append(QString::fromStdString(frame));
+    }
+    qWarning().noquote() << "Event loop" << QString::fromStdString(stall.loop)
+                         << "stalled for" << stall.lagMicros / 1000
+                         << "ms in" << (activity.isEmpty() ? "?" : activity)
+                         << "\n  " + stack.join("\n  ");
+    auto lag = static_cast<qint64>(stall.lagMicros);
+    QMetaObject::invokeMethod(
+        this,
+        [this, activity, lag, stack]() { emit stalled(activity, lag, stack); },
+        Qt::QueuedConnection);
+}
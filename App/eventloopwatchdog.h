@@ -0,0 +1,63 @@
+#ifndef EVENTLOOPWATCHDOG_H
+#define EVENTLOOPWATCHDOG_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "loopmonitor.h"
+
+class QTimer;
+
+/**
+ * @brief Monitors the lag of the Qt event loop of the thread it lives in.
+ *
+ * A precise single shot timer is restarted from every tick, so the lateness of
+ * each tick is the time the loop spent on other work beyond the interval. When
+ * the loop is blocked for longer than the stall threshold, the watchdog thread
+ * logs the activity and stack of the loop thread with qWarning() right away,
+ * and stalled() is emitted once the loop runs again.
+ *
+ * Wrap the handlers worth naming in a Base::Diagnostics::LoopMonitor::Activity
+ * on monitor().
+ */
+class EventLoopWatchdog : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit EventLoopWatchdog(const QString& name = "gui", int interval = 50,
+                               int stallThreshold = 250,
+                               QObject* parent = nullptr);
+
+    ~EventLoopWatchdog() override;
+
+    /**
+     * @brief Starts monitoring. Call on the thread whose loop to monitor.
+     */
+    void start();
+
+    void stop();
+
+    Base::Diagnostics::LoopMonitor& monitor() { return _monitor; }
+
+    /**
+     * @brief Returns a one line summary of the lag histogram, in
+     * microseconds.
+     */
+    QString report() const;
+
+  signals:
+    void stalled(const QString& activity, qint64 lagMicros,
+                 const QStringList& stack);
+
+  private slots:
+    void onTick();
+
+  private:
+    void onStall(const Base::Diagnostics::LoopStall& stall);
+
+    Base::Diagnostics::LoopMonitor _monitor;
+    QTimer* _timer;
+};
+
+#endif // EVENTLOOPWATCHDOG_H
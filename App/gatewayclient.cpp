@@ -0,0 +1,114 @@
+#include "gatewayclient.h"
+
+#include <vector>
+
+#include <QTcpSocket>
+#include <QTimer>
+
+using namespace Base::Gateway;
+
+static const int reconnectInterval = 1000;
+
+GatewayClient::GatewayClient(const QString& host, quint16 port,
+                             uint32_t window, uint64_t processed,
+                             QObject* parent)
+    : QObject(parent), _host(host), _port(port),
+      _socket(new QTcpSocket(this)), _reconnectTimer(new QTimer(this)),
+      _receiver(window, processed),
+      _eventHandler([this](CreditReceiver& receiver,
+                           const GatewayEvent& event) {
+          onGatewayEvent(receiver, event);
+      }) {
+    _eventHandler.connect(_receiver.eventReceivedEvent());
+    connect(_socket, &QTcpSocket::connected, this,
+            &GatewayClient::onConnected);
+    connect(_socket, &QTcpSocket::readyRead, this,
+            &GatewayClient::onReadyRead);
+    connect(_socket, &QTcpSocket::disconnected, this,
+            &GatewayClient::onDisconnected);
+    // A failed connection attempt only reports an error
+    connect(_socket, &QTcpSocket::errorOccurred, this,
+            &GatewayClient::onDisconnected);
+    _reconnectTimer->setSingleShot(true);
+    connect(_reconnectTimer, &QTimer::timeout, this,
+            &GatewayClient::connectToGateway);
+}
+
+void GatewayClient::start() {
+    _stopped = false;
+    connectToGateway();
+}
+
+void GatewayClient::stop() {
+    _stopped = true;
+    _reconnectTimer->stop();
+    _socket->abort();
+}
+
+bool GatewayClient::sendSms(const QString& recipient, const QString& text,
+                            bool alarm) {
+    if (!isConnected()) {
+        return false;
+    }
+    std::vector<uint8_t> frame;
+    Protocol::writeSend(frame, recipient.toStdString(), text.toStdString(),
+                        alarm);
+    _socket->write(reinterpret_cast<const char*>(frame.data()),
+                   static_cast<qint64>(frame.size()));
+    return true;
+}
+
+void GatewayClient::acknowledge(uint64_t sequence) {
+    _receiver.setAcknowledged(sequence);
+    std::vector<uint8_t> frame;
+    if (isConnected() && _receiver.acknowledge(frame)) {
+        _socket->write(reinterpret_cast<const char*>(frame.data()),
+                       static_cast<qint64>(frame.size()));
+    }
+}
+
+bool GatewayClient::isConnected() const {
+    return _socket->state() == QAbstractSocket::ConnectedState;
+}
+
+void GatewayClient::onConnected() {
+    _socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    std::vector<uint8_t> hello;
+    _receiver.hello(hello);
+    _socket->write(reinterpret_cast<const char*>(hello.data()),
+                   static_cast<qint64>(hello.size()));
+}
+
+void GatewayClient::onReadyRead() {
+    auto data = _socket->readAll();
+    std::vector<uint8_t> reply;
+    auto ok = _receiver.feed(reinterpret_cast<const uint8_t*>(data.constData()),
+                             static_cast<size_t>(data.size()), reply);
+    if (!reply.empty()) {
+        _socket->write(reinterpret_cast<const char*>(reply.data()),
+                       static_cast<qint64>(reply.size()));
+    }
+    if (!ok) {
+        // Reconnecting makes the gateway resend after the last processed event
+        QTimer::singleShot(0, _socket, &QTcpSocket::abort);
+    }
+}
+
+void GatewayClient::onDisconnected() {
+    if (!_stopped) {
+        // An error followed by a disconnect reconnects only once
+        _reconnectTimer->start(reconnectInterval);
+    }
+}
+
+void GatewayClient::connectToGateway() {
+    if (!_stopped && _socket->state() == QAbstractSocket::UnconnectedState) {
+        _socket->connectToHost(_host, _port);
+    }
+}
+
+void GatewayClient::onGatewayEvent(CreditReceiver&, const GatewayEvent& event) {
+    emit eventReceived(event.sequence, event.timestamp,
+                       QString::fromStdString(event.sender),
+                       QString::fromStdString(event.text));
+}
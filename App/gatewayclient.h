@@ -0,0 +1,101 @@
+#ifndef GATEWAYCLIENT_H
+#define GATEWAYCLIENT_H
+
+#include <cstdint>
+
+#include <QObject>
+#include <QString>
+
+#include "event.h"
+#include "gatewaylink.h"
+
+class QTcpSocket;
+class QTimer;
+
+/**
+ * @brief Receives the events of a GsmGateway over TCP and emits
+ * eventReceived() for each of them.
+ *
+ * Flow control is done by a Base::Gateway::CreditReceiver: the gateway only
+ * sends while this client has credits, and a credit is returned once the
+ * events of a batch have been handled. When the UI falls behind, the events
+ * wait in the journal of the gateway rather than in socket buffers here.
+ * After a disconnect the client reconnects and the gateway resends whatever
+ * had not been processed yet.
+ *
+ * SMS to send, such as alarms, go the other way with sendSms().
+ */
+class GatewayClient : public QObject {
+    Q_OBJECT
+
+  public:
+    /**
+     * @brief Creates a new GatewayClient.
+     *
+     * @param window the number of batches the gateway may have in flight.
+     * @param processed the last event processed by a previous run, if known.
+     */
+    explicit GatewayClient(const QString& host, quint16 port,
+                           uint32_t window = 8, uint64_t processed = 0,
+                           QObject* parent = nullptr);
+
+    /**
+     * @brief Connects to the gateway and keeps reconnecting when the
+     * connection is lost.
+     */
+    void start();
+
+    void stop();
+
+    /**
+     * @brief Asks the gateway to send an SMS.
+     *
+     * @param alarm whether the SMS is an alarm, which the gateway sends ahead
+     * of bulk SMS such as messages to all members.
+     * @return false if the gateway is not connected.
+     */
+    bool sendSms(const QString& recipient, const QString& text,
+                 bool alarm = true);
+
+    /**
+     * @brief Reports events up to the given sequence number as processed to
+     * the gateway, and no further ones until called again.
+     *
+     * Used when events are kept after eventReceived(), so that the gateway
+     * resends them if App stops before it is done with them.
+     */
+    void acknowledge(uint64_t sequence);
+
+    bool isConnected() const;
+
+    /**
+     * @brief Returns the last event that has been processed.
+     */
+    uint64_t processed() const { return _receiver.processed(); }
+
+  signals:
+    void eventReceived(quint64 sequence, qint64 timestamp,
+                       const QString& sender, const QString& text);
+
+  private slots:
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+    void connectToGateway();
+
+  private:
+    void onGatewayEvent(Base::Gateway::CreditReceiver& receiver,
+                        const Base::Gateway::GatewayEvent& event);
+
+    QString _host;
+    quint16 _port;
+    QTcpSocket* _socket;
+    QTimer* _reconnectTimer;
+    bool _stopped = true;
+    Base::Gateway::CreditReceiver _receiver;
+    Base::Event::SingleEventHandler<Base::Gateway::CreditReceiver&,
+                                    const Base::Gateway::GatewayEvent&>
+        _eventHandler;
+};
+
+#endif // GATEWAYCLIENT_H
@@ -0,0 +1,118 @@
+#include "gatewayingest.h"
+
+#include <algorithm>
+
+#include <QTimer>
+
+#include "gatewayclient.h"
+
+using namespace Base::Gateway;
+
+GatewayIngest::GatewayIngest(const QVector<GatewayAddress>& gateways,
+                             std::chrono::milliseconds window,
+                             QObject* parent)
+    : QObject(parent), _merger(static_cast<size_t>(gateways.size()), window),
+      _mergedHandler([this](size_t gateway, const GatewayEvent& event) {
+          onMerged(gateway, event);
+      }),
+      _releaseTimer(new QTimer(this)) {
+    _mergedHandler.connect(_merger.eventMergedEvent());
+    _releaseTimer->setTimerType(Qt::PreciseTimer);
+    _releaseTimer->setSingleShot(true);
+    connect(_releaseTimer, &QTimer::timeout, this,
+            &GatewayIngest::onReleaseTimer);
+    for (const auto& gateway : gateways) {
+        auto index = _clients.size();
+        auto client = new GatewayClient(gateway.host, gateway.port, 8,
+                                        gateway.processed, this);
+        // Held events are not acknowledged until they leave the window
+        client->acknowledge(gateway.processed);
+        connect(client, &GatewayClient::eventReceived, this,
+                [this, index](quint64 sequence, qint64 timestamp,
+                              const QString& sender, const QString& text) {
+                    onClientEvent(index, sequence, timestamp, sender, text);
+                });
+        _clients.push_back(client);
+        _initial.push_back(gateway.processed);
+    }
+}
+
+void GatewayIngest::start() {
+    for (auto client : _clients) {
+        client->start();
+    }
+}
+
+void GatewayIngest::stop() {
+    for (auto client : _clients) {
+        client->stop();
+    }
+    _releaseTimer->stop();
+    _merger.flush();
+}
+
+bool GatewayIngest::sendSms(const QString& recipient, const QString& text,
+                            bool alarm) {
+    for (auto client : _clients) {
+        if (client->sendSms(recipient, text, alarm)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t GatewayIngest::processed(int gateway) const {
+    auto index = static_cast<size_t>(gateway);
+    return std::max(_initial[index], _merger.merged(index));
+}
+
+QString GatewayIngest::report() const {
+    const auto& stats = _merger.stats();
+    return QString("gateways: %1 received, %2 merged, %3 duplicates, %4 late; "
+                   "window latency %5")
+        .arg(stats.received)
+        .arg(stats.merged)
+        .arg(stats.duplicates)
+        .arg(stats.late)
+        .arg(QString::fromStdString(_merger.latency().summary()));
+}
+
+void GatewayIngest::onReleaseTimer() {
+    _merger.release();
+    acknowledge();
+    scheduleRelease();
+}
+
+void GatewayIngest::onClientEvent(size_t gateway, quint64 sequence,
+                                  qint64 timestamp, const QString& sender,
+                                  const QString& text) {
+    _merger.add(gateway, GatewayEvent{sequence, timestamp,
+                                      sender.toStdString(),
+                                      text.toStdString()});
+    acknowledge();
+    scheduleRelease();
+}
+
+void GatewayIngest::onMerged(size_t, const GatewayEvent& event) {
+    emit eventReceived(event.sequence, event.timestamp,
+                       QString::fromStdString(event.sender),
+                       QString::fromStdString(event.text));
+}
+
+void GatewayIngest::acknowledge() {
+    for (size_t i = 0; i < _clients.size(); ++i) {
+        _clients[i]->acknowledge(processed(static_cast<int>(i)));
+    }
+}
+
+void GatewayIngest::scheduleRelease() {
+    auto next = _merger.nextRelease();
+    if (next == EventMerger::Clock::time_point::max()) {
+        _releaseTimer->stop();
+        return;
+    }
+    auto delay = std::chrono::ceil<std::chrono::milliseconds>(
+        next - EventMerger::Clock::now());
+    _releaseTimer->start(
+        static_cast<int>(std::max<int64_t>(0, delay.count())));
+}
@@ -0,0 +1,115 @@
+#ifndef GATEWAYINGEST_H
+#define GATEWAYINGEST_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include "event.h"
+#include "gatewaymerger.h"
+
+class GatewayClient;
+class QTimer;
+
+/**
+ * @brief The address of a GsmGateway and the last of its events that a
+ * previous run processed.
+ */
+struct GatewayAddress {
+    QString host;
+    quint16 port = 0;
+    uint64_t processed = 0;
+};
+
+/**
+ * @brief Receives the events of several GsmGateways, such as one per
+ * operator, and emits eventReceived() once for each SMS, in the order of the
+ * SMSC timestamps.
+ *
+ * The events go through a Base::Gateway::EventMerger: they are held for the
+ * reorder window and copies that another gateway delivered are dropped. A
+ * gateway is only told that an event is processed once it has left the
+ * window, so events held when App stops are sent again by the gateway on the
+ * next run rather than lost.
+ *
+ * SMS to send go through the first connected gateway.
+ */
+class GatewayIngest : public QObject {
+    Q_OBJECT
+
+  public:
+    /**
+     * @brief Creates a new GatewayIngest.
+     *
+     * @param window how long events are held for reordering.
+     */
+    explicit GatewayIngest(
+        const QVector<GatewayAddress>& gateways,
+        std::chrono::milliseconds window = std::chrono::milliseconds(1000),
+        QObject* parent = nullptr);
+
+    void start();
+
+    /**
+     * @brief Stops the gateways and emits the events still held.
+     */
+    void stop();
+
+    /**
+     * @brief Asks a connected gateway to send an SMS.
+     *
+     * @return false if no gateway is connected.
+     */
+    bool sendSms(const QString& recipient, const QString& text,
+                 bool alarm = true);
+
+    /**
+     * @brief Returns the last event of a gateway that has been processed, to
+     * pass as GatewayAddress::processed on the next run.
+     */
+    uint64_t processed(int gateway) const;
+
+    /**
+     * @brief Returns the time events spent in the reorder window, in
+     * microseconds.
+     */
+    const Base::Diagnostics::Histogram& latency() const {
+        return _merger.latency();
+    }
+
+    const Base::Gateway::MergerStats& stats() const { return _merger.stats(); }
+
+    /**
+     * @brief Returns a one line summary of the merge statistics and latency.
+     */
+    QString report() const;
+
+  signals:
+    void eventReceived(quint64 sequence, qint64 timestamp,
+                       const QString& sender, const QString& text);
+
+  private slots:
+    void onReleaseTimer();
+
+  private:
+    void onClientEvent(size_t gateway, quint64 sequence, qint64 timestamp,
+                       const QString& sender, const QString& text);
+    void onMerged(size_t gateway, const Base::Gateway::GatewayEvent& event);
+    void acknowledge();
+    void scheduleRelease();
+
+    std::vector<GatewayClient*> _clients;
+    // What the previous run processed, per gateway
+    std::vector<uint64_t> _initial;
+    Base::Gateway::EventMerger _merger;
+    Base::Event::SingleEventHandler<size_t,
+                                    const Base::Gateway::GatewayEvent&>
+        _mergedHandler;
+    QTimer* _releaseTimer;
+};
+
+#endif // GATEWAYINGEST_H
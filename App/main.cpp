@@ -1,10 +1,28 @@
+#include "eventloopwatchdog.h"
 #include "mainwindow.h"
+#include "memorymonitor.h"
+#include "responder.h"
+#include <QAction>
 #include <QApplication>
+#include <QKeySequence>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    EventLoopWatchdog watchdog;
+    watchdog.start();
+
+    Base::Model::Collection<QString, Responder> responders(&Responder::id);
+    MemoryMonitor memory;
+    memory.inspector().watch("Responder", responders, responderSchema);
+
     MainWindow w;
+    // A debug action that logs the memory of the models
+    auto memoryReport = new QAction("Memory report", &w);
+    memoryReport->setShortcut(QKeySequence("Ctrl+Shift+M"));
+    w.addAction(memoryReport);
+    QObject::connect(memoryReport, &QAction::triggered, &memory,
+                     &MemoryMonitor::dump);
     w.show();
 
     return a.exec();
@@ -0,0 +1,22 @@
+#include "memorymonitor.h"
+
+#include <QDebug>
+#include <QTimer>
+
+MemoryMonitor::MemoryMonitor(int interval, QObject* parent)
+    : QObject(parent), _timer(new QTimer(this)) {
+    connect(_timer, &QTimer::timeout, this, &MemoryMonitor::dump);
+    if (interval > 0) {
+        _timer->start(interval);
+    }
+}
+
+QString MemoryMonitor::report() const {
+    return QString::fromStdString(_inspector.report());
+}
+
+void MemoryMonitor::dump() {
+    auto text = report();
+    qInfo().noquote() << "Memory by model type:\n" + text.trimmed();
+    emit reported(text);
+}
@@ -0,0 +1,52 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <QObject>
+#include <QString>
+
+#include "memoryinspector.h"
+
+class QTimer;
+
+/**
+ * @brief Reports the memory of the models of App by type, see
+ * Base::Diagnostics::MemoryInspector.
+ *
+ * Register the models on inspector() where they are created. dump() logs the
+ * report with qInfo(); it is bound to a debug action of the main window and
+ * can also run periodically. The models are measured on the thread the
+ * monitor lives in, which must own them.
+ */
+class MemoryMonitor : public QObject {
+    Q_OBJECT
+
+  public:
+    /**
+     * @brief Creates a new MemoryMonitor.
+     *
+     * @param interval the milliseconds between periodic reports, 0 for none.
+     */
+    explicit MemoryMonitor(int interval = 0, QObject* parent = nullptr);
+
+    Base::Diagnostics::MemoryInspector& inspector() { return _inspector; }
+
+    /**
+     * @brief Returns one line per model type, followed by the total.
+     */
+    QString report() const;
+
+  public slots:
+    /**
+     * @brief Logs the report and emits reported().
+     */
+    void dump();
+
+  signals:
+    void reported(const QString& report);
+
+  private:
+    Base::Diagnostics::MemoryInspector _inspector;
+    QTimer* _timer;
+};
+
+#endif // MEMORYMONITOR_H
@@ -0,0 +1,126 @@
+#include "replicationlink.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTimer>
+
+using namespace Base::Replication;
+
+static const int heartbeatInterval = 100;
+static const int reconnectInterval = 100;
+
+ReplicationPrimary::ReplicationPrimary(DeltaLog& log, const QString& serverName,
+                                       QObject* parent)
+    : QObject(parent), _log(log), _serverName(serverName),
+      _server(new QLocalServer(this)), _heartbeatTimer(new QTimer(this)),
+      _forwarder([this](DeltaLog& log, const std::vector<uint8_t>& frame) {
+          onRecordAppended(log, frame);
+      }) {
+    _forwarder.connect(log.recordAppendedEvent());
+    connect(_server, &QLocalServer::newConnection, this,
+            &ReplicationPrimary::onNewConnection);
+    connect(_heartbeatTimer, &QTimer::timeout, this,
+            [this]() { _log.heartbeat(); });
+}
+
+bool ReplicationPrimary::listen() {
+    QLocalServer::removeServer(_serverName);
+    if (!_server->listen(_serverName)) {
+        return false;
+    }
+    _heartbeatTimer->start(heartbeatInterval);
+    return true;
+}
+
+void ReplicationPrimary::onNewConnection() {
+    while (auto socket = _server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            _standbys.removeAll(socket);
+            socket->deleteLater();
+        });
+        // Standbys that are already in sync keep following the live records
+        auto snapshot = _log.snapshotFrames();
+        socket->write(reinterpret_cast<const char*>(snapshot.data()),
+                      static_cast<qint64>(snapshot.size()));
+        _standbys.append(socket);
+    }
+}
+
+void ReplicationPrimary::onRecordAppended(DeltaLog&,
+                                          const std::vector<uint8_t>& frame) {
+    for (auto socket : _standbys) {
+        socket->write(reinterpret_cast<const char*>(frame.data()),
+                      static_cast<qint64>(frame.size()));
+    }
+}
+
+ReplicationStandby::ReplicationStandby(ReplicationSink& sink,
+                                       const QString& serverName,
+                                       int failoverTimeout, QObject* parent)
+    : QObject(parent), _sink(sink), _serverName(serverName),
+      _failoverTimeout(failoverTimeout), _socket(new QLocalSocket(this)),
+      _watchdog(new QTimer(this)), _reconnectTimer(new QTimer(this)),
+      _outOfSyncHandler([this](ReplicationSink& sink) { onOutOfSync(sink); }) {
+    _outOfSyncHandler.connect(sink.outOfSyncEvent());
+    connect(_socket, &QLocalSocket::readyRead, this,
+            &ReplicationStandby::onReadyRead);
+    connect(_socket, &QLocalSocket::disconnected, this,
+            &ReplicationStandby::onDisconnected);
+    // A failed connection attempt only reports an error
+    connect(_socket, &QLocalSocket::errorOccurred, this,
+            &ReplicationStandby::onDisconnected);
+    _reconnectTimer->setSingleShot(true);
+    connect(_reconnectTimer, &QTimer::timeout, this,
+            &ReplicationStandby::connectToPrimary);
+    connect(_watchdog, &QTimer::timeout, this,
+            &ReplicationStandby::onWatchdog);
+}
+
+void ReplicationStandby::start() {
+    _sinceLastData.start();
+    _watchdog->start(_failoverTimeout / 5);
+    connectToPrimary();
+}
+
+void ReplicationStandby::promote() {
+    _promoted = true;
+    _watchdog->stop();
+    _reconnectTimer->stop();
+    _socket->abort();
+    _sink.reset();
+}
+
+void ReplicationStandby::onReadyRead() {
+    auto data = _socket->readAll();
+    _sinceLastData.restart();
+    _primaryLost = false;
+    _sink.feed(reinterpret_cast<const uint8_t*>(data.constData()),
+               static_cast<size_t>(data.size()));
+}
+
+void ReplicationStandby::onDisconnected() {
+    _sink.reset();
+    if (!_promoted) {
+        // An error followed by a disconnect reconnects only once
+        _reconnectTimer->start(reconnectInterval);
+    }
+}
+
+void ReplicationStandby::onWatchdog() {
+    if (!_primaryLost && _sinceLastData.elapsed() > _failoverTimeout) {
+        _primaryLost = true;
+        emit primaryLost();
+    }
+}
+
+void ReplicationStandby::connectToPrimary() {
+    if (!_promoted && _socket->state() == QLocalSocket::UnconnectedState) {
+        _socket->connectToServer(_serverName);
+    }
+}
+
+void ReplicationStandby::onOutOfSync(ReplicationSink&) {
+    // Reconnecting makes the primary send a new snapshot. The sink is still
+    // processing received data, so disconnect once it has returned.
+    QTimer::singleShot(0, _socket, &QLocalSocket::abort);
+}
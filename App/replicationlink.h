@@ -0,0 +1,121 @@
+#ifndef REPLICATIONLINK_H
+#define REPLICATIONLINK_H
+
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+#include "event.h"
+#include "replication.h"
+
+class QLocalServer;
+class QLocalSocket;
+class QTimer;
+
+/**
+ * @brief Streams a DeltaLog to standby instances over a local socket. Every
+ * standby that connects gets a full snapshot followed by the live deltas.
+ * Heartbeats are appended to the log while it is idle, so that the standbys
+ * can measure lag and notice when the primary is gone.
+ */
+class ReplicationPrimary : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit ReplicationPrimary(Base::Replication::DeltaLog& log,
+                                const QString& serverName,
+                                QObject* parent = nullptr);
+
+    /**
+     * @brief Starts accepting standby connections.
+     *
+     * @return true on success, false if the server could not be started.
+     */
+    bool listen();
+
+    int standbyCount() const { return _standbys.size(); }
+
+  private slots:
+    void onNewConnection();
+
+  private:
+    void onRecordAppended(Base::Replication::DeltaLog& log,
+                          const std::vector<uint8_t>& frame);
+
+    Base::Replication::DeltaLog& _log;
+    QString _serverName;
+    QLocalServer* _server;
+    QTimer* _heartbeatTimer;
+    QList<QLocalSocket*> _standbys;
+    Base::Event::SingleEventHandler<Base::Replication::DeltaLog&,
+                                    const std::vector<uint8_t>&>
+        _forwarder;
+};
+
+/**
+ * @brief Follows a ReplicationPrimary and feeds its deltas to a
+ * ReplicationSink that keeps the local replicas warm.
+ *
+ * When nothing has been received from the primary within the failover
+ * timeout, primaryLost() is emitted. The application then calls promote() and
+ * starts replicating the replicas it already holds with a ReplicationPrimary of
+ * its own; nothing needs to be reloaded.
+ */
+class ReplicationStandby : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit ReplicationStandby(Base::Replication::ReplicationSink& sink,
+                                const QString& serverName,
+                                int failoverTimeout = 500,
+                                QObject* parent = nullptr);
+
+    /**
+     * @brief Connects to the primary and starts following it.
+     */
+    void start();
+
+    /**
+     * @brief Stops following the primary. The replicas keep their state.
+     */
+    void promote();
+
+    bool isPromoted() const { return _promoted; }
+
+    /**
+     * @brief Returns the replication statistics, including the lag of the
+     * last applied record.
+     */
+    Base::Replication::ReplicationStats const& stats() const {
+        return _sink.stats();
+    }
+
+  signals:
+    void primaryLost();
+
+  private slots:
+    void onReadyRead();
+    void onDisconnected();
+    void onWatchdog();
+    void connectToPrimary();
+
+  private:
+    void onOutOfSync(Base::Replication::ReplicationSink& sink);
+
+    Base::Replication::ReplicationSink& _sink;
+    QString _serverName;
+    int _failoverTimeout;
+    QLocalSocket* _socket;
+    QTimer* _watchdog;
+    QTimer* _reconnectTimer;
+    QElapsedTimer _sinceLastData;
+    bool _promoted = false;
+    bool _primaryLost = false;
+    Base::Event::SingleEventHandler<Base::Replication::ReplicationSink&>
+        _outOfSyncHandler;
+};
+
+#endif // REPLICATIONLINK_H
@@ -0,0 +1,53 @@
+#include "residencycontroller.h"
+
+#include <QDebug>
+#include <QTimer>
+
+#include "memoryinspector.h"
+
+using namespace Base::Model;
+
+ResidencyController::ResidencyController(const QString& archiveDirectory,
+                                         size_t budget, int interval,
+                                         QObject* parent)
+    : QObject(parent), _archive(archiveDirectory.toStdString()),
+      _manager(_archive, budget), _timer(new QTimer(this)) {
+    _timer->setInterval(interval);
+    connect(_timer, &QTimer::timeout, this, &ResidencyController::onTimer);
+}
+
+void ResidencyController::start() { _timer->start(); }
+
+void ResidencyController::stop() { _timer->stop(); }
+
+bool ResidencyController::access(const QString& incident) {
+    auto ok = _manager.access(incident.toStdString());
+    if (!ok) {
+        qWarning() << "Cannot load incident" << incident << "from"
+                   << QString::fromStdString(_archive.directory());
+    }
+    return ok;
+}
+
+QString ResidencyController::report() const {
+    using Base::Diagnostics::formatBytes;
+    const auto& stats = _manager.stats();
+    return QString("incidents: %1 of %2 resident, %3 of %4; %5 evictions, "
+                   "%6 reloads, %7 failures")
+        .arg(_manager.residentCount())
+        .arg(_manager.unitCount())
+        .arg(QString::fromStdString(
+            formatBytes(static_cast<double>(stats.residentBytes))))
+        .arg(QString::fromStdString(
+            formatBytes(static_cast<double>(_manager.budget()))))
+        .arg(stats.evictions)
+        .arg(stats.reloads)
+        .arg(stats.failures);
+}
+
+void ResidencyController::onTimer() {
+    auto failures = _manager.stats().failures;
+    if (_manager.enforce() > 0 || _manager.stats().failures > failures) {
+        qInfo().noquote() << report();
+    }
+}
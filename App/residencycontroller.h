@@ -0,0 +1,67 @@
+#ifndef RESIDENCYCONTROLLER_H
+#define RESIDENCYCONTROLLER_H
+
+#include <cstddef>
+
+#include <QObject>
+#include <QString>
+
+#include "residency.h"
+
+class QTimer;
+
+/**
+ * @brief Keeps the collections of App within a memory budget: closed
+ * incidents that have not been looked at for a while are evicted to an
+ * archive directory and loaded back when they are accessed.
+ *
+ * Register each incident's collections under the incident ID on manager(),
+ * and mark the incident closed when it is. Using an evicted collection loads
+ * it back; call access() when an incident is shown, so it counts as recently
+ * used. The budget is enforced periodically on the thread the controller
+ * lives in, which must own the collections.
+ */
+class ResidencyController : public QObject {
+    Q_OBJECT
+
+  public:
+    /**
+     * @brief Creates a new ResidencyController.
+     *
+     * @param archiveDirectory the directory for evicted incidents.
+     * @param budget the memory the incidents may use, in bytes.
+     * @param interval the milliseconds between enforcements.
+     */
+    explicit ResidencyController(const QString& archiveDirectory,
+                                 size_t budget, int interval = 60000,
+                                 QObject* parent = nullptr);
+
+    void start();
+
+    void stop();
+
+    /**
+     * @brief Makes the collections of an incident resident, reloading them
+     * if they were evicted.
+     *
+     * @return false if the incident is unknown or could not be reloaded.
+     */
+    bool access(const QString& incident);
+
+    Base::Model::ResidencyManager& manager() { return _manager; }
+
+    /**
+     * @brief Returns a one line summary of the residency statistics.
+     */
+    QString report() const;
+
+  private slots:
+    void onTimer();
+
+  private:
+    Base::Model::FileArchive _archive;
+    Base::Model::ResidencyManager _manager;
+    QTimer* _timer;
+};
+
+#endif // RESIDENCYCONTROLLER_H
@@ -0,0 +1,14 @@
+#include "responder.h"
+
+#include <QtMath>
+
+double GeoPosition::distanceTo(const GeoPosition& other) const {
+    const double earthRadius = 6371.0;
+    auto dLatitude = qDegreesToRadians(other.latitude - latitude);
+    auto dLongitude = qDegreesToRadians(other.longitude - longitude);
+    auto a = qSin(dLatitude / 2) * qSin(dLatitude / 2) +
+             qCos(qDegreesToRadians(latitude)) *
+                 qCos(qDegreesToRadians(other.latitude)) *
+                 qSin(dLongitude / 2) * qSin(dLongitude / 2);
+    return earthRadius * 2 * qAtan2(qSqrt(a), qSqrt(1 - a));
+}
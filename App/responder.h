@@ -0,0 +1,83 @@
+#ifndef RESPONDER_H
+#define RESPONDER_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include "field.h"
+#include "model.h"
+
+/**
+ * @brief Whether a responder can currently be alerted.
+ */
+enum class Availability { Available, Busy, Unavailable };
+
+/**
+ * @brief Qualifications of a responder, combined as bit flags.
+ */
+enum Qualification : quint32 {
+    NoQualifications = 0,
+    Driver = 1 << 0,
+    SmokeDiver = 1 << 1,
+    FirstAid = 1 << 2,
+    Paramedic = 1 << 3,
+    Officer = 1 << 4,
+    BoatCrew = 1 << 5,
+};
+
+using Qualifications = quint32;
+
+/**
+ * @brief A position in WGS84 coordinates.
+ */
+struct GeoPosition {
+    double latitude = 0;
+    double longitude = 0;
+
+    /**
+     * @brief Returns the great-circle distance to the given position.
+     *
+     * @param other the other position.
+     * @return the distance in kilometres.
+     */
+    double distanceTo(const GeoPosition& other) const;
+};
+
+inline bool operator==(const GeoPosition& p1, const GeoPosition& p2) {
+    return p1.latitude == p2.latitude && p1.longitude == p2.longitude;
+}
+
+inline bool operator!=(const GeoPosition& p1, const GeoPosition& p2) {
+    return !(p1 == p2);
+}
+
+/**
+ * @brief A person who can be alerted and respond to alarms.
+ */
+class Responder {
+    PROPERTY(QString, name)
+    PROPERTY(QString, phoneNumber)
+    PROPERTY(Availability, availability)
+    PROPERTY(Qualifications, qualifications)
+    PROPERTY(QString, station)
+    PROPERTY(GeoPosition, position)
+
+  public:
+    explicit Responder(const QString& id) : _id(id) {}
+
+    QString id() const { return _id; }
+
+  private:
+    QString _id;
+};
+
+/**
+ * @brief The replicated properties of a responder. Append new fields to the
+ * end, the index of a field is part of the replication protocol.
+ */
+inline const auto responderSchema = Base::Model::makeSchema(
+    FIELD(Responder, name), FIELD(Responder, phoneNumber),
+    FIELD(Responder, availability), FIELD(Responder, qualifications),
+    FIELD(Responder, station), FIELD(Responder, position));
+
+#endif // RESPONDER_H
@@ -0,0 +1,413 @@
+#include "rosterimporter.h"
+
+#include <cstring>
+#include <string_view>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QStringList>
+
+#include "csv.h"
+
+namespace {
+
+struct Columns {
+    int id = -1;
+    int name = -1;
+    int phone = -1;
+    int station = -1;
+    int qualifications = -1;
+    int latitude = -1;
+    int longitude = -1;
+    int availability = -1;
+};
+
+struct Chunk {
+    std::vector<std::unique_ptr<Responder>> responders;
+    int rejectedRows = 0;
+};
+
+QString toQString(std::string_view text) {
+    return QString::fromUtf8(text.data(), static_cast<int>(text.size()));
+}
+
+Qualifications parseQualifications(const QString& text) {
+    static const std::pair<const char*, Qualification> names[] = {
+        {"driver", Driver},     {"smokediver", SmokeDiver},
+        {"firstaid", FirstAid}, {"paramedic", Paramedic},
+        {"officer", Officer},   {"boatcrew", BoatCrew},
+    };
+    Qualifications qualifications = NoQualifications;
+    static const QRegularExpression separators("[|;]");
+    const auto parts = text.split(separators, Qt::SkipEmptyParts);
+    for (const auto& part : parts) {
+        auto name = part.trimmed().toLower().remove(' ');
+        for (const auto& entry : names) {
+            if (name == QLatin1String(entry.first)) {
+                qualifications |= entry.second;
+            }
+        }
+    }
+    return qualifications;
+}
+
+void setAvailability(Responder& responder, const QString& text) {
+    auto value = text.trimmed().toLower();
+    if (value == "available") {
+        responder.availability() = Availability::Available;
+    } else if (value == "busy") {
+        responder.availability() = Availability::Busy;
+    } else if (value == "unavailable") {
+        responder.availability() = Availability::Unavailable;
+    }
+}
+
+void setPosition(Responder& responder, const QString& latitude,
+                 const QString& longitude) {
+    bool latitudeOk, longitudeOk;
+    GeoPosition position;
+    position.latitude = latitude.toDouble(&latitudeOk);
+    position.longitude = longitude.toDouble(&longitudeOk);
+    if (latitudeOk && longitudeOk) {
+        responder.position() = position;
+    }
+}
+
+std::unique_ptr<Responder>
+makeResponder(const Columns& columns,
+              const std::vector<std::string_view>& fields) {
+    auto field = [&fields](int column) {
+        return column >= 0 && column < static_cast<int>(fields.size())
+                   ? fields[static_cast<size_t>(column)]
+                   : std::string_view();
+    };
+    auto id = toQString(field(columns.id)).trimmed();
+    if (id.isEmpty()) {
+        return nullptr;
+    }
+    auto responder = std::make_unique<Responder>(id);
+    if (!field(columns.name).empty()) {
+        responder->name() = toQString(field(columns.name));
+    }
+    if (!field(columns.phone).empty()) {
+        responder->phoneNumber() = toQString(field(columns.phone)).trimmed();
+    }
+    if (!field(columns.station).empty()) {
+        responder->station() = toQString(field(columns.station)).trimmed();
+    }
+    if (columns.qualifications >= 0) {
+        responder->qualifications() =
+            parseQualifications(toQString(field(columns.qualifications)));
+    }
+    if (!field(columns.latitude).empty() &&
+        !field(columns.longitude).empty()) {
+        setPosition(*responder, toQString(field(columns.latitude)),
+                    toQString(field(columns.longitude)));
+    }
+    if (!field(columns.availability).empty()) {
+        setAvailability(*responder, toQString(field(columns.availability)));
+    }
+    return responder;
+}
+
+Columns findColumns(const QStringList& header) {
+    Columns columns;
+    for (int i = 0; i < header.size(); ++i) {
+        auto name = header.at(i).trimmed().toLower();
+        if (name == "id") {
+            columns.id = i;
+        } else if (name == "name") {
+            columns.name = i;
+        } else if (name == "phone") {
+            columns.phone = i;
+        } else if (name == "station") {
+            columns.station = i;
+        } else if (name == "qualifications") {
+            columns.qualifications = i;
+        } else if (name == "latitude") {
+            columns.latitude = i;
+        } else if (name == "longitude") {
+            columns.longitude = i;
+        } else if (name == "availability") {
+            columns.availability = i;
+        }
+    }
+    return columns;
+}
+
+// The roster properties, by whether a file has a column for them
+constexpr unsigned nameColumn = 1;
+constexpr unsigned phoneColumn = 2;
+constexpr unsigned stationColumn = 4;
+constexpr unsigned qualificationsColumn = 8;
+constexpr unsigned positionColumn = 16;
+constexpr unsigned allColumns = 31;
+
+unsigned presentColumns(const Columns& columns) {
+    return (columns.name >= 0 ? nameColumn : 0) |
+           (columns.phone >= 0 ? phoneColumn : 0) |
+           (columns.station >= 0 ? stationColumn : 0) |
+           (columns.qualifications >= 0 ? qualificationsColumn : 0) |
+           (columns.latitude >= 0 && columns.longitude >= 0 ? positionColumn
+                                                            : 0);
+}
+
+template <typename T>
+void copyProperty(Base::Model::Property<T>& to,
+                  const Base::Model::Property<T>& from) {
+    if (from.hasValue()) {
+        to = from.value();
+    } else {
+        to.clear();
+    }
+}
+
+// The properties that come from the roster, as opposed to live status
+const auto rosterSchema = Base::Model::makeSchema(
+    FIELD(Responder, name), FIELD(Responder, phoneNumber),
+    FIELD(Responder, qualifications), FIELD(Responder, station),
+    FIELD(Responder, position));
+
+struct QStringHash {
+    size_t operator()(const QString& string) const { return qHash(string); }
+};
+
+} // namespace
+
+RosterImporter::RosterImporter(
+    Base::Model::Collection<QString, Responder>& responders)
+    : _responders(responders) {}
+
+bool RosterImporter::importFile(const QString& fileName) {
+    std::vector<std::unique_ptr<Responder>> responders;
+    if (!readFile(fileName, responders)) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<Responder*> items;
+    items.reserve(responders.size());
+    for (auto& responder : responders) {
+        items.push_back(responder.release());
+    }
+    _responders.addAll(items);
+    _stats.insertMicros = timer.nsecsElapsed() / 1000;
+    return true;
+}
+
+bool RosterImporter::reloadFile(const QString& fileName) {
+    std::vector<std::unique_ptr<Responder>> responders;
+    if (!readFile(fileName, responders)) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    // Properties without a column are kept rather than cleared, so a roster
+    // with fewer columns does not wipe what an earlier one set
+    if (_columns != allColumns) {
+        for (auto& responder : responders) {
+            if (!_responders.contains(responder->id())) {
+                continue;
+            }
+            const auto& existing = _responders.findById(responder->id());
+            if ((_columns & nameColumn) == 0) {
+                copyProperty(responder->name(), existing.name());
+            }
+            if ((_columns & phoneColumn) == 0) {
+                copyProperty(responder->phoneNumber(), existing.phoneNumber());
+            }
+            if ((_columns & stationColumn) == 0) {
+                copyProperty(responder->station(), existing.station());
+            }
+            if ((_columns & qualificationsColumn) == 0) {
+                copyProperty(responder->qualifications(),
+                             existing.qualifications());
+            }
+            if ((_columns & positionColumn) == 0) {
+                copyProperty(responder->position(), existing.position());
+            }
+        }
+    }
+    _reconcileResult = Base::Model::reconcile(_responders, responders,
+                                              rosterSchema, QStringHash());
+    _stats.insertMicros = timer.nsecsElapsed() / 1000;
+    return true;
+}
+
+bool RosterImporter::readFile(
+    const QString& fileName,
+    std::vector<std::unique_ptr<Responder>>& responders) {
+    _stats = RosterImportStats();
+    _columns = 0;
+    _errorString.clear();
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        _errorString = file.errorString();
+        return false;
+    }
+    _stats.bytes = file.size();
+    if (_stats.bytes == 0) {
+        return true;
+    }
+    auto data = reinterpret_cast<const char*>(file.map(0, file.size()));
+    if (data == nullptr) {
+        _errorString = file.errorString();
+        return false;
+    }
+
+    bool ok;
+    if (QFileInfo(fileName).suffix().compare("json", Qt::CaseInsensitive) ==
+        0) {
+        ok = readJson(data, _stats.bytes, responders);
+    } else {
+        ok = readCsv(data, _stats.bytes, responders);
+    }
+    _stats.parseMicros = timer.nsecsElapsed() / 1000;
+    return ok;
+}
+
+bool RosterImporter::readCsv(
+    const char* data, qint64 size,
+    std::vector<std::unique_ptr<Responder>>& responders) {
+    const auto end = data + size;
+    // Skip a UTF-8 byte order mark
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        data += 3;
+    }
+    auto lineEnd = static_cast<const char*>(
+        memchr(data, '\n', static_cast<size_t>(end - data)));
+    auto firstLine = std::string_view(
+        data, static_cast<size_t>((lineEnd ? lineEnd : end) - data));
+    char delimiter = firstLine.find(',') == std::string_view::npos &&
+                             firstLine.find(';') != std::string_view::npos
+                         ? ';'
+                         : ',';
+
+    std::vector<std::string_view> fields;
+    std::string scratch;
+    auto body = Base::Csv::parseRow(data, end, delimiter, fields, scratch);
+    QStringList header;
+    for (const auto& field : fields) {
+        header.append(toQString(field));
+    }
+    auto columns = findColumns(header);
+    if (columns.id < 0) {
+        _errorString = "The roster has no id column";
+        return false;
+    }
+    _columns = presentColumns(columns);
+
+    auto chunks = Base::Csv::parseParallel(
+        body, static_cast<size_t>(end - body),
+        [&columns, delimiter](const char* begin, const char* chunkEnd) {
+            Chunk chunk;
+            Base::Csv::parse(
+                begin, chunkEnd, delimiter,
+                [&](const std::vector<std::string_view>& row) {
+                    auto responder = makeResponder(columns, row);
+                    if (responder) {
+                        chunk.responders.push_back(std::move(responder));
+                    } else {
+                        chunk.rejectedRows++;
+                    }
+                });
+            return chunk;
+        });
+
+    size_t count = 0;
+    for (const auto& chunk : chunks) {
+        count += chunk.responders.size();
+    }
+    responders.reserve(responders.size() + count);
+    for (auto& chunk : chunks) {
+        _stats.rejectedRows += chunk.rejectedRows;
+        for (auto& responder : chunk.responders) {
+            responders.push_back(std::move(responder));
+        }
+    }
+    _stats.rows = static_cast<int>(count) + _stats.rejectedRows;
+    _stats.threads = static_cast<int>(chunks.size());
+    return true;
+}
+
+bool RosterImporter::readJson(
+    const char* data, qint64 size,
+    std::vector<std::unique_ptr<Responder>>& responders) {
+    QJsonParseError error;
+    auto document = QJsonDocument::fromJson(
+        QByteArray::fromRawData(data, static_cast<int>(size)), &error);
+    if (document.isNull()) {
+        _errorString = error.errorString();
+        return false;
+    }
+    if (!document.isArray()) {
+        _errorString = "The roster is not a JSON array";
+        return false;
+    }
+    const auto array = document.array();
+    responders.reserve(responders.size() + static_cast<size_t>(array.size()));
+    _stats.threads = 1;
+    for (const auto& value : array) {
+        _stats.rows++;
+        const auto object = value.toObject();
+        auto id = object.value("id").toVariant().toString().trimmed();
+        if (id.isEmpty()) {
+            _stats.rejectedRows++;
+            continue;
+        }
+        auto responder = std::make_unique<Responder>(id);
+        // A key in any of the objects counts as a column
+        _columns |= (object.contains("name") ? nameColumn : 0) |
+                    (object.contains("phone") ? phoneColumn : 0) |
+                    (object.contains("station") ? stationColumn : 0) |
+                    (object.contains("qualifications") ? qualificationsColumn
+                                                       : 0) |
+                    (object.contains("latitude") &&
+                             object.contains("longitude")
+                         ? positionColumn
+                         : 0);
+        if (object.contains("name")) {
+            responder->name() = object.value("name").toString();
+        }
+        if (object.contains("phone")) {
+            responder->phoneNumber() =
+                object.value("phone").toString().trimmed();
+        }
+        if (object.contains("station")) {
+            responder->station() =
+                object.value("station").toVariant().toString().trimmed();
+        }
+        if (object.value("qualifications").isArray()) {
+            QStringList names;
+            for (const auto& name : object.value("qualifications").toArray()) {
+                names.append(name.toString());
+            }
+            responder->qualifications() = parseQualifications(names.join('|'));
+        } else if (object.contains("qualifications")) {
+            responder->qualifications() =
+                parseQualifications(object.value("qualifications").toString());
+        }
+        if (object.contains("latitude") && object.contains("longitude")) {
+            GeoPosition position;
+            position.latitude = object.value("latitude").toDouble();
+            position.longitude = object.value("longitude").toDouble();
+            responder->position() = position;
+        }
+        if (object.contains("availability")) {
+            setAvailability(*responder,
+                            object.value("availability").toString());
+        }
+        responders.push_back(std::move(responder));
+    }
+    return true;
+}
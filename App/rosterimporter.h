@@ -0,0 +1,105 @@
+#ifndef ROSTERIMPORTER_H
+#define ROSTERIMPORTER_H
+
+#include <memory>
+#include <vector>
+
+#include <QString>
+#include <QtGlobal>
+
+#include "model.h"
+#include "reconcile.h"
+#include "responder.h"
+
+/**
+ * @brief Statistics of the last roster import.
+ */
+struct RosterImportStats {
+    qint64 bytes = 0;
+    int rows = 0;
+    int rejectedRows = 0;
+    int threads = 0;
+    // Time spent mapping, parsing and building the responders
+    qint64 parseMicros = 0;
+    // Time spent inserting the responders into the collection
+    qint64 insertMicros = 0;
+
+    /**
+     * @brief Returns the parse throughput in megabytes per second.
+     */
+    double megabytesPerSecond() const {
+        return parseMicros > 0 ? static_cast<double>(bytes) / parseMicros : 0;
+    }
+};
+
+/**
+ * @brief Imports responder rosters exported from HR systems.
+ *
+ * CSV files (comma or semicolon separated, with a header row) are memory
+ * mapped and parsed in parallel, one row-aligned chunk per core. Recognized
+ * columns are id, name, phone, station, qualifications (names separated by |
+ * or ;), latitude, longitude and availability; other columns are ignored and
+ * rows without an id are rejected. JSON files must contain an array of objects
+ * with the same keys and are parsed on the calling thread.
+ */
+class RosterImporter {
+  public:
+    explicit RosterImporter(
+        Base::Model::Collection<QString, Responder>& responders);
+
+    /**
+     * @brief Reads the given roster and adds its responders to the collection
+     * in one batch. Responders that are already in the collection are left
+     * untouched.
+     *
+     * @return true on success, false if the file could not be read.
+     */
+    bool importFile(const QString& fileName);
+
+    /**
+     * @brief Reads the given roster and reconciles the collection with it:
+     * responders missing from the roster are removed, new ones are added and
+     * existing ones only get the roster properties that differ updated. Live
+     * status such as availability is kept, and so are the roster properties
+     * that the file has no column for.
+     *
+     * @return true on success, false if the file could not be read.
+     */
+    bool reloadFile(const QString& fileName);
+
+    /**
+     * @brief Returns the changes made by the last reloadFile().
+     */
+    Base::Model::ReconcileResult const& reconcileResult() const {
+        return _reconcileResult;
+    }
+
+    /**
+     * @brief Reads the given roster without touching the collection.
+     *
+     * @param fileName the roster file.
+     * @param responders receives the responders of the roster, in file order.
+     * @return true on success, false if the file could not be read.
+     */
+    bool readFile(const QString& fileName,
+                  std::vector<std::unique_ptr<Responder>>& responders);
+
+    RosterImportStats const& stats() const { return _stats; }
+
+    QString errorString() const { return _errorString; }
+
+  private:
+    bool readCsv(const char* data, qint64 size,
+                 std::vector<std::unique_ptr<Responder>>& responders);
+    bool readJson(const char* data, qint64 size,
+                  std::vector<std::unique_ptr<Responder>>& responders);
+
+    Base::Model::Collection<QString, Responder>& _responders;
+    RosterImportStats _stats;
+    Base::Model::ReconcileResult _reconcileResult;
+    // The roster properties that the last file read has columns for
+    unsigned _columns = 0;
+    QString _errorString;
+};
+
+#endif // ROSTERIMPORTER_H
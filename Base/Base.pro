@@ -2,6 +2,29 @@ TEMPLATE = subdirs
 
 CONFIG += c++17
 
-HEADERS += common.h \
+HEADERS += actor.h \
+    asioexecutor.h \
+    audit.h \
+    codec.h \
+    common.h \
+    csv.h \
+    deltapush.h \
+    epoch.h \
     event.h \
-    model.h
+    field.h \
+    gatewaylink.h \
+    gatewaymerger.h \
+    instrumentation.h \
+    loopmonitor.h \
+    memoryinspector.h \
+    memoryusage.h \
+    model.h \
+    query.h \
+    reconcile.h \
+    replication.h \
+    residency.h \
+    selection.h \
+    sha256.h \
+    sharedsnapshot.h \
+    threadpool.h \
+    websocketpush.h
@@ -0,0 +1,210 @@
+#ifndef ACTOR_H
+#define ACTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+using namespace std;
+
+#include "common.h"
+#include "threadpool.h"
+
+namespace Base::Concurrency {
+
+/**
+ * @brief Runs tasks on a ThreadPool one at a time, in the order they were
+ * posted. Tasks of different strands run in parallel, tasks of one strand
+ * never do, so state that only a strand touches needs no locking.
+ *
+ * A strand occupies at most one worker at a time. After a batch of tasks it
+ * goes to the back of the pool's queue, so a busy strand cannot starve the
+ * others.
+ */
+class Strand : private Base::NonCopyable {
+  public:
+    static constexpr size_t batchSize = 64;
+
+    /**
+     * @brief Creates a new Strand on the given pool.
+     *
+     * @param pool the pool that runs the tasks.
+     * @param priority the priority the strand runs with on the pool.
+     */
+    explicit Strand(ThreadPool& pool = ThreadPool::shared(),
+                    Priority priority = Priority::Normal)
+        : _pool(pool), _priority(priority) {}
+
+    /**
+     * @brief Waits until every posted task has run. Must not be destroyed
+     * from one of its own tasks.
+     */
+    ~Strand() override { drain(); }
+
+    /**
+     * @brief Queues a task. It runs after all tasks posted before it.
+     *
+     * @param task the task.
+     */
+    void post(function<void()> task) {
+        bool schedule;
+        {
+            lock_guard<mutex> lock(_mutex);
+            _tasks.push_back(move(task));
+            schedule = !_scheduled;
+            _scheduled = true;
+        }
+        if (schedule) {
+            _pool.post([this] { run(); }, _priority);
+        }
+    }
+
+    /**
+     * @brief Queues the given function object, like post(). This makes the
+     * strand an executor, e.g. for QueuedEventHandler.
+     */
+    template <typename Function> void execute(Function&& function) {
+        post(makeTask(forward<Function>(function)));
+    }
+
+    /**
+     * @brief Blocks until the strand has no queued or running tasks. Must not
+     * be called from one of its own tasks.
+     */
+    void drain() {
+        unique_lock<mutex> lock(_mutex);
+        _idle.wait(lock, [this] { return !_scheduled; });
+    }
+
+    /**
+     * @brief Checks if the calling thread is running a task of this strand.
+     */
+    bool runningInThisThread() const { return current() == this; }
+
+  private:
+    static const Strand*& current() {
+        static thread_local const Strand* strand = nullptr;
+        return strand;
+    }
+
+    void run() {
+        auto previous = current();
+        current() = this;
+        for (size_t i = 0; i < batchSize; ++i) {
+            function<void()> task;
+            {
+                lock_guard<mutex> lock(_mutex);
+                if (_tasks.empty()) {
+                    current() = previous;
+                    _scheduled = false;
+                    // Notify with the mutex held, drain() may destroy us as
+                    // soon as it can take it
+                    _idle.notify_all();
+                    return;
+                }
+                task = move(_tasks.front());
+                _tasks.pop_front();
+            }
+            try {
+                task();
+            } catch (...) {
+                _pool.handleException(current_exception());
+            }
+        }
+        current() = previous;
+        _pool.post([this] { run(); }, _priority);
+    }
+
+    ThreadPool& _pool;
+    Priority _priority;
+    mutex _mutex;
+    condition_variable _idle;
+    deque<function<void()>> _tasks;
+    bool _scheduled = false;
+};
+
+/**
+ * @brief Owns a piece of state, such as the collections of one incident, and
+ * serializes all access to it on a Strand. Other threads and other actors
+ * never touch the state directly; they send messages to the actor's mailbox
+ * with tell() or ask(). The messages of one actor run one at a time, so the
+ * models inside need no locks, while independent actors run in parallel on
+ * the pool.
+ *
+ * Model events fire on the actor's strand. Handlers that belong to another
+ * actor should forward what they need with a message to that actor.
+ *
+ * @tparam State the type of the owned state.
+ */
+template <typename State> class Actor : private Base::NonCopyable {
+  public:
+    /**
+     * @brief Creates a new Actor whose state is constructed from the given
+     * arguments.
+     *
+     * @param pool the pool that runs the messages.
+     * @param args the arguments for the constructor of the state.
+     */
+    template <typename... Args>
+    explicit Actor(ThreadPool& pool, Args&&... args)
+        : _state(forward<Args>(args)...), _strand(pool) {}
+
+    /**
+     * @brief Waits for the pending messages before destroying the state. Must
+     * not be destroyed from one of its own messages.
+     */
+    ~Actor() override { _strand.drain(); }
+
+    /**
+     * @brief Sends a message that is run with the state on the actor's
+     * strand.
+     *
+     * @param message the message.
+     */
+    void tell(function<void(State&)> message) {
+        _strand.post([this, message = move(message)] { message(_state); });
+    }
+
+    /**
+     * @brief Sends a message and returns a future for its result. Exceptions
+     * thrown by the message end up in the future. Waiting for the future from
+     * a message of the same actor deadlocks.
+     *
+     * @param message a function taking the state.
+     * @return the future result of the message.
+     */
+    template <typename Function>
+    auto ask(Function&& message) -> future<invoke_result_t<Function, State&>> {
+        using Result = invoke_result_t<Function, State&>;
+        auto task = make_shared<packaged_task<Result(State&)>>(
+            forward<Function>(message));
+        auto result = task->get_future();
+        _strand.post([this, task] { (*task)(_state); });
+        return result;
+    }
+
+    /**
+     * @brief Checks if the calling thread is running a message of this actor,
+     * i.e. if it may access the state.
+     */
+    bool isCurrent() const { return _strand.runningInThisThread(); }
+
+    /**
+     * @brief Returns the strand that runs the messages, for posting work that
+     * must not overlap with them.
+     */
+    Strand& strand() { return _strand; }
+
+  private:
+    State _state;
+    Strand _strand;
+};
+
+} // namespace Base::Concurrency
+
+#endif // ACTOR_H
@@ -0,0 +1,70 @@
+#ifndef ASIOEXECUTOR_H
+#define ASIOEXECUTOR_H
+
+#include <utility>
+
+#include <boost/asio/execution.hpp>
+#include <boost/asio/execution_context.hpp>
+
+using namespace std;
+
+#include "threadpool.h"
+
+namespace Base::Concurrency {
+
+/**
+ * @brief Adapts an Executor to the standard executor model of Boost.Asio, so
+ * that completion handlers, e.g. through boost::asio::post(),
+ * boost::asio::bind_executor() or boost::asio::make_strand(), run on the
+ * ThreadPool. Only for components that are built with Boost.Asio; the rest
+ * of Base does not depend on it.
+ *
+ * Work is always queued, never run inline, so the adapter only supports
+ * blocking.never; other properties that Asio prefers are ignored, since the
+ * pool finishes all queued work before it is destroyed anyway.
+ */
+class AsioExecutor {
+  public:
+    explicit AsioExecutor(const Executor& executor) : _executor(executor) {}
+
+    template <typename Function> void execute(Function&& function) const {
+        _executor.execute(forward<Function>(function));
+    }
+
+    AsioExecutor require(boost::asio::execution::blocking_t::never_t) const {
+        return *this;
+    }
+
+    static constexpr boost::asio::execution::blocking_t
+    query(boost::asio::execution::blocking_t) noexcept {
+        return boost::asio::execution::blocking.never;
+    }
+
+    // Asio keeps services, such as the one behind boost::asio::make_strand(),
+    // in an execution context. The pool is not one, so all adapters share a
+    // context for that.
+    static boost::asio::execution_context&
+    query(boost::asio::execution::context_t) noexcept {
+        static boost::asio::execution_context context;
+        return context;
+    }
+
+    const Executor& executor() const noexcept { return _executor; }
+
+    friend bool operator==(const AsioExecutor& e1,
+                           const AsioExecutor& e2) noexcept {
+        return e1._executor == e2._executor;
+    }
+
+    friend bool operator!=(const AsioExecutor& e1,
+                           const AsioExecutor& e2) noexcept {
+        return !(e1 == e2);
+    }
+
+  private:
+    Executor _executor;
+};
+
+} // namespace Base::Concurrency
+
+#endif // ASIOEXECUTOR_H
@@ -0,0 +1,466 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "codec.h"
+#include "common.h"
+#include "event.h"
+#include "replication.h"
+#include "sha256.h"
+
+namespace Base::Audit {
+
+using Base::Crypto::Sha256;
+using Base::Replication::DeltaLog;
+using Base::Serialization::Reader;
+using Base::Serialization::Writer;
+
+/**
+ * @brief The layout of an audit log file. The file is a sequence of blocks:
+ *
+ * fixed32 magic, fixed64 block index, fixed32 record count, fixed32 payload
+ * size, 32 byte hash of the previous block, payload, 32 byte hash.
+ *
+ * The payload is the DeltaLog frames of the block, unchanged. The hash is the
+ * SHA-256 of everything before it in the block, including the hash of the
+ * previous block, so changing, removing or reordering any block breaks the
+ * chain from that block onwards. The first block links to a hash of zeros.
+ */
+namespace Format {
+constexpr uint32_t magic = 0x4c415452; // "RTAL"
+constexpr size_t headerSize = 4 + 8 + 4 + 4 + 32;
+constexpr size_t hashSize = 32;
+constexpr uint32_t maxPayloadSize = 256 * 1024 * 1024;
+} // namespace Format
+
+/**
+ * @brief Statistics of an AuditLog.
+ */
+struct AuditStats {
+    uint64_t records = 0;
+    uint64_t blocks = 0;
+    // Bytes written to the file, including block headers and hashes
+    uint64_t bytes = 0;
+    // Bytes of a torn last block that open() cut off
+    uint64_t truncatedBytes = 0;
+};
+
+/**
+ * @brief The result of verifyAuditLog().
+ */
+struct AuditVerification {
+    bool valid = false;
+    uint64_t blocks = 0;
+    uint64_t records = 0;
+    // Size of the verified part of the file. When the log is invalid, this is
+    // the offset of the first bad block.
+    uint64_t validBytes = 0;
+    // Hash of the last valid block
+    Sha256::Digest lastHash{};
+    // The file ends within the first bad block, as after a crash while the
+    // block was written
+    bool torn = false;
+    string error;
+};
+
+/**
+ * @brief Verifies the hash chain of an audit log file.
+ *
+ * @param fileName the file to verify.
+ * @param onRecord if set, called with every frame (including its length
+ * prefix) of every valid block. The frames can be fed to a ReplicationSink to
+ * replay the logged changes.
+ * @return the result of the verification.
+ */
+inline AuditVerification verifyAuditLog(
+    const string& fileName,
+    const function<void(const uint8_t*, size_t)>& onRecord = nullptr) {
+    AuditVerification result;
+    ifstream file(fileName, ios::binary);
+    if (!file) {
+        result.error = "Cannot open " + fileName;
+        return result;
+    }
+    vector<uint8_t> block;
+    while (true) {
+        block.resize(Format::headerSize);
+        file.read(reinterpret_cast<char*>(block.data()), Format::headerSize);
+        if (file.gcount() == 0) {
+            break;
+        }
+        if (static_cast<size_t>(file.gcount()) < Format::headerSize) {
+            result.error = "Truncated block header";
+            result.torn = true;
+            return result;
+        }
+        Reader header(block.data(), block.size());
+        if (header.readFixed32() != Format::magic) {
+            result.error = "Bad block magic";
+            return result;
+        }
+        if (header.readFixed64() != result.blocks) {
+            result.error = "Unexpected block index";
+            return result;
+        }
+        auto records = header.readFixed32();
+        auto payloadSize = header.readFixed32();
+        if (payloadSize > Format::maxPayloadSize) {
+            result.error = "Bad payload size";
+            return result;
+        }
+        if (memcmp(header.readBytes(Format::hashSize), result.lastHash.data(),
+                   Format::hashSize) != 0) {
+            result.error = "Broken hash chain";
+            return result;
+        }
+        auto size = Format::headerSize + payloadSize + Format::hashSize;
+        block.resize(size);
+        file.read(reinterpret_cast<char*>(block.data() + Format::headerSize),
+                  static_cast<streamsize>(size - Format::headerSize));
+        if (static_cast<size_t>(file.gcount()) < size - Format::headerSize) {
+            result.error = "Truncated block";
+            result.torn = true;
+            return result;
+        }
+        auto hash = Sha256::hash(block.data(), size - Format::hashSize);
+        if (memcmp(hash.data(), block.data() + size - Format::hashSize,
+                   Format::hashSize) != 0) {
+            result.error = "Block hash mismatch";
+            return result;
+        }
+
+        // Check that the payload consists of exactly the declared frames
+        Reader payload(block.data() + Format::headerSize, payloadSize);
+        uint32_t count = 0;
+        try {
+            while (!payload.atEnd()) {
+                auto frame = payload.readBytes(4);
+                auto length = Reader(frame, 4).readFixed32();
+                payload.readBytes(length);
+                if (onRecord) {
+                    onRecord(frame, 4 + length);
+                }
+                count++;
+            }
+        } catch (const Base::Serialization::DecodeError&) {
+            count = records + 1;
+        }
+        if (count != records) {
+            result.error = "Bad record count";
+            return result;
+        }
+
+        result.lastHash = hash;
+        result.blocks++;
+        result.records += records;
+        result.validBytes += size;
+    }
+    result.valid = true;
+    return result;
+}
+
+/**
+ * @brief Writes every record of a DeltaLog to a tamper evident, hash chained
+ * audit log file (see Format).
+ *
+ * The recordAppended handler only copies the frame into a pending batch; a
+ * background thread cuts the batch into a block, hashes it and writes it, so
+ * no file I/O or hashing happens on the thread that changes the models. A
+ * block is written when the batch reaches the batch size or when the flush
+ * interval has passed, whichever comes first. Every block is synced to disk
+ * before it counts as written, so the records that stats() and flush()
+ * report as written survive a power failure.
+ *
+ * Heartbeats are logged too; they show that the log was alive during quiet
+ * periods. Snapshots appended to the DeltaLog end up in the log as well and
+ * act as checkpoints for replay.
+ */
+class AuditLog : private Base::NonCopyable {
+  public:
+    static constexpr size_t defaultBatchSize = 64 * 1024;
+
+    /**
+     * @brief Creates a new AuditLog. Nothing is logged until open() has been
+     * called.
+     *
+     * @param log the log whose records to write.
+     * @param flushInterval the longest time a record waits before it is
+     * written.
+     * @param batchSize the number of pending bytes that triggers a write.
+     */
+    explicit AuditLog(DeltaLog& log,
+                      chrono::milliseconds flushInterval =
+                          chrono::milliseconds(100),
+                      size_t batchSize = defaultBatchSize)
+        : _log(log), _flushInterval(flushInterval), _batchSize(batchSize) {}
+
+    ~AuditLog() override { close(); }
+
+    /**
+     * @brief Opens the given file and starts logging. An existing file is
+     * verified first and the new blocks continue its hash chain. A torn last
+     * block, as left by a crash, is cut off and its size reported in
+     * AuditStats::truncatedBytes; a file that fails verification otherwise
+     * is left untouched and not opened. Opening writes a snapshot
+     * of the DeltaLog, so that the file can be replayed from there. The
+     * snapshot is taken with DeltaLog::snapshotFrames(), so the other readers
+     * of the log do not see it.
+     *
+     * @return true on success, false if the file could not be opened or
+     * failed verification. See errorString().
+     */
+    bool open(const string& fileName) {
+        close();
+        AuditVerification existing;
+        uint64_t truncated = 0;
+        if (ifstream(fileName, ios::binary)) {
+            existing = verifyAuditLog(fileName);
+            if (!existing.valid && existing.torn) {
+                error_code error;
+                auto size = filesystem::file_size(fileName, error);
+                if (!error) {
+                    filesystem::resize_file(fileName, existing.validBytes,
+                                            error);
+                }
+                if (!error) {
+                    truncated = size - existing.validBytes;
+                    existing.valid = true;
+                }
+            }
+            if (!existing.valid) {
+                _error = fileName + ": " + existing.error;
+                return false;
+            }
+        }
+        auto created = !filesystem::exists(fileName);
+        _fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (_fd < 0 || (created && !syncDirectory(fileName))) {
+            _error = "Cannot open " + fileName + ": " + strerror(errno);
+            closeFile();
+            return false;
+        }
+        _error.clear();
+        _failed = false;
+        _previousHash = existing.lastHash;
+        _blockIndex = existing.blocks;
+        _stats.truncatedBytes = truncated;
+        _stopping = false;
+        _thread = thread(&AuditLog::run, this);
+        auto snapshot = _log.snapshotFrames();
+        for (size_t offset = 0; offset < snapshot.size();) {
+            auto size =
+                4 + Reader(snapshot.data() + offset, 4).readFixed32();
+            onRecordAppended(snapshot.data() + offset, size);
+            offset += size;
+        }
+        _handler = make_unique<RecordHandler>(
+            [this](DeltaLog&, const vector<uint8_t>& frame) {
+                onRecordAppended(frame.data(), frame.size());
+            });
+        _handler->connect(_log.recordAppendedEvent());
+        return true;
+    }
+
+    /**
+     * @brief Writes all pending records and closes the file.
+     */
+    void close() {
+        if (!_thread.joinable()) {
+            return;
+        }
+        _handler.reset();
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wakeUp.notify_one();
+        _thread.join();
+        closeFile();
+    }
+
+    /**
+     * @brief Blocks until every record appended so far has been written.
+     */
+    void flush() {
+        unique_lock<mutex> lock(_mutex);
+        auto target = _appended;
+        _flushRequested = true;
+        _wakeUp.notify_one();
+        _written.wait(lock,
+                      [&] { return _stats.records >= target || _failed; });
+    }
+
+    /**
+     * @brief Checks if writing has failed. Records are no longer written after
+     * a failure.
+     */
+    bool failed() const {
+        lock_guard<mutex> lock(_mutex);
+        return _failed;
+    }
+
+    string errorString() const {
+        lock_guard<mutex> lock(_mutex);
+        return _error;
+    }
+
+    AuditStats stats() const {
+        lock_guard<mutex> lock(_mutex);
+        return _stats;
+    }
+
+  private:
+    void onRecordAppended(const uint8_t* frame, size_t size) {
+        bool full;
+        {
+            lock_guard<mutex> lock(_mutex);
+            _pending.insert(_pending.end(), frame, frame + size);
+            _pendingRecords++;
+            _appended++;
+            full = _pending.size() >= _batchSize;
+        }
+        if (full) {
+            _wakeUp.notify_one();
+        }
+    }
+
+    void run() {
+        vector<uint8_t> batch;
+        vector<uint8_t> block;
+        unique_lock<mutex> lock(_mutex);
+        while (true) {
+            _wakeUp.wait_for(lock, _flushInterval, [this] {
+                return _stopping || _flushRequested ||
+                       _pending.size() >= _batchSize;
+            });
+            _flushRequested = false;
+            if (_pending.empty() || _failed) {
+                _pending.clear();
+                _written.notify_all();
+                if (_stopping) {
+                    return;
+                }
+                continue;
+            }
+            swap(batch, _pending);
+            auto records = _pendingRecords;
+            _pendingRecords = 0;
+            lock.unlock();
+
+            auto ok = writeBlock(block, batch, records);
+            batch.clear();
+
+            lock.lock();
+            if (ok) {
+                _stats.records += records;
+                _stats.blocks++;
+                _stats.bytes += block.size();
+            } else {
+                _failed = true;
+                _error = "Writing the audit log failed";
+            }
+            _written.notify_all();
+        }
+    }
+
+    bool writeBlock(vector<uint8_t>& block, const vector<uint8_t>& payload,
+                    uint32_t records) {
+        block.clear();
+        block.reserve(Format::headerSize + payload.size() + Format::hashSize);
+        Writer writer(block);
+        writer.writeFixed32(Format::magic);
+        writer.writeFixed64(_blockIndex);
+        writer.writeFixed32(records);
+        writer.writeFixed32(static_cast<uint32_t>(payload.size()));
+        writer.writeBytes(_previousHash.data(), _previousHash.size());
+        writer.writeBytes(payload.data(), payload.size());
+        _previousHash = Sha256::hash(block.data(), block.size());
+        writer.writeBytes(_previousHash.data(), _previousHash.size());
+        _blockIndex++;
+        size_t written = 0;
+        while (written < block.size()) {
+            auto result = ::write(_fd, block.data() + written,
+                                  block.size() - written);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+        return ::fsync(_fd) == 0;
+    }
+
+    // Makes a new file's directory entry durable, not only its contents
+    static bool syncDirectory(const string& fileName) {
+        error_code error;
+        auto path = filesystem::absolute(fileName, error).parent_path();
+        if (error) {
+            return false;
+        }
+        auto directory = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+        if (directory < 0) {
+            return false;
+        }
+        auto synced = ::fsync(directory) == 0;
+        ::close(directory);
+        return synced;
+    }
+
+    void closeFile() {
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+
+    using RecordHandler =
+        Base::Event::SingleEventHandler<DeltaLog&, const vector<uint8_t>&>;
+
+    DeltaLog& _log;
+    unique_ptr<RecordHandler> _handler;
+    chrono::milliseconds _flushInterval;
+    size_t _batchSize;
+
+    // Only used by the background thread while it runs
+    int _fd = -1;
+    Sha256::Digest _previousHash{};
+    uint64_t _blockIndex = 0;
+    thread _thread;
+
+    mutable mutex _mutex;
+    condition_variable _wakeUp;
+    condition_variable _written;
+    vector<uint8_t> _pending;
+    uint32_t _pendingRecords = 0;
+    uint64_t _appended = 0;
+    bool _stopping = false;
+    bool _flushRequested = false;
+    bool _failed = false;
+    string _error;
+    AuditStats _stats;
+};
+
+} // namespace Base::Audit
+
+#endif // AUDIT_H
@@ -0,0 +1,257 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+namespace Base::Serialization {
+
+/**
+ * @brief Thrown by Reader when the input is truncated or malformed.
+ */
+class DecodeError : public runtime_error {
+  public:
+    explicit DecodeError(const string& what) : runtime_error(what) {}
+};
+
+/**
+ * @brief Encodes values into a compact, little endian binary format. Unsigned
+ * integers are written as varints and signed integers as zigzag varints.
+ *
+ * Types are encoded by specializations of Codec.
+ */
+class Writer {
+  public:
+    /**
+     * @brief Creates a new Writer that appends to the given buffer.
+     *
+     * @param buffer the buffer to append to.
+     */
+    explicit Writer(vector<uint8_t>& buffer) : _buffer(buffer) {}
+
+    void writeByte(uint8_t byte) { _buffer.push_back(byte); }
+
+    void writeBytes(const void* data, size_t size) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        _buffer.insert(_buffer.end(), bytes, bytes + size);
+    }
+
+    void writeVarint(uint64_t value) {
+        while (value >= 0x80) {
+            _buffer.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        _buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    void writeSignedVarint(int64_t value) {
+        writeVarint((static_cast<uint64_t>(value) << 1) ^
+                    static_cast<uint64_t>(value >> 63));
+    }
+
+    void writeFixed32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            _buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void writeFixed64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            _buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    /**
+     * @brief Writes the given value using its Codec.
+     *
+     * @param value the value to write.
+     */
+    template <typename T> void write(const T& value);
+
+    /**
+     * @brief Returns the number of bytes in the buffer.
+     */
+    size_t size() const { return _buffer.size(); }
+
+    vector<uint8_t>& buffer() { return _buffer; }
+
+  private:
+    vector<uint8_t>& _buffer;
+};
+
+/**
+ * @brief Decodes values written by Writer. All methods throw DecodeError if
+ * the input ends prematurely.
+ */
+class Reader {
+  public:
+    /**
+     * @brief Creates a new Reader over the given bytes. The bytes must outlive
+     * the reader.
+     *
+     * @param data the bytes to read.
+     * @param size the number of bytes.
+     */
+    explicit Reader(const uint8_t* data, size_t size)
+        : _position(data), _end(data + size) {}
+
+    uint8_t readByte() {
+        require(1);
+        return *_position++;
+    }
+
+    const uint8_t* readBytes(size_t size) {
+        require(size);
+        auto bytes = _position;
+        _position += size;
+        return bytes;
+    }
+
+    uint64_t readVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            auto byte = readByte();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw DecodeError("Varint is too long");
+    }
+
+    int64_t readSignedVarint() {
+        auto value = readVarint();
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    uint32_t readFixed32() {
+        auto bytes = readBytes(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t readFixed64() {
+        auto bytes = readBytes(8);
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    /**
+     * @brief Reads a value using its Codec.
+     *
+     * @return the value.
+     */
+    template <typename T> T read();
+
+    /**
+     * @brief Returns the number of bytes that have not been read yet.
+     */
+    size_t remaining() const { return static_cast<size_t>(_end - _position); }
+
+    bool atEnd() const { return _position == _end; }
+
+  private:
+    void require(size_t size) const {
+        if (remaining() < size) {
+            throw DecodeError("Unexpected end of input");
+        }
+    }
+
+    const uint8_t* _position;
+    const uint8_t* _end;
+};
+
+/**
+ * @brief Encodes and decodes values of type T. Specialize this template to
+ * make other types serializable:
+ *
+ * template <> struct Codec<MyType> {
+ *     static void encode(Writer& writer, const MyType& value);
+ *     static MyType decode(Reader& reader);
+ * };
+ */
+template <typename T, typename Enable = void> struct Codec;
+
+template <> struct Codec<bool> {
+    static void encode(Writer& writer, bool value) {
+        writer.writeByte(value ? 1 : 0);
+    }
+    static bool decode(Reader& reader) { return reader.readByte() != 0; }
+};
+
+template <typename T>
+struct Codec<T, enable_if_t<is_integral_v<T> && is_unsigned_v<T> &&
+                            !is_same_v<T, bool>>> {
+    static void encode(Writer& writer, T value) { writer.writeVarint(value); }
+    static T decode(Reader& reader) {
+        return static_cast<T>(reader.readVarint());
+    }
+};
+
+template <typename T>
+struct Codec<T, enable_if_t<is_integral_v<T> && is_signed_v<T>>> {
+    static void encode(Writer& writer, T value) {
+        writer.writeSignedVarint(value);
+    }
+    static T decode(Reader& reader) {
+        return static_cast<T>(reader.readSignedVarint());
+    }
+};
+
+template <typename T> struct Codec<T, enable_if_t<is_enum_v<T>>> {
+    using Underlying = underlying_type_t<T>;
+    static void encode(Writer& writer, T value) {
+        Codec<Underlying>::encode(writer, static_cast<Underlying>(value));
+    }
+    static T decode(Reader& reader) {
+        return static_cast<T>(Codec<Underlying>::decode(reader));
+    }
+};
+
+template <> struct Codec<double> {
+    static void encode(Writer& writer, double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        writer.writeFixed64(bits);
+    }
+    static double decode(Reader& reader) {
+        auto bits = reader.readFixed64();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+template <> struct Codec<string> {
+    static void encode(Writer& writer, const string& value) {
+        writer.writeVarint(value.size());
+        writer.writeBytes(value.data(), value.size());
+    }
+    static string decode(Reader& reader) {
+        auto size = reader.readVarint();
+        auto bytes = reader.readBytes(size);
+        return string(reinterpret_cast<const char*>(bytes), size);
+    }
+};
+
+template <typename T> void Writer::write(const T& value) {
+    Codec<T>::encode(*this, value);
+}
+
+template <typename T> T Reader::read() { return Codec<T>::decode(*this); }
+
+} // namespace Base::Serialization
+
+#endif // CODEC_H
@@ -19,6 +19,24 @@ class NonCopyable {
     virtual ~NonCopyable() = default;
 };
 
+/**
+ * @brief Base class for types that can be moved but not copied. Unlike
+ * NonCopyable it adds no virtual table, so values of derived types can be kept
+ * in contiguous containers without any overhead.
+ */
+class MoveOnly {
+  public:
+    explicit MoveOnly() = default;
+
+    MoveOnly(const MoveOnly&) = delete;
+    MoveOnly(MoveOnly&&) noexcept = default;
+    MoveOnly& operator=(const MoveOnly&) = delete;
+    MoveOnly& operator=(MoveOnly&&) noexcept = default;
+
+  protected:
+    ~MoveOnly() = default;
+};
+
 } // namespace Base
 
 #endif // COMMON_H
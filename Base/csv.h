@@ -0,0 +1,327 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+#include "threadpool.h"
+
+namespace Base::Csv {
+
+/**
+ * @brief Returns the first quote, delimiter, CR or LF in the given range, or
+ * end if there is none. Scans 16 bytes at a time where SSE2 is available.
+ *
+ * @param position the start of the range.
+ * @param end the end of the range.
+ * @param delimiter the field delimiter.
+ * @return the position of the first special character, or end.
+ */
+inline const char* findSpecial(const char* position, const char* end,
+                               char delimiter) {
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+    const auto quotes = _mm_set1_epi8('"');
+    const auto delimiters = _mm_set1_epi8(delimiter);
+    const auto lineFeeds = _mm_set1_epi8('\n');
+    const auto carriageReturns = _mm_set1_epi8('\r');
+    while (end - position >= 16) {
+        auto bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+        auto matches = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, quotes),
+                         _mm_cmpeq_epi8(bytes, delimiters)),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, lineFeeds),
+                         _mm_cmpeq_epi8(bytes, carriageReturns)));
+        auto mask = _mm_movemask_epi8(matches);
+        if (mask != 0) {
+            return position + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        position += 16;
+    }
+#endif
+    while (position < end && *position != '"' && *position != delimiter &&
+           *position != '\n' && *position != '\r') {
+        ++position;
+    }
+    return position;
+}
+
+/**
+ * @brief Counts the quote characters in the given range. Scans 16 bytes at a
+ * time where SSE2 is available.
+ */
+inline size_t countQuotes(const char* position, const char* end) {
+    size_t count = 0;
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+    const auto quotes = _mm_set1_epi8('"');
+    while (end - position >= 16) {
+        auto bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+        auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quotes));
+        count += static_cast<size_t>(
+            __builtin_popcount(static_cast<unsigned>(mask)));
+        position += 16;
+    }
+#endif
+    return count + static_cast<size_t>(std::count(position, end, '"'));
+}
+
+/**
+ * @brief Parses a single RFC 4180 row. Quoted fields may contain delimiters,
+ * line breaks and escaped quotes (""). Both LF and CRLF line endings are
+ * accepted.
+ *
+ * @param position the start of the row.
+ * @param end the end of the input.
+ * @param delimiter the field delimiter.
+ * @param fields receives the fields of the row. The fields point into the
+ * input, or into scratch for quoted fields with escaped quotes, and stay valid
+ * until the next call with the same scratch buffer.
+ * @param scratch a buffer for unescaped fields.
+ * @return the start of the next row.
+ */
+inline const char* parseRow(const char* position, const char* end,
+                            char delimiter, vector<string_view>& fields,
+                            string& scratch) {
+    struct Span {
+        const char* data;
+        size_t scratchOffset;
+        size_t size;
+    };
+    // Up to 32 fields are recorded without allocating
+    Span inlineSpans[32];
+    vector<Span> moreSpans;
+    size_t count = 0;
+    auto addSpan = [&](Span span) {
+        if (count < 32) {
+            inlineSpans[count] = span;
+        } else {
+            moreSpans.push_back(span);
+        }
+        ++count;
+    };
+
+    scratch.clear();
+    bool rowEnded = false;
+    while (!rowEnded) {
+        if (position < end && *position == '"') {
+            auto start = ++position;
+            size_t scratchStart = scratch.size();
+            bool escaped = false;
+            while (true) {
+                auto quote = static_cast<const char*>(
+                    memchr(position, '"', static_cast<size_t>(end - position)));
+                if (quote == nullptr) {
+                    // Unterminated quote, take the rest of the input
+                    quote = end;
+                }
+                if (quote + 1 < end && quote[1] == '"') {
+                    scratch.append(position, quote + 1);
+                    position = quote + 2;
+                    escaped = true;
+                    continue;
+                }
+                if (escaped) {
+                    scratch.append(position, quote);
+                    addSpan({nullptr, scratchStart,
+                             scratch.size() - scratchStart});
+                } else {
+                    addSpan({start, 0, static_cast<size_t>(quote - start)});
+                }
+                position = quote < end ? quote + 1 : end;
+                break;
+            }
+            // Ignore anything between the closing quote and the delimiter
+            while (position < end && *position != delimiter &&
+                   *position != '\n' && *position != '\r') {
+                ++position;
+            }
+        } else {
+            auto start = position;
+            position = findSpecial(position, end, delimiter);
+            // Quotes inside unquoted fields are taken literally
+            while (position < end && *position == '"') {
+                position = findSpecial(position + 1, end, delimiter);
+            }
+            addSpan({start, 0, static_cast<size_t>(position - start)});
+        }
+        if (position == end) {
+            rowEnded = true;
+        } else if (*position == delimiter) {
+            ++position;
+        } else {
+            if (*position == '\r') {
+                ++position;
+            }
+            if (position < end && *position == '\n') {
+                ++position;
+            }
+            rowEnded = true;
+        }
+    }
+
+    // The scratch buffer no longer grows, so views into it are now stable
+    fields.clear();
+    for (size_t i = 0; i < count; ++i) {
+        auto span = i < 32 ? inlineSpans[i] : moreSpans[i - 32];
+        auto data =
+            span.data ? span.data : scratch.data() + span.scratchOffset;
+        fields.emplace_back(data, span.size);
+    }
+    return position;
+}
+
+/**
+ * @brief Parses all rows in the given range, skipping empty lines.
+ *
+ * @param begin the start of the input.
+ * @param end the end of the input.
+ * @param delimiter the field delimiter.
+ * @param handler the function to invoke with the fields of every row, as a
+ * const vector<string_view>&.
+ * @return the number of rows.
+ */
+template <typename RowHandler>
+size_t parse(const char* begin, const char* end, char delimiter,
+             RowHandler&& handler) {
+    vector<string_view> fields;
+    string scratch;
+    size_t rows = 0;
+    auto position = begin;
+    while (position < end) {
+        position = parseRow(position, end, delimiter, fields, scratch);
+        if (fields.size() > 1 || !fields.front().empty()) {
+            handler(static_cast<const vector<string_view>&>(fields));
+            ++rows;
+        }
+    }
+    return rows;
+}
+
+/**
+ * @brief Splits the input into at most chunkCount chunks of roughly equal size
+ * that start at row boundaries. A line break only ends a row if it is preceded
+ * by an even number of quotes, so quoted fields are never split.
+ *
+ * @param data the input.
+ * @param size the size of the input.
+ * @param chunkCount the desired number of chunks.
+ * @return the offsets of the chunk boundaries, starting with 0 and ending with
+ * size.
+ */
+inline vector<size_t> split(const char* data, size_t size,
+                            size_t chunkCount) {
+    chunkCount = max<size_t>(1, chunkCount);
+    vector<size_t> boundaries{0};
+    size_t quotes = 0;
+    size_t counted = 0;
+    for (size_t i = 1; i < chunkCount; ++i) {
+        size_t nominal = size * i / chunkCount;
+        if (nominal <= boundaries.back()) {
+            continue;
+        }
+        quotes += countQuotes(data + counted, data + nominal);
+        counted = nominal;
+        bool inQuotes = quotes % 2 != 0;
+        auto position = nominal;
+        while (position < size && (inQuotes || data[position] != '\n')) {
+            if (data[position] == '"') {
+                inQuotes = !inQuotes;
+            }
+            ++position;
+        }
+        if (position >= size) {
+            break;
+        }
+        quotes += countQuotes(data + counted, data + position);
+        counted = position + 1;
+        boundaries.push_back(position + 1);
+    }
+    boundaries.push_back(size);
+    return boundaries;
+}
+
+/**
+ * @brief Splits the input into row-aligned chunks and processes them in
+ * parallel on the shared ThreadPool. Inputs smaller than minChunkSize per
+ * chunk use fewer chunks.
+ *
+ * @param data the input.
+ * @param size the size of the input.
+ * @param function the function to invoke for every chunk with the start and
+ * end of the chunk. It runs on a worker thread and must not touch shared state.
+ * @param threadCount the number of chunks, 0 for the number of workers of the
+ * pool.
+ * @param minChunkSize the smallest chunk that is worth a thread of its own.
+ * @return the results of the function, in input order.
+ * @throws the first exception a chunk threw, once all chunks are done.
+ */
+template <typename ChunkFunction>
+auto parseParallel(const char* data, size_t size, ChunkFunction&& function,
+                   size_t threadCount = 0, size_t minChunkSize = 256 * 1024)
+    -> vector<decltype(function(data, data))> {
+    auto& pool = Base::Concurrency::ThreadPool::shared();
+    if (threadCount == 0) {
+        threadCount = pool.size();
+    }
+    threadCount = max<size_t>(1, min(threadCount, size / minChunkSize));
+    auto boundaries = split(data, size, threadCount);
+
+    using Result = decltype(function(data, data));
+    vector<future<Result>> futures;
+    for (size_t i = 1; i + 1 < boundaries.size(); ++i) {
+        futures.push_back(pool.submit([&, i]() {
+            return function(data + boundaries[i], data + boundaries[i + 1]);
+        }));
+    }
+    // The tasks refer to the locals above, so every one of them must have
+    // finished before this returns, even when a chunk throws
+    auto waitFor = [&pool](future<Result>& future) {
+        if (pool.runningInThisThread()) {
+            // Help rather than tie up a worker
+            return pool.wait(future);
+        }
+        // Blocks without running unrelated tasks on the caller's thread,
+        // which may be the GUI thread
+        return future.get();
+    };
+    vector<Result> results;
+    exception_ptr error;
+    try {
+        results.push_back(function(data, data + boundaries[1]));
+    } catch (...) {
+        error = current_exception();
+    }
+    for (auto& future : futures) {
+        try {
+            auto result = waitFor(future);
+            if (!error) {
+                results.push_back(move(result));
+            }
+        } catch (...) {
+            if (!error) {
+                error = current_exception();
+            }
+        }
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+    return results;
+}
+
+} // namespace Base::Csv
+
+#endif // CSV_H
@@ -0,0 +1,171 @@
+#ifndef DELTAPUSH_H
+#define DELTAPUSH_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+#include "common.h"
+#include "event.h"
+#include "replication.h"
+
+namespace Base::Push {
+
+using Base::Replication::DeltaLog;
+
+/**
+ * @brief An encoded message that is shared by every connection it is sent
+ * to.
+ */
+using Buffer = shared_ptr<const vector<uint8_t>>;
+
+/**
+ * @brief Statistics of a DeltaBatcher.
+ */
+struct BatchStats {
+    uint64_t batches = 0;
+    uint64_t bytes = 0;
+    uint64_t snapshots = 0;
+};
+
+/**
+ * @brief Collects the frames of a DeltaLog into batches for push clients such
+ * as browser displays. Every batch is encoded once and shared by all clients,
+ * so the cost of a change does not grow with the number of clients.
+ *
+ * A new client first gets a snapshot(), which holds the frames of a full
+ * snapshot of the log's sources, and then every batch fired after it. Both
+ * use the frame layout of DeltaLog, starting with a SnapshotBegin record for
+ * snapshots.
+ *
+ * Snapshots are taken without appending anything to the log, so the log can
+ * be shared with standbys and the audit log. A snapshot's frames are numbered
+ * so that the batches after it continue its sequence numbers.
+ */
+class DeltaBatcher : public Base::Event::EventHandler<DeltaBatcher> {
+  public:
+    /**
+     * @brief Creates a new DeltaBatcher.
+     *
+     * @param log the log to batch.
+     * @param maxBatchBytes the size at which a batch is fired without waiting
+     * for flush().
+     */
+    explicit DeltaBatcher(DeltaLog& log, size_t maxBatchBytes = 256 * 1024)
+        : _log(log), _maxBatchBytes(maxBatchBytes) {
+        connect(log.recordAppendedEvent(), &DeltaBatcher::onRecordAppended);
+    }
+
+    /**
+     * @brief Fires the frames appended since the last batch, if any. Call
+     * this periodically; the interval trades latency for fewer messages.
+     */
+    void flush() {
+        if (_batch.empty()) {
+            return;
+        }
+        auto batch = make_shared<const vector<uint8_t>>(move(_batch));
+        _batch = vector<uint8_t>();
+        _batch.reserve(batch->size());
+        _stats.batches++;
+        _stats.bytes += batch->size();
+        _batchReady.fire(*this, batch);
+    }
+
+    /**
+     * @brief Returns a full snapshot for clients that connect now. Pending
+     * frames are fired first, so the snapshot is followed by exactly the
+     * batches fired after it. Nothing is appended to the log, so other
+     * clients, standbys and the audit log do not see the snapshot.
+     */
+    Buffer snapshot() {
+        flush();
+        auto snapshot =
+            make_shared<const vector<uint8_t>>(_log.snapshotFrames());
+        _stats.snapshots++;
+        return snapshot;
+    }
+
+    BatchStats const& stats() const { return _stats; }
+
+    EVENT(batchReady, DeltaBatcher&, const Buffer&)
+
+  private:
+    void onRecordAppended(DeltaLog&, const vector<uint8_t>& frame) {
+        _batch.insert(_batch.end(), frame.begin(), frame.end());
+        if (_batch.size() >= _maxBatchBytes) {
+            flush();
+        }
+    }
+
+    DeltaLog& _log;
+    size_t _maxBatchBytes;
+    vector<uint8_t> _batch;
+    BatchStats _stats;
+};
+
+/**
+ * @brief The outgoing messages of one push client, bounded in bytes so that
+ * a slow client cannot make the server hold an unbounded backlog.
+ *
+ * When a message does not fit, the queue drops everything it holds and
+ * reports an overflow. The client is then out of date and should be sent a
+ * new snapshot instead of the deltas it missed.
+ */
+class SendQueue {
+  public:
+    explicit SendQueue(size_t maxBytes = 4 * 1024 * 1024)
+        : _maxBytes(maxBytes) {}
+
+    /**
+     * @brief Queues a message.
+     *
+     * @return false if the queue overflowed and has been cleared.
+     */
+    bool push(const Buffer& buffer) {
+        if (_bytes + buffer->size() > _maxBytes && !_messages.empty()) {
+            clear();
+            _overflows++;
+            return false;
+        }
+        _bytes += buffer->size();
+        _messages.push_back(buffer);
+        return true;
+    }
+
+    Buffer const& front() const { return _messages.front(); }
+
+    void pop() {
+        _bytes -= _messages.front()->size();
+        _messages.pop_front();
+    }
+
+    void clear() {
+        _messages.clear();
+        _bytes = 0;
+    }
+
+    bool empty() const { return _messages.empty(); }
+
+    size_t size() const { return _messages.size(); }
+
+    size_t bytes() const { return _bytes; }
+
+    /**
+     * @brief Returns how often the queue has overflowed.
+     */
+    uint64_t overflows() const { return _overflows; }
+
+  private:
+    size_t _maxBytes;
+    size_t _bytes = 0;
+    uint64_t _overflows = 0;
+    deque<Buffer> _messages;
+};
+
+} // namespace Base::Push
+
+#endif // DELTAPUSH_H
@@ -0,0 +1,235 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#include "common.h"
+
+namespace Base::Concurrency {
+
+/**
+ * @brief Epoch based deferred reclamation. Readers access shared objects
+ * inside a read epoch (see ReadGuard) without taking any lock. Writers unlink
+ * an object from the shared structure and then retire() it; the object is
+ * deleted only once every reader that could still see it has left its epoch.
+ *
+ * The domain keeps a global epoch. A reader announces the epoch it entered,
+ * and the global epoch advances only when every active reader has announced
+ * the current one. An object retired in epoch e can therefore no longer be
+ * reached once the global epoch is e + 2.
+ *
+ * Entering and leaving a read epoch is lock free. Retiring takes a mutex and
+ * every so often collects the objects that are safe to delete. Deleters run on
+ * the thread that calls retire(), collect() or synchronize(), outside the
+ * mutex.
+ */
+class EpochDomain : private Base::NonCopyable {
+    struct alignas(64) Record {
+        // The epoch the reader entered, or 0 when it is not in a read epoch
+        atomic<uint64_t> epoch{0};
+        atomic<bool> inUse{false};
+        Record* next = nullptr;
+    };
+
+  public:
+    static constexpr size_t defaultCollectThreshold = 64;
+
+    /**
+     * @brief Keeps the calling thread in a read epoch for its lifetime. Objects
+     * read from a structure protected by the domain stay valid until the
+     * guard is destroyed. Guards may be nested.
+     */
+    class ReadGuard : private Base::NonCopyable {
+      public:
+        explicit ReadGuard(EpochDomain& domain)
+            : _record(domain.enterRead()) {}
+
+        ~ReadGuard() override { EpochDomain::leaveRead(_record); }
+
+      private:
+        Record* _record;
+    };
+
+    /**
+     * @brief Creates a new EpochDomain.
+     *
+     * @param collectThreshold the number of retired objects after which
+     * retire() tries to delete the ones that are safe to delete.
+     */
+    explicit EpochDomain(size_t collectThreshold = defaultCollectThreshold)
+        : _collectThreshold(collectThreshold) {}
+
+    /**
+     * @brief Deletes all retired objects. No thread may be in a read epoch of
+     * the domain any more.
+     */
+    ~EpochDomain() override {
+        for (auto& retired : _retired) {
+            retired.second();
+        }
+        auto record = _records.load(memory_order_acquire);
+        while (record != nullptr) {
+            auto next = record->next;
+            delete record;
+            record = next;
+        }
+    }
+
+    /**
+     * @brief Hands an object that is no longer reachable for new readers to
+     * the domain, which calls the deleter once no reader can hold it any more.
+     *
+     * @param deleter the function that deletes the object.
+     */
+    void retire(function<void()> deleter) {
+        bool collectNow;
+        {
+            lock_guard<mutex> lock(_mutex);
+            _retired.emplace_back(_epoch.load(), move(deleter));
+            collectNow = ++_retiredSinceCollect >= _collectThreshold;
+        }
+        if (collectNow) {
+            collect();
+        }
+    }
+
+    /**
+     * @brief Retires the given object, see retire(function<void()>). Null is
+     * ignored.
+     */
+    template <typename T> void retire(T* object) {
+        if (object != nullptr) {
+            retire([object] { delete object; });
+        }
+    }
+
+    /**
+     * @brief Advances the epoch if possible and deletes the retired objects
+     * that no reader can hold any more.
+     *
+     * @return the number of objects deleted.
+     */
+    size_t collect() {
+        vector<function<void()>> deleters;
+        {
+            lock_guard<mutex> lock(_mutex);
+            _retiredSinceCollect = 0;
+            tryAdvance();
+            auto epoch = _epoch.load();
+            while (!_retired.empty() && _retired.front().first + 2 <= epoch) {
+                deleters.push_back(move(_retired.front().second));
+                _retired.pop_front();
+            }
+        }
+        for (auto& deleter : deleters) {
+            deleter();
+        }
+        return deleters.size();
+    }
+
+    /**
+     * @brief Blocks until every object retired so far has been deleted. Must
+     * not be called from inside a read epoch.
+     */
+    void synchronize() {
+        while (true) {
+            collect();
+            if (pending() == 0) {
+                return;
+            }
+            this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief Returns the number of retired objects that have not been deleted
+     * yet.
+     */
+    size_t pending() const {
+        lock_guard<mutex> lock(_mutex);
+        return _retired.size();
+    }
+
+    /**
+     * @brief Returns the current global epoch.
+     */
+    uint64_t epoch() const { return _epoch.load(); }
+
+  private:
+    Record* enterRead() {
+        auto record = acquireRecord();
+        // Announce the epoch and check that it is still current, so that the
+        // epoch cannot advance twice past a reader that has not announced yet
+        auto epoch = _epoch.load();
+        while (true) {
+            record->epoch.store(epoch);
+            auto current = _epoch.load();
+            if (current == epoch) {
+                return record;
+            }
+            epoch = current;
+        }
+    }
+
+    static void leaveRead(Record* record) {
+        record->epoch.store(0, memory_order_release);
+        record->inUse.store(false, memory_order_release);
+    }
+
+    Record* acquireRecord() {
+        auto head = _records.load(memory_order_acquire);
+        for (auto record = head; record != nullptr; record = record->next) {
+            auto expected = false;
+            if (!record->inUse.load(memory_order_relaxed) &&
+                record->inUse.compare_exchange_strong(
+                    expected, true, memory_order_acquire)) {
+                return record;
+            }
+        }
+        // Every record is taken by a reader: add one. Records are only freed
+        // with the domain.
+        auto record = new Record;
+        record->inUse.store(true, memory_order_relaxed);
+        record->next = head;
+        while (!_records.compare_exchange_weak(record->next, record,
+                                               memory_order_release,
+                                               memory_order_acquire)) {
+        }
+        return record;
+    }
+
+    // Called with the mutex held
+    void tryAdvance() {
+        auto epoch = _epoch.load();
+        for (auto record = _records.load(memory_order_acquire);
+             record != nullptr; record = record->next) {
+            auto announced = record->epoch.load();
+            if (announced != 0 && announced != epoch) {
+                return;
+            }
+        }
+        _epoch.compare_exchange_strong(epoch, epoch + 1);
+    }
+
+    size_t _collectThreshold;
+    atomic<uint64_t> _epoch{1};
+    atomic<Record*> _records{nullptr};
+
+    mutable mutex _mutex;
+    deque<pair<uint64_t, function<void()>>> _retired;
+    size_t _retiredSinceCollect = 0;
+};
+
+} // namespace Base::Concurrency
+
+#endif // EPOCH_H
@@ -2,19 +2,25 @@
 #define EVENT_H
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 using namespace std;
 
 #include "common.h"
+#include "instrumentation.h"
 
 // Based on code example found here:
 // https://stackoverflow.com/questions/35847756/robust-c-event-pattern
 
 namespace Base::Event {
 
+class EventBase;
+
 /**
  * @brief Base class for Subscriber. Clients should not need to use this class
  * directly.
@@ -38,6 +44,40 @@ template <class... EventArgs> class SubscriberBase : private Base::NonCopyable {
      * false otherwise.
      */
     virtual bool representsEventHandler(void* eventHandler) const = 0;
+
+    /**
+     * @brief Returns the size of this subscriber in bytes.
+     */
+    virtual size_t memoryUsage() const = 0;
+
+    /**
+     * @brief Updates the list of connected events of the event handler after
+     * the event has moved to a new address.
+     *
+     * @param from the old address of the event.
+     * @param to the new address of the event, or nullptr if the event has been
+     * destroyed.
+     */
+    void eventMoved(EventBase* from, EventBase* to) const {
+        if (_connectedEvents == nullptr) {
+            return;
+        }
+        if (to != nullptr) {
+            replace(_connectedEvents->begin(), _connectedEvents->end(), from,
+                    to);
+        } else {
+            _connectedEvents->erase(remove(_connectedEvents->begin(),
+                                           _connectedEvents->end(), from),
+                                    _connectedEvents->end());
+        }
+    }
+
+  protected:
+    explicit SubscriberBase(vector<EventBase*>* connectedEvents)
+        : _connectedEvents(connectedEvents) {}
+
+  private:
+    vector<EventBase*>* _connectedEvents;
 };
 
 /**
@@ -54,8 +94,10 @@ class Subscriber : public SubscriberBase<EventArgs...> {
     // Creates a new Subscriber for the given event handler and event handler
     // method.
     explicit Subscriber(TEventHandler* eventHandler,
-                        void (TEventHandler::*eventHandlerMethod)(EventArgs...))
-        : _eventHandler(eventHandler), _handlerMethod(eventHandlerMethod) {}
+                        void (TEventHandler::*eventHandlerMethod)(EventArgs...),
+                        vector<EventBase*>* connectedEvents)
+        : SubscriberBase<EventArgs...>(connectedEvents),
+          _eventHandler(eventHandler), _handlerMethod(eventHandlerMethod) {}
 
     void invoke(EventArgs... args) const override final {
         (_eventHandler->*_handlerMethod)(args...);
@@ -65,6 +107,8 @@ class Subscriber : public SubscriberBase<EventArgs...> {
         return _eventHandler == eventHandler;
     }
 
+    size_t memoryUsage() const override final { return sizeof(*this); }
+
   private:
     TEventHandler* _eventHandler;
     void (TEventHandler::*_handlerMethod)(EventArgs...);
@@ -74,8 +118,13 @@ class Subscriber : public SubscriberBase<EventArgs...> {
  * @brief Base class for Event. Clients should not need to use this class
  * directly but interact with Event instead.
  */
-class EventBase : private Base::NonCopyable {
+class EventBase : private Base::MoveOnly {
   public:
+    EventBase() = default;
+    EventBase(EventBase&&) = default;
+    EventBase& operator=(EventBase&&) = default;
+    virtual ~EventBase() = default;
+
     /**
      * @brief Unsubscribes the given event handler from this event. Clients do
      * not need to call this method if they use the EventHandler class.
@@ -89,11 +138,46 @@ class EventBase : private Base::NonCopyable {
  * @brief Event class that can be subscribed to and fired. When the event is
  * fired, the event arguments will be passed to all its subscribers.
  *
+ * Events can be moved but not copied. The subscribers move along with the
+ * event, and event handlers that are connected to it are told about its new
+ * address, so they stay connected and disconnect correctly when they are
+ * destroyed. This lets objects with events, such as models, be kept by value
+ * in containers that relocate their elements.
+ *
  * @tparam EventArgs the types of the event arguments.
  */
 template <class... EventArgs> class Event : public EventBase {
   public:
+    Event() = default;
+
+    /**
+     * @brief Creates a new Event that takes over the subscribers of the given
+     * event. The given event is left without subscribers.
+     */
+    Event(Event&& other) noexcept : _subscribers(move(other._subscribers)) {
+        other._subscribers.clear();
+        moveConnections(&other, this);
+    }
+
+    /**
+     * @brief Replaces the subscribers of this event with the subscribers of
+     * the given event. The current subscribers are dropped, as if this event
+     * had been destroyed.
+     */
+    Event& operator=(Event&& other) noexcept {
+        if (this != &other) {
+            moveConnections(this, nullptr);
+            _subscribers = move(other._subscribers);
+            other._subscribers.clear();
+            moveConnections(&other, this);
+        }
+        return *this;
+    }
+
+    ~Event() { moveConnections(this, nullptr); }
+
     void unsubscribe(void* eventHandler) override final {
+        BASE_INSTRUMENT_COUNT(Event, Unsubscribe);
         auto toRemove = remove_if(_subscribers.begin(), _subscribers.end(),
                                   [eventHandler](auto& subscriber) {
                                       return subscriber->representsEventHandler(
@@ -108,12 +192,16 @@ template <class... EventArgs> class Event : public EventBase {
      * @param eventHandler the event handler.
      * @param handlerMethod the method of the event handler that will be invoked
      * when the event is fired.
+     * @param connectedEvents if set, the list of connected events of the event
+     * handler, which is kept up to date when this event moves or is destroyed.
      */
     template <class TEventHandler>
     void subscribe(TEventHandler* eventHandler,
-                   void (TEventHandler::*handlerMethod)(EventArgs... args)) {
+                   void (TEventHandler::*handlerMethod)(EventArgs... args),
+                   vector<EventBase*>* connectedEvents = nullptr) {
+        BASE_INSTRUMENT_COUNT(Event, Subscribe);
         auto subscriber = new Subscriber<TEventHandler, EventArgs...>(
-            eventHandler, handlerMethod);
+            eventHandler, handlerMethod, connectedEvents);
         _subscribers.push_back(SmartBasePointer(subscriber));
     }
 
@@ -123,12 +211,33 @@ template <class... EventArgs> class Event : public EventBase {
      * @param args the event arguments to pass to all subscribers.
      */
     void fire(EventArgs... args) const {
+        BASE_INSTRUMENT_SCOPE(Event, Fire, _subscribers.size());
         for (auto& subscriber : _subscribers) {
             subscriber->invoke(args...);
         }
     }
 
+    size_t subscriberCount() const { return _subscribers.size(); }
+
+    /**
+     * @brief Returns the heap memory used by the subscribers of this event, in
+     * bytes.
+     */
+    size_t memoryUsage() const {
+        auto size = _subscribers.capacity() * sizeof(SmartBasePointer);
+        for (const auto& subscriber : _subscribers) {
+            size += subscriber->memoryUsage();
+        }
+        return size;
+    }
+
   private:
+    void moveConnections(EventBase* from, EventBase* to) {
+        for (auto& subscriber : _subscribers) {
+            subscriber->eventMoved(from, to);
+        }
+    }
+
     using SmartBasePointer = unique_ptr<SubscriberBase<EventArgs...>>;
     vector<SmartBasePointer> _subscribers;
 };
@@ -138,6 +247,10 @@ template <class... EventArgs> class Event : public EventBase {
  * notifications. This event handler will automatically unsubscribe from the
  * event upon destruction.
  *
+ * Event handlers cannot be moved, since the events they are connected to refer
+ * to them by address. Keep them in place, or on the heap, and move the events
+ * instead.
+ *
  * @tparam Derived the subclass that extends this event handler and defines the
  * event handler method.
  */
@@ -154,7 +267,8 @@ template <class Derived> class EventHandler : private Base::NonCopyable {
     template <class... EventArgs>
     void connect(Event<EventArgs...>& event,
                  void (Derived::*handlerMethod)(EventArgs... args)) {
-        event.subscribe(dynamic_cast<Derived*>(this), handlerMethod);
+        event.subscribe(dynamic_cast<Derived*>(this), handlerMethod,
+                        &_connectedEvents);
         _connectedEvents.push_back(&event);
     }
 
@@ -194,8 +308,8 @@ class SingleEventHandler
      * @param event the event to connect to.
      */
     void connect(Event<EventArgs...>& event) {
-        EventHandler<SingleEventHandler<EventArgs...>>::connect(event,
-                                                                &handleEvent);
+        EventHandler<SingleEventHandler<EventArgs...>>::connect(
+            event, &SingleEventHandler::handleEvent);
     }
 
   private:
@@ -204,6 +318,93 @@ class SingleEventHandler
     function<void(EventArgs...)> _handler;
 };
 
+/**
+ * @brief Event handler that runs its function on an executor instead of on
+ * the thread that fires the event, like a queued connection in Qt. The
+ * executor is anything with an execute() member that takes a function
+ * object, e.g. a Base::Concurrency::Executor, a Strand or a Boost.Asio
+ * executor.
+ *
+ * The event arguments are copied into the queued call, except for non-const
+ * lvalue references such as the sender, which are passed on as references and
+ * must still be valid when the call runs. Calls that are still queued when
+ * the handler is destroyed are skipped, but a call that is already running is
+ * not waited for.
+ *
+ * @tparam EventArgs the types of the event arguments.
+ */
+template <class... EventArgs>
+class QueuedEventHandler
+    : public EventHandler<QueuedEventHandler<EventArgs...>> {
+  public:
+    /**
+     * @brief Creates a new QueuedEventHandler.
+     *
+     * @param executor the executor that runs the handler function. Copyable
+     * executors are copied, others, such as a Strand, are referenced and must
+     * outlive the handler.
+     * @param handler the function that will be invoked for every fired event.
+     */
+    template <class Executor>
+    explicit QueuedEventHandler(Executor&& executor,
+                                const function<void(EventArgs...)>& handler)
+        : _execute(executeOn(forward<Executor>(executor))),
+          _shared(make_shared<Shared>(handler)) {}
+
+    ~QueuedEventHandler() override { _shared->connected = false; }
+
+    /**
+     * @brief Connects this event handler to the given event.
+     *
+     * @param event the event to connect to.
+     */
+    void connect(Event<EventArgs...>& event) {
+        EventHandler<QueuedEventHandler<EventArgs...>>::connect(
+            event, &QueuedEventHandler::handleEvent);
+    }
+
+  private:
+    template <class T>
+    using Stored =
+        conditional_t<is_lvalue_reference_v<T> &&
+                          !is_const_v<remove_reference_t<T>>,
+                      T, decay_t<T>>;
+
+    struct Shared {
+        explicit Shared(const function<void(EventArgs...)>& handler)
+            : handler(handler) {}
+
+        function<void(EventArgs...)> handler;
+        atomic<bool> connected{true};
+    };
+
+    template <class Executor>
+    static function<void(function<void()>)> executeOn(Executor&& executor) {
+        using Type = decay_t<Executor>;
+        if constexpr (is_copy_constructible_v<Type>) {
+            return [executor = Type(executor)](function<void()> call) mutable {
+                executor.execute(move(call));
+            };
+        } else {
+            return [&executor](function<void()> call) {
+                executor.execute(move(call));
+            };
+        }
+    }
+
+    void handleEvent(EventArgs... args) {
+        _execute([shared = _shared,
+                  arguments = tuple<Stored<EventArgs>...>(args...)]() mutable {
+            if (shared->connected) {
+                apply(shared->handler, move(arguments));
+            }
+        });
+    }
+
+    function<void(function<void()>)> _execute;
+    shared_ptr<Shared> _shared;
+};
+
 }; // namespace Base::Event
 
 // TODO Document this macro in some way
@@ -0,0 +1,157 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+using namespace std;
+
+#include "model.h"
+
+namespace Base::Model {
+
+/**
+ * @brief Describes a Property that has been declared with the PROPERTY macro,
+ * making it possible to reach the same property on any instance of the item
+ * class. Use the FIELD macro to create fields.
+ *
+ * @tparam Item the class that declares the property.
+ * @tparam T the value type of the property.
+ */
+template <typename Item, typename T> class Field {
+  public:
+    using ItemType = Item;
+    using ValueType = T;
+    using Accessor = Property<T>& (Item::*)();
+
+    /**
+     * @brief Creates a new Field.
+     *
+     * @param name the name of the property.
+     * @param accessor the non-const accessor generated by the PROPERTY macro.
+     */
+    constexpr Field(const char* name, Accessor accessor)
+        : _name(name), _accessor(accessor) {}
+
+    /**
+     * @brief Returns the name of the property.
+     */
+    const char* name() const { return _name; }
+
+    /**
+     * @brief Returns the property of the given item.
+     *
+     * @param item the item whose property to return.
+     * @return the property.
+     */
+    Property<T>& of(Item& item) const { return (item.*_accessor)(); }
+
+    /**
+     * @brief Returns the property of the given item.
+     *
+     * @param item the item whose property to return.
+     * @return the property.
+     */
+    Property<T> const& of(Item const& item) const {
+        return (const_cast<Item&>(item).*_accessor)();
+    }
+
+  private:
+    const char* _name;
+    Accessor _accessor;
+};
+
+/**
+ * @brief Creates a new Field. Clients normally use the FIELD macro instead.
+ *
+ * @param name the name of the property.
+ * @param accessor the non-const accessor generated by the PROPERTY macro.
+ * @return the field.
+ */
+template <typename Item, typename T>
+constexpr Field<Item, T> makeField(const char* name,
+                                   Property<T>& (Item::*accessor)()) {
+    return Field<Item, T>(name, accessor);
+}
+
+/**
+ * @brief An ordered list of the fields of an item class. The position of a
+ * field in the schema is its index, which is used to refer to the field in
+ * serialized form. Use makeSchema() to create schemas.
+ *
+ * @tparam Item the item class.
+ * @tparam Fields the types of the fields.
+ */
+template <typename Item, typename... Fields> class Schema {
+  public:
+    using ItemType = Item;
+
+    constexpr explicit Schema(Fields... fields) : _fields(fields...) {}
+
+    /**
+     * @brief Returns the number of fields in the schema.
+     */
+    static constexpr size_t size() { return sizeof...(Fields); }
+
+    /**
+     * @brief Invokes the given function for every field, in order. The
+     * function receives the index of the field as a
+     * std::integral_constant<size_t, Index> and the field itself.
+     *
+     * @param function the function to invoke.
+     */
+    template <typename Function> void forEach(Function&& function) const {
+        forEach(function, index_sequence_for<Fields...>());
+    }
+
+    /**
+     * @brief Invokes the given function for the field with the given index.
+     *
+     * @param index the index of the field.
+     * @param function the function to invoke with the field.
+     * @return true if the field was found, false if the index is out of range.
+     */
+    template <typename Function>
+    bool visit(size_t index, Function&& function) const {
+        bool found = false;
+        forEach([&](auto fieldIndex, const auto& field) {
+            if (fieldIndex == index) {
+                function(field);
+                found = true;
+            }
+        });
+        return found;
+    }
+
+  private:
+    template <typename Function, size_t... Indexes>
+    void forEach(Function& function, index_sequence<Indexes...>) const {
+        (function(integral_constant<size_t, Indexes>(), get<Indexes>(_fields)),
+         ...);
+    }
+
+    tuple<Fields...> _fields;
+};
+
+/**
+ * @brief Creates a new Schema from the given fields.
+ *
+ * @param fields the fields, typically created with the FIELD macro.
+ * @return the schema.
+ */
+template <typename Item, typename... T>
+constexpr Schema<Item, Field<Item, T>...>
+makeSchema(Field<Item, T>... fields) {
+    return Schema<Item, Field<Item, T>...>(fields...);
+}
+
+} // namespace Base::Model
+
+/**
+ * Creates a Base::Model::Field for a property declared with the PROPERTY macro,
+ * e.g. FIELD(Responder, status).
+ */
+#define FIELD(type, name) Base::Model::makeField(#name, &type::name)
+
+#endif // FIELD_H
@@ -0,0 +1,440 @@
+#ifndef GATEWAYLINK_H
+#define GATEWAYLINK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "codec.h"
+#include "common.h"
+#include "event.h"
+
+namespace Base::Gateway {
+
+using Base::Serialization::DecodeError;
+using Base::Serialization::Reader;
+using Base::Serialization::Writer;
+
+/**
+ * @brief Something the gateway received from the GSM network, such as the SMS
+ * reply of a responder. Events are numbered by the gateway's journal.
+ */
+struct GatewayEvent {
+    uint64_t sequence = 0;
+    // Microseconds since the epoch
+    int64_t timestamp = 0;
+    string sender;
+    string text;
+};
+
+} // namespace Base::Gateway
+
+namespace Base::Serialization {
+
+template <> struct Codec<Base::Gateway::GatewayEvent> {
+    static void encode(Writer& writer,
+                       const Base::Gateway::GatewayEvent& event) {
+        writer.writeVarint(event.sequence);
+        writer.writeSignedVarint(event.timestamp);
+        writer.write(event.sender);
+        writer.write(event.text);
+    }
+
+    static Base::Gateway::GatewayEvent decode(Reader& reader) {
+        Base::Gateway::GatewayEvent event;
+        event.sequence = reader.readVarint();
+        event.timestamp = reader.readSignedVarint();
+        event.sender = reader.read<string>();
+        event.text = reader.read<string>();
+        return event;
+    }
+};
+
+} // namespace Base::Serialization
+
+namespace Base::Gateway {
+
+/**
+ * @brief The frames exchanged between the gateway and App. Every frame is a
+ * fixed32 length of the rest of the frame, a type byte and the body:
+ *
+ * Hello (App to gateway, after connecting): varint last sequence App has
+ * processed, varint credits.
+ *
+ * Credit (App to gateway): varint last sequence App has processed, varint
+ * additional credits.
+ *
+ * Batch (gateway to App): varint event count, the events.
+ *
+ * Send (App to gateway): string recipient, string text of an SMS to send,
+ * optional byte 1 if it is an alarm or 0 if it is bulk, such as a message to
+ * all members; an alarm if absent.
+ *
+ * One credit allows the gateway to send one batch, so App bounds the data in
+ * flight by the credits it hands out.
+ */
+namespace Protocol {
+
+enum class FrameType : uint8_t {
+    Hello = 1,
+    Credit = 2,
+    Batch = 3,
+    Send = 4,
+};
+
+constexpr uint32_t maxFrameLength = 16 * 1024 * 1024;
+
+template <typename Body>
+void writeFrame(vector<uint8_t>& buffer, FrameType type, Body&& body) {
+    auto start = buffer.size();
+    Writer writer(buffer);
+    writer.writeFixed32(0);
+    writer.writeByte(static_cast<uint8_t>(type));
+    body(writer);
+    auto length = static_cast<uint32_t>(buffer.size() - start - 4);
+    for (size_t i = 0; i < 4; ++i) {
+        buffer[start + i] = static_cast<uint8_t>(length >> (8 * i));
+    }
+}
+
+inline void writeHello(vector<uint8_t>& buffer, uint64_t processed,
+                       uint32_t credits) {
+    writeFrame(buffer, FrameType::Hello, [&](Writer& writer) {
+        writer.writeVarint(processed);
+        writer.writeVarint(credits);
+    });
+}
+
+inline void writeCredit(vector<uint8_t>& buffer, uint64_t processed,
+                        uint32_t credits) {
+    writeFrame(buffer, FrameType::Credit, [&](Writer& writer) {
+        writer.writeVarint(processed);
+        writer.writeVarint(credits);
+    });
+}
+
+inline void writeBatch(vector<uint8_t>& buffer,
+                       const vector<GatewayEvent>& events) {
+    writeFrame(buffer, FrameType::Batch, [&](Writer& writer) {
+        writer.writeVarint(events.size());
+        for (const auto& event : events) {
+            writer.write(event);
+        }
+    });
+}
+
+inline void writeSend(vector<uint8_t>& buffer, const string& recipient,
+                      const string& text, bool alarm = true) {
+    writeFrame(buffer, FrameType::Send, [&](Writer& writer) {
+        writer.write(recipient);
+        writer.write(text);
+        writer.writeByte(alarm ? 1 : 0);
+    });
+}
+
+/**
+ * @brief Splits received bytes into frames.
+ */
+class FrameParser {
+  public:
+    /**
+     * @brief Feeds received bytes and invokes the handler with the type and a
+     * reader over the body of every complete frame. The bytes do not need to
+     * be aligned with frame boundaries.
+     *
+     * @return false if the stream is corrupt; reset() before reusing it.
+     */
+    template <typename Handler>
+    bool feed(const uint8_t* data, size_t size, Handler&& handler) {
+        _buffer.insert(_buffer.end(), data, data + size);
+        size_t offset = 0;
+        while (_buffer.size() - offset >= 5) {
+            auto length = Reader(_buffer.data() + offset, 4).readFixed32();
+            if (length == 0 || length > maxFrameLength) {
+                _buffer.clear();
+                return false;
+            }
+            if (_buffer.size() - offset - 4 < length) {
+                break;
+            }
+            auto type = static_cast<FrameType>(_buffer[offset + 4]);
+            Reader body(_buffer.data() + offset + 5, length - 1);
+            try {
+                handler(type, body);
+            } catch (const DecodeError&) {
+                _buffer.clear();
+                return false;
+            }
+            offset += 4 + length;
+        }
+        _buffer.erase(_buffer.begin(),
+                      _buffer.begin() + static_cast<ptrdiff_t>(offset));
+        return true;
+    }
+
+    void reset() { _buffer.clear(); }
+
+  private:
+    vector<uint8_t> _buffer;
+};
+
+} // namespace Protocol
+
+/**
+ * @brief Statistics of a CreditSender.
+ */
+struct CreditStats {
+    uint64_t batches = 0;
+    uint64_t events = 0;
+    // How often events were waiting while App had no credits left
+    uint64_t stalls = 0;
+};
+
+/**
+ * @brief The gateway side of the flow control. It decides when a batch may be
+ * sent and what goes in it; the caller does the I/O.
+ *
+ * Events are read from a source, normally the journal, so nothing is held in
+ * memory while App has no credits: new events simply wait in the journal.
+ * When App reconnects it says which events it has processed, and sending
+ * resumes after those.
+ */
+class CreditSender : private Base::NonCopyable {
+  public:
+    /**
+     * @brief Reads up to maxCount events, starting at the given sequence
+     * number or the first one after it that still exists.
+     */
+    using Source =
+        function<void(uint64_t from, size_t maxCount, vector<GatewayEvent>&)>;
+
+    /**
+     * @brief Creates a new CreditSender.
+     *
+     * @param source the source of the events.
+     * @param maxBatchEvents the largest number of events in a batch.
+     */
+    explicit CreditSender(Source source, size_t maxBatchEvents = 64)
+        : _source(move(source)), _maxBatchEvents(maxBatchEvents) {}
+
+    /**
+     * @brief Handles the Hello of a newly connected App. Sending restarts
+     * after the last processed event, so batches that were in flight when
+     * the previous connection broke are sent again.
+     */
+    void connect(uint64_t processed, uint32_t credits) {
+        _connected = true;
+        _processed = max(_processed, processed);
+        _next = _processed + 1;
+        _credits = credits;
+        _stalled = false;
+    }
+
+    void disconnect() {
+        _connected = false;
+        _credits = 0;
+    }
+
+    /**
+     * @brief Handles a Credit frame.
+     */
+    void grant(uint64_t processed, uint32_t credits) {
+        _processed = max(_processed, processed);
+        _credits += credits;
+        _stalled = false;
+    }
+
+    /**
+     * @brief Tells the sender that events up to the given sequence number are
+     * available from the source.
+     */
+    void published(uint64_t sequence) {
+        _published = max(_published, sequence);
+    }
+
+    /**
+     * @brief Appends the next batch to the given buffer, if App is connected,
+     * has a credit left and there are events to send.
+     *
+     * @return true if a batch was written.
+     */
+    bool nextBatch(vector<uint8_t>& buffer) {
+        if (!_connected || _next > _published) {
+            return false;
+        }
+        if (_credits == 0) {
+            if (!_stalled) {
+                _stalled = true;
+                _stats.stalls++;
+            }
+            return false;
+        }
+        _batch.clear();
+        _source(_next, _maxBatchEvents, _batch);
+        if (_batch.empty()) {
+            return false;
+        }
+        Protocol::writeBatch(buffer, _batch);
+        _next = _batch.back().sequence + 1;
+        _credits--;
+        _stats.batches++;
+        _stats.events += _batch.size();
+        return true;
+    }
+
+    bool isConnected() const { return _connected; }
+
+    uint32_t credits() const { return _credits; }
+
+    /**
+     * @brief Returns the last event that App has reported as processed.
+     */
+    uint64_t processed() const { return _processed; }
+
+    /**
+     * @brief Returns the number of published events that App has not
+     * processed yet.
+     */
+    uint64_t backlog() const {
+        return _published > _processed ? _published - _processed : 0;
+    }
+
+    CreditStats const& stats() const { return _stats; }
+
+  private:
+    Source _source;
+    size_t _maxBatchEvents;
+    vector<GatewayEvent> _batch;
+    bool _connected = false;
+    bool _stalled = false;
+    uint32_t _credits = 0;
+    uint64_t _processed = 0;
+    uint64_t _next = 1;
+    uint64_t _published = 0;
+    CreditStats _stats;
+};
+
+/**
+ * @brief The App side of the flow control. It hands out a fixed window of
+ * credits and returns one credit for every batch once its events have been
+ * handled, so the gateway never has more than the window in flight and a
+ * stalled App stops the gateway instead of being flooded.
+ *
+ * The eventReceived handlers run from feed(); an event counts as processed
+ * when they return. Events that were already processed, because the gateway
+ * resends after a reconnect, are skipped.
+ *
+ * Handlers that keep events before they are done with them, such as the
+ * reorder window of an EventMerger, hold back the acknowledgement with
+ * setAcknowledged(): the gateway keeps unacknowledged events in its journal
+ * and sends them again to a restarted App.
+ */
+class CreditReceiver : private Base::NonCopyable {
+  public:
+    /**
+     * @brief Creates a new CreditReceiver.
+     *
+     * @param window the number of batches the gateway may have in flight.
+     * @param processed the last event processed before, e.g. by a previous
+     * run of App.
+     */
+    explicit CreditReceiver(uint32_t window = 8, uint64_t processed = 0)
+        : _window(max<uint32_t>(window, 1)), _processed(processed) {}
+
+    /**
+     * @brief Appends the Hello frame to send after connecting, and forgets
+     * any partial frame of a previous connection.
+     */
+    void hello(vector<uint8_t>& buffer) {
+        _parser.reset();
+        _reported = acknowledged();
+        Protocol::writeHello(buffer, _reported, _window);
+    }
+
+    /**
+     * @brief Feeds bytes received from the gateway and appends the credits to
+     * return to the given buffer.
+     *
+     * @return false if the stream is corrupt, in which case App should
+     * reconnect.
+     */
+    bool feed(const uint8_t* data, size_t size, vector<uint8_t>& reply) {
+        uint32_t credits = 0;
+        auto ok = _parser.feed(
+            data, size, [&](Protocol::FrameType type, Reader& reader) {
+                if (type != Protocol::FrameType::Batch) {
+                    throw DecodeError("Unexpected frame");
+                }
+                auto count = reader.readVarint();
+                for (uint64_t i = 0; i < count; ++i) {
+                    auto event = reader.read<GatewayEvent>();
+                    if (event.sequence > _processed) {
+                        _eventReceived.fire(*this, event);
+                        _processed = event.sequence;
+                    }
+                }
+                credits++;
+            });
+        if (credits > 0) {
+            _reported = acknowledged();
+            Protocol::writeCredit(reply, _reported, credits);
+        }
+        return ok;
+    }
+
+    /**
+     * @brief Limits the events reported to the gateway as processed to those
+     * up to the given sequence number, from now on.
+     */
+    void setAcknowledged(uint64_t sequence) {
+        _deferred = true;
+        _acknowledged = sequence;
+    }
+
+    /**
+     * @brief Appends a Credit frame without credits if the acknowledged
+     * position has advanced since it was last reported.
+     *
+     * @return true if a frame was written.
+     */
+    bool acknowledge(vector<uint8_t>& reply) {
+        if (acknowledged() <= _reported) {
+            return false;
+        }
+        _reported = acknowledged();
+        Protocol::writeCredit(reply, _reported, 0);
+        return true;
+    }
+
+    /**
+     * @brief Returns the last processed event.
+     */
+    uint64_t processed() const { return _processed; }
+
+    /**
+     * @brief Returns the last event that may be reported as processed.
+     */
+    uint64_t acknowledged() const {
+        return _deferred ? min(_acknowledged, _processed) : _processed;
+    }
+
+    uint32_t window() const { return _window; }
+
+    EVENT(eventReceived, CreditReceiver&, const GatewayEvent&)
+
+  private:
+    Protocol::FrameParser _parser;
+    uint32_t _window;
+    uint64_t _processed;
+    bool _deferred = false;
+    uint64_t _acknowledged = 0;
+    uint64_t _reported = 0;
+};
+
+} // namespace Base::Gateway
+
+#endif // GATEWAYLINK_H
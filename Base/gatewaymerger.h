@@ -0,0 +1,276 @@
+#ifndef GATEWAYMERGER_H
+#define GATEWAYMERGER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+#include "common.h"
+#include "event.h"
+#include "gatewaylink.h"
+#include "loopmonitor.h"
+
+namespace Base::Gateway {
+
+/**
+ * @brief Statistics of an EventMerger.
+ */
+struct MergerStats {
+    uint64_t received = 0;
+    uint64_t merged = 0;
+    // Copies of an SMS that another gateway delivered first
+    uint64_t duplicates = 0;
+    // Events that arrived after later ones had left the window
+    uint64_t late = 0;
+};
+
+/**
+ * @brief Merges the events of several gateways, such as two GsmGateways on
+ * different operators, into one stream in which every SMS appears once.
+ *
+ * Events are held for a reorder window and then handed on in the order of
+ * their SMSC timestamp, then gateway and sequence number, so replies that
+ * reach the gateways in a different order still come out in the order they
+ * were sent. An event that arrives after a later one has left the window is
+ * handed on at once and counted as late.
+ *
+ * The same SMS from the same sender with the same text, delivered by another
+ * gateway within the duplicate tolerance of its SMSC timestamp, is a copy and
+ * dropped; the first gateway to deliver it wins. Events of one gateway are
+ * never duplicates of each other: a responder may well send "YES" twice.
+ *
+ * The time an event spends in the window is recorded in latency(), in
+ * microseconds. merged() tells each gateway which of its events are done,
+ * for CreditReceiver::setAcknowledged().
+ *
+ * Not thread safe. Call release() at nextRelease(); add() releases what is
+ * due too.
+ */
+class EventMerger : private Base::NonCopyable {
+  public:
+    using Clock = chrono::steady_clock;
+
+    /**
+     * @brief Creates a new EventMerger.
+     *
+     * @param sources the number of gateways.
+     * @param window how long events are held for reordering; zero hands
+     * them on at once.
+     * @param duplicateTolerance how far the SMSC timestamps of two copies of
+     * an SMS may be apart.
+     * @param remembered the number of recent SMS kept to detect copies.
+     */
+    explicit EventMerger(
+        size_t sources,
+        chrono::milliseconds window = chrono::milliseconds(1000),
+        chrono::seconds duplicateTolerance = chrono::seconds(60),
+        size_t remembered = 4096)
+        : _window(window),
+          _tolerance(chrono::duration_cast<chrono::microseconds>(
+                         duplicateTolerance)
+                         .count()),
+          _remembered(max<size_t>(remembered, 1)), _added(sources, 0),
+          _pending(sources) {}
+
+    /**
+     * @brief Adds an event received from a gateway, and hands on what is
+     * due.
+     */
+    void add(size_t source, const GatewayEvent& event,
+             Clock::time_point now = Clock::now()) {
+        _stats.received++;
+        _added[source] = max(_added[source], event.sequence);
+        if (isDuplicate(source, event)) {
+            _stats.duplicates++;
+            release(now);
+            return;
+        }
+        Key key{event.timestamp, source, event.sequence};
+        if (_hasReleased && key < _lastReleased) {
+            _stats.late++;
+            _latency.record(0);
+            merge(source, event);
+            release(now);
+            return;
+        }
+        _buffer.emplace(key, Held{event, now});
+        _pending[source].insert(event.sequence);
+        _deadlines.push_back({now + _window, key});
+        release(now);
+    }
+
+    /**
+     * @brief Hands on, in order, the events whose window has passed and
+     * those that come before them.
+     */
+    void release(Clock::time_point now = Clock::now()) {
+        while (!_deadlines.empty() && _deadlines.front().deadline <= now) {
+            auto key = _deadlines.front().key;
+            _deadlines.pop_front();
+            // Events are released early when a later one's window passes
+            while (!_buffer.empty() && _buffer.begin()->first <= key) {
+                releaseFirst(now);
+            }
+        }
+        // Drop the deadlines of events that were released early
+        while (!_deadlines.empty() &&
+               (_buffer.empty() || _deadlines.front().key <= _lastReleased)) {
+            _deadlines.pop_front();
+        }
+    }
+
+    /**
+     * @brief Hands on every event in the window.
+     */
+    void flush(Clock::time_point now = Clock::now()) {
+        while (!_buffer.empty()) {
+            releaseFirst(now);
+        }
+        _deadlines.clear();
+    }
+
+    /**
+     * @brief Returns when release() should be called next, or
+     * Clock::time_point::max() if no event is held.
+     */
+    Clock::time_point nextRelease() const {
+        return _deadlines.empty() ? Clock::time_point::max()
+                                  : _deadlines.front().deadline;
+    }
+
+    size_t held() const { return _buffer.size(); }
+
+    /**
+     * @brief Returns the last sequence number of a gateway up to which every
+     * event has been handed on or dropped.
+     */
+    uint64_t merged(size_t source) const {
+        const auto& pending = _pending[source];
+        return pending.empty() ? _added[source] : *pending.begin() - 1;
+    }
+
+    const Diagnostics::Histogram& latency() const { return _latency; }
+
+    const MergerStats& stats() const { return _stats; }
+
+    EVENT(eventMerged, size_t, const GatewayEvent&)
+
+  private:
+    // SMSC timestamp, gateway, sequence number
+    using Key = tuple<int64_t, size_t, uint64_t>;
+
+    struct Held {
+        GatewayEvent event;
+        Clock::time_point added;
+    };
+
+    struct Deadline {
+        Clock::time_point deadline;
+        Key key;
+    };
+
+    struct Copy {
+        uint64_t fingerprint;
+        size_t source;
+        int64_t timestamp;
+    };
+
+    static uint64_t fingerprintOf(const GatewayEvent& event) {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash](char c) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        };
+        for (auto c : event.sender) {
+            add(c);
+        }
+        add(0);
+        for (auto c : event.text) {
+            add(c);
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Returns whether another gateway delivered the SMS already, and
+     * remembers it otherwise.
+     */
+    bool isDuplicate(size_t source, const GatewayEvent& event) {
+        auto fingerprint = fingerprintOf(event);
+        auto range = _copies.equal_range(fingerprint);
+        for (auto copy = range.first; copy != range.second; ++copy) {
+            const auto& seen = _recent[copy->second - _recentBase];
+            auto distance = seen.timestamp > event.timestamp
+                                ? seen.timestamp - event.timestamp
+                                : event.timestamp - seen.timestamp;
+            if (seen.source != source && distance <= _tolerance) {
+                return true;
+            }
+        }
+        _copies.emplace(fingerprint, _recentBase + _recent.size());
+        _recent.push_back({fingerprint, source, event.timestamp});
+        if (_recent.size() > _remembered) {
+            // Forget the oldest, which has the lowest index of its range
+            auto oldest = _copies.equal_range(_recent.front().fingerprint);
+            for (auto copy = oldest.first; copy != oldest.second; ++copy) {
+                if (copy->second == _recentBase) {
+                    _copies.erase(copy);
+                    break;
+                }
+            }
+            _recent.pop_front();
+            _recentBase++;
+        }
+        return false;
+    }
+
+    void releaseFirst(Clock::time_point now) {
+        auto first = _buffer.begin();
+        auto source = get<1>(first->first);
+        auto event = move(first->second.event);
+        auto added = first->second.added;
+        _lastReleased = first->first;
+        _hasReleased = true;
+        _buffer.erase(first);
+        _pending[source].erase(event.sequence);
+        _latency.record(static_cast<uint64_t>(
+            chrono::duration_cast<chrono::microseconds>(now - added)
+                .count()));
+        merge(source, event);
+    }
+
+    void merge(size_t source, const GatewayEvent& event) {
+        _stats.merged++;
+        _eventMerged.fire(source, event);
+    }
+
+    chrono::milliseconds _window;
+    int64_t _tolerance;
+    size_t _remembered;
+    map<Key, Held> _buffer;
+    deque<Deadline> _deadlines;
+    Key _lastReleased;
+    bool _hasReleased = false;
+    // The last sequence number added and those still held, per gateway
+    vector<uint64_t> _added;
+    vector<set<uint64_t>> _pending;
+    // The recent SMS by fingerprint, as their index in _recent plus
+    // _recentBase
+    unordered_multimap<uint64_t, uint64_t> _copies;
+    deque<Copy> _recent;
+    uint64_t _recentBase = 0;
+    Diagnostics::Histogram _latency;
+    MergerStats _stats;
+};
+
+} // namespace Base::Gateway
+
+#endif // GATEWAYMERGER_H
@@ -0,0 +1,392 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+/**
+ * Instrumentation of events, properties and collections, for finding out in
+ * production which model types are hot. It is compiled in only when
+ * BASE_INSTRUMENTATION is defined; otherwise the hooks below expand to
+ * nothing and this header declares nothing else.
+ *
+ * Every instantiated Event, Property and Collection type gets a site that
+ * counts its operations, the distribution of subscriber counts of fired
+ * events and item counts of sorted collections, and a histogram of the time
+ * spent firing and sorting. Each thread records into a slot of its own, so
+ * the hooks never contend; Registry::stats() adds the slots up on demand.
+ */
+
+#ifdef BASE_INSTRUMENTATION
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+using namespace std;
+
+namespace Base::Instrumentation {
+
+enum class Kind : uint8_t { Event, Property, Collection };
+
+enum class Operation : uint8_t {
+    Fire,
+    Subscribe,
+    Unsubscribe,
+    SetValue,
+    Clear,
+    Add,
+    Remove,
+    Sort,
+};
+
+constexpr size_t operationCount = 8;
+
+inline const char* operationName(Operation operation) {
+    static const char* names[operationCount] = {
+        "fire", "subscribe", "unsubscribe", "setValue",
+        "clear", "add", "remove", "sort"};
+    return names[static_cast<size_t>(operation)];
+}
+
+constexpr Kind kindOf(Operation operation) {
+    return operation <= Operation::Unsubscribe ? Kind::Event
+           : operation <= Operation::Clear     ? Kind::Property
+                                               : Kind::Collection;
+}
+
+/**
+ * @brief Power of two buckets: bucket 0 holds 0, bucket i holds values from
+ * 2^(i-1) up to 2^i - 1, and the last bucket everything above.
+ */
+constexpr size_t timeBucketCount = 40;
+constexpr size_t sizeBucketCount = 24;
+
+inline size_t bucketOf(uint64_t value, size_t bucketCount) {
+    size_t bucket = 0;
+    while (value > 0 && bucket + 1 < bucketCount) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief The counters of one site written by one thread.
+ */
+struct alignas(64) ThreadSlot {
+    array<atomic<uint64_t>, operationCount> counts{};
+    // Nanoseconds spent firing or sorting
+    atomic<uint64_t> nanos{0};
+    array<atomic<uint64_t>, timeBucketCount> timeBuckets{};
+    // Subscribers per fire, or items per sort
+    array<atomic<uint64_t>, sizeBucketCount> sizeBuckets{};
+};
+
+/**
+ * @brief The aggregated counters of one site.
+ */
+struct SiteStats {
+    string name;
+    Kind kind = Kind::Event;
+    array<uint64_t, operationCount> counts{};
+    uint64_t nanos = 0;
+    array<uint64_t, timeBucketCount> timeBuckets{};
+    array<uint64_t, sizeBucketCount> sizeBuckets{};
+
+    uint64_t count(Operation operation) const {
+        return counts[static_cast<size_t>(operation)];
+    }
+
+    uint64_t total() const {
+        uint64_t total = 0;
+        for (auto count : counts) {
+            total += count;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Returns an upper bound of the given quantile (0 to 1) of the
+     * firing or sorting time, in nanoseconds.
+     */
+    uint64_t timeQuantile(double quantile) const {
+        return quantileOf(timeBuckets.data(), timeBucketCount, quantile);
+    }
+
+    /**
+     * @brief Returns an upper bound of the given quantile of the subscriber
+     * or item counts.
+     */
+    uint64_t sizeQuantile(double quantile) const {
+        return quantileOf(sizeBuckets.data(), sizeBucketCount, quantile);
+    }
+
+  private:
+    static uint64_t quantileOf(const uint64_t* buckets, size_t bucketCount,
+                               double quantile) {
+        uint64_t total = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            total += buckets[i];
+        }
+        if (total == 0) {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(quantile * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return i == 0 ? 0 : (uint64_t(1) << i) - 1;
+            }
+        }
+        return (uint64_t(1) << (bucketCount - 1)) - 1;
+    }
+};
+
+/**
+ * @brief The instrumentation of one Event, Property or Collection type.
+ */
+class Site {
+  public:
+    static constexpr size_t slotCount = 32;
+
+    Site(string name, Kind kind)
+        : _name(move(name)), _kind(kind), _slots(new ThreadSlot[slotCount]) {}
+
+    /**
+     * @brief Returns the slot of the calling thread. Threads beyond
+     * slotCount share slots, which only costs some contention.
+     */
+    ThreadSlot& slot() { return _slots[threadIndex() % slotCount]; }
+
+    void count(Operation operation) {
+        slot().counts[static_cast<size_t>(operation)].fetch_add(
+            1, memory_order_relaxed);
+    }
+
+    void record(Operation operation, uint64_t size, uint64_t nanos) {
+        auto& slot = this->slot();
+        slot.counts[static_cast<size_t>(operation)].fetch_add(
+            1, memory_order_relaxed);
+        slot.nanos.fetch_add(nanos, memory_order_relaxed);
+        slot.timeBuckets[bucketOf(nanos, timeBucketCount)].fetch_add(
+            1, memory_order_relaxed);
+        slot.sizeBuckets[bucketOf(size, sizeBucketCount)].fetch_add(
+            1, memory_order_relaxed);
+    }
+
+    SiteStats stats() const {
+        SiteStats stats;
+        stats.name = _name;
+        stats.kind = _kind;
+        for (size_t s = 0; s < slotCount; ++s) {
+            const auto& slot = _slots[s];
+            for (size_t i = 0; i < operationCount; ++i) {
+                stats.counts[i] += slot.counts[i].load(memory_order_relaxed);
+            }
+            stats.nanos += slot.nanos.load(memory_order_relaxed);
+            for (size_t i = 0; i < timeBucketCount; ++i) {
+                stats.timeBuckets[i] +=
+                    slot.timeBuckets[i].load(memory_order_relaxed);
+            }
+            for (size_t i = 0; i < sizeBucketCount; ++i) {
+                stats.sizeBuckets[i] +=
+                    slot.sizeBuckets[i].load(memory_order_relaxed);
+            }
+        }
+        return stats;
+    }
+
+    void reset() {
+        for (size_t s = 0; s < slotCount; ++s) {
+            auto& slot = _slots[s];
+            for (auto& count : slot.counts) {
+                count.store(0, memory_order_relaxed);
+            }
+            slot.nanos.store(0, memory_order_relaxed);
+            for (auto& bucket : slot.timeBuckets) {
+                bucket.store(0, memory_order_relaxed);
+            }
+            for (auto& bucket : slot.sizeBuckets) {
+                bucket.store(0, memory_order_relaxed);
+            }
+        }
+    }
+
+  private:
+    static size_t threadIndex() {
+        static atomic<size_t> nextIndex{0};
+        thread_local size_t index =
+            nextIndex.fetch_add(1, memory_order_relaxed);
+        return index;
+    }
+
+    string _name;
+    Kind _kind;
+    unique_ptr<ThreadSlot[]> _slots;
+};
+
+/**
+ * @brief All sites of the process.
+ */
+class Registry {
+  public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    Site& add(string name, Kind kind) {
+        lock_guard<mutex> lock(_mutex);
+        _sites.push_back(make_unique<Site>(move(name), kind));
+        return *_sites.back();
+    }
+
+    /**
+     * @brief Returns the statistics of all sites, busiest first.
+     */
+    vector<SiteStats> stats() const {
+        vector<SiteStats> stats;
+        {
+            lock_guard<mutex> lock(_mutex);
+            for (const auto& site : _sites) {
+                stats.push_back(site->stats());
+            }
+        }
+        sort(stats.begin(), stats.end(),
+             [](const SiteStats& s1, const SiteStats& s2) {
+                 return s1.total() > s2.total();
+             });
+        return stats;
+    }
+
+    void reset() {
+        lock_guard<mutex> lock(_mutex);
+        for (auto& site : _sites) {
+            site->reset();
+        }
+    }
+
+    /**
+     * @brief Returns one line per site with its counts and, for sites that
+     * fire or sort, the median and 99th percentile of time and size.
+     *
+     * @param maxSites the number of busiest sites to include.
+     */
+    string report(size_t maxSites = 20) const {
+        ostringstream report;
+        auto stats = this->stats();
+        for (size_t i = 0; i < stats.size() && i < maxSites; ++i) {
+            const auto& site = stats[i];
+            if (site.total() == 0) {
+                break;
+            }
+            report << site.name;
+            for (size_t op = 0; op < operationCount; ++op) {
+                if (site.counts[op] > 0) {
+                    report << " " << operationName(Operation(op)) << "="
+                           << site.counts[op];
+                }
+            }
+            if (site.count(Operation::Fire) + site.count(Operation::Sort) >
+                0) {
+                report << " ns p50<=" << site.timeQuantile(0.5)
+                       << " p99<=" << site.timeQuantile(0.99)
+                       << " size p50<=" << site.sizeQuantile(0.5)
+                       << " p99<=" << site.sizeQuantile(0.99);
+            }
+            report << "\n";
+        }
+        return report.str();
+    }
+
+  private:
+    mutable mutex _mutex;
+    vector<unique_ptr<Site>> _sites;
+};
+
+template <typename T> string typeName() {
+    const char* name = typeid(T).name();
+#ifdef __GNUG__
+    int status = 0;
+    unique_ptr<char, void (*)(void*)> demangled(
+        abi::__cxa_demangle(name, nullptr, nullptr, &status), free);
+    if (status == 0) {
+        return demangled.get();
+    }
+#endif
+    return name;
+}
+
+/**
+ * @brief Returns the site of the given type, registering it on first use.
+ */
+template <typename T, Kind kind> Site& siteOf() {
+    static Site& site = Registry::instance().add(typeName<T>(), kind);
+    return site;
+}
+
+/**
+ * @brief Records a timed operation when it goes out of scope.
+ */
+class Scope {
+  public:
+    Scope(Site& site, Operation operation, uint64_t size)
+        : _site(site), _operation(operation), _size(size),
+          _start(chrono::steady_clock::now()) {}
+
+    ~Scope() {
+        auto nanos = chrono::duration_cast<chrono::nanoseconds>(
+                         chrono::steady_clock::now() - _start)
+                         .count();
+        _site.record(_operation, _size, static_cast<uint64_t>(nanos));
+    }
+
+  private:
+    Site& _site;
+    Operation _operation;
+    uint64_t _size;
+    chrono::steady_clock::time_point _start;
+};
+
+} // namespace Base::Instrumentation
+
+/**
+ * Counts an operation on the given type.
+ */
+#define BASE_INSTRUMENT_COUNT(Type, operation)                                 \
+    ::Base::Instrumentation::siteOf<                                           \
+        Type, ::Base::Instrumentation::kindOf(                                 \
+                  ::Base::Instrumentation::Operation::operation)>()            \
+        .count(::Base::Instrumentation::Operation::operation)
+
+/**
+ * Times an operation on the given type until the end of the enclosing scope
+ * and records its size, i.e. the number of subscribers or items.
+ */
+#define BASE_INSTRUMENT_SCOPE(Type, operation, size)                           \
+    ::Base::Instrumentation::Scope baseInstrumentationScope(                   \
+        ::Base::Instrumentation::siteOf<                                       \
+            Type, ::Base::Instrumentation::kindOf(                             \
+                      ::Base::Instrumentation::Operation::operation)>(),       \
+        ::Base::Instrumentation::Operation::operation, (size))
+
+#else
+
+#define BASE_INSTRUMENT_COUNT(Type, operation)
+#define BASE_INSTRUMENT_SCOPE(Type, operation, size)
+
+#endif // BASE_INSTRUMENTATION
+
+#endif // INSTRUMENTATION_H
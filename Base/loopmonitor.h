@@ -0,0 +1,466 @@
+#ifndef LOOPMONITOR_H
+#define LOOPMONITOR_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define BASE_LOOPMONITOR_STACKS
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+using namespace std;
+
+#include "common.h"
+
+namespace Base::Diagnostics {
+
+/**
+ * @brief A histogram of non-negative values with log-linear buckets: values
+ * below 16 have buckets of their own and every power of two above that is
+ * split into 16 buckets, so percentiles are accurate to within 6.25%.
+ *
+ * One thread records while any thread reads; the counters are atomic but a
+ * reader may see a recording half done.
+ */
+class Histogram {
+  public:
+    static constexpr size_t bucketCount = 16 + 60 * 16;
+
+    void record(uint64_t value) {
+        _buckets[indexOf(value)].fetch_add(1, memory_order_relaxed);
+        _count.fetch_add(1, memory_order_relaxed);
+        _sum.fetch_add(value, memory_order_relaxed);
+        if (value > _max.load(memory_order_relaxed)) {
+            _max.store(value, memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const { return _count.load(memory_order_relaxed); }
+
+    uint64_t max() const { return _max.load(memory_order_relaxed); }
+
+    double mean() const {
+        auto count = this->count();
+        return count > 0
+                   ? static_cast<double>(_sum.load(memory_order_relaxed)) /
+                         count
+                   : 0;
+    }
+
+    /**
+     * @brief Returns the value below which the given percentage of the
+     * recorded values fall, rounded up to the end of its bucket.
+     *
+     * @param percent the percentile, e.g. 99.9.
+     */
+    uint64_t percentile(double percent) const {
+        auto count = this->count();
+        if (count == 0) {
+            return 0;
+        }
+        auto target = static_cast<uint64_t>(percent / 100 * count + 0.5);
+        target = target == 0 ? 1 : target;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            seen += _buckets[i].load(memory_order_relaxed);
+            if (seen >= target) {
+                return min(upperBound(i), max());
+            }
+        }
+        return max();
+    }
+
+    /**
+     * @brief Calls the given function with the bounds (inclusive) and count
+     * of every non-empty bucket, in ascending order.
+     */
+    template <typename Function> void forEachBucket(Function&& function) const {
+        for (size_t i = 0; i < bucketCount; ++i) {
+            auto count = _buckets[i].load(memory_order_relaxed);
+            if (count > 0) {
+                function(lowerBound(i), upperBound(i), count);
+            }
+        }
+    }
+
+    /**
+     * @brief Returns a one line summary, e.g. "n=120 p50=3 p90=12 p99=250
+     * p99.9=900 max=1210".
+     */
+    string summary() const {
+        return "n=" + to_string(count()) +
+               " p50=" + to_string(percentile(50)) +
+               " p90=" + to_string(percentile(90)) +
+               " p99=" + to_string(percentile(99)) +
+               " p99.9=" + to_string(percentile(99.9)) +
+               " max=" + to_string(max());
+    }
+
+    void reset() {
+        for (auto& bucket : _buckets) {
+            bucket.store(0, memory_order_relaxed);
+        }
+        _count.store(0, memory_order_relaxed);
+        _sum.store(0, memory_order_relaxed);
+        _max.store(0, memory_order_relaxed);
+    }
+
+    static size_t indexOf(uint64_t value) {
+        if (value < 16) {
+            return static_cast<size_t>(value);
+        }
+        int exponent = 4;
+        while (exponent < 63 && (value >> (exponent + 1)) != 0) {
+            ++exponent;
+        }
+        auto subBucket = (value >> (exponent - 4)) & 15;
+        return static_cast<size_t>(16 + (exponent - 4) * 16 + subBucket);
+    }
+
+    static uint64_t lowerBound(size_t index) {
+        if (index < 16) {
+            return index;
+        }
+        auto exponent = (index - 16) / 16 + 4;
+        return (16 + (index - 16) % 16) << (exponent - 4);
+    }
+
+    static uint64_t upperBound(size_t index) {
+        return index + 1 < bucketCount ? lowerBound(index + 1) - 1
+                                       : UINT64_MAX;
+    }
+
+  private:
+    array<atomic<uint64_t>, bucketCount> _buckets{};
+    atomic<uint64_t> _count{0};
+    atomic<uint64_t> _sum{0};
+    atomic<uint64_t> _max{0};
+};
+
+#ifdef BASE_LOOPMONITOR_STACKS
+/**
+ * @brief Captures the stack of another thread by signalling it and calling
+ * backtrace() in the signal handler. The handler is installed with
+ * SA_RESTART, so that system calls interrupted by it are restarted.
+ *
+ * Every capture has a generation. The handler only records a stack for the
+ * pending generation on the target thread and claims it first, so a signal
+ * that arrives after its capture timed out cannot write into the next one.
+ * Signals that are not for a capture go to the handler that was installed
+ * before.
+ */
+namespace StackCapture {
+
+// Rarely used and ignored by default
+constexpr int signalNumber = SIGURG;
+constexpr int maxFrames = 64;
+
+struct State {
+    // The generation of the capture waiting for a stack, 0 if none
+    atomic<uint64_t> requested{0};
+    // The generation whose stack is in addresses
+    atomic<uint64_t> completed{0};
+    uint64_t generation = 0;
+    pthread_t target{};
+    int frames = 0;
+    void* addresses[maxFrames];
+    struct sigaction previous {};
+};
+
+inline State state;
+inline mutex captureMutex;
+
+inline void handleSignal(int signal, siginfo_t* info, void* context) {
+    auto generation = state.requested.load(memory_order_acquire);
+    if (generation != 0 && pthread_equal(pthread_self(), state.target) &&
+        state.requested.compare_exchange_strong(generation, 0,
+                                                memory_order_acq_rel)) {
+        state.frames = backtrace(state.addresses, maxFrames);
+        state.completed.store(generation, memory_order_release);
+        return;
+    }
+    const auto& previous = state.previous;
+    if (previous.sa_flags & SA_SIGINFO) {
+        if (previous.sa_sigaction != nullptr) {
+            previous.sa_sigaction(signal, info, context);
+        }
+    } else if (previous.sa_handler != SIG_DFL &&
+               previous.sa_handler != SIG_IGN) {
+        previous.sa_handler(signal);
+    }
+}
+
+inline void install() {
+    static once_flag installed;
+    call_once(installed, [] {
+        // The first call of backtrace() loads libgcc, which is not safe in
+        // a signal handler
+        void* address;
+        backtrace(&address, 1);
+        struct sigaction action {};
+        action.sa_sigaction = &handleSignal;
+        action.sa_flags = SA_RESTART | SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(signalNumber, &action, &state.previous);
+    });
+}
+
+/**
+ * @brief Returns the symbolized stack of the given thread, or an empty vector
+ * if the thread did not respond within the timeout.
+ */
+inline vector<string> capture(pthread_t thread,
+                              chrono::milliseconds timeout) {
+    install();
+    lock_guard<mutex> lock(captureMutex);
+    auto generation = ++state.generation;
+    state.target = thread;
+    state.requested.store(generation, memory_order_release);
+    if (pthread_kill(thread, signalNumber) != 0) {
+        state.requested.store(0, memory_order_relaxed);
+        return {};
+    }
+    auto deadline = chrono::steady_clock::now() + timeout;
+    while (state.completed.load(memory_order_acquire) != generation) {
+        if (chrono::steady_clock::now() > deadline &&
+            state.requested.exchange(0, memory_order_acq_rel) ==
+                generation) {
+            // Not claimed, so a late signal finds nothing to write
+            return {};
+        }
+        // Otherwise the handler is running and finishes shortly
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+    auto frames = state.frames;
+    vector<string> stack;
+    auto symbols = backtrace_symbols(state.addresses, frames);
+    if (symbols != nullptr) {
+        // Skip the signal handler and the signal trampoline
+        for (int i = 2; i < frames; ++i) {
+            stack.emplace_back(symbols[i]);
+        }
+        free(symbols);
+    }
+    return stack;
+}
+
+} // namespace StackCapture
+#endif
+
+/**
+ * @brief A snapshot of an event loop that has not run its monitor tick for
+ * longer than the stall threshold.
+ */
+struct LoopStall {
+    string loop;
+    // How late the tick was when the snapshot was taken, in microseconds
+    int64_t lagMicros = 0;
+    // The innermost Activity of the loop thread, or empty
+    string activity;
+    // The stack of the loop thread, innermost frame first. Only captured on
+    // Linux with glibc.
+    vector<string> stack;
+};
+
+/**
+ * @brief Measures how late an event loop runs a periodic tick and catches the
+ * loop in the act when it stalls.
+ *
+ * The event loop integration (a QTimer or an asio timer) calls tick() every
+ * interval, rescheduling from the time of the previous tick; every tick
+ * records its lateness in the lag histogram. A watchdog thread notices when
+ * the next tick is overdue by more than the stall threshold while the loop is
+ * still blocked, and passes a LoopStall with the current Activity and the
+ * stack of the loop thread to the stall handler.
+ */
+class LoopMonitor : private Base::NonCopyable {
+  public:
+    /**
+     * @brief Names what the loop thread is doing for as long as the object
+     * lives. Activities nest; the innermost one is reported.
+     */
+    class Activity {
+      public:
+        /**
+         * @brief Starts the activity. Must be created on the loop thread.
+         *
+         * @param monitor the monitor of the loop.
+         * @param name the name of the activity, a string literal or a string
+         * that outlives the activity.
+         */
+        explicit Activity(LoopMonitor& monitor, const char* name)
+            : _monitor(monitor),
+              _previous(monitor._activity.load(memory_order_relaxed)) {
+            monitor._activity.store(name, memory_order_relaxed);
+        }
+
+        ~Activity() {
+            _monitor._activity.store(_previous, memory_order_relaxed);
+        }
+
+        Activity(const Activity&) = delete;
+        Activity& operator=(const Activity&) = delete;
+
+      private:
+        LoopMonitor& _monitor;
+        const char* _previous;
+    };
+
+    /**
+     * @brief Creates a new LoopMonitor.
+     *
+     * @param name the name of the loop in stall reports.
+     * @param interval the interval of the ticks.
+     * @param stallThreshold how late a tick must be to count as a stall.
+     */
+    explicit LoopMonitor(const string& name,
+                         chrono::milliseconds interval =
+                             chrono::milliseconds(50),
+                         chrono::milliseconds stallThreshold =
+                             chrono::milliseconds(250))
+        : _name(name), _interval(interval), _stallThreshold(stallThreshold) {}
+
+    ~LoopMonitor() override { stop(); }
+
+    /**
+     * @brief Starts the watchdog. Must be called on the loop thread, right
+     * before the first tick is scheduled.
+     */
+    void start() {
+        stop();
+#ifdef BASE_LOOPMONITOR_STACKS
+        _loopThread = pthread_self();
+        StackCapture::install();
+#endif
+        _lastTick = now();
+        _beat.store(_lastTick, memory_order_release);
+        _stopping = false;
+        _watchdog = thread(&LoopMonitor::watch, this);
+    }
+
+    void stop() {
+        if (!_watchdog.joinable()) {
+            return;
+        }
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wakeUp.notify_one();
+        _watchdog.join();
+    }
+
+    /**
+     * @brief Records a tick. Call from the loop every interval.
+     */
+    void tick() {
+        auto time = now();
+        auto lag = time - _lastTick - micros(_interval);
+        _lag.record(lag > 0 ? static_cast<uint64_t>(lag) : 0);
+        _lastTick = time;
+        _beat.store(time, memory_order_release);
+    }
+
+    /**
+     * @brief Sets the function that receives stall snapshots. It is called on
+     * the watchdog thread while the loop is still stalled.
+     */
+    void setStallHandler(const function<void(const LoopStall&)>& handler) {
+        lock_guard<mutex> lock(_mutex);
+        _stallHandler = handler;
+    }
+
+    const string& name() const { return _name; }
+
+    chrono::milliseconds interval() const { return _interval; }
+
+    /**
+     * @brief Returns the histogram of tick lateness, in microseconds.
+     */
+    Histogram const& lag() const { return _lag; }
+
+    Histogram& lag() { return _lag; }
+
+    /**
+     * @brief Returns the number of stalls caught by the watchdog.
+     */
+    uint64_t stalls() const { return _stalls.load(memory_order_relaxed); }
+
+  private:
+    static int64_t now() {
+        return micros(chrono::steady_clock::now().time_since_epoch());
+    }
+
+    template <typename Duration> static int64_t micros(Duration duration) {
+        return chrono::duration_cast<chrono::microseconds>(duration).count();
+    }
+
+    void watch() {
+        int64_t reportedBeat = -1;
+        unique_lock<mutex> lock(_mutex);
+        while (!_stopping) {
+            _wakeUp.wait_for(lock, _interval / 2,
+                             [this] { return _stopping; });
+            auto beat = _beat.load(memory_order_acquire);
+            auto lag = now() - beat - micros(_interval);
+            if (_stopping || beat == reportedBeat ||
+                lag <= micros(_stallThreshold)) {
+                continue;
+            }
+            // Report every stall once, however long it lasts
+            reportedBeat = beat;
+            _stalls.fetch_add(1, memory_order_relaxed);
+            LoopStall stall;
+            stall.loop = _name;
+            stall.lagMicros = lag;
+            auto activity = _activity.load(memory_order_relaxed);
+            stall.activity = activity != nullptr ? activity : "";
+#ifdef BASE_LOOPMONITOR_STACKS
+            stall.stack = StackCapture::capture(_loopThread,
+                                                chrono::milliseconds(100));
+#endif
+            auto handler = _stallHandler;
+            lock.unlock();
+            if (handler) {
+                handler(stall);
+            }
+            lock.lock();
+        }
+    }
+
+    string _name;
+    chrono::milliseconds _interval;
+    chrono::milliseconds _stallThreshold;
+    Histogram _lag;
+
+    // Only used by the loop thread
+    int64_t _lastTick = 0;
+
+    atomic<int64_t> _beat{0};
+    atomic<const char*> _activity{nullptr};
+    atomic<uint64_t> _stalls{0};
+#ifdef BASE_LOOPMONITOR_STACKS
+    pthread_t _loopThread{};
+#endif
+
+    mutex _mutex;
+    condition_variable _wakeUp;
+    bool _stopping = false;
+    function<void(const LoopStall&)> _stallHandler;
+    thread _watchdog;
+};
+
+} // namespace Base::Diagnostics
+
+#endif // LOOPMONITOR_H
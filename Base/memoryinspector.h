@@ -0,0 +1,157 @@
+#ifndef MEMORYINSPECTOR_H
+#define MEMORYINSPECTOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#include "common.h"
+#include "field.h"
+#include "memoryusage.h"
+#include "model.h"
+
+namespace Base::Diagnostics {
+
+using Base::Model::Collection;
+using Base::Model::Schema;
+
+/**
+ * @brief Returns the memory used by a collection including the values and
+ * subscribers of the schema properties of its items. Visits every item, so
+ * call it from the thread that owns the collection, and not too often. An
+ * evicted collection is not reloaded; only its own usage is counted.
+ */
+template <typename Id, typename Item, typename... Fields>
+MemoryUsage memoryUsage(const Collection<Id, Item>& collection,
+                        const Schema<Item, Fields...>& schema) {
+    auto usage = collection.memoryUsage();
+    if (collection.isEvicted()) {
+        return usage;
+    }
+    for (const auto& id : collection.ids()) {
+        const auto& item = collection.findById(id);
+        schema.forEach([&](auto, const auto& field) {
+            auto property = field.of(item).memoryUsage();
+            usage.valueBytes += property.valueBytes;
+            usage.eventBytes += property.eventBytes;
+            usage.subscribers += property.subscribers;
+        });
+    }
+    return usage;
+}
+
+/**
+ * @brief Formats a number of bytes with a binary unit, e.g. "1.5 MiB".
+ */
+inline string formatBytes(double bytes) {
+    static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    size_t unit = 0;
+    while (bytes >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        bytes /= 1024;
+        unit++;
+    }
+    ostringstream text;
+    text << fixed << setprecision(unit == 0 ? 0 : 1) << bytes << " "
+         << units[unit];
+    return text.str();
+}
+
+/**
+ * @brief Measures the memory of the registered models on demand and reports
+ * it by model type, to find out where the memory goes and what each object
+ * costs.
+ *
+ * Models are measured when measure() or report() is called, on the calling
+ * thread, so call them from the thread that owns the models. Models
+ * registered under the same type name are added up.
+ */
+class MemoryInspector : private Base::NonCopyable {
+  public:
+    using Measure = function<MemoryUsage()>;
+
+    /**
+     * @brief Registers a model.
+     *
+     * @param type the model type to report the memory under.
+     * @param measure a function that measures the model.
+     * @return a key for unwatch().
+     */
+    uint64_t watch(const string& type, Measure measure) {
+        _watched.emplace(++_lastKey, make_pair(type, move(measure)));
+        return _lastKey;
+    }
+
+    /**
+     * @brief Registers a collection, including the schema properties of its
+     * items. The collection must stay in place until it is unwatched.
+     */
+    template <typename Id, typename Item, typename... Fields>
+    uint64_t watch(const string& type, const Collection<Id, Item>& collection,
+                   const Schema<Item, Fields...>& schema) {
+        return watch(type, [&collection, schema]() {
+            return memoryUsage(collection, schema);
+        });
+    }
+
+    void unwatch(uint64_t key) { _watched.erase(key); }
+
+    /**
+     * @brief Measures all models and returns their memory by type, the
+     * largest first.
+     */
+    vector<pair<string, MemoryUsage>> measure() const {
+        map<string, MemoryUsage> byType;
+        for (const auto& watched : _watched) {
+            byType[watched.second.first] += watched.second.second();
+        }
+        vector<pair<string, MemoryUsage>> usages(byType.begin(),
+                                                 byType.end());
+        sort(usages.begin(), usages.end(), [](const auto& u1, const auto& u2) {
+            return u1.second.total() > u2.second.total();
+        });
+        return usages;
+    }
+
+    /**
+     * @brief Returns one line per model type with its total, the cost per
+     * object and the breakdown of the total, followed by the grand total.
+     */
+    string report() const {
+        ostringstream report;
+        MemoryUsage all;
+        for (const auto& usage : measure()) {
+            const auto& u = usage.second;
+            report << usage.first << ": " << formatBytes(u.total()) << " for "
+                   << u.objects << " objects";
+            if (u.objects > 0) {
+                report << " (" << formatBytes(double(u.total()) / u.objects)
+                       << " each)";
+            }
+            report << ", objects " << formatBytes(u.objectBytes)
+                   << ", containers " << formatBytes(u.containerBytes)
+                   << ", values " << formatBytes(u.valueBytes) << ", events "
+                   << formatBytes(u.eventBytes) << " for " << u.subscribers
+                   << " subscribers\n";
+            all += u;
+        }
+        report << "Total: " << formatBytes(all.total()) << " for "
+               << all.objects << " objects\n";
+        return report.str();
+    }
+
+  private:
+    uint64_t _lastKey = 0;
+    map<uint64_t, pair<string, Measure>> _watched;
+};
+
+} // namespace Base::Diagnostics
+
+#endif // MEMORYINSPECTOR_H
@@ -0,0 +1,120 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef QT_CORE_LIB
+#include <QString>
+#endif
+
+using namespace std;
+
+namespace Base::Diagnostics {
+
+/**
+ * @brief An estimate of the memory used by model objects, in bytes.
+ * Allocator overhead is not included, so the real usage is somewhat higher.
+ */
+struct MemoryUsage {
+    // Number of items
+    size_t objects = 0;
+    // The items themselves, including their properties and events
+    size_t objectBytes = 0;
+    // Indexes and tree nodes of collections
+    size_t containerBytes = 0;
+    // Heap memory owned by property values, e.g. long strings
+    size_t valueBytes = 0;
+    // Subscriber lists and subscribers of events
+    size_t eventBytes = 0;
+    // Number of subscribers
+    size_t subscribers = 0;
+
+    size_t total() const {
+        return objectBytes + containerBytes + valueBytes + eventBytes;
+    }
+
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        objects += other.objects;
+        objectBytes += other.objectBytes;
+        containerBytes += other.containerBytes;
+        valueBytes += other.valueBytes;
+        eventBytes += other.eventBytes;
+        subscribers += other.subscribers;
+        return *this;
+    }
+};
+
+/**
+ * @brief The size of a tree node of std::map and std::set without the value:
+ * color, parent, left and right.
+ */
+constexpr size_t treeNodeOverhead = 4 * sizeof(void*);
+
+/**
+ * @brief Returns the heap memory owned by a value, not counting sizeof the
+ * value itself. Specialize this for value types that own heap memory;
+ * strings, vectors and optionals are handled here.
+ */
+template <typename T, typename = void> struct HeapSize {
+    static size_t of(const T&) { return 0; }
+};
+
+template <typename T> size_t heapSizeOf(const T& value) {
+    return HeapSize<T>::of(value);
+}
+
+template <> struct HeapSize<string> {
+    static size_t of(const string& value) {
+        // Short strings are stored inside the string object
+        auto data = reinterpret_cast<const char*>(value.data());
+        auto object = reinterpret_cast<const char*>(&value);
+        if (data >= object && data < object + sizeof(string)) {
+            return 0;
+        }
+        return value.capacity() + 1;
+    }
+};
+
+template <typename T> struct HeapSize<vector<T>> {
+    static size_t of(const vector<T>& value) {
+        auto size = value.capacity() * sizeof(T);
+        for (const auto& element : value) {
+            size += heapSizeOf(element);
+        }
+        return size;
+    }
+};
+
+template <typename T> struct HeapSize<optional<T>> {
+    static size_t of(const optional<T>& value) {
+        return value.has_value() ? heapSizeOf(*value) : 0;
+    }
+};
+
+#ifdef QT_CORE_LIB
+/**
+ * @brief The heap memory of a QString: the array header and the UTF-16 data.
+ * Implicitly shared strings are counted for every holder, so copies of the
+ * same string make the estimate too high.
+ *
+ * It is defined here rather than next to the Qt models, so that every
+ * translation unit that measures a Property<QString> sees it.
+ */
+template <> struct HeapSize<QString> {
+    static size_t of(const QString& value) {
+        if (value.capacity() == 0) {
+            // Null and empty strings share static data
+            return 0;
+        }
+        return sizeof(QArrayData) +
+               static_cast<size_t>(value.capacity() + 1) * sizeof(QChar);
+    }
+};
+#endif
+
+} // namespace Base::Diagnostics
+
+#endif // MEMORYUSAGE_H
@@ -2,21 +2,33 @@
 #define MODEL_H
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <optional>
 #include <set>
+#include <type_traits>
+#include <utility>
 
 using namespace std;
 
 #include "common.h"
+#include "epoch.h"
 #include "event.h"
+#include "instrumentation.h"
+#include "memoryusage.h"
 
 namespace Base::Model {
 
 /**
- * TODO Document me!
+ * @brief A value that fires events when it is changed or cleared.
+ *
+ * A Property can be moved but not copied. Moving a Property moves its value
+ * and its subscribers (see Event), so an item made of properties can be kept
+ * by value in a vector and its event handlers keep working when the vector
+ * relocates it. Moving into an existing Property does not fire valueChanged
+ * and drops the subscribers of the target.
  */
-template <typename T> class Property : private Base::NonCopyable {
+template <typename T> class Property : private Base::MoveOnly {
   public:
     /**
      * @brief Creates a new Property without a value.
@@ -51,6 +63,7 @@ template <typename T> class Property : private Base::NonCopyable {
      * @param value the new value to set.
      */
     void setValue(const T& value) {
+        BASE_INSTRUMENT_COUNT(Property, SetValue);
         _value = value;
         _valueChanged.fire(*this, value);
     }
@@ -88,10 +101,25 @@ template <typename T> class Property : private Base::NonCopyable {
      * @brief Clears this Property.
      */
     void clear() {
+        BASE_INSTRUMENT_COUNT(Property, Clear);
         _value.reset();
         _cleared.fire(*this);
     }
 
+    /**
+     * @brief Returns the memory used by the value and the subscribers of this
+     * Property beyond its own size.
+     */
+    Base::Diagnostics::MemoryUsage memoryUsage() const {
+        Base::Diagnostics::MemoryUsage usage;
+        usage.valueBytes = Base::Diagnostics::heapSizeOf(_value);
+        usage.eventBytes =
+            _valueChanged.memoryUsage() + _cleared.memoryUsage();
+        usage.subscribers =
+            _valueChanged.subscriberCount() + _cleared.subscriberCount();
+        return usage;
+    }
+
     EVENT(valueChanged, Property<T>&, T)
     EVENT(cleared, Property<T>&)
 
@@ -127,12 +155,12 @@ template <typename Id> class SortView {
 
   public:
     explicit SortView() : _sortedIds(vector<Id>(0)) {}
-    explicit SortView(const vector<Id>& sortedIds) : _sortedIds(sortedIds) {}
+    explicit SortView(vector<Id> sortedIds) : _sortedIds(move(sortedIds)) {}
 
     size_type size() const { return _sortedIds.size(); }
 
     Id at(const size_type index) const { return _sortedIds.at(index); }
-    Id at(const int index) const { return at(index); }
+    Id at(const int index) const { return at(static_cast<size_type>(index)); }
 
   private:
     vector<Id> _sortedIds;
@@ -155,57 +183,130 @@ class Collection : private Base::NonCopyable {
     explicit Collection(const function<Id(Item const&)>& idFunction)
         : _idFunction(idFunction) {}
 
+    ~Collection() {
+        // Readers may still hold the items, see setReclamation()
+        if (_shared) {
+            for (auto& kv : _items) {
+                _shared->domain->retire(kv.second.release());
+            }
+        }
+    }
+
     /**
      * @brief Checks if this collection is empty.
      * @return true if this collection is empty, false if it contains at least
      * one item.
      */
-    bool isEmpty() const { return _items.empty(); }
+    bool isEmpty() const {
+        use();
+        return _items.empty();
+    }
 
     /**
      * @brief Checks if this collection has any items.
      * @return true if this collection has at least one item, false if it is
      * empty.
      */
-    bool hasItems() const { return !_items.empty(); }
+    bool hasItems() const {
+        use();
+        return !_items.empty();
+    }
 
     /**
      * @brief Returns the size of this collection (i.e. the number of items in
      * it).
      * @return the collection size.
      */
-    size_type size() const { return _items.size(); }
+    size_type size() const {
+        use();
+        return _items.size();
+    }
+
+    /**
+     * @brief Returns the ID of the given item, which does not need to be in
+     * this collection.
+     * @param item the item.
+     * @return the ID of the item.
+     */
+    Id idOf(Item const& item) const { return _idFunction(item); }
 
     /**
      * @brief contains
      * @param id
      * @return
      */
-    bool contains(const Id& id) const { return _items.count(id) > 0; }
+    bool contains(const Id& id) const {
+        use();
+        return _items.count(id) > 0;
+    }
 
     /**
      * @brief ids
      * @return
      */
-    set<Id> const& ids() const { return _ids; }
+    set<Id> const& ids() const {
+        use();
+        return _ids;
+    }
 
     /**
      * @brief findById
      * @param id
      * @return
      */
-    Item& findById(const Id& id) const { return *_items.at(id); }
+    Item& findById(const Id& id) const {
+        use();
+        return *_items.at(id);
+    }
 
     /**
      * @brief add
      * @param item
      */
     void add(Item* item) {
-        auto id = _idFunction(*item);
-        if (!contains(id)) {
-            _ids.insert(id);
-            _items[id] = SmartItemPointer(item);
-            _itemAdded.fire(*this, id, *item);
+        BASE_INSTRUMENT_COUNT(Collection, Add);
+        insert(item);
+    }
+
+    /**
+     * @brief Adds the given item by moving it into the collection, so that
+     * items can be built by value.
+     * @param item the item.
+     */
+    void add(Item&& item) {
+        // Counted like add(Item*), whether or not the item is new
+        BASE_INSTRUMENT_COUNT(Collection, Add);
+        if (!contains(_idFunction(item))) {
+            insert(new Item(move(item)));
+        }
+    }
+
+    /**
+     * @brief Adds all the given items in one batch. Unlike add(), this fires a
+     * single itemsAdded event instead of one itemAdded event per item, which
+     * makes it the preferred way of loading large amounts of items. Items
+     * whose ID is already in the collection are deleted.
+     * @param items the items to add. The collection takes ownership of them.
+     */
+    void addAll(const vector<Item*>& items) {
+        // One timed add per batch, with the batch size as its size
+        BASE_INSTRUMENT_SCOPE(Collection, Add, items.size());
+        use();
+        vector<Id> addedIds;
+        addedIds.reserve(items.size());
+        for (auto item : items) {
+            auto id = _idFunction(*item);
+            auto inserted = _items.try_emplace(id, item);
+            if (inserted.second) {
+                _ids.insert(_ids.end(), id);
+                addedIds.push_back(id);
+            } else {
+                delete item;
+            }
+        }
+        if (!addedIds.empty()) {
+            publish();
+            _itemsAdded.fire(*this, addedIds);
         }
     }
 
@@ -224,9 +325,20 @@ class Collection : private Base::NonCopyable {
      * @param id
      */
     void removeById(const Id& id) {
-        if (_items.erase(id) > 0) {
+        BASE_INSTRUMENT_COUNT(Collection, Remove);
+        use();
+        auto found = _items.find(id);
+        if (found != _items.end()) {
+            // Keep the item alive until the event has fired, so that handlers
+            // can still disconnect from the events of the item.
+            auto item = move(found->second);
+            _items.erase(found);
             _ids.erase(id);
+            publish();
             _itemRemoved.fire(*this, id);
+            if (_shared) {
+                _shared->domain->retire(item.release());
+            }
         }
     }
 
@@ -234,48 +346,272 @@ class Collection : private Base::NonCopyable {
      * @brief remove
      * @param item
      */
-    void remove(const Item& item) { removeById(getItemId(item)); }
+    void remove(const Item& item) { removeById(idOf(item)); }
 
     /**
      * @brief clear
      */
     void clear() {
+        use();
+        // Keep the items alive until the event has fired, see removeById().
+        auto items = move(_items);
         _items.clear();
+        _ids.clear();
+        publish();
         _cleared.fire(*this);
+        if (_shared) {
+            for (auto& kv : items) {
+                _shared->domain->retire(kv.second.release());
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the memory used by this collection: its items, their
+     * index and the subscribers of the collection events. The heap memory and
+     * subscribers of the item properties are not included, since the
+     * collection does not know them; see Base::Diagnostics::MemoryInspector.
+     */
+    Base::Diagnostics::MemoryUsage memoryUsage() const {
+        using Base::Diagnostics::heapSizeOf;
+        using Base::Diagnostics::treeNodeOverhead;
+        Base::Diagnostics::MemoryUsage usage;
+        usage.objects = _items.size();
+        usage.objectBytes = _items.size() * sizeof(Item);
+        usage.containerBytes =
+            sizeof(*this) +
+            _items.size() *
+                (treeNodeOverhead +
+                 sizeof(typename map<Id, SmartItemPointer>::value_type)) +
+            _ids.size() * (treeNodeOverhead + sizeof(Id)) +
+            _sortedIds.capacity() * sizeof(Id);
+        for (const auto& id : _ids) {
+            // Every ID is stored in both _items and _ids
+            usage.containerBytes += 2 * heapSizeOf(id);
+        }
+        if (_shared) {
+            auto index = _shared->index.load(memory_order_acquire);
+            usage.containerBytes +=
+                sizeof(Shared) +
+                (index ? index->capacity() * sizeof(pair<Id, Item*>) : 0);
+        }
+        usage.eventBytes = _itemAdded.memoryUsage() +
+                           _itemsAdded.memoryUsage() +
+                           _itemRemoved.memoryUsage() + _cleared.memoryUsage();
+        usage.subscribers =
+            _itemAdded.subscriberCount() + _itemsAdded.subscriberCount() +
+            _itemRemoved.subscriberCount() + _cleared.subscriberCount();
+        return usage;
     }
 
     SortView<Id> sort(const CompareFunction& compareFunction) const {
-        if (_items.size() > 0) {
-            vector<SmartItemPointer> sortVector(_items.size());
-            for (const auto& kv : _items) {
-                sortVector.push_back(kv.second);
+        use();
+        BASE_INSTRUMENT_SCOPE(Collection, Sort, _items.size());
+        vector<pair<Id, Item const*>> sortVector;
+        sortVector.reserve(_items.size());
+        for (const auto& kv : _items) {
+            sortVector.emplace_back(kv.first, kv.second.get());
+        }
+        std::sort(sortVector.begin(), sortVector.end(),
+                  [compareFunction](pair<Id, Item const*> const& i1,
+                                    pair<Id, Item const*> const& i2) {
+                      return compareFunction(*i1.second, *i2.second);
+                  });
+        vector<Id> sortedIds;
+        sortedIds.reserve(sortVector.size());
+        for (const auto& kv : sortVector) {
+            sortedIds.push_back(kv.first);
+        }
+        return SortView<Id>(move(sortedIds));
+    }
+
+    /**
+     * @brief Invokes the given function for every item, in ID order. The
+     * function receives the ID and the item. If the function returns a bool,
+     * the iteration stops as soon as it returns false.
+     * @param function the function to invoke.
+     */
+    template <typename Function> void forEach(Function&& function) const {
+        use();
+        for (const auto& kv : _items) {
+            if constexpr (is_same_v<decltype(function(kv.first, *kv.second)),
+                                    bool>) {
+                if (!function(kv.first, *kv.second)) {
+                    return;
+                }
+            } else {
+                function(kv.first, *kv.second);
             }
-            sort(sortVector.begin(), sortVector.end(),
-                 [compareFunction](SmartItemPointer const& i1,
-                                   SmartItemPointer const& i2) {
-                     return compareFunction(*i1, *i2);
-                 });
-            vector<Id> sortedIds(sortVector.size());
-            for (const auto& item : sortVector) {
-                sortedIds.push_back(item->id());
+        }
+    }
+
+    /**
+     * @brief Drops the items from memory because they have been saved to an
+     * archive, see Base::Model::ResidencyManager. Fires the cleared event
+     * like clear(), but isSwapping() is true meanwhile, so that mirrors of
+     * the collection, such as a ReplicationSource, can tell that the items
+     * were not deleted.
+     *
+     * Until restore() is called the collection is evicted. Using it then,
+     * by reading or changing its items, first calls the given function,
+     * which is expected to restore() the items.
+     *
+     * @param reload the function that loads the items back.
+     */
+    void evict(function<void()> reload = nullptr) {
+        _residency = Residency::Evicting;
+        auto items = move(_items);
+        _items.clear();
+        _ids.clear();
+        publish();
+        _cleared.fire(*this);
+        if (_shared) {
+            for (auto& kv : items) {
+                _shared->domain->retire(kv.second.release());
             }
-            return SortView<Id>(sortedIds);
-        } else {
-            return SortView<Id>();
         }
+        items.clear();
+        _residency = Residency::Evicted;
+        _reload = move(reload);
+    }
+
+    /**
+     * @brief Adds the items of an evicted collection back, like addAll(),
+     * with isSwapping() true while the itemsAdded event fires.
+     * @param items the items. The collection takes ownership of them.
+     */
+    void restore(const vector<Item*>& items) {
+        _residency = Residency::Restoring;
+        _reload = nullptr;
+        addAll(items);
+        _residency = Residency::Resident;
+    }
+
+    /**
+     * @brief Checks if the items have been evicted and not restored yet.
+     */
+    bool isEvicted() const { return _residency == Residency::Evicted; }
+
+    /**
+     * @brief Checks if the collection is being evicted or restored, so its
+     * events do not stand for deleted or new items.
+     */
+    bool isSwapping() const {
+        return _residency == Residency::Evicting ||
+               _residency == Residency::Restoring;
     }
 
-    ~Collection() {}
+    /**
+     * @brief Lets other threads read the items without locking. From now on
+     * removed items are retired to the given domain instead of being deleted
+     * right away, and every change publishes an immutable index of the items
+     * that lookup() and forEachShared() read. Changes get more expensive, as
+     * the index is rebuilt each time, so use this for collections that are
+     * read much more often than items are added or removed.
+     *
+     * Only the lifetime of the items is protected: properties that the
+     * owning thread changes still need their own synchronization. The domain
+     * must outlive the collection. Call this on the owning thread before
+     * sharing the collection.
+     *
+     * @param domain the domain that protects the items.
+     */
+    void setReclamation(Base::Concurrency::EpochDomain& domain) {
+        if (!_shared) {
+            _shared = make_unique<Shared>();
+        }
+        _shared->domain = &domain;
+        publish();
+    }
+
+    /**
+     * @brief Returns the item with the given ID, or nullptr if there is none.
+     * May be called from any thread while it is in a read epoch of the domain
+     * given to setReclamation(); the item stays valid until the epoch ends.
+     * @param id the ID.
+     */
+    Item* lookup(const Id& id) const {
+        auto index = _shared->index.load(memory_order_acquire);
+        auto found = lower_bound(
+            index->begin(), index->end(), id,
+            [](const auto& entry, const Id& id) { return entry.first < id; });
+        if (found == index->end() || id < found->first) {
+            return nullptr;
+        }
+        return found->second;
+    }
+
+    /**
+     * @brief Invokes the given function for every item, in ID order, like
+     * forEach(). May be called from any thread while it is in a read epoch of
+     * the domain given to setReclamation(). The items are those of a single
+     * published state of the collection.
+     * @param function the function to invoke with the ID and the item.
+     */
+    template <typename Function>
+    void forEachShared(Function&& function) const {
+        auto index = _shared->index.load(memory_order_acquire);
+        for (const auto& entry : *index) {
+            function(entry.first, *entry.second);
+        }
+    }
 
     EVENT(itemAdded, Collection<Id, Item>&, Id, Item&)
+    EVENT(itemsAdded, Collection<Id, Item>&, const vector<Id>&)
     EVENT(itemRemoved, Collection<Id, Item>&, Id)
     EVENT(cleared, Collection<Id, Item>&)
 
   private:
+    using SharedIndex = vector<pair<Id, Item*>>;
+
+    enum class Residency : uint8_t { Resident, Evicting, Evicted, Restoring };
+
+    struct Shared {
+        Base::Concurrency::EpochDomain* domain = nullptr;
+        atomic<const SharedIndex*> index{nullptr};
+
+        ~Shared() { domain->retire(index.load()); }
+    };
+
+    void insert(Item* item) {
+        auto id = _idFunction(*item);
+        if (!contains(id)) {
+            _ids.insert(id);
+            _items[id] = SmartItemPointer(item);
+            publish();
+            _itemAdded.fire(*this, id, *item);
+        }
+    }
+
+    // Loads the items back before an evicted collection is used
+    void use() const {
+        if (_residency == Residency::Evicted && _reload) {
+            // Restoring resets _reload while it runs
+            auto reload = _reload;
+            reload();
+        }
+    }
+
+    void publish() {
+        if (!_shared) {
+            return;
+        }
+        auto index = new SharedIndex();
+        index->reserve(_items.size());
+        for (const auto& kv : _items) {
+            index->emplace_back(kv.first, kv.second.get());
+        }
+        auto previous = _shared->index.exchange(index, memory_order_acq_rel);
+        _shared->domain->retire(previous);
+    }
+
     function<Id(Item const&)> _idFunction;
     map<Id, SmartItemPointer> _items;
     set<Id> _ids;
     vector<Id> _sortedIds;
+    unique_ptr<Shared> _shared;
+    Residency _residency = Residency::Resident;
+    function<void()> _reload;
 };
 
 template <typename Id> class Identifiable {
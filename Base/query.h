@@ -0,0 +1,363 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#include "field.h"
+#include "model.h"
+
+/*
+ * A query DSL over the fields of Collection items, built from expression
+ * templates. Predicates, projections and orderings are plain values whose types
+ * encode the whole query, so that the compiler can inline every comparison and
+ * a query runs as a single pass over the collection:
+ *
+ * auto status = FIELD(Responder, status);
+ * auto eta = FIELD(Responder, eta);
+ * auto name = FIELD(Responder, name);
+ * auto rows = where(status == Responding && eta < 10)
+ *                 .select(name, eta)
+ *                 .orderBy(eta)
+ *                 .limit(20)
+ *                 .rows(responders);
+ */
+namespace Base::Query {
+
+using Base::Model::Collection;
+using Base::Model::Field;
+using Base::Model::SortView;
+
+/**
+ * @brief Base class of all predicate expressions. Only predicates can be
+ * combined with &&, || and !.
+ *
+ * @tparam Derived the predicate class.
+ */
+template <typename Derived> class Predicate {
+  public:
+    Derived const& self() const { return static_cast<Derived const&>(*this); }
+};
+
+/**
+ * @brief A predicate that matches every item.
+ */
+class Always : public Predicate<Always> {
+  public:
+    template <typename Item> bool operator()(Item const&) const { return true; }
+};
+
+/**
+ * @brief Compares a field with a value. Items whose property is empty never
+ * match, regardless of the operator.
+ */
+template <typename Item, typename T, typename V, typename Operator>
+class Comparison : public Predicate<Comparison<Item, T, V, Operator>> {
+  public:
+    explicit Comparison(const Field<Item, T>& field, const V& value)
+        : _field(field), _value(value) {}
+
+    bool operator()(Item const& item) const {
+        auto const& property = _field.of(item);
+        return property.hasValue() && Operator()(property.value(), _value);
+    }
+
+  private:
+    Field<Item, T> _field;
+    V _value;
+};
+
+/**
+ * @brief Matches items whose property has a value.
+ */
+template <typename Item, typename T>
+class HasValue : public Predicate<HasValue<Item, T>> {
+  public:
+    explicit HasValue(const Field<Item, T>& field) : _field(field) {}
+
+    bool operator()(Item const& item) const {
+        return _field.of(item).hasValue();
+    }
+
+  private:
+    Field<Item, T> _field;
+};
+
+template <typename L, typename R> class And : public Predicate<And<L, R>> {
+  public:
+    explicit And(const L& left, const R& right) : _left(left), _right(right) {}
+
+    template <typename Item> bool operator()(Item const& item) const {
+        return _left(item) && _right(item);
+    }
+
+  private:
+    L _left;
+    R _right;
+};
+
+template <typename L, typename R> class Or : public Predicate<Or<L, R>> {
+  public:
+    explicit Or(const L& left, const R& right) : _left(left), _right(right) {}
+
+    template <typename Item> bool operator()(Item const& item) const {
+        return _left(item) || _right(item);
+    }
+
+  private:
+    L _left;
+    R _right;
+};
+
+template <typename P> class Not : public Predicate<Not<P>> {
+  public:
+    explicit Not(const P& predicate) : _predicate(predicate) {}
+
+    template <typename Item> bool operator()(Item const& item) const {
+        return !_predicate(item);
+    }
+
+  private:
+    P _predicate;
+};
+
+template <typename L, typename R>
+And<L, R> operator&&(const Predicate<L>& left, const Predicate<R>& right) {
+    return And<L, R>(left.self(), right.self());
+}
+
+template <typename L, typename R>
+Or<L, R> operator||(const Predicate<L>& left, const Predicate<R>& right) {
+    return Or<L, R>(left.self(), right.self());
+}
+
+template <typename P> Not<P> operator!(const Predicate<P>& predicate) {
+    return Not<P>(predicate.self());
+}
+
+template <typename Item, typename T>
+HasValue<Item, T> hasValue(const Field<Item, T>& field) {
+    return HasValue<Item, T>(field);
+}
+
+/**
+ * @brief Ordering of a query without orderBy().
+ */
+class Unordered {};
+
+/**
+ * @brief Orders items by a field. Items whose property is empty come last in
+ * both directions.
+ */
+template <typename Item, typename T, bool Descending> class OrderBy {
+  public:
+    explicit OrderBy(const Field<Item, T>& field) : _field(field) {}
+
+    bool operator()(Item const& first, Item const& second) const {
+        auto const& p1 = _field.of(first);
+        auto const& p2 = _field.of(second);
+        if (!p1.hasValue() || !p2.hasValue()) {
+            return p1.hasValue() && !p2.hasValue();
+        }
+        return Descending ? p2.value() < p1.value() : p1.value() < p2.value();
+    }
+
+  private:
+    Field<Item, T> _field;
+};
+
+/**
+ * @brief A query. Queries are immutable; every builder method returns a new
+ * query. Nothing is evaluated until ids() or rows() is called.
+ *
+ * @tparam Where the predicate type.
+ * @tparam Order the ordering type.
+ * @tparam Selected the types of the selected fields.
+ */
+template <typename Where, typename Order, typename... Selected> class Query {
+  public:
+    static constexpr size_t noLimit = numeric_limits<size_t>::max();
+
+    explicit Query(const Where& where, const Order& order,
+                   const tuple<Selected...>& selected, size_t limit)
+        : _where(where), _order(order), _selected(selected), _limit(limit) {}
+
+    /**
+     * @brief Selects the fields that rows() returns.
+     */
+    template <typename... Fields>
+    Query<Where, Order, Fields...> select(const Fields&... fields) const {
+        return Query<Where, Order, Fields...>(_where, _order,
+                                              make_tuple(fields...), _limit);
+    }
+
+    /**
+     * @brief Orders the result by the given field, in ascending order.
+     */
+    template <typename Item, typename T>
+    Query<Where, OrderBy<Item, T, false>, Selected...>
+    orderBy(const Field<Item, T>& field) const {
+        return Query<Where, OrderBy<Item, T, false>, Selected...>(
+            _where, OrderBy<Item, T, false>(field), _selected, _limit);
+    }
+
+    /**
+     * @brief Orders the result by the given field, in descending order.
+     */
+    template <typename Item, typename T>
+    Query<Where, OrderBy<Item, T, true>, Selected...>
+    orderByDescending(const Field<Item, T>& field) const {
+        return Query<Where, OrderBy<Item, T, true>, Selected...>(
+            _where, OrderBy<Item, T, true>(field), _selected, _limit);
+    }
+
+    /**
+     * @brief Returns at most the given number of items. Combined with an
+     * ordering, only the best items are kept while scanning.
+     */
+    Query limit(size_t limit) const {
+        return Query(_where, _order, _selected, limit);
+    }
+
+    /**
+     * @brief Runs the query and returns the IDs of the matching items.
+     */
+    template <typename Id, typename Item>
+    SortView<Id> ids(const Collection<Id, Item>& collection) const {
+        vector<Id> ids;
+        run(collection, [&ids](const Id& id, Item const&) {
+            ids.push_back(id);
+        });
+        return SortView<Id>(move(ids));
+    }
+
+    /**
+     * @brief Runs the query and returns the ID and the selected fields of
+     * every matching item. Empty properties are returned as empty optionals.
+     */
+    template <typename Id, typename Item>
+    vector<tuple<Id, optional<typename Selected::ValueType>...>>
+    rows(const Collection<Id, Item>& collection) const {
+        vector<tuple<Id, optional<typename Selected::ValueType>...>> rows;
+        run(collection, [&](const Id& id, Item const& item) {
+            rows.push_back(apply(
+                [&](const auto&... fields) {
+                    return make_tuple(id, value(fields.of(item))...);
+                },
+                _selected));
+        });
+        return rows;
+    }
+
+  private:
+    template <typename T>
+    static optional<T> value(const Base::Model::Property<T>& property) {
+        return property.hasValue() ? optional<T>(property.value()) : nullopt;
+    }
+
+    template <typename Id, typename Item, typename Emit>
+    void run(const Collection<Id, Item>& collection, Emit&& emit) const {
+        if (_limit == 0) {
+            return;
+        }
+        if constexpr (is_same_v<Order, Unordered>) {
+            size_t count = 0;
+            collection.forEach([&](const Id& id, Item const& item) {
+                if (_where(item)) {
+                    emit(id, item);
+                    return ++count < _limit;
+                }
+                return true;
+            });
+        } else {
+            // With a limit, the candidates are kept in a heap whose top is
+            // the worst one, so each item is compared against it only once.
+            using Candidate = pair<Id, Item const*>;
+            auto before = [this](const Candidate& c1, const Candidate& c2) {
+                return _order(*c1.second, *c2.second);
+            };
+            vector<Candidate> candidates;
+            if (_limit != noLimit) {
+                candidates.reserve(min(_limit, collection.size()));
+            }
+            collection.forEach([&](const Id& id, Item const& item) {
+                if (!_where(item)) {
+                    return;
+                }
+                if (candidates.size() < _limit) {
+                    candidates.emplace_back(id, &item);
+                    if (_limit != noLimit) {
+                        push_heap(candidates.begin(), candidates.end(),
+                                  before);
+                    }
+                } else if (_order(item, *candidates.front().second)) {
+                    pop_heap(candidates.begin(), candidates.end(), before);
+                    candidates.back() = Candidate(id, &item);
+                    push_heap(candidates.begin(), candidates.end(), before);
+                }
+            });
+            if (_limit != noLimit) {
+                sort_heap(candidates.begin(), candidates.end(), before);
+            } else {
+                stable_sort(candidates.begin(), candidates.end(), before);
+            }
+            for (const auto& candidate : candidates) {
+                emit(candidate.first, *candidate.second);
+            }
+        }
+    }
+
+    Where _where;
+    Order _order;
+    tuple<Selected...> _selected;
+    size_t _limit;
+};
+
+/**
+ * @brief Starts a query that matches the items satisfying the given
+ * predicate.
+ */
+template <typename P> Query<P, Unordered> where(const Predicate<P>& predicate) {
+    return Query<P, Unordered>(predicate.self(), Unordered(), tuple<>(),
+                               Query<P, Unordered>::noLimit);
+}
+
+/**
+ * @brief Starts a query that matches all items.
+ */
+inline Query<Always, Unordered> all() { return where(Always()); }
+
+} // namespace Base::Query
+
+// The comparison operators of fields live next to Field, so that argument
+// dependent lookup finds them without a using directive.
+namespace Base::Model {
+
+#define BASE_QUERY_COMPARISON(op, function)                                    \
+    template <typename Item, typename T, typename V>                           \
+    auto op(const Field<Item, T>& field, const V& value) {                     \
+        using Value = decay_t<const V>;                                        \
+        return Base::Query::Comparison<Item, T, Value, function>(field,        \
+                                                                 value);       \
+    }
+
+BASE_QUERY_COMPARISON(operator==, equal_to<>)
+BASE_QUERY_COMPARISON(operator!=, not_equal_to<>)
+BASE_QUERY_COMPARISON(operator<, less<>)
+BASE_QUERY_COMPARISON(operator<=, less_equal<>)
+BASE_QUERY_COMPARISON(operator>, greater<>)
+BASE_QUERY_COMPARISON(operator>=, greater_equal<>)
+
+#undef BASE_QUERY_COMPARISON
+
+} // namespace Base::Model
+
+#endif // QUERY_H
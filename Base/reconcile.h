@@ -0,0 +1,109 @@
+#ifndef RECONCILE_H
+#define RECONCILE_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+#include "field.h"
+#include "model.h"
+
+namespace Base::Model {
+
+/**
+ * @brief The changes made by reconcile().
+ */
+struct ReconcileResult {
+    size_t added = 0;
+    size_t removed = 0;
+    // Number of existing items that had at least one property changed
+    size_t changedItems = 0;
+    // Number of properties that were set or cleared
+    size_t changedProperties = 0;
+    size_t unchangedItems = 0;
+};
+
+/**
+ * @brief Makes the collection contain the given items while firing as few
+ * events as possible. The items are matched by ID through a hash join:
+ * existing items that are not among the given items are removed, new items are
+ * added in one batch with addAll(), and items that exist on both sides get
+ * only those schema properties updated that differ. Properties outside the
+ * schema (e.g. live status) are left untouched, and unchanged items fire no
+ * events at all.
+ *
+ * @param collection the collection to update.
+ * @param incoming the desired items. Items that are added are moved into the
+ * collection; the rest are destroyed when the vector is.
+ * @param schema the properties to compare and copy.
+ * @param hash the hash function of the ID type.
+ * @return what was changed.
+ */
+template <typename Id, typename Item, typename... Fields,
+          typename Hash = hash<Id>>
+ReconcileResult reconcile(Collection<Id, Item>& collection,
+                          vector<unique_ptr<Item>>& incoming,
+                          const Schema<Item, Fields...>& schema,
+                          Hash hash = Hash()) {
+    ReconcileResult result;
+    unordered_map<Id, Item*, Hash> incomingById(incoming.size() * 2, hash);
+    for (auto& item : incoming) {
+        incomingById.emplace(collection.idOf(*item), item.get());
+    }
+
+    vector<Id> toRemove;
+    for (const auto& id : collection.ids()) {
+        auto match = incomingById.find(id);
+        if (match == incomingById.end()) {
+            toRemove.push_back(id);
+            continue;
+        }
+        auto& existing = collection.findById(id);
+        auto& desired = *match->second;
+        size_t changed = 0;
+        schema.forEach([&](auto, const auto& field) {
+            auto& property = field.of(existing);
+            const auto& desiredProperty = field.of(desired);
+            if (property != desiredProperty) {
+                if (desiredProperty.hasValue()) {
+                    property = desiredProperty.value();
+                } else {
+                    property.clear();
+                }
+                ++changed;
+            }
+        });
+        if (changed > 0) {
+            result.changedItems++;
+            result.changedProperties += changed;
+        } else {
+            result.unchangedItems++;
+        }
+        // Mark as matched, so that it is not added below
+        match->second = nullptr;
+    }
+
+    for (const auto& id : toRemove) {
+        collection.removeById(id);
+    }
+    result.removed = toRemove.size();
+
+    vector<Item*> toAdd;
+    for (auto& item : incoming) {
+        auto match = incomingById.find(collection.idOf(*item));
+        // Only the first of several items with the same ID is added
+        if (match != incomingById.end() && match->second == item.get()) {
+            match->second = nullptr;
+            toAdd.push_back(item.release());
+        }
+    }
+    collection.addAll(toAdd);
+    result.added = toAdd.size();
+    return result;
+}
+
+} // namespace Base::Model
+
+#endif // RECONCILE_H
@@ -0,0 +1,657 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+#include "codec.h"
+#include "common.h"
+#include "event.h"
+#include "field.h"
+#include "model.h"
+
+namespace Base::Replication {
+
+using Base::Model::Collection;
+using Base::Model::Property;
+using Base::Model::Schema;
+using Base::Serialization::DecodeError;
+using Base::Serialization::Reader;
+using Base::Serialization::Writer;
+
+/**
+ * @brief The kinds of records in a DeltaLog.
+ */
+enum class RecordKind : uint8_t {
+    // Sent periodically so that the standby can measure lag and detect a
+    // dead primary while the models are idle
+    Heartbeat = 0,
+    // Starts a full snapshot of all channels
+    SnapshotBegin = 1,
+    ItemAdded = 2,
+    ItemRemoved = 3,
+    Cleared = 4,
+    ValueChanged = 5,
+    ValueCleared = 6,
+};
+
+/**
+ * @brief Returns the current wall clock time in microseconds since the epoch.
+ * Record timestamps use this clock, so lag measurements between hosts are only
+ * as accurate as their clock synchronization.
+ */
+inline int64_t currentTimeMicros() {
+    return chrono::duration_cast<chrono::microseconds>(
+               chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Interface of objects that can write their full state into a DeltaLog.
+ */
+class SnapshotSource {
+  public:
+    /**
+     * @brief Appends records that recreate the full state of this source.
+     */
+    virtual void writeSnapshot() = 0;
+
+    virtual ~SnapshotSource() = default;
+};
+
+/**
+ * @brief An ordered log of model changes. Every record gets the next sequence
+ * number and a timestamp and is published through the recordAppended event as
+ * a length-prefixed frame, ready to be written to a socket. The log does not
+ * retain records; a standby that falls behind asks for a new snapshot.
+ *
+ * Frame layout: fixed32 length of the rest of the frame, varint sequence,
+ * signed varint timestamp, varint channel, byte kind, payload.
+ */
+class DeltaLog : private Base::NonCopyable {
+  public:
+    /**
+     * @brief Appends a record to the log.
+     *
+     * @param channel the channel (i.e. replicated collection) of the record.
+     * @param kind the kind of the record.
+     * @param writePayload a function that receives a Writer and writes the
+     * payload of the record.
+     */
+    template <typename PayloadWriter>
+    void append(uint16_t channel, RecordKind kind,
+                PayloadWriter&& writePayload) {
+        if (_captured) {
+            // Numbered by snapshotFrames() once the snapshot is complete
+            vector<uint8_t> payload;
+            Writer writer(payload);
+            writePayload(writer);
+            _captured->push_back({channel, kind, move(payload)});
+            return;
+        }
+        _frame.clear();
+        writeFrame(_frame, ++_sequence, channel, kind, writePayload);
+        _recordAppended.fire(*this, _frame);
+    }
+
+    /**
+     * @brief Appends a heartbeat record.
+     */
+    void heartbeat() {
+        append(0, RecordKind::Heartbeat, [](Writer&) {});
+    }
+
+    /**
+     * @brief Appends a full snapshot of all registered snapshot sources. Every
+     * reader of the log starts over from it.
+     */
+    void snapshot() {
+        append(0, RecordKind::SnapshotBegin, [](Writer&) {});
+        for (auto source : _snapshotSources) {
+            source->writeSnapshot();
+        }
+    }
+
+    /**
+     * @brief Returns the frames of a full snapshot of all registered snapshot
+     * sources for a single new reader, such as a standby that just connected.
+     * Nothing is appended to the log, so the other readers do not see it.
+     *
+     * The frames are numbered so that the last one has the sequence number of
+     * the last appended record, and the records appended next follow them
+     * (modulo 2^64 while the log is younger than the snapshot).
+     */
+    vector<uint8_t> snapshotFrames() {
+        vector<Captured> captured;
+        _captured = &captured;
+        for (auto source : _snapshotSources) {
+            source->writeSnapshot();
+        }
+        _captured = nullptr;
+        vector<uint8_t> frames;
+        auto sequence = _sequence - captured.size();
+        writeFrame(frames, sequence, 0, RecordKind::SnapshotBegin,
+                   [](Writer&) {});
+        for (const auto& record : captured) {
+            writeFrame(frames, ++sequence, record.channel, record.kind,
+                       [&record](Writer& writer) {
+                           writer.writeBytes(record.payload.data(),
+                                             record.payload.size());
+                       });
+        }
+        return frames;
+    }
+
+    void addSnapshotSource(SnapshotSource* source) {
+        _snapshotSources.push_back(source);
+    }
+
+    void removeSnapshotSource(SnapshotSource* source) {
+        _snapshotSources.erase(remove(_snapshotSources.begin(),
+                                      _snapshotSources.end(), source),
+                               _snapshotSources.end());
+    }
+
+    /**
+     * @brief Returns the sequence number of the last appended record.
+     */
+    uint64_t sequence() const { return _sequence; }
+
+    EVENT(recordAppended, DeltaLog&, const vector<uint8_t>&)
+
+  private:
+    struct Captured {
+        uint16_t channel;
+        RecordKind kind;
+        vector<uint8_t> payload;
+    };
+
+    template <typename PayloadWriter>
+    static void writeFrame(vector<uint8_t>& buffer, uint64_t sequence,
+                           uint16_t channel, RecordKind kind,
+                           PayloadWriter&& writePayload) {
+        auto start = buffer.size();
+        Writer writer(buffer);
+        writer.writeFixed32(0);
+        writer.writeVarint(sequence);
+        writer.writeSignedVarint(currentTimeMicros());
+        writer.writeVarint(channel);
+        writer.writeByte(static_cast<uint8_t>(kind));
+        writePayload(writer);
+        auto length = static_cast<uint32_t>(buffer.size() - start - 4);
+        for (int i = 0; i < 4; ++i) {
+            buffer[start + i] = static_cast<uint8_t>(length >> (8 * i));
+        }
+    }
+
+    uint64_t _sequence = 0;
+    vector<uint8_t> _frame;
+    vector<SnapshotSource*> _snapshotSources;
+    // Where append() collects the records of snapshotFrames()
+    vector<Captured>* _captured = nullptr;
+};
+
+/**
+ * @brief Writes the ID of an item and the values of its schema properties
+ * that have one.
+ */
+template <typename Id, typename Item, typename... Fields>
+void writeItem(Writer& writer, const Id& id, Item const& item,
+               const Schema<Item, Fields...>& schema) {
+    writer.write(id);
+    uint64_t count = 0;
+    schema.forEach([&](auto, const auto& field) {
+        count += field.of(item).hasValue() ? 1 : 0;
+    });
+    writer.writeVarint(count);
+    schema.forEach([&](auto index, const auto& field) {
+        if (field.of(item).hasValue()) {
+            writer.writeVarint(index);
+            writer.write(field.of(item).value());
+        }
+    });
+}
+
+/**
+ * @brief Reads the index and the value of a schema property and sets the
+ * property of the item, unless it already has that value.
+ *
+ * @throws DecodeError if the input is malformed.
+ */
+template <typename Item, typename... Fields>
+void readValue(Reader& reader, Item& item,
+               const Schema<Item, Fields...>& schema) {
+    auto found = schema.visit(reader.readVarint(), [&](const auto& field) {
+        using T = typename decay_t<decltype(field)>::ValueType;
+        auto value = reader.read<T>();
+        if (field.of(item) != value) {
+            field.of(item) = value;
+        }
+    });
+    if (!found) {
+        throw DecodeError("Unknown field");
+    }
+}
+
+/**
+ * @brief Reads the values written by writeItem() after the ID.
+ *
+ * @throws DecodeError if the input is malformed.
+ */
+template <typename Item, typename... Fields>
+void readValues(Reader& reader, Item& item,
+                const Schema<Item, Fields...>& schema) {
+    auto count = reader.readVarint();
+    for (uint64_t i = 0; i < count; ++i) {
+        readValue(reader, item, schema);
+    }
+}
+
+/**
+ * @brief Appends every change of a Collection and of the schema properties of
+ * its items to a DeltaLog.
+ *
+ * Values are serialized with Base::Serialization::Codec, so the ID type and
+ * the value type of every field must have a codec.
+ *
+ * Evicting and restoring the collection (see Collection::evict()) is not
+ * replicated, and an evicted collection is left out of snapshots, so the
+ * standbys keep the items while they are in the archive. If a snapshot left
+ * them out, the restored items are appended again, so that standbys that
+ * started from that snapshot get them too.
+ */
+template <typename Id, typename Item, typename... Fields>
+class ReplicationSource
+    : public Base::Event::EventHandler<ReplicationSource<Id, Item, Fields...>>,
+      public SnapshotSource {
+  public:
+    /**
+     * @brief Creates a new ReplicationSource and registers it as a snapshot
+     * source of the log.
+     *
+     * @param log the log to append to.
+     * @param channel the channel that identifies the collection in the log.
+     * @param collection the collection to replicate.
+     * @param schema the properties of the items to replicate.
+     */
+    explicit ReplicationSource(DeltaLog& log, uint16_t channel,
+                               Collection<Id, Item>& collection,
+                               const Schema<Item, Fields...>& schema)
+        : _log(log), _channel(channel), _collection(collection),
+          _schema(schema) {
+        this->connect(collection.itemAddedEvent(),
+                      &ReplicationSource::onItemAdded);
+        this->connect(collection.itemsAddedEvent(),
+                      &ReplicationSource::onItemsAdded);
+        this->connect(collection.itemRemovedEvent(),
+                      &ReplicationSource::onItemRemoved);
+        this->connect(collection.clearedEvent(), &ReplicationSource::onCleared);
+        if (collection.isEvicted()) {
+            // Never replicated; sent once restored
+            _omitted = true;
+        } else {
+            for (const auto& id : collection.ids()) {
+                watch(id, collection.findById(id));
+            }
+        }
+        log.addSnapshotSource(this);
+    }
+
+    ~ReplicationSource() override { _log.removeSnapshotSource(this); }
+
+    void writeSnapshot() override {
+        if (_collection.isEvicted()) {
+            // Left to the archive; a standby keeps what it has
+            _omitted = true;
+            return;
+        }
+        _log.append(_channel, RecordKind::Cleared, [](Writer&) {});
+        for (const auto& id : _collection.ids()) {
+            auto& item = _collection.findById(id);
+            _log.append(_channel, RecordKind::ItemAdded, [&](Writer& writer) {
+                writeItem(writer, id, item, _schema);
+            });
+        }
+    }
+
+  private:
+    class ItemWatcher : public Base::Event::EventHandler<ItemWatcher> {
+      public:
+        explicit ItemWatcher(ReplicationSource& source, const Id& id)
+            : _source(source), _id(id) {}
+
+        template <size_t Index, typename T>
+        void onValueChanged(Property<T>&, T value) {
+            _source._log.append(_source._channel, RecordKind::ValueChanged,
+                                [&](Writer& writer) {
+                                    writer.write(_id);
+                                    writer.writeVarint(Index);
+                                    writer.write(value);
+                                });
+        }
+
+        template <size_t Index, typename T> void onCleared(Property<T>&) {
+            _source._log.append(_source._channel, RecordKind::ValueCleared,
+                                [&](Writer& writer) {
+                                    writer.write(_id);
+                                    writer.writeVarint(Index);
+                                });
+        }
+
+      private:
+        ReplicationSource& _source;
+        Id _id;
+    };
+
+    void watch(const Id& id, Item& item) {
+        auto watcher = make_unique<ItemWatcher>(*this, id);
+        _schema.forEach([&](auto index, const auto& field) {
+            using T = typename decay_t<decltype(field)>::ValueType;
+            constexpr size_t I = decltype(index)::value;
+            watcher->connect(field.of(item).valueChangedEvent(),
+                             &ItemWatcher::template onValueChanged<I, T>);
+            watcher->connect(field.of(item).clearedEvent(),
+                             &ItemWatcher::template onCleared<I, T>);
+        });
+        _watchers[id] = move(watcher);
+    }
+
+    void onItemAdded(Collection<Id, Item>&, Id id, Item& item) {
+        watch(id, item);
+        _log.append(_channel, RecordKind::ItemAdded, [&](Writer& writer) {
+            writeItem(writer, id, item, _schema);
+        });
+    }
+
+    void onItemsAdded(Collection<Id, Item>& collection,
+                      const vector<Id>& ids) {
+        auto restored = collection.isSwapping();
+        for (const auto& id : ids) {
+            if (restored && !_omitted) {
+                // Restored from an archive; the standbys still have it
+                watch(id, collection.findById(id));
+            } else {
+                onItemAdded(collection, id, collection.findById(id));
+            }
+        }
+        if (restored) {
+            _omitted = false;
+        }
+    }
+
+    void onItemRemoved(Collection<Id, Item>&, Id id) {
+        _watchers.erase(id);
+        _log.append(_channel, RecordKind::ItemRemoved,
+                    [&](Writer& writer) { writer.write(id); });
+    }
+
+    void onCleared(Collection<Id, Item>& collection) {
+        _watchers.clear();
+        if (!collection.isSwapping()) {
+            _log.append(_channel, RecordKind::Cleared, [](Writer&) {});
+        }
+    }
+
+    DeltaLog& _log;
+    uint16_t _channel;
+    Collection<Id, Item>& _collection;
+    Schema<Item, Fields...> _schema;
+    map<Id, unique_ptr<ItemWatcher>> _watchers;
+    // Whether a snapshot left out the evicted items
+    bool _omitted = false;
+};
+
+/**
+ * @brief Creates a new ReplicationSource, deducing its template arguments.
+ */
+template <typename Id, typename Item, typename... Fields>
+unique_ptr<ReplicationSource<Id, Item, Fields...>>
+makeReplicationSource(DeltaLog& log, uint16_t channel,
+                      Collection<Id, Item>& collection,
+                      const Schema<Item, Fields...>& schema) {
+    return make_unique<ReplicationSource<Id, Item, Fields...>>(
+        log, channel, collection, schema);
+}
+
+/**
+ * @brief Interface of objects that apply the records of one channel.
+ */
+class ChannelApplier {
+  public:
+    /**
+     * @brief Applies a record.
+     *
+     * @param kind the kind of the record.
+     * @param payload the payload of the record.
+     * @throws DecodeError if the record is malformed or does not match the
+     * state of the replica.
+     */
+    virtual void apply(RecordKind kind, Reader& payload) = 0;
+
+    virtual ~ChannelApplier() = default;
+};
+
+/**
+ * @brief Applies the records written by a ReplicationSource to a replica
+ * Collection. The replica fires the same events as the original, so views and
+ * indexes on the standby stay warm.
+ *
+ * Items are created with a constructor that takes the item ID.
+ */
+template <typename Id, typename Item, typename... Fields>
+class ReplicaApplier : public ChannelApplier {
+  public:
+    /**
+     * @brief Creates a new ReplicaApplier.
+     *
+     * @param collection the replica collection.
+     * @param schema the same schema as used by the source.
+     */
+    explicit ReplicaApplier(Collection<Id, Item>& collection,
+                            const Schema<Item, Fields...>& schema)
+        : _collection(collection), _schema(schema) {}
+
+    void apply(RecordKind kind, Reader& payload) override {
+        switch (kind) {
+        case RecordKind::ItemAdded: {
+            auto id = payload.read<Id>();
+            if (_collection.contains(id)) {
+                readValues(payload, _collection.findById(id), _schema);
+            } else {
+                auto item = make_unique<Item>(id);
+                readValues(payload, *item, _schema);
+                _collection.add(item.release());
+            }
+            break;
+        }
+        case RecordKind::ItemRemoved:
+            _collection.removeById(payload.read<Id>());
+            break;
+        case RecordKind::Cleared:
+            _collection.clear();
+            break;
+        case RecordKind::ValueChanged: {
+            auto& item = find(payload.read<Id>());
+            readValue(payload, item, _schema);
+            break;
+        }
+        case RecordKind::ValueCleared: {
+            auto& item = find(payload.read<Id>());
+            visit(payload.readVarint(),
+                  [&](const auto& field) { field.of(item).clear(); });
+            break;
+        }
+        default:
+            throw DecodeError("Unexpected record kind");
+        }
+    }
+
+  private:
+    Item& find(const Id& id) {
+        if (!_collection.contains(id)) {
+            throw DecodeError("Unknown item");
+        }
+        return _collection.findById(id);
+    }
+
+    template <typename Function> void visit(size_t index, Function&& function) {
+        if (!_schema.visit(index, function)) {
+            throw DecodeError("Unknown field");
+        }
+    }
+
+    Collection<Id, Item>& _collection;
+    Schema<Item, Fields...> _schema;
+};
+
+/**
+ * @brief Creates a new ReplicaApplier, deducing its template arguments.
+ */
+template <typename Id, typename Item, typename... Fields>
+unique_ptr<ReplicaApplier<Id, Item, Fields...>>
+makeReplicaApplier(Collection<Id, Item>& collection,
+                   const Schema<Item, Fields...>& schema) {
+    return make_unique<ReplicaApplier<Id, Item, Fields...>>(collection, schema);
+}
+
+/**
+ * @brief Replication statistics of a ReplicationSink.
+ */
+struct ReplicationStats {
+    // Sequence number of the last applied record
+    uint64_t sequence = 0;
+    // Number of applied records
+    uint64_t records = 0;
+    // Number of times the sink has fallen out of sync
+    uint64_t resyncs = 0;
+    // Time between appending and applying the last record, in microseconds
+    int64_t lastLag = 0;
+    // Largest lag observed, in microseconds
+    int64_t maxLag = 0;
+};
+
+/**
+ * @brief Receives the frames of a DeltaLog on the standby and dispatches them
+ * to the ChannelAppliers of their channels.
+ *
+ * The sink starts out of sync and ignores everything until a snapshot begins.
+ * After that every record must have the next sequence number. If a record is
+ * missing or cannot be applied, the sink falls out of sync, fires the
+ * outOfSync event and waits for the next snapshot. The replicas keep the
+ * state they already have in the meantime.
+ */
+class ReplicationSink : private Base::NonCopyable {
+  public:
+    /**
+     * @brief Registers the applier of the given channel.
+     *
+     * @param channel the channel.
+     * @param applier the applier, which must outlive the sink.
+     */
+    void registerChannel(uint16_t channel, ChannelApplier& applier) {
+        _channels[channel] = &applier;
+    }
+
+    /**
+     * @brief Feeds bytes received from the primary to the sink. The bytes do
+     * not need to be aligned with frame boundaries.
+     *
+     * @param data the received bytes.
+     * @param size the number of bytes.
+     */
+    void feed(const uint8_t* data, size_t size) {
+        _buffer.insert(_buffer.end(), data, data + size);
+        size_t offset = 0;
+        while (_buffer.size() - offset >= 4) {
+            Reader header(_buffer.data() + offset, 4);
+            auto length = header.readFixed32();
+            if (length > maxFrameLength) {
+                _buffer.clear();
+                fallOutOfSync();
+                return;
+            }
+            if (_buffer.size() - offset - 4 < length) {
+                break;
+            }
+            process(_buffer.data() + offset + 4, length);
+            offset += 4 + length;
+        }
+        _buffer.erase(_buffer.begin(), _buffer.begin() + offset);
+    }
+
+    /**
+     * @brief Discards any partially received frame and waits for the next
+     * snapshot. Call this when the connection to the primary is lost.
+     */
+    void reset() {
+        _buffer.clear();
+        _inSync = false;
+    }
+
+    /**
+     * @brief Checks if the replicas are in sync with the primary.
+     */
+    bool isInSync() const { return _inSync; }
+
+    ReplicationStats const& stats() const { return _stats; }
+
+    EVENT(outOfSync, ReplicationSink&)
+
+  private:
+    static constexpr uint32_t maxFrameLength = 64 * 1024 * 1024;
+
+    void process(const uint8_t* frame, size_t size) {
+        try {
+            Reader reader(frame, size);
+            auto sequence = reader.readVarint();
+            auto timestamp = reader.readSignedVarint();
+            auto channel = static_cast<uint16_t>(reader.readVarint());
+            auto kind = static_cast<RecordKind>(reader.readByte());
+            if (kind == RecordKind::SnapshotBegin) {
+                _inSync = true;
+            } else if (!_inSync) {
+                return;
+            } else if (sequence != _stats.sequence + 1) {
+                fallOutOfSync();
+                return;
+            }
+            if (kind != RecordKind::Heartbeat &&
+                kind != RecordKind::SnapshotBegin) {
+                auto applier = _channels.find(channel);
+                if (applier == _channels.end()) {
+                    throw DecodeError("Unknown channel");
+                }
+                applier->second->apply(kind, reader);
+            }
+            _stats.sequence = sequence;
+            _stats.records++;
+            _stats.lastLag = currentTimeMicros() - timestamp;
+            _stats.maxLag = max(_stats.maxLag, _stats.lastLag);
+        } catch (const DecodeError&) {
+            fallOutOfSync();
+        }
+    }
+
+    void fallOutOfSync() {
+        if (_inSync) {
+            _inSync = false;
+            _stats.resyncs++;
+            _outOfSync.fire(*this);
+        }
+    }
+
+    vector<uint8_t> _buffer;
+    map<uint16_t, ChannelApplier*> _channels;
+    bool _inSync = false;
+    ReplicationStats _stats;
+};
+
+} // namespace Base::Replication
+
+#endif // REPLICATION_H
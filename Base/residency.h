@@ -0,0 +1,470 @@
+#ifndef RESIDENCY_H
+#define RESIDENCY_H
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "codec.h"
+#include "common.h"
+#include "field.h"
+#include "memoryinspector.h"
+#include "memoryusage.h"
+#include "model.h"
+#include "replication.h"
+
+namespace Base::Model {
+
+using Base::Serialization::DecodeError;
+using Base::Serialization::Reader;
+using Base::Serialization::Writer;
+
+/**
+ * @brief Stores records by key, such as the collections of closed incidents
+ * that a ResidencyManager evicted.
+ */
+class Archive {
+  public:
+    /**
+     * @brief Stores a record, replacing the one with the same key.
+     *
+     * @return true on success.
+     */
+    virtual bool store(const string& key, const vector<uint8_t>& data) = 0;
+
+    /**
+     * @brief Loads a record.
+     *
+     * @return true on success, false if there is no record or it cannot be
+     * read.
+     */
+    virtual bool load(const string& key, vector<uint8_t>& data) = 0;
+
+    virtual void remove(const string& key) = 0;
+
+    virtual ~Archive() = default;
+};
+
+/**
+ * @brief An Archive with a file per record in a directory. A record is
+ * written to a temporary file that is synced and then replaces the old one,
+ * and the directory is synced after the rename, so a crash while storing
+ * leaves the previous record intact and a stored record survives a crash.
+ */
+class FileArchive : public Archive, private Base::NonCopyable {
+  public:
+    explicit FileArchive(const string& directory) : _directory(directory) {}
+
+    bool store(const string& key, const vector<uint8_t>& data) override {
+        error_code error;
+        filesystem::create_directories(_directory, error);
+        if (error) {
+            return false;
+        }
+        auto path = pathOf(key);
+        auto temporary = path + ".tmp";
+        if (!writeFile(temporary, data)) {
+            ::unlink(temporary.c_str());
+            return false;
+        }
+        filesystem::rename(temporary, path, error);
+        if (error) {
+            return false;
+        }
+        // Makes the rename itself durable
+        auto directory = ::open(_directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (directory < 0) {
+            return false;
+        }
+        auto synced = ::fsync(directory) == 0;
+        ::close(directory);
+        return synced;
+    }
+
+    bool load(const string& key, vector<uint8_t>& data) override {
+        ifstream file(pathOf(key), ios::binary | ios::ate);
+        if (!file) {
+            return false;
+        }
+        auto size = static_cast<streamsize>(file.tellg());
+        file.seekg(0);
+        data.resize(static_cast<size_t>(size));
+        file.read(reinterpret_cast<char*>(data.data()), size);
+        return static_cast<bool>(file);
+    }
+
+    void remove(const string& key) override {
+        error_code error;
+        filesystem::remove(pathOf(key), error);
+    }
+
+    const string& directory() const { return _directory; }
+
+  private:
+    static bool writeFile(const string& path, const vector<uint8_t>& data) {
+        auto file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file < 0) {
+            return false;
+        }
+        size_t written = 0;
+        while (written < data.size()) {
+            auto result = ::write(file, data.data() + written,
+                                  data.size() - written);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                ::close(file);
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+        auto synced = ::fsync(file) == 0;
+        return ::close(file) == 0 && synced;
+    }
+
+    string pathOf(const string& key) const {
+        // Other characters are escaped, so any key makes a valid file name
+        string name;
+        for (unsigned char c : key) {
+            if (isalnum(c) || c == '-' || c == '_') {
+                name += static_cast<char>(c);
+            } else {
+                char escaped[4];
+                snprintf(escaped, sizeof(escaped), "%%%02X", c);
+                name += escaped;
+            }
+        }
+        return _directory + "/" + name + ".bin";
+    }
+
+    string _directory;
+};
+
+/**
+ * @brief One part of the state of a unit of a ResidencyManager, such as one
+ * of the collections of an incident: how to measure it, to write it to the
+ * archive, to read it back and to drop it from memory.
+ */
+struct ResidentPart {
+    function<Base::Diagnostics::MemoryUsage()> measure;
+    function<void(Writer&)> save;
+    // Throws DecodeError if the input is malformed
+    function<void(Reader&)> load;
+    // Receives a function that reloads the unit, for when the part is used
+    // while it is unloaded
+    function<void(function<void()>)> unload;
+};
+
+/**
+ * @brief Makes a collection a ResidentPart. The items and their schema
+ * properties are archived. Unloading evicts the collection and loading
+ * restores the items in one batch (see Collection::evict()), so views see a
+ * cleared and then an itemsAdded event, while a ReplicationSource, and with
+ * it the standbys and the audit log, sees nothing. Using the evicted
+ * collection reloads it. Items are created with a constructor that takes
+ * the item ID.
+ *
+ * The collection and the schema must outlive the part.
+ */
+template <typename Id, typename Item, typename... Fields>
+ResidentPart residentCollection(Collection<Id, Item>& collection,
+                                const Schema<Item, Fields...>& schema) {
+    ResidentPart part;
+    part.measure = [&collection, schema] {
+        return Base::Diagnostics::memoryUsage(collection, schema);
+    };
+    part.save = [&collection, schema](Writer& writer) {
+        writer.writeVarint(collection.size());
+        for (const auto& id : collection.ids()) {
+            Base::Replication::writeItem(writer, id,
+                                         collection.findById(id), schema);
+        }
+    };
+    part.load = [&collection, schema](Reader& reader) {
+        auto count = reader.readVarint();
+        vector<unique_ptr<Item>> items;
+        for (uint64_t i = 0; i < count; ++i) {
+            auto item = make_unique<Item>(reader.read<Id>());
+            Base::Replication::readValues(reader, *item, schema);
+            items.push_back(move(item));
+        }
+        vector<Item*> added;
+        added.reserve(items.size());
+        for (auto& item : items) {
+            added.push_back(item.release());
+        }
+        collection.restore(added);
+    };
+    part.unload = [&collection](function<void()> reload) {
+        collection.evict(move(reload));
+    };
+    return part;
+}
+
+/**
+ * @brief Statistics of a ResidencyManager.
+ */
+struct ResidencyStats {
+    uint64_t evictions = 0;
+    uint64_t reloads = 0;
+    // Evictions and reloads that failed on the archive
+    uint64_t failures = 0;
+    // The memory of the resident units at the last enforce(), in bytes
+    size_t residentBytes = 0;
+};
+
+/**
+ * @brief Keeps the memory of the models within a budget by evicting units,
+ * such as the collections of closed incidents, to an Archive and loading
+ * them back when they are accessed again.
+ *
+ * A unit is made of the ResidentParts added under its key. Only closed units
+ * are evicted, and only after they have not been accessed for the minimum
+ * idle time. enforce() measures the resident units and, while they are over
+ * the budget, evicts the least recently accessed ones first. Closed units
+ * that have not been accessed for the maximum age are evicted even under the
+ * budget, so a station that runs for weeks keeps a flat memory use.
+ *
+ * Using the models of an evicted unit reloads it, so callers need not know
+ * about eviction. Still call access() when a unit is opened or shown: it
+ * makes the unit the most recently used and tells whether it could be
+ * reloaded.
+ *
+ * Not thread safe; use it from the thread that owns the models.
+ */
+class ResidencyManager : private Base::NonCopyable {
+  public:
+    using Clock = chrono::steady_clock;
+
+    /**
+     * @brief Creates a new ResidencyManager.
+     *
+     * @param archive the archive to evict to; must outlive the manager.
+     * @param budget the memory the resident units may use, in bytes.
+     * @param minIdle how long a unit must not have been accessed before it
+     * may be evicted.
+     * @param maxAge how long a closed unit may stay resident without being
+     * accessed.
+     */
+    explicit ResidencyManager(
+        Archive& archive, size_t budget,
+        chrono::seconds minIdle = chrono::minutes(10),
+        chrono::seconds maxAge = chrono::hours(24))
+        : _archive(archive), _budget(budget), _minIdle(minIdle),
+          _maxAge(maxAge), _alive(make_shared<char>()) {}
+
+    /**
+     * @brief Adds a part to the unit with the given key, creating an open
+     * unit if there is none. The part must be loaded.
+     */
+    void add(const string& key, ResidentPart part,
+             Clock::time_point now = Clock::now()) {
+        auto& unit = _units[key];
+        if (unit.parts.empty()) {
+            unit.lastAccess = now;
+        } else {
+            // The new part joins the others in memory
+            access(key, now);
+        }
+        unit.parts.push_back(move(part));
+    }
+
+    /**
+     * @brief Forgets a unit and removes it from the archive. Its parts are
+     * left as they are.
+     */
+    void remove(const string& key) {
+        if (_units.erase(key) > 0) {
+            _archive.remove(key);
+        }
+    }
+
+    /**
+     * @brief Marks a unit as closed, which allows evicting it, or as open.
+     */
+    void setClosed(const string& key, bool closed = true) {
+        auto unit = _units.find(key);
+        if (unit != _units.end()) {
+            unit->second.closed = closed;
+        }
+    }
+
+    /**
+     * @brief Marks a unit as used, and reloads it from the archive if it was
+     * evicted.
+     *
+     * @return true if the unit is loaded, false if it is unknown or could
+     * not be reloaded.
+     */
+    bool access(const string& key, Clock::time_point now = Clock::now()) {
+        auto found = _units.find(key);
+        if (found == _units.end()) {
+            return false;
+        }
+        auto& unit = found->second;
+        unit.lastAccess = now;
+        return unit.resident || reload(key, unit);
+    }
+
+    bool isResident(const string& key) const {
+        auto unit = _units.find(key);
+        return unit != _units.end() && unit->second.resident;
+    }
+
+    /**
+     * @brief Measures the resident units and evicts closed ones as the
+     * budget and the maximum age require.
+     *
+     * @return the number of units evicted.
+     */
+    size_t enforce(Clock::time_point now = Clock::now()) {
+        size_t total = 0;
+        vector<pair<Clock::time_point, map<string, Unit>::iterator>> idle;
+        for (auto unit = _units.begin(); unit != _units.end(); ++unit) {
+            auto& state = unit->second;
+            if (!state.resident) {
+                continue;
+            }
+            state.bytes = 0;
+            for (const auto& part : state.parts) {
+                state.bytes += part.measure().total();
+            }
+            total += state.bytes;
+            if (state.closed && now - state.lastAccess >= _minIdle) {
+                idle.emplace_back(state.lastAccess, unit);
+            }
+        }
+        sort(idle.begin(), idle.end(),
+             [](const auto& a, const auto& b) { return a.first < b.first; });
+        size_t evicted = 0;
+        for (auto& [lastAccess, unit] : idle) {
+            if (total <= _budget && now - lastAccess < _maxAge) {
+                // The rest were accessed more recently still
+                break;
+            }
+            auto bytes = unit->second.bytes;
+            if (evict(unit->first, unit->second)) {
+                total -= bytes;
+                evicted++;
+            }
+        }
+        _stats.residentBytes = total;
+        return evicted;
+    }
+
+    size_t budget() const { return _budget; }
+
+    void setBudget(size_t budget) { _budget = budget; }
+
+    size_t unitCount() const { return _units.size(); }
+
+    size_t residentCount() const {
+        return static_cast<size_t>(
+            count_if(_units.begin(), _units.end(),
+                     [](const auto& unit) { return unit.second.resident; }));
+    }
+
+    const ResidencyStats& stats() const { return _stats; }
+
+  private:
+    struct Unit {
+        vector<ResidentPart> parts;
+        bool closed = false;
+        bool resident = true;
+        Clock::time_point lastAccess;
+        // As measured by the last enforce()
+        size_t bytes = 0;
+    };
+
+    bool evict(const string& key, Unit& unit) {
+        vector<uint8_t> data;
+        Writer writer(data);
+        writer.writeVarint(unit.parts.size());
+        for (const auto& part : unit.parts) {
+            part.save(writer);
+        }
+        if (!_archive.store(key, data)) {
+            // Kept in memory rather than lost
+            _stats.failures++;
+            return false;
+        }
+        for (const auto& part : unit.parts) {
+            part.unload(reloader(key));
+        }
+        unit.resident = false;
+        unit.bytes = 0;
+        _stats.evictions++;
+        return true;
+    }
+
+    function<void()> reloader(const string& key) {
+        // The parts may outlive the manager
+        return [this, key, alive = weak_ptr<char>(_alive)] {
+            if (!alive.expired()) {
+                access(key);
+            }
+        };
+    }
+
+    bool reload(const string& key, Unit& unit) {
+        vector<uint8_t> data;
+        auto ok = _archive.load(key, data);
+        // Handlers of the first parts may use the others before they are
+        // loaded, which must not load the unit again
+        unit.resident = true;
+        if (ok) {
+            try {
+                Reader reader(data.data(), data.size());
+                if (reader.readVarint() != unit.parts.size()) {
+                    throw DecodeError("Wrong number of parts");
+                }
+                for (const auto& part : unit.parts) {
+                    part.load(reader);
+                }
+            } catch (const DecodeError&) {
+                // Leave no part half loaded
+                for (const auto& part : unit.parts) {
+                    part.unload(reloader(key));
+                }
+                ok = false;
+            }
+        }
+        if (!ok) {
+            unit.resident = false;
+            _stats.failures++;
+            return false;
+        }
+        _stats.reloads++;
+        return true;
+    }
+
+    Archive& _archive;
+    size_t _budget;
+    chrono::seconds _minIdle;
+    chrono::seconds _maxAge;
+    map<string, Unit> _units;
+    ResidencyStats _stats;
+    shared_ptr<char> _alive;
+};
+
+} // namespace Base::Model
+
+#endif // RESIDENCY_H
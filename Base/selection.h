@@ -0,0 +1,234 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+#include "event.h"
+#include "field.h"
+#include "model.h"
+
+namespace Base::Model {
+
+/**
+ * @brief Keeps cached lists of the ids of the items in a Collection that match
+ * a predicate, one list per key. A list is computed the first time it is
+ * selected and is after that kept up to date incrementally: added items are
+ * tested, removed items are dropped and items whose watched properties change
+ * are tested again. Selecting a cached key never scans the collection.
+ *
+ * The selection must not outlive the collection.
+ *
+ * @tparam Id the type of the item IDs.
+ * @tparam Item the type of the items.
+ * @tparam Key the type of the keys that the predicate is evaluated against.
+ */
+template <typename Id, typename Item, typename Key>
+class Selection
+    : public Base::Event::EventHandler<Selection<Id, Item, Key>> {
+    using Predicate = function<bool(Key const&, Item const&)>;
+
+  public:
+    /**
+     * @brief Creates a new Selection.
+     *
+     * @param collection the collection to select items from.
+     * @param predicate the function that decides whether an item belongs to
+     * the selection of a key.
+     */
+    explicit Selection(Collection<Id, Item>& collection,
+                       const Predicate& predicate)
+        : _collection(collection), _predicate(predicate) {
+        this->connect(collection.itemAddedEvent(), &Selection::onItemAdded);
+        this->connect(collection.itemsAddedEvent(), &Selection::onItemsAdded);
+        this->connect(collection.itemRemovedEvent(),
+                      &Selection::onItemRemoved);
+        this->connect(collection.clearedEvent(), &Selection::onCleared);
+        for (const auto& id : collection.ids()) {
+            _watchers[id] = make_unique<ItemWatcher>(*this, id);
+        }
+    }
+
+    /**
+     * @brief Tells the selection that the predicate reads the given property.
+     * Whenever the property of an item changes, the item is tested again
+     * against all cached keys. Properties that are not watched must not
+     * affect the outcome of the predicate.
+     *
+     * @param field the property to watch.
+     */
+    template <typename T> void watch(const Field<Item, T>& field) {
+        auto connector = [field](ItemWatcher& watcher, Item& item) {
+            watcher.connect(field.of(item).valueChangedEvent(),
+                            &ItemWatcher::template onValueChanged<T>);
+            watcher.connect(field.of(item).clearedEvent(),
+                            &ItemWatcher::template onCleared<T>);
+        };
+        for (auto& kv : _watchers) {
+            connector(*kv.second, _collection.findById(kv.first));
+        }
+        _connectors.push_back(connector);
+    }
+
+    /**
+     * @brief Returns the IDs of all items that match the given key, in
+     * ascending order. The result is computed if it is not cached.
+     *
+     * @param key the key.
+     * @return the IDs of the matching items. The reference stays valid until
+     * the key is invalidated.
+     */
+    vector<Id> const& select(const Key& key) {
+        auto cached = _cache.find(key);
+        if (cached != _cache.end()) {
+            return cached->second;
+        }
+        vector<Id> ids;
+        _collection.forEach([&](const Id& id, Item const& item) {
+            if (_predicate(key, item)) {
+                ids.push_back(id);
+            }
+        });
+        return _cache[key] = move(ids);
+    }
+
+    /**
+     * @brief Computes and caches the selection of the given key in advance, so
+     * that the next call to select() returns immediately.
+     *
+     * @param key the key.
+     */
+    void warm(const Key& key) { select(key); }
+
+    /**
+     * @brief Checks if the selection of the given key is cached.
+     *
+     * @param key the key.
+     * @return true if the selection is cached, false otherwise.
+     */
+    bool isCached(const Key& key) const { return _cache.count(key) > 0; }
+
+    /**
+     * @brief Drops the cached selection of the given key. Clients must call
+     * this when the predicate changes its mind about a key for reasons other
+     * than the watched properties.
+     *
+     * @param key the key.
+     */
+    void invalidate(const Key& key) { _cache.erase(key); }
+
+    /**
+     * @brief Drops all cached selections.
+     */
+    void invalidateAll() { _cache.clear(); }
+
+  private:
+    /**
+     * @brief Watches the properties of a single item on behalf of the
+     * selection.
+     */
+    class ItemWatcher : public Base::Event::EventHandler<ItemWatcher> {
+      public:
+        explicit ItemWatcher(Selection& selection, const Id& id)
+            : _selection(selection), _id(id) {}
+
+        template <typename T> void onValueChanged(Property<T>&, T) {
+            _selection.reevaluate(_id);
+        }
+
+        template <typename T> void onCleared(Property<T>&) {
+            _selection.reevaluate(_id);
+        }
+
+      private:
+        Selection& _selection;
+        Id _id;
+    };
+
+    void onItemAdded(Collection<Id, Item>&, Id id, Item& item) {
+        watchItem(id, item);
+        reevaluate(id, item);
+    }
+
+    void onItemsAdded(Collection<Id, Item>&, const vector<Id>& ids) {
+        for (const auto& id : ids) {
+            watchItem(id, _collection.findById(id));
+        }
+        // Merge the matches in one go instead of inserting them one by one
+        for (auto& kv : _cache) {
+            auto& selected = kv.second;
+            auto middle = selected.size();
+            for (const auto& id : ids) {
+                if (_predicate(kv.first, _collection.findById(id))) {
+                    selected.push_back(id);
+                }
+            }
+            sort(selected.begin() + middle, selected.end());
+            inplace_merge(selected.begin(), selected.begin() + middle,
+                          selected.end());
+        }
+    }
+
+    void watchItem(const Id& id, Item& item) {
+        auto watcher = make_unique<ItemWatcher>(*this, id);
+        for (const auto& connector : _connectors) {
+            connector(*watcher, item);
+        }
+        _watchers[id] = move(watcher);
+    }
+
+    void onItemRemoved(Collection<Id, Item>&, Id id) {
+        _watchers.erase(id);
+        for (auto& kv : _cache) {
+            erase(kv.second, id);
+        }
+    }
+
+    void onCleared(Collection<Id, Item>&) {
+        _watchers.clear();
+        for (auto& kv : _cache) {
+            kv.second.clear();
+        }
+    }
+
+    void reevaluate(const Id& id) { reevaluate(id, _collection.findById(id)); }
+
+    void reevaluate(const Id& id, Item const& item) {
+        for (auto& kv : _cache) {
+            if (_predicate(kv.first, item)) {
+                insert(kv.second, id);
+            } else {
+                erase(kv.second, id);
+            }
+        }
+    }
+
+    static void insert(vector<Id>& ids, const Id& id) {
+        auto position = lower_bound(ids.begin(), ids.end(), id);
+        if (position == ids.end() || *position != id) {
+            ids.insert(position, id);
+        }
+    }
+
+    static void erase(vector<Id>& ids, const Id& id) {
+        auto position = lower_bound(ids.begin(), ids.end(), id);
+        if (position != ids.end() && *position == id) {
+            ids.erase(position);
+        }
+    }
+
+    Collection<Id, Item>& _collection;
+    Predicate _predicate;
+    vector<function<void(ItemWatcher&, Item&)>> _connectors;
+    map<Id, unique_ptr<ItemWatcher>> _watchers;
+    map<Key, vector<Id>> _cache;
+};
+
+} // namespace Base::Model
+
+#endif // SELECTION_H
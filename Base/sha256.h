@@ -0,0 +1,285 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#define BASE_SHA256_SHANI
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace Base::Crypto {
+
+/**
+ * @brief Incremental SHA-256 (FIPS 180-4). On x86 processors with the SHA
+ * extensions, blocks are compressed with the SHA-NI instructions; otherwise
+ * a portable implementation is used. The choice is made once at run time.
+ */
+class Sha256 {
+  public:
+    using Digest = array<uint8_t, 32>;
+
+    explicit Sha256() { reset(); }
+
+    /**
+     * @brief Starts a new hash, discarding any data written so far.
+     */
+    void reset() {
+        static constexpr uint32_t initial[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        memcpy(_state, initial, sizeof(_state));
+        _buffered = 0;
+        _length = 0;
+    }
+
+    /**
+     * @brief Adds data to the hash.
+     *
+     * @param data the data.
+     * @param size the number of bytes.
+     */
+    void update(const void* data, size_t size) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        _length += size;
+        if (_buffered > 0) {
+            auto count = min(size, sizeof(_buffer) - _buffered);
+            memcpy(_buffer + _buffered, bytes, count);
+            _buffered += count;
+            bytes += count;
+            size -= count;
+            if (_buffered < sizeof(_buffer)) {
+                return;
+            }
+            compress(_state, _buffer, 1);
+            _buffered = 0;
+        }
+        if (size >= 64) {
+            compress(_state, bytes, size / 64);
+            bytes += size & ~size_t(63);
+            size &= 63;
+        }
+        memcpy(_buffer, bytes, size);
+        _buffered = size;
+    }
+
+    /**
+     * @brief Finishes the hash and returns the digest. Call reset() before
+     * reusing the object.
+     */
+    Digest finish() {
+        uint64_t bits = _length * 8;
+        uint8_t padding[72] = {0x80};
+        size_t paddingSize = (_buffered < 56 ? 56 : 120) - _buffered;
+        for (int i = 0; i < 8; ++i) {
+            padding[paddingSize + i] =
+                static_cast<uint8_t>(bits >> (56 - 8 * i));
+        }
+        update(padding, paddingSize + 8);
+        Digest digest;
+        for (int i = 0; i < 8; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                digest[4 * i + j] =
+                    static_cast<uint8_t>(_state[i] >> (24 - 8 * j));
+            }
+        }
+        return digest;
+    }
+
+    /**
+     * @brief Returns the SHA-256 digest of the given data.
+     */
+    static Digest hash(const void* data, size_t size) {
+        Sha256 sha;
+        sha.update(data, size);
+        return sha.finish();
+    }
+
+    /**
+     * @brief Checks if blocks are compressed with the SHA-NI instructions.
+     */
+    static bool isAccelerated() {
+        return compressFunction() != &compressPortable;
+    }
+
+    /**
+     * @brief Compresses whole 64 byte blocks into the state with the portable
+     * implementation. Exposed for testing the accelerated one against it.
+     */
+    static void compressPortable(uint32_t* state, const uint8_t* data,
+                                 size_t blocks) {
+        uint32_t w[64];
+        while (blocks-- > 0) {
+            for (int i = 0; i < 16; ++i) {
+                w[i] = uint32_t(data[4 * i]) << 24 |
+                       uint32_t(data[4 * i + 1]) << 16 |
+                       uint32_t(data[4 * i + 2]) << 8 | data[4 * i + 3];
+            }
+            for (int i = 16; i < 64; ++i) {
+                auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^
+                          (w[i - 15] >> 3);
+                auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^
+                          (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+            auto a = state[0], b = state[1], c = state[2], d = state[3];
+            auto e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; ++i) {
+                auto s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+                auto t1 = h + s1 + ((e & f) ^ (~e & g)) + k[i] + w[i];
+                auto s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+                auto t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+            data += 64;
+        }
+    }
+
+  private:
+    using CompressFunction = void (*)(uint32_t*, const uint8_t*, size_t);
+
+    static constexpr uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+        0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+        0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+        0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+    static uint32_t rotr(uint32_t value, int count) {
+        return (value >> count) | (value << (32 - count));
+    }
+
+#ifdef BASE_SHA256_SHANI
+    static bool hasShaExtensions() {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+            (ecx & bit_SSE4_1) == 0) {
+            return false;
+        }
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        // CPUID.(EAX=7, ECX=0):EBX bit 29 is the SHA extensions
+        return (ebx & (1u << 29)) != 0;
+    }
+
+    __attribute__((target("sha,sse4.1"))) static void
+    compressShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+        const __m128i byteSwap =
+            _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        // The rounds instructions keep the state as ABEF and CDGH
+        auto dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+        auto hgfe =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+        auto cdab = _mm_shuffle_epi32(dcba, 0xb1);
+        auto efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+        auto abef = _mm_alignr_epi8(cdab, efgh, 8);
+        auto cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+        while (blocks-- > 0) {
+            auto abefSaved = abef;
+            auto cdghSaved = cdgh;
+            __m128i w[4];
+            for (int i = 0; i < 16; ++i) {
+                __m128i words;
+                if (i < 4) {
+                    words = _mm_shuffle_epi8(
+                        _mm_loadu_si128(
+                            reinterpret_cast<const __m128i*>(data + 16 * i)),
+                        byteSwap);
+                } else {
+                    // W[t-16] + s0(W[t-15]) + W[t-7], then s1(W[t-2])
+                    words = _mm_sha256msg1_epu32(w[i % 4], w[(i + 1) % 4]);
+                    words = _mm_add_epi32(
+                        words,
+                        _mm_alignr_epi8(w[(i + 3) % 4], w[(i + 2) % 4], 4));
+                    words = _mm_sha256msg2_epu32(words, w[(i + 3) % 4]);
+                }
+                w[i % 4] = words;
+                auto constants = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(k + 4 * i));
+                auto message = _mm_add_epi32(words, constants);
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+                message = _mm_shuffle_epi32(message, 0x0e);
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, message);
+            }
+            abef = _mm_add_epi32(abef, abefSaved);
+            cdgh = _mm_add_epi32(cdgh, cdghSaved);
+            data += 64;
+        }
+
+        auto feba = _mm_shuffle_epi32(abef, 0x1b);
+        auto dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+        dcba = _mm_blend_epi16(feba, dchg, 0xf0);
+        hgfe = _mm_alignr_epi8(dchg, feba, 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), dcba);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), hgfe);
+    }
+#endif
+
+    static CompressFunction compressFunction() {
+#ifdef BASE_SHA256_SHANI
+        static const CompressFunction function =
+            hasShaExtensions() ? &compressShaNi : &compressPortable;
+        return function;
+#else
+        return &compressPortable;
+#endif
+    }
+
+    static void compress(uint32_t* state, const uint8_t* data, size_t blocks) {
+        compressFunction()(state, data, blocks);
+    }
+
+    uint32_t _state[8];
+    uint8_t _buffer[64];
+    size_t _buffered;
+    uint64_t _length;
+};
+
+/**
+ * @brief Returns the digest as lower case hexadecimal.
+ */
+inline string toHex(const Sha256::Digest& digest) {
+    static const char digits[] = "0123456789abcdef";
+    string hex;
+    hex.reserve(digest.size() * 2);
+    for (auto byte : digest) {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 0xf];
+    }
+    return hex;
+}
+
+} // namespace Base::Crypto
+
+#endif // SHA256_H
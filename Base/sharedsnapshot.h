@@ -0,0 +1,547 @@
+#ifndef SHAREDSNAPSHOT_H
+#define SHAREDSNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BASE_SHAREDSNAPSHOT_POSIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#include "codec.h"
+#include "common.h"
+#include "event.h"
+#include "field.h"
+#include "model.h"
+#include "replication.h"
+
+namespace Base::SharedMemory {
+
+using Base::Model::Collection;
+using Base::Model::Property;
+using Base::Model::Schema;
+using Base::Serialization::DecodeError;
+using Base::Serialization::Reader;
+using Base::Serialization::Writer;
+
+static_assert(atomic<uint64_t>::is_always_lock_free,
+              "Shared memory needs lock free 64 bit atomics");
+
+/**
+ * @brief The layout of a snapshot region. The header is followed by two
+ * slots, each a SlotHeader and the slot capacity in bytes.
+ *
+ * The publisher writes every snapshot into the slot that was not published
+ * last, so readers of the latest snapshot are only disturbed when the
+ * publisher laps them. Each slot is a seqlock: its sequence is odd while the
+ * slot is written, and a reader whose sequence changed while it was reading
+ * tries again.
+ */
+namespace Layout {
+
+constexpr uint64_t magic = 0x31504e5345534142; // "BASESNP1"
+
+struct alignas(64) Header {
+    uint64_t magic;
+    uint64_t slotCapacity;
+    // The number of snapshots published; the latest is in slot published % 2
+    atomic<uint64_t> published;
+    // Set when the publisher is gone and readers should reopen the region
+    atomic<uint64_t> closed;
+};
+
+struct alignas(64) SlotHeader {
+    atomic<uint64_t> sequence;
+    atomic<uint64_t> size;
+};
+
+constexpr size_t slotStride(size_t capacity) {
+    return sizeof(SlotHeader) + (capacity + 63) / 64 * 64;
+}
+
+constexpr size_t regionSize(size_t capacity) {
+    return sizeof(Header) + 2 * slotStride(capacity);
+}
+
+} // namespace Layout
+
+/**
+ * @brief A memory mapping of a named POSIX shared memory object.
+ */
+class Mapping : private Base::NonCopyable {
+  public:
+    ~Mapping() override { unmap(); }
+
+    bool isMapped() const { return _address != nullptr; }
+
+    uint8_t* address() const { return static_cast<uint8_t*>(_address); }
+
+    size_t size() const { return _size; }
+
+    string errorString() const { return _error; }
+
+  protected:
+    bool map(const string& name, bool writable, size_t size) {
+        unmap();
+#ifdef BASE_SHAREDSNAPSHOT_POSIX
+        auto fd = writable ? ::shm_open(name.c_str(), O_RDWR | O_CREAT, 0644)
+                           : ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return fail("Cannot open " + name);
+        }
+        struct stat status;
+        bool ok = true;
+        if (writable) {
+            ok = ::ftruncate(fd, static_cast<off_t>(size)) == 0;
+        } else if ((ok = ::fstat(fd, &status) == 0)) {
+            size = static_cast<size_t>(status.st_size);
+        }
+        void* address = MAP_FAILED;
+        if (ok && size >= sizeof(Layout::Header)) {
+            address = ::mmap(nullptr, size,
+                             writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                             MAP_SHARED, fd, 0);
+        }
+        auto error = errno;
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            errno = error;
+            return fail("Cannot map " + name);
+        }
+        _address = address;
+        _size = size;
+        _error.clear();
+        return true;
+#else
+        (void)writable;
+        (void)size;
+        _error = "Shared memory is not supported on this platform: " + name;
+        return false;
+#endif
+    }
+
+    void unmap() {
+#ifdef BASE_SHAREDSNAPSHOT_POSIX
+        if (_address != nullptr) {
+            ::munmap(_address, _size);
+        }
+#endif
+        _address = nullptr;
+        _size = 0;
+    }
+
+    Layout::Header& header() const {
+        return *reinterpret_cast<Layout::Header*>(_address);
+    }
+
+    Layout::SlotHeader& slot(uint64_t index) const {
+        return *reinterpret_cast<Layout::SlotHeader*>(
+            address() + sizeof(Layout::Header) +
+            (index % 2) * Layout::slotStride(header().slotCapacity));
+    }
+
+    uint8_t* data(Layout::SlotHeader& slot) const {
+        return reinterpret_cast<uint8_t*>(&slot) + sizeof(Layout::SlotHeader);
+    }
+
+  private:
+    bool fail(const string& message) {
+#ifdef BASE_SHAREDSNAPSHOT_POSIX
+        _error = message + ": " + strerror(errno);
+#else
+        _error = message;
+#endif
+        return false;
+    }
+
+    void* _address = nullptr;
+    size_t _size = 0;
+    string _error;
+};
+
+/**
+ * @brief Publishes snapshots into a named shared memory region that any
+ * number of SnapshotReader processes map read-only.
+ *
+ * Publishing costs one copy into the region, however many readers there are,
+ * and readers never block the publisher. A snapshot that does not fit the
+ * capacity given to create() is not published.
+ */
+class SnapshotPublisher : public Mapping {
+  public:
+    ~SnapshotPublisher() override { close(); }
+
+    /**
+     * @brief Creates the region, replacing any region with the same name.
+     * Readers that still map a replaced region see it as closed.
+     *
+     * @param name the name of the region, e.g. "/wallboard-incidents".
+     * @param capacity the largest snapshot in bytes.
+     * @return true on success, false on failure. See errorString().
+     */
+    bool create(const string& name, size_t capacity) {
+        close();
+#ifdef BASE_SHAREDSNAPSHOT_POSIX
+        ::shm_unlink(name.c_str());
+#endif
+        if (!map(name, true, Layout::regionSize(capacity))) {
+            return false;
+        }
+        _name = name;
+        auto& header = this->header();
+        header.magic = Layout::magic;
+        header.slotCapacity = capacity;
+        header.published.store(0, memory_order_relaxed);
+        header.closed.store(0, memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Marks the region as closed and removes its name. Readers keep
+     * their mapping until they reopen.
+     */
+    void close() {
+        if (!isMapped()) {
+            return;
+        }
+        header().closed.store(1, memory_order_release);
+#ifdef BASE_SHAREDSNAPSHOT_POSIX
+        ::shm_unlink(_name.c_str());
+#endif
+        unmap();
+    }
+
+    /**
+     * @brief Publishes the given bytes as the latest snapshot.
+     *
+     * @return true on success, false if the region is not open or the
+     * snapshot is larger than its capacity.
+     */
+    bool publish(const uint8_t* bytes, size_t size) {
+        if (!isMapped() || size > header().slotCapacity) {
+            return false;
+        }
+        auto& header = this->header();
+        auto published = header.published.load(memory_order_relaxed) + 1;
+        auto& slot = this->slot(published);
+        auto sequence = slot.sequence.load(memory_order_relaxed);
+        slot.sequence.store(sequence + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        memcpy(data(slot), bytes, size);
+        slot.size.store(size, memory_order_relaxed);
+        slot.sequence.store(sequence + 2, memory_order_release);
+        header.published.store(published, memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Publishes the snapshot that the given function writes.
+     */
+    template <typename Body> bool publish(Body&& body) {
+        _buffer.clear();
+        Writer writer(_buffer);
+        body(writer);
+        return publish(_buffer.data(), _buffer.size());
+    }
+
+    /**
+     * @brief Returns the number of snapshots published since create().
+     */
+    uint64_t published() const {
+        return isMapped() ? header().published.load(memory_order_relaxed) : 0;
+    }
+
+    size_t capacity() const {
+        return isMapped() ? header().slotCapacity : 0;
+    }
+
+  private:
+    string _name;
+    vector<uint8_t> _buffer;
+};
+
+/**
+ * @brief Reads the snapshots of a SnapshotPublisher in another process
+ * directly from the shared memory, without copying them.
+ */
+class SnapshotReader : public Mapping {
+  public:
+    /**
+     * @brief Maps the region with the given name read-only.
+     *
+     * @return true on success, false if the region does not exist (yet) or
+     * is not a snapshot region. See errorString().
+     */
+    bool open(const string& name) {
+        if (!map(name, false, 0)) {
+            return false;
+        }
+        if (header().magic != Layout::magic ||
+            size() < Layout::regionSize(header().slotCapacity)) {
+            unmap();
+            return false;
+        }
+        return true;
+    }
+
+    void close() { unmap(); }
+
+    /**
+     * @brief Checks if the publisher has closed or replaced the region. The
+     * reader should then open() it again.
+     */
+    bool isClosed() const {
+        return !isMapped() || header().closed.load(memory_order_acquire) != 0;
+    }
+
+    /**
+     * @brief Returns the number of snapshots published so far, to tell
+     * whether there is anything new to render.
+     */
+    uint64_t published() const {
+        return isMapped() ? header().published.load(memory_order_acquire) : 0;
+    }
+
+    /**
+     * @brief Invokes the given function with a Reader over the latest
+     * snapshot, which points into the shared memory.
+     *
+     * If the publisher overwrites the snapshot while the function runs, the
+     * function may see torn data and is invoked again; anything it derives
+     * from the snapshot should therefore be discarded when it is called
+     * again. A DecodeError thrown by it is treated the same way.
+     *
+     * @param function the function to invoke with a Reader.
+     * @param maxAttempts how often to try before giving up.
+     * @return true if the function has seen a consistent snapshot, false if
+     * there is no snapshot yet, the region is closed or every attempt was
+     * disturbed.
+     */
+    template <typename Function>
+    bool read(Function&& function, int maxAttempts = 100) const {
+        for (int attempt = 0; attempt < maxAttempts; ++attempt) {
+            if (isClosed()) {
+                return false;
+            }
+            auto& header = this->header();
+            auto published = header.published.load(memory_order_acquire);
+            if (published == 0) {
+                return false;
+            }
+            auto& slot = this->slot(published);
+            auto sequence = slot.sequence.load(memory_order_acquire);
+            if (sequence % 2 != 0) {
+                continue;
+            }
+            auto size = slot.size.load(memory_order_relaxed);
+            bool decoded = true;
+            if (size <= header.slotCapacity) {
+                try {
+                    Reader reader(data(slot), size);
+                    function(reader);
+                } catch (const DecodeError&) {
+                    decoded = false;
+                }
+            }
+            atomic_thread_fence(memory_order_acquire);
+            if (slot.sequence.load(memory_order_relaxed) == sequence) {
+                if (!decoded) {
+                    // A consistent snapshot that does not decode will not
+                    // get any better
+                    return false;
+                }
+                return size <= header.slotCapacity;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief Writes all items of a collection in the snapshot format: varint
+ * item count, then every item as written by Replication::writeItem(), so
+ * snapshots, replication and the residency archive share one item encoding.
+ */
+template <typename Id, typename Item, typename... Fields>
+void writeCollection(Writer& writer, const Collection<Id, Item>& collection,
+                     const Schema<Item, Fields...>& schema) {
+    writer.writeVarint(collection.size());
+    for (const auto& id : collection.ids()) {
+        Base::Replication::writeItem(writer, id, collection.findById(id),
+                                     schema);
+    }
+}
+
+/**
+ * @brief Reads a collection written by writeCollection() and invokes the
+ * given function with the ID and a temporary item for every item. Items are
+ * created with a constructor that takes the item ID.
+ */
+template <typename Id, typename Item, typename... Fields, typename Function>
+void readCollection(Reader& reader, const Schema<Item, Fields...>& schema,
+                    Function&& function) {
+    auto count = reader.readVarint();
+    for (uint64_t i = 0; i < count; ++i) {
+        auto id = reader.read<Id>();
+        Item item(id);
+        Base::Replication::readValues(reader, item, schema);
+        function(static_cast<const Id&>(id), static_cast<const Item&>(item));
+    }
+}
+
+/**
+ * @brief Publishes snapshots of a Collection for wallboards and other
+ * read-only viewers.
+ *
+ * The publisher watches the collection and the schema properties of its
+ * items, but only marks itself dirty; flush() publishes a new snapshot if
+ * anything changed since the last one. Calling flush() from a timer bounds
+ * the publishing cost regardless of how busy the collection is.
+ *
+ * Evicting and restoring the collection (see Collection::evict()) does not
+ * make the publisher dirty, and flush() leaves an evicted collection in the
+ * archive, so viewers keep the last snapshot until the items are back.
+ */
+template <typename Id, typename Item, typename... Fields>
+class CollectionPublisher : public Base::Event::EventHandler<
+                                CollectionPublisher<Id, Item, Fields...>> {
+  public:
+    /**
+     * @brief Creates a new CollectionPublisher.
+     *
+     * @param publisher the region to publish to.
+     * @param collection the collection to publish.
+     * @param schema the properties of the items to publish.
+     */
+    explicit CollectionPublisher(SnapshotPublisher& publisher,
+                                 Collection<Id, Item>& collection,
+                                 const Schema<Item, Fields...>& schema)
+        : _publisher(publisher), _collection(collection), _schema(schema) {
+        this->connect(collection.itemAddedEvent(),
+                      &CollectionPublisher::onItemAdded);
+        this->connect(collection.itemsAddedEvent(),
+                      &CollectionPublisher::onItemsAdded);
+        this->connect(collection.itemRemovedEvent(),
+                      &CollectionPublisher::onItemRemoved);
+        this->connect(collection.clearedEvent(),
+                      &CollectionPublisher::onCleared);
+        if (collection.isEvicted()) {
+            return;
+        }
+        for (const auto& id : collection.ids()) {
+            watch(id, collection.findById(id));
+        }
+    }
+
+    /**
+     * @brief Publishes a snapshot if the collection has changed since the
+     * last one.
+     *
+     * @return false if publishing failed, e.g. because the snapshot has
+     * outgrown the region; the collection stays dirty.
+     */
+    bool flush() {
+        if (!_dirty || _collection.isEvicted()) {
+            // Published once the collection is restored
+            return true;
+        }
+        _dirty = !_publisher.publish([this](Writer& writer) {
+            writeCollection(writer, _collection, _schema);
+        });
+        return !_dirty;
+    }
+
+    bool isDirty() const { return _dirty; }
+
+  private:
+    class ItemWatcher : public Base::Event::EventHandler<ItemWatcher> {
+      public:
+        explicit ItemWatcher(CollectionPublisher& publisher)
+            : _publisher(publisher) {}
+
+        template <typename T> void onValueChanged(Property<T>&, T) {
+            _publisher._dirty = true;
+        }
+
+        template <typename T> void onCleared(Property<T>&) {
+            _publisher._dirty = true;
+        }
+
+      private:
+        CollectionPublisher& _publisher;
+    };
+
+    void watch(const Id& id, Item& item) {
+        auto watcher = make_unique<ItemWatcher>(*this);
+        _schema.forEach([&](auto, const auto& field) {
+            using T = typename decay_t<decltype(field)>::ValueType;
+            watcher->connect(field.of(item).valueChangedEvent(),
+                             &ItemWatcher::template onValueChanged<T>);
+            watcher->connect(field.of(item).clearedEvent(),
+                             &ItemWatcher::template onCleared<T>);
+        });
+        _watchers[id] = move(watcher);
+    }
+
+    void onItemAdded(Collection<Id, Item>&, Id id, Item& item) {
+        watch(id, item);
+        _dirty = true;
+    }
+
+    void onItemsAdded(Collection<Id, Item>& collection,
+                      const vector<Id>& ids) {
+        for (const auto& id : ids) {
+            watch(id, collection.findById(id));
+        }
+        if (!collection.isSwapping()) {
+            _dirty = true;
+        }
+    }
+
+    void onItemRemoved(Collection<Id, Item>&, Id id) {
+        _watchers.erase(id);
+        _dirty = true;
+    }
+
+    void onCleared(Collection<Id, Item>& collection) {
+        _watchers.clear();
+        if (!collection.isSwapping()) {
+            _dirty = true;
+        }
+    }
+
+    SnapshotPublisher& _publisher;
+    Collection<Id, Item>& _collection;
+    Schema<Item, Fields...> _schema;
+    map<Id, unique_ptr<ItemWatcher>> _watchers;
+    bool _dirty = true;
+};
+
+/**
+ * @brief Creates a new CollectionPublisher, deducing its template arguments.
+ */
+template <typename Id, typename Item, typename... Fields>
+unique_ptr<CollectionPublisher<Id, Item, Fields...>>
+makeCollectionPublisher(SnapshotPublisher& publisher,
+                        Collection<Id, Item>& collection,
+                        const Schema<Item, Fields...>& schema) {
+    return make_unique<CollectionPublisher<Id, Item, Fields...>>(
+        publisher, collection, schema);
+}
+
+} // namespace Base::SharedMemory
+
+#endif // SHAREDSNAPSHOT_H
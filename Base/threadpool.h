@@ -0,0 +1,407 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#include "common.h"
+
+namespace Base::Concurrency {
+
+/**
+ * @brief The priority of a task. Workers always take a task of the highest
+ * priority that is available anywhere in the pool.
+ */
+enum class Priority { High, Normal, Low };
+
+class Executor;
+
+/**
+ * @brief Wraps a function object in a copyable function<void()>. Move-only
+ * function objects, such as Boost.Asio completion handlers, are kept on the
+ * heap.
+ */
+template <typename Function> function<void()> makeTask(Function&& task) {
+    using Task = decay_t<Function>;
+    if constexpr (is_copy_constructible_v<Task>) {
+        return function<void()>(forward<Function>(task));
+    } else {
+        auto shared = make_shared<Task>(forward<Function>(task));
+        return [shared] { (*shared)(); };
+    }
+}
+
+/**
+ * @brief A work-stealing pool of worker threads. Components share a pool,
+ * usually the one returned by shared(), instead of starting threads of their
+ * own, so together they never use more threads than there are cores.
+ *
+ * Every worker has a queue per priority. Tasks posted from a worker go to its
+ * own queue, tasks posted from other threads go to a shared queue. A worker
+ * runs its own queue in order; when it runs out, it takes from the shared
+ * queue and then steals from the back of the other workers' queues. Idle
+ * workers sleep until a task is posted.
+ */
+class ThreadPool : private Base::NonCopyable {
+    static constexpr size_t priorities = 3;
+    static constexpr size_t noWorker = SIZE_MAX;
+
+    using Queues = deque<function<void()>>[priorities];
+
+    struct alignas(64) Worker {
+        mutex queueMutex;
+        Queues queues;
+        thread worker;
+    };
+
+  public:
+    /**
+     * @brief Creates a new ThreadPool and starts its workers.
+     *
+     * @param threads the number of worker threads, at least one.
+     */
+    explicit ThreadPool(size_t threads = thread::hardware_concurrency()) {
+        threads = max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; ++i) {
+            _workers.push_back(make_unique<Worker>());
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            _workers[i]->worker = thread(&ThreadPool::run, this, i);
+        }
+    }
+
+    /**
+     * @brief Runs the tasks that are still queued and stops the workers.
+     */
+    ~ThreadPool() override {
+        {
+            lock_guard<mutex> lock(_sleepMutex);
+            _stopping = true;
+        }
+        _wakeUp.notify_all();
+        for (auto& worker : _workers) {
+            worker->worker.join();
+        }
+    }
+
+    /**
+     * @brief Returns the pool shared by the whole process, with one worker per
+     * core.
+     */
+    static ThreadPool& shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    /**
+     * @brief Queues a task to run on one of the workers.
+     *
+     * @param task the task.
+     * @param priority the priority of the task.
+     */
+    void post(function<void()> task, Priority priority = Priority::Normal) {
+        auto index = static_cast<size_t>(priority);
+        auto self = currentWorker();
+        if (self != noWorker) {
+            auto& worker = *_workers[self];
+            lock_guard<mutex> lock(worker.queueMutex);
+            worker.queues[index].push_back(move(task));
+        } else {
+            lock_guard<mutex> lock(_sharedMutex);
+            _shared[index].push_back(move(task));
+        }
+        _pending.fetch_add(1);
+        if (_sleepers.load() > 0) {
+            lock_guard<mutex> lock(_sleepMutex);
+            _wakeUp.notify_one();
+        }
+    }
+
+    /**
+     * @brief Queues a function and returns a future for its result.
+     * Exceptions thrown by the function end up in the future.
+     *
+     * @param function the function.
+     * @param priority the priority of the task.
+     * @return the future result.
+     */
+    template <typename Function>
+    auto submit(Function&& function, Priority priority = Priority::Normal)
+        -> future<invoke_result_t<decay_t<Function>>> {
+        using Result = invoke_result_t<decay_t<Function>>;
+        auto task =
+            make_shared<packaged_task<Result()>>(forward<Function>(function));
+        auto result = task->get_future();
+        post([task] { (*task)(); }, priority);
+        return result;
+    }
+
+    /**
+     * @brief Waits for the given future and returns its result. Meanwhile the
+     * calling thread runs queued tasks, so a task can wait for the tasks it
+     * submitted without tying up a worker.
+     *
+     * @param future the future, usually from submit().
+     * @return the result of the future.
+     */
+    template <typename T> T wait(future<T>& future) {
+        while (future.wait_for(chrono::seconds(0)) != future_status::ready) {
+            if (!runOne()) {
+                future.wait_for(chrono::microseconds(100));
+            }
+        }
+        return future.get();
+    }
+
+    /**
+     * @brief Runs one queued task on the calling thread, if there is one.
+     *
+     * @return true if a task was run.
+     */
+    bool runOne() {
+        function<void()> task;
+        if (!take(currentWorker(), task)) {
+            return false;
+        }
+        runTask(task);
+        return true;
+    }
+
+    /**
+     * @brief Returns an executor that posts to this pool with the given
+     * priority.
+     */
+    Executor executor(Priority priority = Priority::Normal);
+
+    /**
+     * @brief Returns the number of worker threads.
+     */
+    size_t size() const { return _workers.size(); }
+
+    /**
+     * @brief Checks if the calling thread is one of the workers of this pool.
+     */
+    bool runningInThisThread() const { return currentWorker() != noWorker; }
+
+    /**
+     * @brief Returns the number of tasks that workers took from the queue of
+     * another worker.
+     */
+    uint64_t steals() const { return _steals.load(memory_order_relaxed); }
+
+    /**
+     * @brief Sets the function that receives the exceptions thrown by tasks.
+     * By default they are written to the standard error stream.
+     */
+    void setExceptionHandler(function<void(exception_ptr)> handler) {
+        lock_guard<mutex> lock(_sharedMutex);
+        _exceptionHandler = move(handler);
+    }
+
+    /**
+     * @brief Passes an exception thrown by a task to the exception handler.
+     */
+    void handleException(exception_ptr exception) {
+        function<void(exception_ptr)> handler;
+        {
+            lock_guard<mutex> lock(_sharedMutex);
+            handler = _exceptionHandler;
+        }
+        if (handler) {
+            handler(exception);
+            return;
+        }
+        try {
+            rethrow_exception(exception);
+        } catch (const std::exception& e) {
+            cerr << "Uncaught exception in thread pool task: " << e.what()
+                 << endl;
+        } catch (...) {
+            cerr << "Uncaught exception in thread pool task" << endl;
+        }
+    }
+
+  private:
+    struct Current {
+        const ThreadPool* pool = nullptr;
+        size_t worker = noWorker;
+    };
+
+    static Current& current() {
+        static thread_local Current current;
+        return current;
+    }
+
+    size_t currentWorker() const {
+        auto& current = ThreadPool::current();
+        return current.pool == this ? current.worker : noWorker;
+    }
+
+    bool take(size_t self, function<void()>& task) {
+        for (size_t priority = 0; priority < priorities; ++priority) {
+            if (self != noWorker &&
+                takeFront(*_workers[self], priority, task)) {
+                return true;
+            }
+            {
+                lock_guard<mutex> lock(_sharedMutex);
+                auto& queue = _shared[priority];
+                if (!queue.empty()) {
+                    task = move(queue.front());
+                    queue.pop_front();
+                    _pending.fetch_sub(1);
+                    return true;
+                }
+            }
+            auto start = self == noWorker ? 0 : self + 1;
+            for (size_t i = 0; i < _workers.size(); ++i) {
+                auto victim = (start + i) % _workers.size();
+                if (victim != self && stealBack(*_workers[victim], priority,
+                                                task)) {
+                    _steals.fetch_add(1, memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool takeFront(Worker& worker, size_t priority, function<void()>& task) {
+        lock_guard<mutex> lock(worker.queueMutex);
+        auto& queue = worker.queues[priority];
+        if (queue.empty()) {
+            return false;
+        }
+        task = move(queue.front());
+        queue.pop_front();
+        _pending.fetch_sub(1);
+        return true;
+    }
+
+    bool stealBack(Worker& worker, size_t priority, function<void()>& task) {
+        lock_guard<mutex> lock(worker.queueMutex);
+        auto& queue = worker.queues[priority];
+        if (queue.empty()) {
+            return false;
+        }
+        task = move(queue.back());
+        queue.pop_back();
+        _pending.fetch_sub(1);
+        return true;
+    }
+
+    void runTask(function<void()>& task) {
+        try {
+            task();
+        } catch (...) {
+            handleException(current_exception());
+        }
+        task = nullptr;
+    }
+
+    void run(size_t self) {
+        current() = {this, self};
+        function<void()> task;
+        while (true) {
+            if (take(self, task)) {
+                runTask(task);
+                continue;
+            }
+            unique_lock<mutex> lock(_sleepMutex);
+            // Announce the sleeper before checking for work, post() checks
+            // the other way around, so no wake up gets lost
+            _sleepers.fetch_add(1);
+            _wakeUp.wait(lock,
+                         [this] { return _stopping || _pending.load() > 0; });
+            _sleepers.fetch_sub(1);
+            if (_stopping && _pending.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    vector<unique_ptr<Worker>> _workers;
+
+    mutex _sharedMutex;
+    Queues _shared;
+    function<void(exception_ptr)> _exceptionHandler;
+
+    // Briefly negative when a task is taken before post() has counted it
+    atomic<int64_t> _pending{0};
+    atomic<size_t> _sleepers{0};
+    atomic<uint64_t> _steals{0};
+    mutex _sleepMutex;
+    condition_variable _wakeUp;
+    bool _stopping = false;
+};
+
+/**
+ * @brief A lightweight handle that posts function objects to a ThreadPool
+ * with a fixed priority. Components take an executor instead of a pool, so
+ * the caller decides where and how urgently their work runs. It works with
+ * QueuedEventHandler, and asioexecutor.h adapts it to Boost.Asio.
+ */
+class Executor {
+  public:
+    explicit Executor(ThreadPool& pool, Priority priority = Priority::Normal)
+        : _pool(&pool), _priority(priority) {}
+
+    /**
+     * @brief Queues the given function object on the pool.
+     */
+    template <typename Function> void execute(Function&& function) const {
+        _pool->post(makeTask(forward<Function>(function)), _priority);
+    }
+
+    /**
+     * @brief Runs the given function object right away when called on a
+     * worker of the pool, otherwise queues it.
+     */
+    template <typename Function> void dispatch(Function&& function) const {
+        if (_pool->runningInThisThread()) {
+            forward<Function>(function)();
+        } else {
+            execute(forward<Function>(function));
+        }
+    }
+
+    ThreadPool& context() const noexcept { return *_pool; }
+
+    Priority priority() const noexcept { return _priority; }
+
+    friend bool operator==(const Executor& e1, const Executor& e2) noexcept {
+        return e1._pool == e2._pool && e1._priority == e2._priority;
+    }
+
+    friend bool operator!=(const Executor& e1, const Executor& e2) noexcept {
+        return !(e1 == e2);
+    }
+
+  private:
+    ThreadPool* _pool;
+    Priority _priority;
+};
+
+inline Executor ThreadPool::executor(Priority priority) {
+    return Executor(*this, priority);
+}
+
+} // namespace Base::Concurrency
+
+#endif // THREADPOOL_H
@@ -0,0 +1,284 @@
+#ifndef WEBSOCKETPUSH_H
+#define WEBSOCKETPUSH_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+
+using namespace std;
+
+#include "common.h"
+#include "deltapush.h"
+
+namespace Base::Push {
+
+/**
+ * @brief Statistics of a WebSocketPushServer.
+ */
+struct PushStats {
+    uint64_t connections = 0;
+    uint64_t messages = 0;
+    uint64_t snapshots = 0;
+    // Clients whose queue overflowed and were sent a new snapshot
+    uint64_t overflows = 0;
+};
+
+/**
+ * @brief Pushes the batches of a DeltaBatcher to browser displays over
+ * WebSocket with Boost.Beast. Only for components that are built with Boost;
+ * the rest of Base does not depend on it.
+ *
+ * Every client gets a snapshot when it connects and then each broadcast()
+ * batch as one binary message. All clients share the same buffers. Each
+ * client has a bounded SendQueue; a client that falls too far behind gets a
+ * new snapshot instead of the deltas it missed, so it never holds up the
+ * others. Snapshot requests of clients that connect or overflow at the same
+ * time are combined into one.
+ *
+ * Messages from clients are ignored. Idle clients are pinged and dropped
+ * when they stop answering.
+ *
+ * All members must be called on the io_context thread, except broadcast(),
+ * which may be called from any thread. The io_context must have stopped
+ * before the server is destroyed.
+ */
+class WebSocketPushServer : private Base::NonCopyable {
+  public:
+    /**
+     * @brief Takes a snapshot and passes it to the given function. It may do
+     * so later and on any thread, e.g. after posting to the thread that owns
+     * the models; batches broadcast before that function is called must not
+     * be part of the snapshot.
+     */
+    using SnapshotProvider = function<void(function<void(Buffer)> done)>;
+
+    /**
+     * @brief Creates a new WebSocketPushServer.
+     *
+     * @param context the io_context to run on.
+     * @param port the TCP port to listen on.
+     * @param provider takes the snapshots for new and overflowed clients.
+     * @param maxQueueBytes the bound of the queue of each client.
+     */
+    explicit WebSocketPushServer(boost::asio::io_context& context,
+                                 uint16_t port, SnapshotProvider provider,
+                                 size_t maxQueueBytes = 4 * 1024 * 1024)
+        : _context(context), _port(port), _provider(move(provider)),
+          _maxQueueBytes(maxQueueBytes), _acceptor(context) {}
+
+    /**
+     * @brief Starts accepting clients.
+     *
+     * @return true on success, false on failure. See errorString().
+     */
+    bool listen() {
+        using boost::asio::ip::tcp;
+        boost::system::error_code error;
+        tcp::endpoint endpoint(tcp::v4(), _port);
+        _acceptor.open(endpoint.protocol(), error);
+        if (!error) {
+            _acceptor.set_option(tcp::acceptor::reuse_address(true), error);
+        }
+        if (!error) {
+            _acceptor.bind(endpoint, error);
+        }
+        if (!error) {
+            _acceptor.listen(boost::asio::socket_base::max_listen_connections,
+                             error);
+        }
+        if (error) {
+            _error = error.message();
+            return false;
+        }
+        accept();
+        return true;
+    }
+
+    /**
+     * @brief Stops accepting clients and disconnects the connected ones.
+     */
+    void stop() {
+        boost::system::error_code ignored;
+        _acceptor.close(ignored);
+        for (const auto& session : _sessions) {
+            boost::beast::get_lowest_layer(session->stream).close();
+        }
+        _sessions.clear();
+        _waiting.clear();
+    }
+
+    /**
+     * @brief Sends a batch to every client that is up to date.
+     */
+    void broadcast(Buffer batch) {
+        boost::asio::post(_context, [this, batch = move(batch)] {
+            for (const auto& session : _sessions) {
+                if (session->awaitingSnapshot) {
+                    // The coming snapshot already contains this batch
+                    continue;
+                }
+                if (!session->queue.push(batch)) {
+                    _stats.overflows++;
+                    requestSnapshot(session);
+                    continue;
+                }
+                write(session);
+            }
+        });
+    }
+
+    size_t clientCount() const { return _sessions.size(); }
+
+    PushStats const& stats() const { return _stats; }
+
+    string errorString() const { return _error; }
+
+  private:
+    using Stream =
+        boost::beast::websocket::stream<boost::beast::tcp_stream>;
+
+    struct Session {
+        Session(boost::asio::ip::tcp::socket socket, size_t maxQueueBytes)
+            : stream(move(socket)), queue(maxQueueBytes) {}
+
+        Stream stream;
+        boost::beast::flat_buffer readBuffer;
+        SendQueue queue;
+        bool writing = false;
+        bool awaitingSnapshot = true;
+    };
+
+    void accept() {
+        _acceptor.async_accept([this](const boost::system::error_code& error,
+                                      boost::asio::ip::tcp::socket socket) {
+            if (error == boost::asio::error::operation_aborted) {
+                return;
+            }
+            if (!error) {
+                handshake(make_shared<Session>(move(socket), _maxQueueBytes));
+            }
+            accept();
+        });
+    }
+
+    void handshake(const shared_ptr<Session>& session) {
+        boost::system::error_code ignored;
+        boost::beast::get_lowest_layer(session->stream)
+            .socket()
+            .set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+        using Timeout = boost::beast::websocket::stream_base::timeout;
+        auto timeouts = Timeout::suggested(boost::beast::role_type::server);
+        timeouts.idle_timeout = chrono::seconds(30);
+        timeouts.keep_alive_pings = true;
+        session->stream.set_option(timeouts);
+        session->stream.binary(true);
+        session->stream.read_message_max(4096);
+        session->stream.async_accept(
+            [this, session](const boost::system::error_code& error) {
+                if (error) {
+                    return;
+                }
+                _sessions.insert(session);
+                _stats.connections++;
+                requestSnapshot(session);
+                read(session);
+            });
+    }
+
+    void read(const shared_ptr<Session>& session) {
+        session->stream.async_read(
+            session->readBuffer,
+            [this, session](const boost::system::error_code& error, size_t) {
+                if (error) {
+                    close(session);
+                    return;
+                }
+                session->readBuffer.clear();
+                read(session);
+            });
+    }
+
+    void write(const shared_ptr<Session>& session) {
+        if (session->writing || session->queue.empty()) {
+            return;
+        }
+        // Taken off the queue now, so an overflow cannot drop it mid-write
+        auto message = session->queue.front();
+        session->queue.pop();
+        session->writing = true;
+        session->stream.async_write(
+            boost::asio::buffer(*message),
+            [this, session, message](const boost::system::error_code& error,
+                                     size_t) {
+                session->writing = false;
+                if (error) {
+                    close(session);
+                    return;
+                }
+                _stats.messages++;
+                write(session);
+            });
+    }
+
+    void requestSnapshot(const shared_ptr<Session>& session) {
+        session->awaitingSnapshot = true;
+        session->queue.clear();
+        _waiting.push_back(session);
+        if (_snapshotRequested) {
+            return;
+        }
+        _snapshotRequested = true;
+        _provider([this](Buffer snapshot) {
+            boost::asio::post(_context, [this, snapshot = move(snapshot)] {
+                onSnapshot(snapshot);
+            });
+        });
+    }
+
+    void onSnapshot(const Buffer& snapshot) {
+        _snapshotRequested = false;
+        for (const auto& waiting : _waiting) {
+            auto session = waiting.lock();
+            if (!session || _sessions.count(session) == 0 ||
+                !session->awaitingSnapshot) {
+                continue;
+            }
+            session->awaitingSnapshot = false;
+            session->queue.push(snapshot);
+            _stats.snapshots++;
+            write(session);
+        }
+        _waiting.clear();
+    }
+
+    void close(const shared_ptr<Session>& session) {
+        if (_sessions.erase(session) > 0) {
+            boost::beast::get_lowest_layer(session->stream).close();
+        }
+    }
+
+    boost::asio::io_context& _context;
+    uint16_t _port;
+    SnapshotProvider _provider;
+    size_t _maxQueueBytes;
+    boost::asio::ip::tcp::acceptor _acceptor;
+    set<shared_ptr<Session>> _sessions;
+    vector<weak_ptr<Session>> _waiting;
+    bool _snapshotRequested = false;
+    PushStats _stats;
+    string _error;
+};
+
+} // namespace Base::Push
+
+#endif // WEBSOCKETPUSH_H
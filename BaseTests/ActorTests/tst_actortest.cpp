@@ -0,0 +1,149 @@
+#include <QtTest>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "actor.h"
+#include "model.h"
+
+using namespace Base::Concurrency;
+using namespace Base::Model;
+
+class ActorTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void strand_runs_tasks_in_order();
+    void actors_run_in_parallel();
+    void ask_returns_result();
+    void ask_returns_exception();
+    void messages_between_actors();
+    void destructor_waits_for_messages();
+};
+
+struct Incident {
+    explicit Incident(int id) : id(id), units(&Unit::id) {}
+
+    struct Unit {
+        explicit Unit(int id) : _id(id) {}
+        int id() const { return _id; }
+        PROPERTY(int, status)
+
+      private:
+        int _id;
+    };
+
+    int id;
+    Collection<int, Unit> units;
+    int messages = 0;
+};
+
+void ActorTest::strand_runs_tasks_in_order() {
+    ThreadPool pool(4);
+    vector<int> order;
+    atomic<int> running{0};
+    atomic<bool> overlapped{false};
+    {
+        Strand strand(pool);
+        for (int i = 0; i < 1000; ++i) {
+            strand.post([&, i] {
+                if (running++ != 0) {
+                    overlapped = true;
+                }
+                order.push_back(i);
+                running--;
+            });
+        }
+    }
+    QVERIFY(!overlapped);
+    QCOMPARE(order.size(), size_t(1000));
+    for (int i = 0; i < 1000; ++i) {
+        QCOMPARE(order[static_cast<size_t>(i)], i);
+    }
+}
+
+void ActorTest::actors_run_in_parallel() {
+    ThreadPool pool(2);
+    Actor<Incident> first(pool, 1);
+    Actor<Incident> second(pool, 2);
+    // Each message waits for the other one, which only works if they run
+    // at the same time
+    atomic<int> arrived{0};
+    auto meet = [&arrived](Incident&) {
+        arrived++;
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+        while (arrived.load() < 2 && chrono::steady_clock::now() < deadline) {
+            this_thread::yield();
+        }
+        return arrived.load() == 2;
+    };
+    auto firstMet = first.ask(meet);
+    auto secondMet = second.ask(meet);
+    QVERIFY(firstMet.get());
+    QVERIFY(secondMet.get());
+}
+
+void ActorTest::ask_returns_result() {
+    ThreadPool pool(2);
+    Actor<Incident> incident(pool, 7);
+    incident.tell([](Incident& state) {
+        state.units.add(new Incident::Unit(1));
+        state.units.findById(1).status() = 3;
+    });
+    bool current = false;
+    auto status = incident.ask([&](Incident& state) {
+        current = incident.isCurrent();
+        return state.units.findById(1).status().value();
+    });
+    QCOMPARE(status.get(), 3);
+    QVERIFY(current);
+    QVERIFY(!incident.isCurrent());
+}
+
+void ActorTest::ask_returns_exception() {
+    ThreadPool pool(1);
+    Actor<Incident> incident(pool, 7);
+    auto result = incident.ask([](Incident&) -> int {
+        throw runtime_error("no such unit");
+    });
+    QVERIFY_EXCEPTION_THROWN(result.get(), runtime_error);
+    // The actor keeps working after a failed message
+    QCOMPARE(incident.ask([](Incident& state) { return state.id; }).get(), 7);
+}
+
+void ActorTest::messages_between_actors() {
+    ThreadPool pool(4);
+    Actor<Incident> first(pool, 1);
+    Actor<Incident> second(pool, 2);
+    for (int i = 0; i < 500; ++i) {
+        first.tell([&second](Incident& state) {
+            state.messages++;
+            second.tell([](Incident& other) { other.messages++; });
+        });
+    }
+    first.strand().drain();
+    second.strand().drain();
+    QCOMPARE(first.ask([](Incident& s) { return s.messages; }).get(), 500);
+    QCOMPARE(second.ask([](Incident& s) { return s.messages; }).get(), 500);
+}
+
+void ActorTest::destructor_waits_for_messages() {
+    ThreadPool pool(2);
+    atomic<int> handled{0};
+    {
+        Actor<Incident> incident(pool, 1);
+        for (int i = 0; i < 200; ++i) {
+            incident.tell([&handled](Incident& state) {
+                state.units.add(new Incident::Unit(state.messages++));
+                handled++;
+            });
+        }
+    }
+    QCOMPARE(handled.load(), 200);
+}
+
+QTEST_APPLESS_MAIN(ActorTest)
+
+#include "tst_actortest.moc"
@@ -0,0 +1,73 @@
+#include <QtTest>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+
+#include "asioexecutor.h"
+#include "threadpool.h"
+
+using namespace Base::Concurrency;
+
+class AsioExecutorTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void post_runs_on_pool();
+    void strand_keeps_order();
+};
+
+void AsioExecutorTest::post_runs_on_pool() {
+    ThreadPool pool(2);
+    AsioExecutor executor(pool.executor());
+    promise<bool> ran;
+    auto onPool = ran.get_future();
+    boost::asio::post(executor, [&pool, &ran] {
+        ran.set_value(pool.runningInThisThread());
+    });
+    QVERIFY(onPool.wait_for(chrono::seconds(5)) == future_status::ready);
+    QVERIFY(onPool.get());
+    QVERIFY(!pool.runningInThisThread());
+}
+
+void AsioExecutorTest::strand_keeps_order() {
+    ThreadPool pool(4);
+    auto strand = boost::asio::make_strand(AsioExecutor(pool.executor()));
+    constexpr int count = 1000;
+    // Only touched on the strand, which must never run two tasks at once
+    vector<int> order;
+    atomic<int> running{0};
+    atomic<bool> overlapped{false};
+    atomic<bool> offPool{false};
+    promise<void> finished;
+    for (int i = 0; i < count; ++i) {
+        boost::asio::post(strand, [&, i] {
+            if (running++ != 0) {
+                overlapped = true;
+            }
+            if (!pool.runningInThisThread()) {
+                offPool = true;
+            }
+            order.push_back(i);
+            running--;
+            if (i == count - 1) {
+                finished.set_value();
+            }
+        });
+    }
+    QVERIFY(finished.get_future().wait_for(chrono::seconds(5)) ==
+            future_status::ready);
+    QVERIFY(!overlapped.load());
+    QVERIFY(!offPool.load());
+    QCOMPARE(order.size(), size_t(count));
+    for (int i = 0; i < count; ++i) {
+        QCOMPARE(order[size_t(i)], i);
+    }
+}
+
+QTEST_APPLESS_MAIN(AsioExecutorTest)
+
+#include "tst_asioexecutortest.moc"
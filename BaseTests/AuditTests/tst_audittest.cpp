@@ -0,0 +1,279 @@
+#include <QtTest>
+
+#include <filesystem>
+#include <fstream>
+
+#include "audit.h"
+
+using namespace Base::Audit;
+using namespace Base::Crypto;
+using namespace Base::Model;
+using namespace Base::Replication;
+
+class AuditTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void sha256_known_digests();
+    void sha256_incremental_update();
+    void sha256_portable_matches();
+    void log_verifies_and_replays();
+    void reopen_continues_chain();
+    void tampering_is_detected();
+    void torn_block_is_cut_off();
+    void open_does_not_reset_standbys();
+};
+
+class Unit {
+    PROPERTY(string, name)
+    PROPERTY(int, eta)
+
+  private:
+    int _id;
+
+  public:
+    explicit Unit(const int id) : _id(id) {}
+    int id() const { return _id; }
+};
+
+static const auto unitSchema =
+    makeSchema(FIELD(Unit, name), FIELD(Unit, eta));
+
+static string digestOf(const string& data) {
+    return toHex(Sha256::hash(data.data(), data.size()));
+}
+
+static vector<uint8_t> randomBytes(size_t size) {
+    vector<uint8_t> bytes(size);
+    uint32_t state = 12345;
+    for (auto& byte : bytes) {
+        state = state * 1103515245 + 12345;
+        byte = static_cast<uint8_t>(state >> 16);
+    }
+    return bytes;
+}
+
+void AuditTest::sha256_known_digests() {
+    QCOMPARE(digestOf(""), string("e3b0c44298fc1c149afbf4c8996fb924"
+                                  "27ae41e4649b934ca495991b7852b855"));
+    QCOMPARE(digestOf("abc"), string("ba7816bf8f01cfea414140de5dae2223"
+                                     "b00361a396177a9cb410ff61f20015ad"));
+    QCOMPARE(digestOf("abcdbcdecdefdefgefghfghighijhijk"
+                      "ijkljklmklmnlmnomnopnopq"),
+             string("248d6a61d20638b8e5c026930c3e6039"
+                    "a33ce45964ff2167f6ecedd419db06c1"));
+    QCOMPARE(digestOf(string(1000000, 'a')),
+             string("cdc76e5c9914fb9281a1c7e284d73e67"
+                    "f1809a48a497200e046d39ccc7112cd0"));
+}
+
+void AuditTest::sha256_incremental_update() {
+    auto data = randomBytes(1000);
+    auto expected = Sha256::hash(data.data(), data.size());
+    for (size_t step : {1, 7, 63, 64, 65, 500}) {
+        Sha256 sha;
+        for (size_t i = 0; i < data.size(); i += step) {
+            sha.update(data.data() + i, min(step, data.size() - i));
+        }
+        QVERIFY(sha.finish() == expected);
+    }
+}
+
+void AuditTest::sha256_portable_matches() {
+    // Hash two blocks by hand with the portable compression function and
+    // compare with whichever implementation Sha256 picked at run time
+    auto data = randomBytes(100);
+    uint8_t blocks[128] = {};
+    memcpy(blocks, data.data(), data.size());
+    blocks[data.size()] = 0x80;
+    blocks[126] = (100 * 8) >> 8;
+    blocks[127] = (100 * 8) & 0xff;
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    Sha256::compressPortable(state, blocks, 2);
+    auto digest = Sha256::hash(data.data(), data.size());
+    for (int i = 0; i < 8; ++i) {
+        uint32_t word = uint32_t(digest[4 * i]) << 24 |
+                        uint32_t(digest[4 * i + 1]) << 16 |
+                        uint32_t(digest[4 * i + 2]) << 8 | digest[4 * i + 3];
+        QCOMPARE(word, state[i]);
+    }
+}
+
+void AuditTest::log_verifies_and_replays() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto fileName = dir.filePath("audit.log").toStdString();
+
+    Collection<int, Unit> units(&Unit::id);
+    DeltaLog log;
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    units.add(new Unit(1));
+    // The record of the first unit predates the audit log
+    auto before = log.sequence();
+    {
+        // A small batch size makes the log write several blocks
+        AuditLog audit(log, chrono::milliseconds(10), 64);
+        QVERIFY(audit.open(fileName));
+        for (int i = 2; i <= 50; ++i) {
+            units.add(new Unit(i));
+            units.findById(i).eta() = i;
+        }
+        // Whatever the timing, the records after a flush go in a new block
+        audit.flush();
+        units.findById(1).name() = "Unit 1";
+        units.removeById(2);
+        audit.flush();
+        // The snapshot of the first unit takes no sequence numbers
+        QCOMPARE(audit.stats().records, log.sequence() - before + 3);
+        QVERIFY(audit.stats().blocks > 1);
+        QVERIFY(!audit.failed());
+    }
+
+    Collection<int, Unit> replica(&Unit::id);
+    auto applier = makeReplicaApplier(replica, unitSchema);
+    ReplicationSink sink;
+    sink.registerChannel(1, *applier);
+    auto result = verifyAuditLog(
+        fileName, [&sink](const uint8_t* frame, size_t size) {
+            sink.feed(frame, size);
+        });
+    QVERIFY(result.valid);
+    QCOMPARE(result.records, log.sequence() - before + 3);
+    QVERIFY(sink.isInSync());
+    QCOMPARE(replica.size(), size_t(49));
+    QVERIFY(!replica.contains(2));
+    QCOMPARE(replica.findById(1).name().value(), string("Unit 1"));
+    QCOMPARE(replica.findById(50).eta().value(), 50);
+}
+
+void AuditTest::reopen_continues_chain() {
+    QTemporaryDir dir;
+    auto fileName = dir.filePath("audit.log").toStdString();
+    Collection<int, Unit> units(&Unit::id);
+    DeltaLog log;
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    {
+        AuditLog audit(log);
+        QVERIFY(audit.open(fileName));
+        units.add(new Unit(1));
+    }
+    auto first = verifyAuditLog(fileName);
+    QVERIFY(first.valid);
+    {
+        AuditLog audit(log);
+        QVERIFY(audit.open(fileName));
+        units.add(new Unit(2));
+    }
+    auto second = verifyAuditLog(fileName);
+    QVERIFY(second.valid);
+    QVERIFY(second.blocks > first.blocks);
+    // Two units and two snapshots of a begin and a cleared record each, the
+    // second one with the first unit
+    QCOMPARE(log.sequence(), uint64_t(2));
+    QCOMPARE(second.records, uint64_t(7));
+}
+
+void AuditTest::tampering_is_detected() {
+    QTemporaryDir dir;
+    auto fileName = dir.filePath("audit.log").toStdString();
+    Collection<int, Unit> units(&Unit::id);
+    DeltaLog log;
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    {
+        AuditLog audit(log, chrono::milliseconds(10), 16);
+        QVERIFY(audit.open(fileName));
+        for (int i = 1; i <= 10; ++i) {
+            units.add(new Unit(i));
+            audit.flush();
+        }
+    }
+    auto intact = verifyAuditLog(fileName);
+    QVERIFY(intact.valid);
+
+    // Flip one byte in the payload of the second block
+    fstream file(fileName, ios::in | ios::out | ios::binary);
+    vector<char> header(Format::headerSize);
+    file.read(header.data(), header.size());
+    auto payloadSize = Base::Serialization::Reader(
+                           reinterpret_cast<uint8_t*>(header.data()) + 16, 4)
+                           .readFixed32();
+    auto offset = static_cast<streamoff>(
+        2 * Format::headerSize + payloadSize + Format::hashSize + 5);
+    file.seekg(offset);
+    char byte;
+    file.read(&byte, 1);
+    byte ^= 1;
+    file.seekp(offset);
+    file.write(&byte, 1);
+    file.close();
+
+    auto tampered = verifyAuditLog(fileName);
+    QVERIFY(!tampered.valid);
+    QCOMPARE(tampered.blocks, uint64_t(1));
+    QCOMPARE(tampered.error, string("Block hash mismatch"));
+
+    // A tampered log is not appended to
+    AuditLog audit(log);
+    QVERIFY(!audit.open(fileName));
+}
+
+void AuditTest::torn_block_is_cut_off() {
+    QTemporaryDir dir;
+    auto fileName = dir.filePath("audit.log").toStdString();
+    Collection<int, Unit> units(&Unit::id);
+    DeltaLog log;
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    {
+        AuditLog audit(log);
+        QVERIFY(audit.open(fileName));
+        units.add(new Unit(1));
+        audit.flush();
+        units.add(new Unit(2));
+    }
+    auto intact = verifyAuditLog(fileName);
+    QVERIFY(intact.valid);
+    QVERIFY(intact.blocks > 1);
+
+    // As if the process died while writing the last block
+    auto size = filesystem::file_size(fileName);
+    filesystem::resize_file(fileName, size - 10);
+    auto torn = verifyAuditLog(fileName);
+    QVERIFY(!torn.valid);
+    QVERIFY(torn.torn);
+    QCOMPARE(torn.blocks, intact.blocks - 1);
+
+    {
+        AuditLog audit(log);
+        QVERIFY(audit.open(fileName));
+        QCOMPARE(audit.stats().truncatedBytes, size - 10 - torn.validBytes);
+        units.add(new Unit(3));
+    }
+    auto reopened = verifyAuditLog(fileName);
+    QVERIFY(reopened.valid);
+    QVERIFY(reopened.blocks > torn.blocks);
+}
+
+void AuditTest::open_does_not_reset_standbys() {
+    QTemporaryDir dir;
+    auto fileName = dir.filePath("audit.log").toStdString();
+    Collection<int, Unit> units(&Unit::id);
+    DeltaLog log;
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    units.add(new Unit(1));
+    int appended = 0;
+    using Handler =
+        Base::Event::SingleEventHandler<DeltaLog&, const vector<uint8_t>&>;
+    Handler handler(
+        [&appended](DeltaLog&, const vector<uint8_t>&) { appended++; });
+    handler.connect(log.recordAppendedEvent());
+
+    AuditLog audit(log);
+    QVERIFY(audit.open(fileName));
+    QCOMPARE(appended, 0);
+    audit.flush();
+    QCOMPARE(audit.stats().records, uint64_t(3));
+}
+
+QTEST_APPLESS_MAIN(AuditTest)
+
+#include "tst_audittest.moc"
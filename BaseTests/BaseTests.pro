@@ -1,5 +1,23 @@
 TEMPLATE = subdirs
 
 SUBDIRS = \
+    ActorTests \
+    AsioExecutorTests \
+    AuditTests \
+    CsvTests \
+    DeltaPushTests \
+    EpochTests \
     EventTests \
-    ModelTests
+    GatewayLinkTests \
+    GatewayMergerTests \
+    InstrumentationTests \
+    LoopMonitorTests \
+    MemoryInspectorTests \
+    ModelTests \
+    QueryTests \
+    ReconcileTests \
+    ReplicationTests \
+    ResidencyTests \
+    SelectionTests \
+    SharedSnapshotTests \
+    ThreadPoolTests
@@ -0,0 +1,136 @@
+#include <QtTest>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "csv.h"
+
+using namespace Base::Csv;
+
+class CsvTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void parse_simple_rows();
+    void parse_quoted_fields();
+    void parse_crlf_and_empty_lines();
+    void find_special_long_input();
+    void split_respects_quotes();
+    void parse_parallel_matches_sequential();
+    void parse_parallel_waits_before_throwing();
+};
+
+static vector<vector<string>> parseAll(const string& input,
+                                       char delimiter = ',') {
+    vector<vector<string>> rows;
+    parse(input.data(), input.data() + input.size(), delimiter,
+          [&rows](const vector<string_view>& fields) {
+              rows.emplace_back(fields.begin(), fields.end());
+          });
+    return rows;
+}
+
+void CsvTest::parse_simple_rows() {
+    auto rows = parseAll("1,Anna,12\n2,Bertil,\n");
+    QCOMPARE(rows.size(), size_t(2));
+    QVERIFY(rows[0] == vector<string>({"1", "Anna", "12"}));
+    QVERIFY(rows[1] == vector<string>({"2", "Bertil", ""}));
+}
+
+void CsvTest::parse_quoted_fields() {
+    auto rows = parseAll("1,\"Doe, John\",\"say \"\"hi\"\"\",\"two\nlines\"\n"
+                         "2,\"\",x\"y");
+    QCOMPARE(rows.size(), size_t(2));
+    QVERIFY(rows[0] ==
+            vector<string>({"1", "Doe, John", "say \"hi\"", "two\nlines"}));
+    QVERIFY(rows[1] == vector<string>({"2", "", "x\"y"}));
+}
+
+void CsvTest::parse_crlf_and_empty_lines() {
+    auto rows = parseAll("1;a\r\n\r\n2;b\r\n", ';');
+    QCOMPARE(rows.size(), size_t(2));
+    QVERIFY(rows[0] == vector<string>({"1", "a"}));
+    QVERIFY(rows[1] == vector<string>({"2", "b"}));
+}
+
+void CsvTest::find_special_long_input() {
+    string input(100, 'a');
+    input[37] = ',';
+    auto found = findSpecial(input.data(), input.data() + input.size(), ',');
+    QCOMPARE(size_t(found - input.data()), size_t(37));
+    QCOMPARE(countQuotes(input.data(), input.data() + input.size()),
+             size_t(0));
+}
+
+void CsvTest::split_respects_quotes() {
+    string input;
+    for (int i = 0; i < 100; ++i) {
+        input += to_string(i) + ",\"multi\nline\ntext\"\n";
+    }
+    auto boundaries = split(input.data(), input.size(), 7);
+    QCOMPARE(boundaries.front(), size_t(0));
+    QCOMPARE(boundaries.back(), input.size());
+    for (size_t i = 1; i + 1 < boundaries.size(); ++i) {
+        auto rows = parseAll(input.substr(boundaries[i], 30));
+        QVERIFY(!rows.empty());
+        QVERIFY(rows[0].size() == 2);
+        QVERIFY(rows[0][1] == "multi\nline\ntext");
+    }
+}
+
+void CsvTest::parse_parallel_matches_sequential() {
+    string input;
+    for (int i = 0; i < 5000; ++i) {
+        input += to_string(i) + ",\"name " + to_string(i) + "\nx\",y\n";
+    }
+    auto chunks = parseParallel(
+        input.data(), input.size(),
+        [](const char* begin, const char* end) {
+            vector<string> ids;
+            parse(begin, end, ',', [&ids](const vector<string_view>& fields) {
+                ids.emplace_back(fields[0]);
+            });
+            return ids;
+        },
+        4, 1024);
+    QVERIFY(chunks.size() > 1);
+    int expected = 0;
+    for (const auto& chunk : chunks) {
+        for (const auto& id : chunk) {
+            QCOMPARE(id, to_string(expected++));
+        }
+    }
+    QCOMPARE(expected, 5000);
+}
+
+void CsvTest::parse_parallel_waits_before_throwing() {
+    string input;
+    for (int i = 0; i < 5000; ++i) {
+        input += to_string(i) + ",name\n";
+    }
+    atomic<int> finished{0};
+    bool thrown = false;
+    try {
+        parseParallel(
+            input.data(), input.size(),
+            [&](const char* begin, const char* end) {
+                if (begin == input.data()) {
+                    throw runtime_error("first chunk");
+                }
+                this_thread::sleep_for(chrono::milliseconds(20));
+                finished++;
+                return end - begin;
+            },
+            4, 1024);
+    } catch (const runtime_error&) {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    // The other chunks were done before the exception left parseParallel
+    QCOMPARE(finished.load(), 3);
+}
+
+QTEST_APPLESS_MAIN(CsvTest)
+
+#include "tst_csvtest.moc"
@@ -0,0 +1,208 @@
+#include <QtTest>
+
+#include <memory>
+#include <vector>
+
+#include "deltapush.h"
+#include "field.h"
+
+using namespace Base::Event;
+using namespace Base::Model;
+using namespace Base::Push;
+using namespace Base::Replication;
+
+class DeltaPushTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void batches_are_shared();
+    void large_batch_fires_early();
+    void snapshot_is_not_batched();
+    void snapshot_then_batches_rebuild_state();
+    void send_queue_is_bounded();
+};
+
+class Unit {
+    PROPERTY(string, name)
+    PROPERTY(int, eta)
+
+  private:
+    int _id;
+
+  public:
+    explicit Unit(const int id) : _id(id) {}
+    int id() const { return _id; }
+};
+
+static const auto unitSchema =
+    makeSchema(FIELD(Unit, name), FIELD(Unit, eta));
+
+// A push client: applies the frames of every message to a replica
+class Display {
+  public:
+    Collection<int, Unit> units;
+    int snapshots = 0;
+
+    Display()
+        : units(&Unit::id), _applier(makeReplicaApplier(units, unitSchema)) {}
+
+    void receive(const Buffer& message) {
+        size_t offset = 0;
+        while (offset < message->size()) {
+            Reader header(message->data() + offset, 4);
+            auto length = header.readFixed32();
+            Reader reader(message->data() + offset + 4, length);
+            reader.readVarint();
+            reader.readSignedVarint();
+            reader.readVarint();
+            auto kind = static_cast<RecordKind>(reader.readByte());
+            if (kind == RecordKind::SnapshotBegin) {
+                snapshots++;
+            } else if (kind != RecordKind::Heartbeat) {
+                _applier->apply(kind, reader);
+            }
+            offset += 4 + length;
+        }
+    }
+
+  private:
+    unique_ptr<ReplicaApplier<int, Unit, Field<Unit, string>, Field<Unit, int>>>
+        _applier;
+};
+
+class Batches {
+  public:
+    vector<Buffer> received;
+
+    explicit Batches(DeltaBatcher& batcher)
+        : _handler([this](DeltaBatcher&, const Buffer& batch) {
+              received.push_back(batch);
+          }) {
+        _handler.connect(batcher.batchReadyEvent());
+    }
+
+  private:
+    SingleEventHandler<DeltaBatcher&, const Buffer&> _handler;
+};
+
+void DeltaPushTest::batches_are_shared() {
+    DeltaLog log;
+    Collection<int, Unit> units(&Unit::id);
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    DeltaBatcher batcher(log);
+    Batches batches(batcher);
+    Batches others(batcher);
+
+    batcher.flush();
+    QVERIFY(batches.received.empty());
+    units.add(new Unit(1));
+    units.findById(1).eta() = 5;
+    units.findById(1).eta() = 6;
+    QVERIFY(batches.received.empty());
+    batcher.flush();
+    QCOMPARE(batches.received.size(), size_t(1));
+    // Every receiver gets the same encoded buffer
+    QCOMPARE(others.received.front().get(), batches.received.front().get());
+    QCOMPARE(batcher.stats().batches, uint64_t(1));
+    QCOMPARE(batcher.stats().bytes, uint64_t(batches.received[0]->size()));
+}
+
+void DeltaPushTest::large_batch_fires_early() {
+    DeltaLog log;
+    Collection<int, Unit> units(&Unit::id);
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    DeltaBatcher batcher(log, 64);
+    Batches batches(batcher);
+    for (int i = 0; i < 20; ++i) {
+        units.add(new Unit(i));
+    }
+    QVERIFY(batches.received.size() > 1);
+    for (const auto& batch : batches.received) {
+        QVERIFY(batch->size() >= 64);
+    }
+}
+
+void DeltaPushTest::snapshot_is_not_batched() {
+    DeltaLog log;
+    Collection<int, Unit> units(&Unit::id);
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    DeltaBatcher batcher(log);
+    Batches batches(batcher);
+    units.add(new Unit(1));
+
+    // Pending changes go out before the snapshot is taken
+    auto sequence = log.sequence();
+    auto snapshot = batcher.snapshot();
+    QCOMPARE(batches.received.size(), size_t(1));
+    // The other readers of the log do not see the snapshot
+    QCOMPARE(log.sequence(), sequence);
+    batcher.flush();
+    QCOMPARE(batches.received.size(), size_t(1));
+    QVERIFY(!snapshot->empty());
+    QCOMPARE(batcher.stats().snapshots, uint64_t(1));
+
+    Display display;
+    display.receive(snapshot);
+    QCOMPARE(display.snapshots, 1);
+    QVERIFY(display.units.contains(1));
+}
+
+void DeltaPushTest::snapshot_then_batches_rebuild_state() {
+    DeltaLog log;
+    Collection<int, Unit> units(&Unit::id);
+    auto source = makeReplicationSource(log, 1, units, unitSchema);
+    DeltaBatcher batcher(log);
+    Display early;
+    Display late;
+    vector<Display*> connected{&early};
+    SingleEventHandler<DeltaBatcher&, const Buffer&> broadcaster(
+        [&connected](DeltaBatcher&, const Buffer& batch) {
+            for (auto display : connected) {
+                display->receive(batch);
+            }
+        });
+    broadcaster.connect(batcher.batchReadyEvent());
+
+    early.receive(batcher.snapshot());
+    units.add(new Unit(1));
+    units.findById(1).name() = "Ambulance 1";
+    units.add(new Unit(2));
+    // Not flushed yet when the late display connects
+    units.findById(2).eta() = 4;
+    late.receive(batcher.snapshot());
+    connected.push_back(&late);
+    units.findById(1).eta() = 9;
+    units.removeById(2);
+    batcher.flush();
+
+    for (auto display : connected) {
+        QCOMPARE(display->snapshots, 1);
+        QCOMPARE(display->units.size(), size_t(1));
+        QCOMPARE(display->units.findById(1).name().value(),
+                 string("Ambulance 1"));
+        QCOMPARE(display->units.findById(1).eta().value(), 9);
+    }
+}
+
+void DeltaPushTest::send_queue_is_bounded() {
+    SendQueue queue(100);
+    auto message = make_shared<const vector<uint8_t>>(40);
+    QVERIFY(queue.push(message));
+    QVERIFY(queue.push(message));
+    QCOMPARE(queue.bytes(), size_t(80));
+    QVERIFY(!queue.push(message));
+    QVERIFY(queue.empty());
+    QCOMPARE(queue.bytes(), size_t(0));
+    QCOMPARE(queue.overflows(), uint64_t(1));
+
+    // A message larger than the bound still goes through an empty queue
+    auto large = make_shared<const vector<uint8_t>>(150);
+    QVERIFY(queue.push(large));
+    QCOMPARE(queue.size(), size_t(1));
+    QCOMPARE(queue.front().get(), large.get());
+    queue.pop();
+    QVERIFY(queue.empty());
+}
+
+QTEST_APPLESS_MAIN(DeltaPushTest)
+
+#include "tst_deltapushtest.moc"
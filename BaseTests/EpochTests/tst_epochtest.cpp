@@ -0,0 +1,145 @@
+#include <QtTest>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "epoch.h"
+#include "model.h"
+
+using namespace Base::Concurrency;
+using namespace Base::Model;
+
+class EpochTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void retired_object_waits_for_reader();
+    void nested_guards();
+    void collection_lookup();
+    void collection_concurrent_readers();
+};
+
+struct Tracked {
+    explicit Tracked(int id, int* deleted) : id(id), deleted(deleted) {}
+    ~Tracked() { (*deleted)++; }
+
+    int id;
+    int* deleted;
+};
+
+void EpochTest::retired_object_waits_for_reader() {
+    EpochDomain domain(1000);
+    int deleted = 0;
+    {
+        EpochDomain::ReadGuard guard(domain);
+        domain.retire(new Tracked(1, &deleted));
+        // The reader may still hold the object, however often we collect
+        for (int i = 0; i < 5; ++i) {
+            domain.collect();
+        }
+        QCOMPARE(deleted, 0);
+        QCOMPARE(domain.pending(), size_t(1));
+    }
+    domain.synchronize();
+    QCOMPARE(deleted, 1);
+    QCOMPARE(domain.pending(), size_t(0));
+}
+
+void EpochTest::nested_guards() {
+    EpochDomain domain;
+    int deleted = 0;
+    {
+        EpochDomain::ReadGuard outer(domain);
+        {
+            EpochDomain::ReadGuard inner(domain);
+        }
+        domain.retire(new Tracked(1, &deleted));
+        domain.collect();
+        domain.collect();
+        QCOMPARE(deleted, 0);
+    }
+    domain.synchronize();
+    QCOMPARE(deleted, 1);
+}
+
+void EpochTest::collection_lookup() {
+    EpochDomain domain;
+    int deleted = 0;
+    {
+        Collection<int, Tracked> collection(
+            [](const Tracked& item) { return item.id; });
+        collection.add(new Tracked(1, &deleted));
+        collection.setReclamation(domain);
+        collection.addAll({new Tracked(2, &deleted), new Tracked(3, &deleted)});
+
+        EpochDomain::ReadGuard guard(domain);
+        auto item = collection.lookup(2);
+        QVERIFY(item != nullptr);
+        QVERIFY(collection.lookup(4) == nullptr);
+
+        collection.removeById(2);
+        QVERIFY(collection.lookup(2) == nullptr);
+        // Still safe to use inside the epoch
+        QCOMPARE(item->id, 2);
+        domain.collect();
+        QCOMPARE(deleted, 0);
+
+        int count = 0;
+        collection.forEachShared([&count](int, Tracked&) { count++; });
+        QCOMPARE(count, 2);
+    }
+    domain.synchronize();
+    QCOMPARE(deleted, 3);
+}
+
+void EpochTest::collection_concurrent_readers() {
+    EpochDomain domain(16);
+    int deleted = 0;
+    Collection<int, Tracked> collection(
+        [](const Tracked& item) { return item.id; });
+    collection.setReclamation(domain);
+
+    atomic<bool> done{false};
+    atomic<long> found{0};
+    vector<thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                EpochDomain::ReadGuard guard(domain);
+                for (int id = 0; id < 64; ++id) {
+                    auto item = collection.lookup(id);
+                    if (item != nullptr && item->id == id) {
+                        found++;
+                    }
+                }
+            }
+        });
+    }
+    int created = 0;
+    for (int round = 0; round < 2000; ++round) {
+        auto id = round % 64;
+        if (collection.contains(id)) {
+            collection.removeById(id);
+        } else {
+            collection.add(new Tracked(id, &deleted));
+            created++;
+        }
+    }
+    // The writer may finish before a reader has run at all; the items left
+    // in the collection are found once they do
+    while (found.load() == 0) {
+        this_thread::yield();
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    collection.clear();
+    domain.synchronize();
+    QCOMPARE(deleted, created);
+    QVERIFY(found.load() > 0);
+}
+
+QTEST_APPLESS_MAIN(EpochTest)
+
+#include "tst_epochtest.moc"
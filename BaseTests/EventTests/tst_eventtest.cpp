@@ -10,6 +10,9 @@ class EventTest : public QObject
   private slots:
     void connect_and_fire();
     void connect_and_fire_with_lambda();
+    void move_keeps_subscribers();
+    void move_assignment_drops_subscribers();
+    void event_destroyed_before_handler();
 };
 
 class MyEventHandler : public EventHandler<MyEventHandler> {
@@ -74,6 +77,59 @@ void EventTest::connect_and_fire_with_lambda() {
     QVERIFY(eventsReceived == 3);
 }
 
+void EventTest::move_keeps_subscribers() {
+    int eventsReceived = 0;
+    auto myEvent = make_unique<Event<const QString&>>();
+    SingleEventHandler<const QString&> myHandler(
+        [&eventsReceived](const QString&) { eventsReceived++; });
+    myHandler.connect(*myEvent);
+
+    vector<Event<const QString&>> events;
+    events.push_back(move(*myEvent));
+    myEvent->fire("to nobody");
+    QCOMPARE(eventsReceived, 0);
+    myEvent.reset();
+
+    // Relocate the event, the handler has to follow it
+    events.resize(16);
+    events.front().fire("hello");
+    QCOMPARE(eventsReceived, 1);
+    // The handler disconnects from the event at its new address; ASan catches
+    // a stale address here.
+}
+
+void EventTest::move_assignment_drops_subscribers() {
+    int firstReceived = 0;
+    int secondReceived = 0;
+    Event<const QString&> first;
+    Event<const QString&> second;
+    SingleEventHandler<const QString&> firstHandler(
+        [&firstReceived](const QString&) { firstReceived++; });
+    SingleEventHandler<const QString&> secondHandler(
+        [&secondReceived](const QString&) { secondReceived++; });
+    firstHandler.connect(first);
+    secondHandler.connect(second);
+
+    second = move(first);
+    second.fire("hello");
+    first.fire("hello");
+    QCOMPARE(firstReceived, 1);
+    QCOMPARE(secondReceived, 0);
+}
+
+void EventTest::event_destroyed_before_handler() {
+    int eventsReceived = 0;
+    SingleEventHandler<const QString&> myHandler(
+        [&eventsReceived](const QString&) { eventsReceived++; });
+    {
+        Event<const QString&> myEvent;
+        myHandler.connect(myEvent);
+        myEvent.fire("hello");
+    }
+    QCOMPARE(eventsReceived, 1);
+    // The handler no longer refers to the destroyed event
+}
+
 QTEST_APPLESS_MAIN(EventTest)
 
 #include "tst_eventtest.moc"
@@ -0,0 +1,331 @@
+#include <QtTest>
+
+#include <cstdint>
+#include <vector>
+
+#include "event.h"
+#include "gatewaylink.h"
+
+using namespace Base::Event;
+using namespace Base::Gateway;
+
+namespace {
+
+// A journal stand-in holding the events 1 to published
+struct Events {
+    uint64_t published = 0;
+
+    void read(uint64_t from, size_t maxCount, vector<GatewayEvent>& events) {
+        for (auto sequence = from;
+             sequence <= published && events.size() < maxCount; ++sequence) {
+            events.push_back({sequence, int64_t(sequence) * 1000,
+                              "+4670" + to_string(sequence),
+                              "YES " + to_string(sequence)});
+        }
+    }
+
+    void publish(CreditSender& sender, uint64_t count) {
+        published += count;
+        sender.published(published);
+    }
+};
+
+struct Received {
+    Received(CreditReceiver& receiver)
+        : handler([this](CreditReceiver&, const GatewayEvent& event) {
+              sequences.push_back(event.sequence);
+          }) {
+        handler.connect(receiver.eventReceivedEvent());
+    }
+
+    vector<uint64_t> sequences;
+    SingleEventHandler<CreditReceiver&, const GatewayEvent&> handler;
+};
+
+// Sends everything the sender may send and returns the number of batches
+size_t pump(CreditSender& sender, CreditReceiver& receiver,
+            vector<uint8_t>& credits) {
+    vector<uint8_t> batches;
+    size_t count = 0;
+    while (sender.nextBatch(batches)) {
+        count++;
+    }
+    receiver.feed(batches.data(), batches.size(), credits);
+    return count;
+}
+
+// Returns the credits to the sender, like AppLink does with Credit frames
+bool returnCredits(CreditSender& sender, vector<uint8_t>& credits) {
+    Protocol::FrameParser parser;
+    auto ok = parser.feed(credits.data(), credits.size(),
+                          [&](Protocol::FrameType type, Reader& reader) {
+                              if (type != Protocol::FrameType::Credit) {
+                                  throw DecodeError("Unexpected frame");
+                              }
+                              auto processed = reader.readVarint();
+                              sender.grant(processed, static_cast<uint32_t>(
+                                                          reader.readVarint()));
+                          });
+    credits.clear();
+    return ok;
+}
+
+} // namespace
+
+class GatewayLinkTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void event_round_trip();
+    void credits_bound_batches();
+    void stall_is_counted();
+    void reconnect_resends_unprocessed();
+    void deferred_acknowledgement();
+    void split_frames();
+    void corrupt_stream();
+    void send_frame();
+};
+
+void GatewayLinkTest::event_round_trip() {
+    Events events;
+    CreditSender sender(
+        [&events](uint64_t from, size_t maxCount,
+                  vector<GatewayEvent>& batch) {
+            events.read(from, maxCount, batch);
+        },
+        4);
+    CreditReceiver receiver(2);
+    GatewayEvent last;
+    SingleEventHandler<CreditReceiver&, const GatewayEvent&> handler(
+        [&last](CreditReceiver&, const GatewayEvent& event) { last = event; });
+    handler.connect(receiver.eventReceivedEvent());
+
+    sender.connect(0, receiver.window());
+    events.publish(sender, 3);
+    vector<uint8_t> credits;
+    QCOMPARE(pump(sender, receiver, credits), size_t(1));
+    QCOMPARE(last.sequence, uint64_t(3));
+    QCOMPARE(last.timestamp, int64_t(3000));
+    QCOMPARE(last.sender, string("+46703"));
+    QCOMPARE(last.text, string("YES 3"));
+    QCOMPARE(receiver.processed(), uint64_t(3));
+}
+
+void GatewayLinkTest::credits_bound_batches() {
+    Events events;
+    CreditSender sender(
+        [&events](uint64_t from, size_t maxCount,
+                  vector<GatewayEvent>& batch) {
+            events.read(from, maxCount, batch);
+        },
+        10);
+    CreditReceiver receiver(3);
+    Received received(receiver);
+
+    sender.connect(0, receiver.window());
+    events.publish(sender, 100);
+    vector<uint8_t> credits;
+    // Only a window of batches goes out until credits come back
+    QCOMPARE(pump(sender, receiver, credits), size_t(3));
+    QCOMPARE(received.sequences.size(), size_t(30));
+    QCOMPARE(sender.credits(), uint32_t(0));
+    QCOMPARE(sender.backlog(), uint64_t(100));
+
+    QVERIFY(returnCredits(sender, credits));
+    QCOMPARE(sender.processed(), uint64_t(30));
+    QCOMPARE(sender.credits(), uint32_t(3));
+    QCOMPARE(sender.backlog(), uint64_t(70));
+    while (pump(sender, receiver, credits) > 0) {
+        QVERIFY(returnCredits(sender, credits));
+    }
+    QCOMPARE(received.sequences.size(), size_t(100));
+    for (size_t i = 0; i < received.sequences.size(); ++i) {
+        QCOMPARE(received.sequences[i], uint64_t(i + 1));
+    }
+    QCOMPARE(sender.stats().batches, uint64_t(10));
+    QCOMPARE(sender.stats().events, uint64_t(100));
+    QCOMPARE(sender.backlog(), uint64_t(0));
+}
+
+void GatewayLinkTest::stall_is_counted() {
+    Events events;
+    CreditSender sender(
+        [&events](uint64_t from, size_t maxCount,
+                  vector<GatewayEvent>& batch) {
+            events.read(from, maxCount, batch);
+        },
+        1);
+    sender.connect(0, 1);
+    events.publish(sender, 5);
+    vector<uint8_t> buffer;
+    QVERIFY(sender.nextBatch(buffer));
+    QVERIFY(!sender.nextBatch(buffer));
+    QVERIFY(!sender.nextBatch(buffer));
+    // Counted once per stall, not once per attempt
+    QCOMPARE(sender.stats().stalls, uint64_t(1));
+    sender.grant(1, 1);
+    QVERIFY(sender.nextBatch(buffer));
+    QVERIFY(!sender.nextBatch(buffer));
+    QCOMPARE(sender.stats().stalls, uint64_t(2));
+}
+
+void GatewayLinkTest::reconnect_resends_unprocessed() {
+    Events events;
+    CreditSender sender(
+        [&events](uint64_t from, size_t maxCount,
+                  vector<GatewayEvent>& batch) {
+            events.read(from, maxCount, batch);
+        },
+        5);
+    CreditReceiver receiver(2);
+    Received received(receiver);
+    vector<uint8_t> hello;
+    receiver.hello(hello);
+    sender.connect(0, receiver.window());
+    events.publish(sender, 20);
+
+    // The first batch arrives, the second is lost with the connection
+    vector<uint8_t> batches;
+    QVERIFY(sender.nextBatch(batches));
+    vector<uint8_t> credits;
+    receiver.feed(batches.data(), batches.size(), credits);
+    batches.clear();
+    QVERIFY(sender.nextBatch(batches));
+    sender.disconnect();
+    QVERIFY(!sender.nextBatch(batches));
+
+    // The new connection starts after what App has processed
+    sender.connect(receiver.processed(), receiver.window());
+    while (pump(sender, receiver, credits) > 0) {
+        QVERIFY(returnCredits(sender, credits));
+    }
+    QCOMPARE(received.sequences.size(), size_t(20));
+    for (size_t i = 0; i < received.sequences.size(); ++i) {
+        QCOMPARE(received.sequences[i], uint64_t(i + 1));
+    }
+
+    // A batch that arrives twice is only handled once
+    CreditSender replay(
+        [&events](uint64_t from, size_t maxCount,
+                  vector<GatewayEvent>& batch) {
+            events.read(from, maxCount, batch);
+        },
+        5);
+    replay.connect(10, 1);
+    replay.published(20);
+    batches.clear();
+    QVERIFY(replay.nextBatch(batches));
+    receiver.feed(batches.data(), batches.size(), credits);
+    QCOMPARE(received.sequences.size(), size_t(20));
+    QVERIFY(!credits.empty());
+}
+
+void GatewayLinkTest::deferred_acknowledgement() {
+    Events events;
+    CreditSender sender(
+        [&events](uint64_t from, size_t maxCount,
+                  vector<GatewayEvent>& batch) {
+            events.read(from, maxCount, batch);
+        },
+        5);
+    CreditReceiver receiver(2);
+    Received received(receiver);
+    receiver.setAcknowledged(0);
+    sender.connect(0, receiver.window());
+    events.publish(sender, 10);
+
+    // Credits come back, but the events stay unacknowledged
+    vector<uint8_t> credits;
+    QCOMPARE(pump(sender, receiver, credits), size_t(2));
+    QCOMPARE(receiver.processed(), uint64_t(10));
+    QCOMPARE(receiver.acknowledged(), uint64_t(0));
+    QVERIFY(returnCredits(sender, credits));
+    QCOMPARE(sender.processed(), uint64_t(0));
+    QCOMPARE(sender.credits(), uint32_t(2));
+    QVERIFY(!receiver.acknowledge(credits));
+
+    receiver.setAcknowledged(7);
+    QVERIFY(receiver.acknowledge(credits));
+    QVERIFY(!receiver.acknowledge(credits));
+    QVERIFY(returnCredits(sender, credits));
+    QCOMPARE(sender.processed(), uint64_t(7));
+    QCOMPARE(sender.credits(), uint32_t(2));
+
+    // Never beyond what was processed
+    receiver.setAcknowledged(20);
+    QCOMPARE(receiver.acknowledged(), uint64_t(10));
+    vector<uint8_t> hello;
+    receiver.hello(hello);
+    QVERIFY(!receiver.acknowledge(credits));
+    QCOMPARE(received.sequences.size(), size_t(10));
+}
+
+void GatewayLinkTest::split_frames() {
+    Events events;
+    CreditSender sender(
+        [&events](uint64_t from, size_t maxCount,
+                  vector<GatewayEvent>& batch) {
+            events.read(from, maxCount, batch);
+        },
+        3);
+    CreditReceiver receiver(4);
+    Received received(receiver);
+    sender.connect(0, receiver.window());
+    events.publish(sender, 12);
+    vector<uint8_t> batches;
+    while (sender.nextBatch(batches)) {
+    }
+    // Feed one byte at a time; the credits come once per complete batch
+    vector<uint8_t> credits;
+    for (auto byte : batches) {
+        QVERIFY(receiver.feed(&byte, 1, credits));
+    }
+    QCOMPARE(received.sequences.size(), size_t(12));
+    QVERIFY(returnCredits(sender, credits));
+    QCOMPARE(sender.credits(), uint32_t(4));
+    QCOMPARE(sender.processed(), uint64_t(12));
+}
+
+void GatewayLinkTest::corrupt_stream() {
+    CreditReceiver receiver;
+    vector<uint8_t> credits;
+    // A frame type App does not accept
+    vector<uint8_t> frame;
+    Protocol::writeCredit(frame, 1, 1);
+    QVERIFY(!receiver.feed(frame.data(), frame.size(), credits));
+    // A length beyond the limit
+    vector<uint8_t> garbage{0xff, 0xff, 0xff, 0xff, 3};
+    QVERIFY(!receiver.feed(garbage.data(), garbage.size(), credits));
+    // A truncated event inside a complete frame
+    frame.clear();
+    Protocol::writeFrame(frame, Protocol::FrameType::Batch,
+                         [](Writer& writer) { writer.writeVarint(1); });
+    QVERIFY(!receiver.feed(frame.data(), frame.size(), credits));
+    QVERIFY(credits.empty());
+    QCOMPARE(receiver.processed(), uint64_t(0));
+}
+
+void GatewayLinkTest::send_frame() {
+    vector<uint8_t> buffer;
+    Protocol::writeSend(buffer, "+46701", "Alarm: fire at station 3");
+    Protocol::writeSend(buffer, "+46702", "Exercise on Monday", false);
+    Protocol::FrameParser parser;
+    vector<string> recipients;
+    vector<string> texts;
+    vector<bool> alarms;
+    auto ok = parser.feed(buffer.data(), buffer.size(),
+                          [&](Protocol::FrameType type, Reader& reader) {
+                              QCOMPARE(type, Protocol::FrameType::Send);
+                              recipients.push_back(reader.read<string>());
+                              texts.push_back(reader.read<string>());
+                              alarms.push_back(reader.readByte() != 0);
+                          });
+    QVERIFY(ok);
+    QCOMPARE(recipients, (vector<string>{"+46701", "+46702"}));
+    QCOMPARE(texts, (vector<string>{"Alarm: fire at station 3",
+                                    "Exercise on Monday"}));
+    QCOMPARE(alarms, (vector<bool>{true, false}));
+}
+
+QTEST_APPLESS_MAIN(GatewayLinkTest)
+
+#include "tst_gatewaylinktest.moc"
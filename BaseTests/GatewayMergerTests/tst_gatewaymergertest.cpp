@@ -0,0 +1,161 @@
+#include <QtTest>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "event.h"
+#include "gatewaymerger.h"
+
+using namespace Base::Event;
+using namespace Base::Gateway;
+
+namespace {
+
+using Clock = EventMerger::Clock;
+
+GatewayEvent sms(uint64_t sequence, int64_t timestamp,
+                 const string& sender = "+46701", const string& text = "YES") {
+    return {sequence, timestamp, sender, text};
+}
+
+struct Merged {
+    Merged(EventMerger& merger)
+        : handler([this](size_t source, const GatewayEvent& event) {
+              events.emplace_back(source, event.sequence);
+          }) {
+        handler.connect(merger.eventMergedEvent());
+    }
+
+    // Gateway and sequence number
+    vector<pair<size_t, uint64_t>> events;
+    SingleEventHandler<size_t, const GatewayEvent&> handler;
+};
+
+} // namespace
+
+class GatewayMergerTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void orders_within_window();
+    void releases_earlier_events();
+    void late_event();
+    void duplicates();
+    void merged_watermark();
+    void latency();
+    void zero_window();
+};
+
+void GatewayMergerTest::orders_within_window() {
+    EventMerger merger(2, chrono::milliseconds(100));
+    Merged merged(merger);
+    Clock::time_point start;
+    merger.add(0, sms(1, 3000, "+46701"), start);
+    merger.add(1, sms(1, 1000, "+46702"), start + chrono::milliseconds(10));
+    merger.add(0, sms(2, 2000, "+46703"), start + chrono::milliseconds(20));
+    QVERIFY(merged.events.empty());
+    QCOMPARE(merger.held(), size_t(3));
+    QVERIFY(merger.nextRelease() == start + chrono::milliseconds(100));
+
+    merger.release(start + chrono::milliseconds(99));
+    QVERIFY(merged.events.empty());
+    merger.release(start + chrono::milliseconds(100));
+    // The first event's window has passed; the earlier ones go with it
+    vector<pair<size_t, uint64_t>> expected{{1, 1}, {0, 2}, {0, 1}};
+    QCOMPARE(merged.events, expected);
+    QCOMPARE(merger.held(), size_t(0));
+    QVERIFY(merger.nextRelease() == Clock::time_point::max());
+}
+
+void GatewayMergerTest::releases_earlier_events() {
+    EventMerger merger(2, chrono::milliseconds(100));
+    Merged merged(merger);
+    Clock::time_point start;
+    merger.add(0, sms(1, 1000, "+46701"), start);
+    merger.add(1, sms(1, 5000, "+46702"), start + chrono::milliseconds(50));
+    merger.release(start + chrono::milliseconds(100));
+    vector<pair<size_t, uint64_t>> expected{{0, 1}};
+    QCOMPARE(merged.events, expected);
+    // Later events wait for their own window
+    QCOMPARE(merger.held(), size_t(1));
+    merger.flush(start + chrono::milliseconds(120));
+    expected.emplace_back(1, 1);
+    QCOMPARE(merged.events, expected);
+}
+
+void GatewayMergerTest::late_event() {
+    EventMerger merger(2, chrono::milliseconds(100));
+    Merged merged(merger);
+    Clock::time_point start;
+    merger.add(0, sms(1, 5000, "+46701"), start);
+    merger.release(start + chrono::milliseconds(100));
+    merger.add(1, sms(1, 1000, "+46702"), start + chrono::milliseconds(200));
+    vector<pair<size_t, uint64_t>> expected{{0, 1}, {1, 1}};
+    QCOMPARE(merged.events, expected);
+    QCOMPARE(merger.stats().late, uint64_t(1));
+    QCOMPARE(merger.held(), size_t(0));
+}
+
+void GatewayMergerTest::duplicates() {
+    EventMerger merger(2, chrono::milliseconds(0), chrono::seconds(60));
+    Merged merged(merger);
+    Clock::time_point start;
+    merger.add(0, sms(1, 1000000, "+46701", "YES"), start);
+    // The same SMS through the other gateway, with its own SMSC time
+    merger.add(1, sms(1, 3000000, "+46701", "YES"), start);
+    // The same text from another responder
+    merger.add(1, sms(2, 3000000, "+46702", "YES"), start);
+    // The responder answering twice through one gateway
+    merger.add(0, sms(2, 4000000, "+46701", "YES"), start);
+    // A copy beyond the tolerance is a new SMS
+    merger.add(1, sms(3, 120000000, "+46701", "YES"), start);
+    vector<pair<size_t, uint64_t>> expected{{0, 1}, {1, 2}, {0, 2}, {1, 3}};
+    QCOMPARE(merged.events, expected);
+    QCOMPARE(merger.stats().received, uint64_t(5));
+    QCOMPARE(merger.stats().merged, uint64_t(4));
+    QCOMPARE(merger.stats().duplicates, uint64_t(1));
+}
+
+void GatewayMergerTest::merged_watermark() {
+    EventMerger merger(2, chrono::milliseconds(100));
+    Clock::time_point start;
+    merger.add(0, sms(1, 1000, "+46701"), start);
+    merger.add(0, sms(2, 2000, "+46702"), start + chrono::milliseconds(50));
+    merger.add(1, sms(1, 1000, "+46701"), start + chrono::milliseconds(60));
+    QCOMPARE(merger.merged(0), uint64_t(0));
+    // The dropped copy is done with at once
+    QCOMPARE(merger.merged(1), uint64_t(1));
+    merger.release(start + chrono::milliseconds(100));
+    QCOMPARE(merger.merged(0), uint64_t(1));
+    merger.release(start + chrono::milliseconds(150));
+    QCOMPARE(merger.merged(0), uint64_t(2));
+}
+
+void GatewayMergerTest::latency() {
+    EventMerger merger(1, chrono::milliseconds(100));
+    Clock::time_point start;
+    merger.add(0, sms(1, 1000, "+46701"), start);
+    merger.add(0, sms(2, 2000, "+46702"), start + chrono::milliseconds(40));
+    merger.release(start + chrono::milliseconds(100));
+    merger.release(start + chrono::milliseconds(140));
+    QCOMPARE(merger.latency().count(), uint64_t(2));
+    QCOMPARE(merger.latency().max(), uint64_t(100000));
+}
+
+void GatewayMergerTest::zero_window() {
+    EventMerger merger(2, chrono::milliseconds(0));
+    Merged merged(merger);
+    merger.add(0, sms(1, 2000, "+46701"));
+    merger.add(1, sms(1, 1000, "+46702"));
+    // Handed on as they come; the second is late
+    vector<pair<size_t, uint64_t>> expected{{0, 1}, {1, 1}};
+    QCOMPARE(merged.events, expected);
+    QCOMPARE(merger.held(), size_t(0));
+    QCOMPARE(merger.stats().late, uint64_t(1));
+}
+
+QTEST_APPLESS_MAIN(GatewayMergerTest)
+
+#include "tst_gatewaymergertest.moc"
@@ -0,0 +1,159 @@
+#include <QtTest>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event.h"
+#include "instrumentation.h"
+#include "model.h"
+
+using namespace Base::Event;
+using namespace Base::Instrumentation;
+using namespace Base::Model;
+
+class InstrumentationTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void init();
+    void event_operations();
+    void property_and_collection_operations();
+    void adds_are_counted_alike();
+    void threads_are_aggregated();
+    void report_lists_busy_types();
+};
+
+// Types of their own, so that other tests do not add to their counts
+struct Alarm {
+    explicit Alarm(int id) : id(id) {}
+    int id;
+    PROPERTY(double, level)
+};
+
+struct Ping {};
+
+static SiteStats statsOf(const string& name) {
+    for (auto& stats : Registry::instance().stats()) {
+        if (stats.name == name) {
+            return stats;
+        }
+    }
+    return SiteStats();
+}
+
+template <typename T> static SiteStats statsOf() {
+    return statsOf(typeName<T>());
+}
+
+void InstrumentationTest::init() { Registry::instance().reset(); }
+
+void InstrumentationTest::event_operations() {
+    Event<Ping&> event;
+    vector<unique_ptr<SingleEventHandler<Ping&>>> handlers;
+    for (int i = 0; i < 5; ++i) {
+        handlers.push_back(
+            make_unique<SingleEventHandler<Ping&>>([](Ping&) {}));
+        handlers.back()->connect(event);
+    }
+    Ping ping;
+    for (int i = 0; i < 10; ++i) {
+        event.fire(ping);
+    }
+    handlers.pop_back();
+
+    auto stats = statsOf<Event<Ping&>>();
+    QCOMPARE(stats.kind, Kind::Event);
+    QCOMPARE(stats.count(Operation::Subscribe), uint64_t(5));
+    QCOMPARE(stats.count(Operation::Unsubscribe), uint64_t(1));
+    QCOMPARE(stats.count(Operation::Fire), uint64_t(10));
+    // 5 subscribers are in the bucket of 4 to 7
+    QCOMPARE(stats.sizeBuckets[3], uint64_t(10));
+    QCOMPARE(stats.sizeQuantile(0.5), uint64_t(7));
+    QVERIFY(stats.timeQuantile(0.99) > 0);
+}
+
+void InstrumentationTest::property_and_collection_operations() {
+    Collection<int, Alarm> alarms([](const Alarm& alarm) { return alarm.id; });
+    for (int i = 0; i < 100; ++i) {
+        alarms.add(new Alarm(i));
+        alarms.findById(i).level() = i * 0.5;
+    }
+    alarms.findById(7).level().clear();
+    alarms.removeById(3);
+    alarms.removeById(1000);
+    auto view = alarms.sort([](const Alarm& a1, const Alarm& a2) {
+        return a1.id > a2.id;
+    });
+    QCOMPARE(view.size(), size_t(99));
+
+    auto property = statsOf<Property<double>>();
+    QCOMPARE(property.kind, Kind::Property);
+    QVERIFY(property.count(Operation::SetValue) >= 100);
+    QVERIFY(property.count(Operation::Clear) >= 1);
+
+    auto collection = statsOf<Collection<int, Alarm>>();
+    QCOMPARE(collection.kind, Kind::Collection);
+    QCOMPARE(collection.count(Operation::Add), uint64_t(100));
+    QCOMPARE(collection.count(Operation::Remove), uint64_t(2));
+    QCOMPARE(collection.count(Operation::Sort), uint64_t(1));
+    // 99 items are in the bucket of 64 to 127
+    QCOMPARE(collection.sizeQuantile(1), uint64_t(127));
+    QVERIFY(collection.nanos > 0);
+}
+
+void InstrumentationTest::adds_are_counted_alike() {
+    Collection<int, Alarm> alarms([](const Alarm& alarm) { return alarm.id; });
+    alarms.add(new Alarm(1));
+    alarms.add(Alarm(1));
+    alarms.add(Alarm(2));
+    alarms.add(Alarm(2));
+    vector<Alarm*> batch;
+    for (int i = 0; i < 20; ++i) {
+        batch.push_back(new Alarm(i));
+    }
+    alarms.addAll(batch);
+
+    // Duplicates count too; a batch counts once with its size
+    auto collection = statsOf<Collection<int, Alarm>>();
+    QCOMPARE(collection.count(Operation::Add), uint64_t(5));
+    // 20 items are in the bucket of 16 to 31
+    QCOMPARE(collection.sizeBuckets[5], uint64_t(1));
+    QCOMPARE(alarms.size(), size_t(20));
+}
+
+void InstrumentationTest::threads_are_aggregated() {
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            Property<Ping*> property;
+            for (int i = 0; i < 1000; ++i) {
+                property = nullptr;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto stats = statsOf<Property<Ping*>>();
+    QCOMPARE(stats.count(Operation::SetValue), uint64_t(4000));
+    auto fired = statsOf<Event<Property<Ping*>&, Ping*>>();
+    QCOMPARE(fired.count(Operation::Fire), uint64_t(4000));
+    QCOMPARE(fired.sizeBuckets[0], uint64_t(4000));
+}
+
+void InstrumentationTest::report_lists_busy_types() {
+    Event<Ping&> event;
+    Ping ping;
+    for (int i = 0; i < 3; ++i) {
+        event.fire(ping);
+    }
+    auto report = Registry::instance().report();
+    auto line = typeName<Event<Ping&>>() + " fire=3";
+    QVERIFY(report.find(line) != string::npos);
+    Registry::instance().reset();
+    QVERIFY(Registry::instance().report().empty());
+}
+
+QTEST_APPLESS_MAIN(InstrumentationTest)
+
+#include "tst_instrumentationtest.moc"
@@ -0,0 +1,154 @@
+#include <QtTest>
+
+#include <atomic>
+#include <thread>
+
+#include "loopmonitor.h"
+
+using namespace Base::Diagnostics;
+
+class LoopMonitorTest : public QObject {
+    Q_OBJECT
+  private slots:
+    // First, so that its handler is installed before the capture handler
+    void stack_capture_chains_and_ignores_late_signals();
+    void histogram_buckets();
+    void histogram_percentiles();
+    void tick_records_lag();
+    void stall_is_caught_while_blocked();
+};
+
+void LoopMonitorTest::histogram_buckets() {
+    for (uint64_t value : {0, 1, 15, 16, 17, 31, 32, 33, 1000, 123456789}) {
+        auto index = Histogram::indexOf(value);
+        QVERIFY(Histogram::lowerBound(index) <= value);
+        QVERIFY(Histogram::upperBound(index) >= value);
+    }
+    QCOMPARE(Histogram::indexOf(UINT64_MAX), Histogram::bucketCount - 1);
+    for (size_t i = 0; i + 1 < Histogram::bucketCount; ++i) {
+        QCOMPARE(Histogram::upperBound(i) + 1, Histogram::lowerBound(i + 1));
+    }
+}
+
+void LoopMonitorTest::histogram_percentiles() {
+    Histogram histogram;
+    QCOMPARE(histogram.percentile(99), uint64_t(0));
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        histogram.record(i);
+    }
+    QCOMPARE(histogram.count(), uint64_t(1000));
+    QCOMPARE(histogram.max(), uint64_t(1000));
+    QCOMPARE(histogram.mean(), 500.5);
+    auto p50 = histogram.percentile(50);
+    QVERIFY(p50 >= 500 && p50 <= 500 * 1.0625);
+    auto p99 = histogram.percentile(99);
+    QVERIFY(p99 >= 990 && p99 <= 1000);
+    QCOMPARE(histogram.percentile(100), uint64_t(1000));
+
+    uint64_t total = 0;
+    histogram.forEachBucket(
+        [&total](uint64_t, uint64_t, uint64_t count) { total += count; });
+    QCOMPARE(total, uint64_t(1000));
+    histogram.reset();
+    QCOMPARE(histogram.count(), uint64_t(0));
+}
+
+void LoopMonitorTest::tick_records_lag() {
+    LoopMonitor monitor("test", chrono::milliseconds(5),
+                        chrono::milliseconds(1000));
+    monitor.start();
+    this_thread::sleep_for(chrono::milliseconds(5));
+    monitor.tick();
+    this_thread::sleep_for(chrono::milliseconds(35));
+    monitor.tick();
+    monitor.stop();
+    QCOMPARE(monitor.lag().count(), uint64_t(2));
+    // The second tick was about 30 ms late
+    QVERIFY(monitor.lag().max() >= 29000);
+    QCOMPARE(monitor.stalls(), uint64_t(0));
+}
+
+void LoopMonitorTest::stall_is_caught_while_blocked() {
+    LoopMonitor monitor("test", chrono::milliseconds(10),
+                        chrono::milliseconds(50));
+    mutex stallMutex;
+    vector<LoopStall> stalls;
+    monitor.setStallHandler([&](const LoopStall& stall) {
+        lock_guard<mutex> lock(stallMutex);
+        stalls.push_back(stall);
+    });
+    monitor.start();
+    {
+        LoopMonitor::Activity outer(monitor, "dispatch");
+        LoopMonitor::Activity inner(monitor, "slowHandler");
+        this_thread::sleep_for(chrono::milliseconds(300));
+    }
+    monitor.tick();
+    monitor.stop();
+
+    lock_guard<mutex> lock(stallMutex);
+    // Reported once while the loop was blocked, not once per watchdog wakeup
+    QCOMPARE(stalls.size(), size_t(1));
+    QCOMPARE(monitor.stalls(), uint64_t(1));
+    QCOMPARE(stalls[0].loop, string("test"));
+    QCOMPARE(stalls[0].activity, string("slowHandler"));
+    QVERIFY(stalls[0].lagMicros > 50000);
+#ifdef BASE_LOOPMONITOR_STACKS
+    QVERIFY(!stalls[0].stack.empty());
+#endif
+    QVERIFY(monitor.lag().max() >= 250000);
+}
+
+#ifdef BASE_LOOPMONITOR_STACKS
+static atomic<int> otherSignals{0};
+
+static void countSignal(int) { otherSignals++; }
+#endif
+
+void LoopMonitorTest::stack_capture_chains_and_ignores_late_signals() {
+#ifdef BASE_LOOPMONITOR_STACKS
+    struct sigaction action {};
+    action.sa_handler = &countSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(StackCapture::signalNumber, &action, nullptr);
+    QVERIFY(!StackCapture::capture(pthread_self(), chrono::seconds(1))
+                 .empty());
+    // A signal that is not for a capture reaches the previous handler
+    pthread_kill(pthread_self(), StackCapture::signalNumber);
+    QCOMPARE(otherSignals.load(), 1);
+
+    // A thread that has the signal blocked answers after the timeout
+    atomic<bool> ready{false};
+    atomic<bool> captured{false};
+    atomic<bool> unblocked{false};
+    thread blocked([&] {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, StackCapture::signalNumber);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        ready = true;
+        while (!captured) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+        unblocked = true;
+    });
+    while (!ready) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    auto stack = StackCapture::capture(blocked.native_handle(),
+                                       chrono::milliseconds(20));
+    captured = true;
+    blocked.join();
+    QVERIFY(stack.empty());
+    QVERIFY(unblocked);
+    // The late signal was not taken for a capture
+    QCOMPARE(otherSignals.load(), 2);
+    QVERIFY(!StackCapture::capture(pthread_self(), chrono::seconds(1))
+                 .empty());
+#endif
+}
+
+QTEST_APPLESS_MAIN(LoopMonitorTest)
+
+#include "tst_loopmonitortest.moc"
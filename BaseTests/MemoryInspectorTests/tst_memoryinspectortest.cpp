@@ -0,0 +1,147 @@
+#include <QtTest>
+
+#include <string>
+#include <vector>
+
+#include "event.h"
+#include "memoryinspector.h"
+
+using namespace Base::Diagnostics;
+using namespace Base::Event;
+using namespace Base::Model;
+
+class MemoryInspectorTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void heap_sizes();
+    void event_subscribers();
+    void property_usage();
+    void collection_usage();
+    void inspector_report();
+};
+
+class Unit {
+    PROPERTY(string, name)
+    PROPERTY(int, eta)
+
+  private:
+    int _id;
+
+  public:
+    explicit Unit(const int id) : _id(id) {}
+    int id() const { return _id; }
+};
+
+static const auto unitSchema =
+    makeSchema(FIELD(Unit, name), FIELD(Unit, eta));
+
+void MemoryInspectorTest::heap_sizes() {
+    QCOMPARE(heapSizeOf(42), size_t(0));
+    QCOMPARE(heapSizeOf(string("short")), size_t(0));
+    string text(100, 'x');
+    QCOMPARE(heapSizeOf(text), text.capacity() + 1);
+    vector<string> texts{text, "short"};
+    QCOMPARE(heapSizeOf(texts), texts.capacity() * sizeof(string) +
+                                    texts[0].capacity() + 1);
+    QCOMPARE(heapSizeOf(optional<string>()), size_t(0));
+    QCOMPARE(heapSizeOf(optional<string>(text)), text.capacity() + 1);
+}
+
+void MemoryInspectorTest::event_subscribers() {
+    Event<int> event;
+    QCOMPARE(event.subscriberCount(), size_t(0));
+    QCOMPARE(event.memoryUsage(), size_t(0));
+    SingleEventHandler<int> handler1([](int) {});
+    SingleEventHandler<int> handler2([](int) {});
+    handler1.connect(event);
+    handler2.connect(event);
+    QCOMPARE(event.subscriberCount(), size_t(2));
+    // The list and a subscriber object per subscriber
+    QVERIFY(event.memoryUsage() > 2 * sizeof(void*) * 2);
+    auto withTwo = event.memoryUsage();
+    event.unsubscribe(&handler2);
+    QCOMPARE(event.subscriberCount(), size_t(1));
+    QVERIFY(event.memoryUsage() < withTwo);
+}
+
+void MemoryInspectorTest::property_usage() {
+    Property<string> property;
+    auto empty = property.memoryUsage();
+    QCOMPARE(empty.valueBytes, size_t(0));
+    QCOMPARE(empty.subscribers, size_t(0));
+    property = string(200, 'y');
+    SingleEventHandler<Property<string>&, string> handler(
+        [](Property<string>&, string) {});
+    handler.connect(property.valueChangedEvent());
+    auto usage = property.memoryUsage();
+    QCOMPARE(usage.valueBytes, property.value().capacity() + 1);
+    QCOMPARE(usage.subscribers, size_t(1));
+    QVERIFY(usage.eventBytes > 0);
+}
+
+void MemoryInspectorTest::collection_usage() {
+    Collection<int, Unit> units(&Unit::id);
+    auto empty = units.memoryUsage();
+    QCOMPARE(empty.objects, size_t(0));
+    QCOMPARE(empty.objectBytes, size_t(0));
+
+    for (int i = 0; i < 100; ++i) {
+        units.add(new Unit(i));
+        units.findById(i).name() = string(50, 'n');
+    }
+    auto own = units.memoryUsage();
+    QCOMPARE(own.objects, size_t(100));
+    QCOMPARE(own.objectBytes, 100 * sizeof(Unit));
+    QVERIFY(own.containerBytes > empty.containerBytes);
+    QCOMPARE(own.valueBytes, size_t(0));
+
+    // With the schema the long names count as well
+    auto all = memoryUsage(units, unitSchema);
+    QCOMPARE(all.objectBytes, own.objectBytes);
+    auto nameBytes = units.findById(0).name().value().capacity() + 1;
+    QCOMPARE(all.valueBytes, 100 * nameBytes);
+    SingleEventHandler<Property<int>&, int> handler(
+        [](Property<int>&, int) {});
+    handler.connect(units.findById(5).eta().valueChangedEvent());
+    QCOMPARE(memoryUsage(units, unitSchema).subscribers, size_t(1));
+    QCOMPARE(all.total(), all.objectBytes + all.containerBytes +
+                              all.valueBytes + all.eventBytes);
+}
+
+void MemoryInspectorTest::inspector_report() {
+    Collection<int, Unit> units(&Unit::id);
+    Collection<int, Unit> moreUnits(&Unit::id);
+    for (int i = 0; i < 10; ++i) {
+        units.add(new Unit(i));
+        moreUnits.add(new Unit(i));
+    }
+    MemoryInspector inspector;
+    inspector.watch("Unit", units, unitSchema);
+    auto key = inspector.watch("Unit", moreUnits, unitSchema);
+    inspector.watch("Cache", [] {
+        MemoryUsage usage;
+        usage.containerBytes = 1024 * 1024;
+        return usage;
+    });
+
+    auto usages = inspector.measure();
+    QCOMPARE(usages.size(), size_t(2));
+    QCOMPARE(usages[0].first, string("Cache"));
+    QCOMPARE(usages[1].first, string("Unit"));
+    QCOMPARE(usages[1].second.objects, size_t(20));
+
+    auto report = inspector.report();
+    QVERIFY(report.find("Cache: 1.0 MiB for 0 objects") != string::npos);
+    QVERIFY(report.find("Unit: ") != string::npos);
+    QVERIFY(report.find("for 20 objects (") != string::npos);
+    QVERIFY(report.find("Total: ") != string::npos);
+
+    inspector.unwatch(key);
+    QCOMPARE(inspector.measure()[1].second.objects, size_t(10));
+    QCOMPARE(formatBytes(512), string("512 B"));
+    QCOMPARE(formatBytes(1536), string("1.5 KiB"));
+}
+
+QTEST_APPLESS_MAIN(MemoryInspectorTest)
+
+#include "tst_memoryinspectortest.moc"
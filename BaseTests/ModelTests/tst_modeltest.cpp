@@ -23,9 +23,15 @@ class ModelTest : public QObject {
     void property_comparation_different_values();
     void property_event_value_changed();
     void property_event_cleared();
+    void property_move_keeps_subscribers();
+    void items_by_value();
 
     void collection_initial_state();
     void collection_add_pointer();
+    void collection_add_all();
+    void collection_remove_by_id();
+    void collection_add_by_value();
+    void collection_not_movable();
 };
 
 class ValueChangeListener : Base::Event::EventHandler<ValueChangeListener> {
@@ -163,6 +169,57 @@ void ModelTest::property_event_cleared() {
     QCOMPARE(1, eventCount);
 }
 
+void ModelTest::property_move_keeps_subscribers() {
+    Property<QString> p;
+    QString receivedValue;
+    SingleEventHandler<Property<QString>&, QString> eventHandler(
+        [&receivedValue](Property<QString>&, QString value) {
+            receivedValue = value;
+        });
+    eventHandler.connect(p.valueChangedEvent());
+    p = "hello";
+
+    Property<QString> moved(move(p));
+    QCOMPARE(moved.value(), "hello");
+    moved = "moved";
+    QCOMPARE(receivedValue, "moved");
+    p = "old";
+    QCOMPARE(receivedValue, "moved");
+}
+
+void ModelTest::items_by_value() {
+    vector<MyModel> models;
+    int changes = 0;
+    vector<unique_ptr<SingleEventHandler<Property<int>&, int>>> handlers;
+    for (int i = 0; i < 4; ++i) {
+        models.emplace_back(i);
+        models.back().myIntProperty() = i;
+    }
+    for (auto& model : models) {
+        handlers.push_back(
+            make_unique<SingleEventHandler<Property<int>&, int>>(
+                [&changes](Property<int>&, int) { changes++; }));
+        handlers.back()->connect(model.myIntProperty().valueChangedEvent());
+    }
+
+    // Growing the vector relocates the models together with their events
+    for (int i = 4; i < 100; ++i) {
+        models.emplace_back(i);
+    }
+    for (auto& model : models) {
+        model.myIntProperty() = model.id();
+    }
+    QCOMPARE(changes, 4);
+    QCOMPARE(models[3].myIntProperty().value(), 3);
+
+    models.erase(models.begin());
+    models[0].myIntProperty() = 10;
+    QCOMPARE(changes, 5);
+    handlers.clear();
+    models[0].myIntProperty() = 11;
+    QCOMPARE(changes, 5);
+}
+
 void ModelTest::collection_initial_state() {
     Collection<int, MyModel> collection(&MyModel::id);
     QVERIFY(collection.isEmpty());
@@ -185,6 +242,59 @@ void ModelTest::collection_add_pointer() {
     QCOMPARE(itemPointer, &collection.findById(123));
 }
 
+void ModelTest::collection_add_all() {
+    Collection<int, MyModel> collection(&MyModel::id);
+    collection.add(new MyModel(2));
+    int batches = 0;
+    vector<int> addedIds;
+    SingleEventHandler<Collection<int, MyModel>&, const vector<int>&>
+        eventHandler([&batches, &addedIds](Collection<int, MyModel>&,
+                                           const vector<int>& ids) {
+            batches++;
+            addedIds = ids;
+        });
+    eventHandler.connect(collection.itemsAddedEvent());
+
+    collection.addAll({new MyModel(1), new MyModel(2), new MyModel(3)});
+    QCOMPARE(batches, 1);
+    QVERIFY(addedIds == vector<int>({1, 3}));
+    QCOMPARE(collection.size(), size_t(3));
+    QVERIFY(collection.ids() == set<int>({1, 2, 3}));
+}
+
+void ModelTest::collection_remove_by_id() {
+    Collection<int, MyModel> collection(&MyModel::id);
+    collection.add(new MyModel(1));
+    bool removedBeforeEvent = false;
+    SingleEventHandler<Collection<int, MyModel>&, int> eventHandler(
+        [&removedBeforeEvent](Collection<int, MyModel>& sender, int id) {
+            removedBeforeEvent = !sender.contains(id);
+        });
+    eventHandler.connect(collection.itemRemovedEvent());
+    collection.removeById(1);
+    QVERIFY(removedBeforeEvent);
+    QVERIFY(collection.isEmpty());
+    QVERIFY(collection.ids().empty());
+}
+
+void ModelTest::collection_add_by_value() {
+    Collection<int, MyModel> collection(&MyModel::id);
+    MyModel model(1);
+    model.myStringProperty() = "one";
+    collection.add(move(model));
+    collection.add(MyModel(1));
+    QCOMPARE(collection.size(), size_t(1));
+    QCOMPARE(collection.findById(1).myStringProperty().value(), "one");
+}
+
+void ModelTest::collection_not_movable() {
+    // Selection, ReplicationSource and the like keep a reference to the
+    // collection, which a move would leave dangling
+    using Models = Collection<int, MyModel>;
+    QVERIFY(!is_move_constructible_v<Models>);
+    QVERIFY(!is_move_assignable_v<Models>);
+}
+
 QTEST_APPLESS_MAIN(ModelTest);
 
 #include "tst_modeltest.moc"
@@ -0,0 +1,142 @@
+#include <QtTest>
+
+#include "query.h"
+
+using namespace Base::Model;
+using namespace Base::Query;
+
+class QueryTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void where_single_comparison();
+    void where_combined_predicates();
+    void empty_properties_never_match();
+    void order_by_and_limit();
+    void order_by_descending_empty_last();
+    void select_rows();
+    void limit_without_order();
+    void collection_sort();
+};
+
+enum class Status { Available, Responding, Unavailable };
+
+class Unit {
+    PROPERTY(string, name)
+    PROPERTY(Status, status)
+    PROPERTY(int, eta)
+
+  private:
+    int _id;
+
+  public:
+    explicit Unit(const int id) : _id(id) {}
+    Unit(const int id, const string& name, Status status, int eta) : _id(id) {
+        _name = name;
+        _status = status;
+        _eta = eta;
+    }
+    int id() const { return _id; }
+};
+
+static const auto name = FIELD(Unit, name);
+static const auto status = FIELD(Unit, status);
+static const auto eta = FIELD(Unit, eta);
+
+class Fixture {
+  public:
+    Collection<int, Unit> units;
+
+    Fixture() : units(&Unit::id) {
+        units.add(new Unit(1, "A", Status::Responding, 12));
+        units.add(new Unit(2, "B", Status::Responding, 4));
+        units.add(new Unit(3, "C", Status::Available, 2));
+        units.add(new Unit(4, "D", Status::Responding, 8));
+        units.add(new Unit(5));
+        units.findById(5).status() = Status::Responding;
+    }
+};
+
+static vector<int> toVector(const SortView<int>& view) {
+    vector<int> ids;
+    for (size_t i = 0; i < view.size(); ++i) {
+        ids.push_back(view.at(i));
+    }
+    return ids;
+}
+
+void QueryTest::where_single_comparison() {
+    Fixture f;
+    auto ids = where(status == Status::Responding).ids(f.units);
+    QVERIFY(toVector(ids) == vector<int>({1, 2, 4, 5}));
+}
+
+void QueryTest::where_combined_predicates() {
+    Fixture f;
+    QVERIFY(toVector(where(status == Status::Responding && eta < 10)
+                         .ids(f.units)) == vector<int>({2, 4}));
+    QVERIFY(toVector(where(eta >= 12 || status == Status::Available)
+                         .ids(f.units)) == vector<int>({1, 3}));
+    QVERIFY(toVector(where(!hasValue(eta)).ids(f.units)) == vector<int>({5}));
+    QVERIFY(toVector(where(name != "A" && eta <= 4).ids(f.units)) ==
+            vector<int>({2, 3}));
+}
+
+void QueryTest::empty_properties_never_match() {
+    Fixture f;
+    QVERIFY(toVector(where(eta < 100).ids(f.units)) ==
+            vector<int>({1, 2, 3, 4}));
+    QVERIFY(toVector(where(eta != 12).ids(f.units)) == vector<int>({2, 3, 4}));
+}
+
+void QueryTest::order_by_and_limit() {
+    Fixture f;
+    auto ids = where(status == Status::Responding)
+                   .orderBy(eta)
+                   .limit(2)
+                   .ids(f.units);
+    QVERIFY(toVector(ids) == vector<int>({2, 4}));
+    QVERIFY(toVector(all().orderBy(eta).ids(f.units)) ==
+            vector<int>({3, 2, 4, 1, 5}));
+}
+
+void QueryTest::order_by_descending_empty_last() {
+    Fixture f;
+    QVERIFY(toVector(all().orderByDescending(eta).ids(f.units)) ==
+            vector<int>({1, 4, 2, 3, 5}));
+    QVERIFY(toVector(all().orderByDescending(eta).limit(4).ids(f.units)) ==
+            vector<int>({1, 4, 2, 3}));
+}
+
+void QueryTest::select_rows() {
+    Fixture f;
+    auto rows = where(status == Status::Responding)
+                    .select(name, eta)
+                    .orderBy(eta)
+                    .limit(20)
+                    .rows(f.units);
+    QCOMPARE(rows.size(), size_t(4));
+    QCOMPARE(get<0>(rows[0]), 2);
+    QVERIFY(get<1>(rows[0]) == string("B"));
+    QVERIFY(get<2>(rows[0]) == 4);
+    QCOMPARE(get<0>(rows[3]), 5);
+    QVERIFY(!get<1>(rows[3]).has_value());
+    QVERIFY(!get<2>(rows[3]).has_value());
+}
+
+void QueryTest::limit_without_order() {
+    Fixture f;
+    QVERIFY(toVector(all().limit(2).ids(f.units)) == vector<int>({1, 2}));
+    QCOMPARE(all().limit(0).ids(f.units).size(), size_t(0));
+}
+
+void QueryTest::collection_sort() {
+    Fixture f;
+    auto view = f.units.sort([](const Unit& u1, const Unit& u2) {
+        return u1.name() < u2.name();
+    });
+    QVERIFY(toVector(view) == vector<int>({5, 1, 2, 3, 4}));
+}
+
+QTEST_APPLESS_MAIN(QueryTest)
+
+#include "tst_querytest.moc"
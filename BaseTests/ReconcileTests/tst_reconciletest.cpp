@@ -0,0 +1,128 @@
+#include <QtTest>
+
+#include "reconcile.h"
+
+using namespace Base::Event;
+using namespace Base::Model;
+
+class ReconcileTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void reconcile_empty_collection();
+    void reconcile_minimal_events();
+    void reconcile_keeps_properties_outside_schema();
+    void reconcile_duplicate_ids();
+};
+
+class Person {
+    PROPERTY(string, name)
+    PROPERTY(int, station)
+    PROPERTY(bool, available)
+
+  private:
+    int _id;
+
+  public:
+    explicit Person(const int id) : _id(id) {}
+    Person(const int id, const string& name, const int station) : _id(id) {
+        _name = name;
+        _station = station;
+    }
+    int id() const { return _id; }
+};
+
+static const auto rosterSchema =
+    makeSchema(FIELD(Person, name), FIELD(Person, station));
+
+static vector<unique_ptr<Person>> roster(vector<Person*> people) {
+    vector<unique_ptr<Person>> result;
+    for (auto person : people) {
+        result.emplace_back(person);
+    }
+    return result;
+}
+
+void ReconcileTest::reconcile_empty_collection() {
+    Collection<int, Person> collection(&Person::id);
+    auto incoming =
+        roster({new Person(1, "Anna", 10), new Person(2, "Bertil", 10)});
+    auto result = reconcile(collection, incoming, rosterSchema);
+    QCOMPARE(result.added, size_t(2));
+    QCOMPARE(collection.size(), size_t(2));
+    QCOMPARE(collection.findById(2).name().value(), string("Bertil"));
+}
+
+void ReconcileTest::reconcile_minimal_events() {
+    Collection<int, Person> collection(&Person::id);
+    collection.add(new Person(1, "Anna", 10));
+    collection.add(new Person(2, "Bertil", 10));
+    collection.add(new Person(3, "Cecilia", 20));
+
+    int batches = 0, removals = 0, valueChanges = 0, clears = 0;
+    {
+        // The handlers must not outlive the items they are connected to
+        SingleEventHandler<Collection<int, Person>&, const vector<int>&>
+            addHandler(
+                [&batches](Collection<int, Person>&, const vector<int>&) {
+                    batches++;
+                });
+        addHandler.connect(collection.itemsAddedEvent());
+        SingleEventHandler<Collection<int, Person>&, int> removeHandler(
+            [&removals](Collection<int, Person>&, int) { removals++; });
+        removeHandler.connect(collection.itemRemovedEvent());
+        SingleEventHandler<Property<int>&, int> stationHandler(
+            [&valueChanges](Property<int>&, int) { valueChanges++; });
+        stationHandler.connect(
+            collection.findById(2).station().valueChangedEvent());
+        SingleEventHandler<Property<string>&> nameHandler(
+            [&clears](Property<string>&) { clears++; });
+        nameHandler.connect(collection.findById(3).name().clearedEvent());
+
+        auto incoming = roster({new Person(1, "Anna", 10),
+                                new Person(2, "Bertil", 30), new Person(3),
+                                new Person(4, "David", 10)});
+        incoming[2]->station() = 20;
+        auto result = reconcile(collection, incoming, rosterSchema);
+
+        QCOMPARE(result.added, size_t(1));
+        QCOMPARE(result.removed, size_t(0));
+        QCOMPARE(result.changedItems, size_t(2));
+        QCOMPARE(result.changedProperties, size_t(2));
+        QCOMPARE(result.unchangedItems, size_t(1));
+        QCOMPARE(batches, 1);
+        QCOMPARE(removals, 0);
+        QCOMPARE(valueChanges, 1);
+        QCOMPARE(clears, 1);
+        QCOMPARE(collection.findById(2).station().value(), 30);
+        QVERIFY(collection.findById(3).name().isEmpty());
+        QVERIFY(collection.contains(4));
+    }
+
+    auto smaller = roster({new Person(1, "Anna", 10)});
+    auto result = reconcile(collection, smaller, rosterSchema);
+    QCOMPARE(result.removed, size_t(3));
+    QVERIFY(collection.ids() == set<int>({1}));
+}
+
+void ReconcileTest::reconcile_keeps_properties_outside_schema() {
+    Collection<int, Person> collection(&Person::id);
+    collection.add(new Person(1, "Anna", 10));
+    collection.findById(1).available() = true;
+    auto incoming = roster({new Person(1, "Anna B", 10)});
+    reconcile(collection, incoming, rosterSchema);
+    QCOMPARE(collection.findById(1).name().value(), string("Anna B"));
+    QVERIFY(collection.findById(1).available() == true);
+}
+
+void ReconcileTest::reconcile_duplicate_ids() {
+    Collection<int, Person> collection(&Person::id);
+    auto incoming =
+        roster({new Person(1, "Anna", 10), new Person(1, "Other", 20)});
+    auto result = reconcile(collection, incoming, rosterSchema);
+    QCOMPARE(result.added, size_t(1));
+    QCOMPARE(collection.findById(1).name().value(), string("Anna"));
+}
+
+QTEST_APPLESS_MAIN(ReconcileTest)
+
+#include "tst_reconciletest.moc"
@@ -0,0 +1,289 @@
+#include <QtTest>
+
+#include "replication.h"
+
+using namespace Base::Event;
+using namespace Base::Model;
+using namespace Base::Replication;
+
+class ReplicationTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void codec_round_trip();
+    void codec_truncated_input();
+    void snapshot_creates_replica();
+    void deltas_are_applied();
+    void frames_split_across_feeds();
+    void sink_ignores_deltas_before_snapshot();
+    void sequence_gap_falls_out_of_sync();
+    void heartbeat_measures_lag();
+    void private_snapshot_for_new_standby();
+    void snapshot_of_evicted_collection();
+};
+
+class Unit {
+    PROPERTY(string, name)
+    PROPERTY(int, eta)
+
+  private:
+    int _id;
+
+  public:
+    explicit Unit(const int id) : _id(id) {}
+    int id() const { return _id; }
+};
+
+static const auto unitSchema =
+    makeSchema(FIELD(Unit, name), FIELD(Unit, eta));
+
+class Link {
+  public:
+    DeltaLog log;
+    ReplicationSink sink;
+    vector<uint8_t> sent;
+    SingleEventHandler<DeltaLog&, const vector<uint8_t>&> forwarder;
+
+    Link()
+        : forwarder([this](DeltaLog&, const vector<uint8_t>& frame) {
+              sent.insert(sent.end(), frame.begin(), frame.end());
+          }) {
+        forwarder.connect(log.recordAppendedEvent());
+    }
+
+    void flush() {
+        sink.feed(sent.data(), sent.size());
+        sent.clear();
+    }
+};
+
+void ReplicationTest::codec_round_trip() {
+    vector<uint8_t> buffer;
+    Base::Serialization::Writer writer(buffer);
+    writer.write(-1234567);
+    writer.write(uint64_t(1) << 60);
+    writer.write(string("hello"));
+    writer.write(3.5);
+    writer.write(true);
+    Base::Serialization::Reader reader(buffer.data(), buffer.size());
+    QCOMPARE(reader.read<int>(), -1234567);
+    QCOMPARE(reader.read<uint64_t>(), uint64_t(1) << 60);
+    QCOMPARE(reader.read<string>(), string("hello"));
+    QCOMPARE(reader.read<double>(), 3.5);
+    QCOMPARE(reader.read<bool>(), true);
+    QVERIFY(reader.atEnd());
+}
+
+void ReplicationTest::codec_truncated_input() {
+    vector<uint8_t> buffer;
+    Base::Serialization::Writer writer(buffer);
+    writer.write(string("hello"));
+    Base::Serialization::Reader reader(buffer.data(), buffer.size() - 1);
+    QVERIFY_EXCEPTION_THROWN(reader.read<string>(),
+                             Base::Serialization::DecodeError);
+}
+
+void ReplicationTest::snapshot_creates_replica() {
+    Collection<int, Unit> primary(&Unit::id), standby(&Unit::id);
+    auto unit = new Unit(1);
+    unit->name() = "Engine 1";
+    unit->eta() = 5;
+    primary.add(unit);
+    primary.add(new Unit(2));
+
+    Link link;
+    auto source = makeReplicationSource(link.log, 1, primary, unitSchema);
+    auto applier = makeReplicaApplier(standby, unitSchema);
+    link.sink.registerChannel(1, *applier);
+    link.log.snapshot();
+    link.flush();
+
+    QVERIFY(link.sink.isInSync());
+    QCOMPARE(standby.size(), size_t(2));
+    QCOMPARE(standby.findById(1).name().value(), string("Engine 1"));
+    QCOMPARE(standby.findById(1).eta().value(), 5);
+    QVERIFY(standby.findById(2).eta().isEmpty());
+}
+
+void ReplicationTest::deltas_are_applied() {
+    Collection<int, Unit> primary(&Unit::id), standby(&Unit::id);
+    Link link;
+    auto source = makeReplicationSource(link.log, 1, primary, unitSchema);
+    auto applier = makeReplicaApplier(standby, unitSchema);
+    link.sink.registerChannel(1, *applier);
+    link.log.snapshot();
+
+    primary.add(new Unit(1));
+    primary.add(new Unit(2));
+    primary.findById(1).eta() = 7;
+    primary.findById(2).name() = "Ladder 2";
+    primary.findById(2).name().clear();
+    primary.removeById(1);
+    link.flush();
+
+    QVERIFY(link.sink.isInSync());
+    QCOMPARE(link.sink.stats().sequence, link.log.sequence());
+    QCOMPARE(standby.size(), size_t(1));
+    QVERIFY(standby.contains(2));
+    QVERIFY(standby.findById(2).name().isEmpty());
+}
+
+void ReplicationTest::frames_split_across_feeds() {
+    Collection<int, Unit> primary(&Unit::id), standby(&Unit::id);
+    Link link;
+    auto source = makeReplicationSource(link.log, 1, primary, unitSchema);
+    auto applier = makeReplicaApplier(standby, unitSchema);
+    link.sink.registerChannel(1, *applier);
+    link.log.snapshot();
+    primary.add(new Unit(1));
+    primary.findById(1).eta() = 3;
+
+    for (auto byte : link.sent) {
+        link.sink.feed(&byte, 1);
+    }
+    QVERIFY(link.sink.isInSync());
+    QCOMPARE(standby.findById(1).eta().value(), 3);
+}
+
+void ReplicationTest::sink_ignores_deltas_before_snapshot() {
+    Collection<int, Unit> primary(&Unit::id), standby(&Unit::id);
+    Link link;
+    auto source = makeReplicationSource(link.log, 1, primary, unitSchema);
+    auto applier = makeReplicaApplier(standby, unitSchema);
+    link.sink.registerChannel(1, *applier);
+    primary.add(new Unit(1));
+    link.flush();
+    QVERIFY(!link.sink.isInSync());
+    QVERIFY(standby.isEmpty());
+
+    link.log.snapshot();
+    link.flush();
+    QVERIFY(link.sink.isInSync());
+    QVERIFY(standby.contains(1));
+}
+
+void ReplicationTest::sequence_gap_falls_out_of_sync() {
+    Collection<int, Unit> primary(&Unit::id), standby(&Unit::id);
+    Link link;
+    auto source = makeReplicationSource(link.log, 1, primary, unitSchema);
+    auto applier = makeReplicaApplier(standby, unitSchema);
+    link.sink.registerChannel(1, *applier);
+    int outOfSyncCount = 0;
+    SingleEventHandler<ReplicationSink&> handler(
+        [&outOfSyncCount](ReplicationSink&) { outOfSyncCount++; });
+    handler.connect(link.sink.outOfSyncEvent());
+    link.log.snapshot();
+    primary.add(new Unit(1));
+    link.flush();
+
+    primary.add(new Unit(2));
+    link.sent.clear();
+    primary.add(new Unit(3));
+    link.flush();
+    QVERIFY(!link.sink.isInSync());
+    QCOMPARE(outOfSyncCount, 1);
+    QCOMPARE(link.sink.stats().resyncs, uint64_t(1));
+    QVERIFY(standby.contains(1));
+    QVERIFY(!standby.contains(3));
+}
+
+void ReplicationTest::heartbeat_measures_lag() {
+    Link link;
+    link.log.snapshot();
+    link.log.heartbeat();
+    link.flush();
+    QCOMPARE(link.sink.stats().records, uint64_t(2));
+    QVERIFY(link.sink.stats().lastLag >= 0);
+    QVERIFY(link.sink.stats().maxLag >= link.sink.stats().lastLag);
+}
+
+void ReplicationTest::private_snapshot_for_new_standby() {
+    Collection<int, Unit> primary(&Unit::id), first(&Unit::id),
+        second(&Unit::id);
+    Link link;
+    auto source = makeReplicationSource(link.log, 1, primary, unitSchema);
+    auto firstApplier = makeReplicaApplier(first, unitSchema);
+    link.sink.registerChannel(1, *firstApplier);
+    link.log.snapshot();
+    primary.add(new Unit(1));
+    primary.add(new Unit(2));
+    link.flush();
+    int cleared = 0;
+    SingleEventHandler<Collection<int, Unit>&> clearedHandler(
+        [&cleared](Collection<int, Unit>&) { cleared++; });
+    clearedHandler.connect(first.clearedEvent());
+
+    // The new standby gets a snapshot of its own, the first one nothing
+    auto frames = link.log.snapshotFrames();
+    QVERIFY(link.sent.empty());
+    ReplicationSink sink;
+    auto secondApplier = makeReplicaApplier(second, unitSchema);
+    sink.registerChannel(1, *secondApplier);
+    sink.feed(frames.data(), frames.size());
+    QVERIFY(sink.isInSync());
+    QCOMPARE(sink.stats().sequence, link.log.sequence());
+    QCOMPARE(second.size(), size_t(2));
+
+    // Both follow the live records that come next
+    primary.findById(2).eta() = 9;
+    sink.feed(link.sent.data(), link.sent.size());
+    link.flush();
+    QVERIFY(link.sink.isInSync());
+    QVERIFY(sink.isInSync());
+    QCOMPARE(first.findById(2).eta().value(), 9);
+    QCOMPARE(second.findById(2).eta().value(), 9);
+    QCOMPARE(cleared, 0);
+}
+
+void ReplicationTest::snapshot_of_evicted_collection() {
+    Collection<int, Unit> primary(&Unit::id), first(&Unit::id),
+        second(&Unit::id);
+    Link link;
+    auto source = makeReplicationSource(link.log, 1, primary, unitSchema);
+    auto firstApplier = makeReplicaApplier(first, unitSchema);
+    link.sink.registerChannel(1, *firstApplier);
+    link.log.snapshot();
+    primary.add(new Unit(1));
+    primary.add(new Unit(2));
+    primary.findById(1).name() = "Engine 1";
+    link.flush();
+    auto reload = [&primary] {
+        auto unit = new Unit(1);
+        unit->name() = "Engine 1";
+        primary.restore({unit, new Unit(2)});
+    };
+    primary.evict(reload);
+    QVERIFY(link.sent.empty());
+
+    // A standby that starts while the items are in the archive has none
+    auto frames = link.log.snapshotFrames();
+    ReplicationSink sink;
+    auto secondApplier = makeReplicaApplier(second, unitSchema);
+    sink.registerChannel(1, *secondApplier);
+    sink.feed(frames.data(), frames.size());
+    QVERIFY(sink.isInSync());
+    QVERIFY(second.isEmpty());
+    QCOMPARE(first.size(), size_t(2));
+
+    // Using the collection restores it and sends the items again
+    primary.findById(1).eta() = 4;
+    QVERIFY(!primary.isEvicted());
+    sink.feed(link.sent.data(), link.sent.size());
+    link.flush();
+    QVERIFY(link.sink.isInSync());
+    QVERIFY(sink.isInSync());
+    for (auto standby : {&first, &second}) {
+        QCOMPARE(standby->size(), size_t(2));
+        QCOMPARE(standby->findById(1).name().value(), string("Engine 1"));
+        QCOMPARE(standby->findById(1).eta().value(), 4);
+    }
+
+    // Only once; later restores are not replicated
+    auto sequence = link.log.sequence();
+    primary.evict(reload);
+    QCOMPARE(primary.size(), size_t(2));
+    QCOMPARE(link.log.sequence(), sequence);
+}
+
+QTEST_APPLESS_MAIN(ReplicationTest)
+
+#include "tst_replicationtest.moc"
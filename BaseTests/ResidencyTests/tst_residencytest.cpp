@@ -0,0 +1,306 @@
+#include <QtTest>
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "residency.h"
+#include "sharedsnapshot.h"
+
+using namespace Base::Model;
+
+namespace {
+
+using Clock = ResidencyManager::Clock;
+
+class Unit {
+    PROPERTY(string, name)
+    PROPERTY(int, eta)
+
+  private:
+    int _id;
+
+  public:
+    explicit Unit(const int id) : _id(id) {}
+    int id() const { return _id; }
+};
+
+const auto unitSchema = makeSchema(FIELD(Unit, name), FIELD(Unit, eta));
+
+using Units = Collection<int, Unit>;
+
+// An archive in memory that can be made to fail
+class MemoryArchive : public Archive {
+  public:
+    bool store(const string& key, const vector<uint8_t>& data) override {
+        if (failing) {
+            return false;
+        }
+        records[key] = data;
+        return true;
+    }
+
+    bool load(const string& key, vector<uint8_t>& data) override {
+        auto record = records.find(key);
+        if (failing || record == records.end()) {
+            return false;
+        }
+        data = record->second;
+        return true;
+    }
+
+    void remove(const string& key) override { records.erase(key); }
+
+    map<string, vector<uint8_t>> records;
+    bool failing = false;
+};
+
+// The collections of an incident
+struct Incident {
+    Incident(int units)
+        : units([](const Unit& unit) { return unit.id(); }) {
+        for (int i = 0; i < units; ++i) {
+            auto unit = new Unit(i);
+            unit->name() = "Unit " + to_string(i) + string(100, 'x');
+            if (i % 2 == 0) {
+                unit->eta() = i * 60;
+            }
+            this->units.add(unit);
+        }
+    }
+
+    Units units;
+};
+
+size_t bytesOf(const Incident& incident) {
+    return Base::Diagnostics::memoryUsage(incident.units, unitSchema).total();
+}
+
+} // namespace
+
+class ResidencyTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void evicts_least_recently_used();
+    void open_units_stay();
+    void access_reloads();
+    void evicts_by_age();
+    void failed_store_keeps_unit();
+    void file_archive();
+    void use_reloads();
+    void eviction_is_not_replicated();
+    void eviction_is_not_published();
+};
+
+void ResidencyTest::evicts_least_recently_used() {
+    MemoryArchive archive;
+    Incident first(50), second(50), third(50);
+    ResidencyManager manager(archive, bytesOf(first) * 2,
+                             chrono::seconds(60));
+    Clock::time_point start;
+    manager.add("first", residentCollection(first.units, unitSchema), start);
+    manager.add("second", residentCollection(second.units, unitSchema),
+                start);
+    manager.add("third", residentCollection(third.units, unitSchema), start);
+    manager.setClosed("first");
+    manager.setClosed("second");
+    manager.setClosed("third");
+    manager.access("first", start + chrono::seconds(30));
+
+    // Not idle long enough yet
+    QCOMPARE(manager.enforce(start + chrono::seconds(59)), size_t(0));
+    QCOMPARE(manager.enforce(start + chrono::seconds(90)), size_t(1));
+    QVERIFY(manager.isResident("first"));
+    QVERIFY(!manager.isResident("second") || !manager.isResident("third"));
+    QCOMPARE(manager.residentCount(), size_t(2));
+    QCOMPARE(manager.stats().evictions, uint64_t(1));
+    QVERIFY(manager.stats().residentBytes <= manager.budget());
+    QCOMPARE(archive.records.size(), size_t(1));
+}
+
+void ResidencyTest::open_units_stay() {
+    MemoryArchive archive;
+    Incident incident(50);
+    ResidencyManager manager(archive, 0, chrono::seconds(0));
+    manager.add("open", residentCollection(incident.units, unitSchema));
+    QCOMPARE(manager.enforce(), size_t(0));
+    QVERIFY(manager.isResident("open"));
+    QCOMPARE(incident.units.size(), size_t(50));
+    QVERIFY(manager.stats().residentBytes > 0);
+}
+
+void ResidencyTest::access_reloads() {
+    MemoryArchive archive;
+    Incident incident(20);
+    Units others([](const Unit& unit) { return unit.id(); });
+    others.add(new Unit(7));
+    ResidencyManager manager(archive, 0, chrono::seconds(0));
+    manager.add("incident", residentCollection(incident.units, unitSchema));
+    manager.add("incident", residentCollection(others, unitSchema));
+    manager.setClosed("incident");
+    QCOMPARE(manager.enforce(), size_t(1));
+    QVERIFY(incident.units.isEvicted());
+    QVERIFY(others.isEvicted());
+
+    QVERIFY(manager.access("incident"));
+    QCOMPARE(incident.units.size(), size_t(20));
+    QCOMPARE(incident.units.findById(3).name().value(),
+             "Unit 3" + string(100, 'x'));
+    QCOMPARE(incident.units.findById(4).eta().value(), 240);
+    QVERIFY(incident.units.findById(3).eta().isEmpty());
+    QCOMPARE(others.size(), size_t(1));
+    QVERIFY(others.contains(7));
+    QCOMPARE(manager.stats().reloads, uint64_t(1));
+    QVERIFY(!manager.access("unknown"));
+
+    manager.remove("incident");
+    QVERIFY(archive.records.empty());
+    QCOMPARE(manager.unitCount(), size_t(0));
+}
+
+void ResidencyTest::evicts_by_age() {
+    MemoryArchive archive;
+    Incident old(10), recent(10);
+    auto budget = (bytesOf(old) + bytesOf(recent)) * 10;
+    ResidencyManager manager(archive, budget, chrono::seconds(60),
+                             chrono::hours(1));
+    Clock::time_point start;
+    manager.add("old", residentCollection(old.units, unitSchema), start);
+    manager.add("recent", residentCollection(recent.units, unitSchema),
+                start + chrono::minutes(50));
+    manager.setClosed("old");
+    manager.setClosed("recent");
+    // Under the budget, only what has not been used for an hour goes
+    QCOMPARE(manager.enforce(start + chrono::minutes(61)), size_t(1));
+    QVERIFY(!manager.isResident("old"));
+    QVERIFY(manager.isResident("recent"));
+}
+
+void ResidencyTest::failed_store_keeps_unit() {
+    MemoryArchive archive;
+    archive.failing = true;
+    Incident incident(10);
+    ResidencyManager manager(archive, 0, chrono::seconds(0));
+    manager.add("incident", residentCollection(incident.units, unitSchema));
+    manager.setClosed("incident");
+    QCOMPARE(manager.enforce(), size_t(0));
+    QVERIFY(manager.isResident("incident"));
+    QCOMPARE(incident.units.size(), size_t(10));
+    QCOMPARE(manager.stats().failures, uint64_t(1));
+
+    archive.failing = false;
+    QCOMPARE(manager.enforce(), size_t(1));
+    archive.failing = true;
+    QVERIFY(!manager.access("incident"));
+    QVERIFY(incident.units.isEmpty());
+    archive.failing = false;
+    QVERIFY(manager.access("incident"));
+    QCOMPARE(incident.units.size(), size_t(10));
+}
+
+void ResidencyTest::file_archive() {
+    auto directory = filesystem::temp_directory_path() / "residencytest";
+    filesystem::remove_all(directory);
+    FileArchive archive(directory.string());
+    vector<uint8_t> data{1, 2, 3, 0, 255};
+    QVERIFY(archive.store("2026/10-18 fire", data));
+    QVERIFY(archive.store("2026/10-18 fire", data));
+    vector<uint8_t> loaded;
+    QVERIFY(archive.load("2026/10-18 fire", loaded));
+    QCOMPARE(loaded, data);
+    QVERIFY(!archive.load("other", loaded));
+    archive.remove("2026/10-18 fire");
+    QVERIFY(!archive.load("2026/10-18 fire", loaded));
+    // Only the escaped file name was used, in the directory itself
+    QVERIFY(filesystem::is_empty(directory));
+    filesystem::remove_all(directory);
+}
+
+void ResidencyTest::use_reloads() {
+    MemoryArchive archive;
+    Incident incident(10);
+    ResidencyManager manager(archive, 0, chrono::seconds(0));
+    manager.add("incident", residentCollection(incident.units, unitSchema));
+    manager.setClosed("incident");
+    QCOMPARE(manager.enforce(), size_t(1));
+    QVERIFY(incident.units.isEvicted());
+
+    // A change made without access() is not lost
+    incident.units.findById(3).eta() = 42;
+    QVERIFY(manager.isResident("incident"));
+    QCOMPARE(manager.stats().reloads, uint64_t(1));
+    QCOMPARE(manager.enforce(), size_t(1));
+    incident.units.add(new Unit(10));
+    QCOMPARE(incident.units.size(), size_t(11));
+    QCOMPARE(incident.units.findById(3).eta().value(), 42);
+    QCOMPARE(manager.stats().reloads, uint64_t(2));
+}
+
+void ResidencyTest::eviction_is_not_replicated() {
+    MemoryArchive archive;
+    Incident incident(10);
+    Base::Replication::DeltaLog log;
+    auto source = Base::Replication::makeReplicationSource(
+        log, 1, incident.units, unitSchema);
+    ResidencyManager manager(archive, 0, chrono::seconds(0));
+    manager.add("incident", residentCollection(incident.units, unitSchema));
+    manager.setClosed("incident");
+
+    int cleared = 0;
+    Base::Event::SingleEventHandler<Units&> clearedHandler(
+        [&cleared](Units&) { cleared++; });
+    clearedHandler.connect(incident.units.clearedEvent());
+    auto sequence = log.sequence();
+    QCOMPARE(manager.enforce(), size_t(1));
+    QCOMPARE(cleared, 1);
+    QVERIFY(manager.access("incident"));
+    QCOMPARE(log.sequence(), sequence);
+
+    // Changes after the reload are replicated again
+    incident.units.findById(1).eta() = 5;
+    QCOMPARE(log.sequence(), sequence + 1);
+
+    // A snapshot leaves the archived items out, so they are sent on reload
+    QCOMPARE(manager.enforce(), size_t(1));
+    QVERIFY(log.snapshotFrames().size() < 32);
+    QVERIFY(manager.access("incident"));
+    QCOMPARE(log.sequence(), sequence + 11);
+}
+
+void ResidencyTest::eviction_is_not_published() {
+    MemoryArchive archive;
+    Incident incident(10);
+    auto name = "/basetests-residency-" + to_string(getpid());
+    Base::SharedMemory::SnapshotPublisher publisher;
+    QVERIFY(publisher.create(name, 1 << 16));
+    auto source = Base::SharedMemory::makeCollectionPublisher(
+        publisher, incident.units, unitSchema);
+    QVERIFY(source->flush());
+    ResidencyManager manager(archive, 0, chrono::seconds(0));
+    manager.add("incident", residentCollection(incident.units, unitSchema));
+    manager.setClosed("incident");
+    QCOMPARE(manager.enforce(), size_t(1));
+
+    // Neither the publisher nor the inspector reloads the items
+    QVERIFY(!source->isDirty());
+    QVERIFY(source->flush());
+    QVERIFY(Base::Diagnostics::memoryUsage(incident.units, unitSchema)
+                .total() < bytesOf(Incident(10)));
+    QVERIFY(incident.units.isEvicted());
+    QCOMPARE(manager.stats().reloads, uint64_t(0));
+    QCOMPARE(publisher.published(), uint64_t(1));
+
+    // Restoring publishes nothing new, but changes after it do
+    QVERIFY(manager.access("incident"));
+    QVERIFY(!source->isDirty());
+    incident.units.findById(1).eta() = 5;
+    QVERIFY(source->flush());
+    QCOMPARE(publisher.published(), uint64_t(2));
+}
+
+QTEST_APPLESS_MAIN(ResidencyTest)
+
+#include "tst_residencytest.moc"
@@ -0,0 +1,136 @@
+#include <QtTest>
+
+#include "selection.h"
+
+using namespace Base::Model;
+
+class SelectionTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void select_initial_items();
+    void select_is_cached();
+    void item_added();
+    void item_removed();
+    void watched_property_changed();
+    void watched_property_cleared();
+    void collection_cleared();
+    void invalidate();
+    void existing_items_are_watched();
+};
+
+class Responder {
+    PROPERTY(bool, available)
+    PROPERTY(int, station)
+
+  private:
+    int _id;
+
+  public:
+    Responder(const int id, const bool available, const int station)
+        : _id(id) {
+        _available = available;
+        _station = station;
+    }
+    int id() const { return _id; }
+};
+
+static bool availableAtStation(const int& station, const Responder& r) {
+    return r.available() == true && r.station() == station;
+}
+
+class Fixture {
+  public:
+    Collection<int, Responder> collection;
+    Selection<int, Responder, int> selection;
+
+    Fixture()
+        : collection(&Responder::id),
+          selection(collection, availableAtStation) {
+        selection.watch(FIELD(Responder, available));
+        selection.watch(FIELD(Responder, station));
+        collection.add(new Responder(1, true, 10));
+        collection.add(new Responder(2, false, 10));
+        collection.add(new Responder(3, true, 20));
+        collection.add(new Responder(4, true, 10));
+    }
+};
+
+void SelectionTest::select_initial_items() {
+    Fixture f;
+    QVERIFY(f.selection.select(10) == vector<int>({1, 4}));
+    QVERIFY(f.selection.select(20) == vector<int>({3}));
+    QVERIFY(f.selection.select(30).empty());
+}
+
+void SelectionTest::select_is_cached() {
+    Fixture f;
+    QVERIFY(!f.selection.isCached(10));
+    f.selection.warm(10);
+    QVERIFY(f.selection.isCached(10));
+    QVERIFY(&f.selection.select(10) == &f.selection.select(10));
+}
+
+void SelectionTest::item_added() {
+    Fixture f;
+    f.selection.warm(10);
+    f.collection.add(new Responder(0, true, 10));
+    f.collection.add(new Responder(5, false, 10));
+    QVERIFY(f.selection.select(10) == vector<int>({0, 1, 4}));
+}
+
+void SelectionTest::item_removed() {
+    Fixture f;
+    f.selection.warm(10);
+    f.collection.removeById(1);
+    QVERIFY(f.selection.select(10) == vector<int>({4}));
+}
+
+void SelectionTest::watched_property_changed() {
+    Fixture f;
+    f.selection.warm(10);
+    f.selection.warm(20);
+    f.collection.findById(2).available() = true;
+    f.collection.findById(4).station() = 20;
+    QVERIFY(f.selection.select(10) == vector<int>({1, 2}));
+    QVERIFY(f.selection.select(20) == vector<int>({3, 4}));
+}
+
+void SelectionTest::watched_property_cleared() {
+    Fixture f;
+    f.selection.warm(10);
+    f.collection.findById(1).available().clear();
+    QVERIFY(f.selection.select(10) == vector<int>({4}));
+}
+
+void SelectionTest::collection_cleared() {
+    Fixture f;
+    f.selection.warm(10);
+    f.collection.clear();
+    QVERIFY(f.selection.isCached(10));
+    QVERIFY(f.selection.select(10).empty());
+    f.collection.add(new Responder(7, true, 10));
+    QVERIFY(f.selection.select(10) == vector<int>({7}));
+}
+
+void SelectionTest::invalidate() {
+    Fixture f;
+    f.selection.warm(10);
+    f.selection.invalidate(10);
+    QVERIFY(!f.selection.isCached(10));
+    QVERIFY(f.selection.select(10) == vector<int>({1, 4}));
+}
+
+void SelectionTest::existing_items_are_watched() {
+    Collection<int, Responder> collection(&Responder::id);
+    collection.add(new Responder(1, true, 10));
+    collection.add(new Responder(2, false, 10));
+    Selection<int, Responder, int> selection(collection, availableAtStation);
+    selection.watch(FIELD(Responder, available));
+    QVERIFY(selection.select(10) == vector<int>({1}));
+    collection.findById(2).available() = true;
+    QVERIFY(selection.select(10) == vector<int>({1, 2}));
+}
+
+QTEST_APPLESS_MAIN(SelectionTest)
+
+#include "tst_selectiontest.moc"
@@ -0,0 +1,190 @@
+#include <QtTest>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "sharedsnapshot.h"
+
+using namespace Base::Model;
+using namespace Base::SharedMemory;
+
+class SharedSnapshotTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void publish_and_read();
+    void snapshot_too_large();
+    void reader_sees_replaced_region();
+    void concurrent_reads_are_consistent();
+    void collection_snapshot();
+};
+
+class Unit {
+    PROPERTY(string, name)
+    PROPERTY(int, eta)
+
+  private:
+    int _id;
+
+  public:
+    explicit Unit(const int id) : _id(id) {}
+    int id() const { return _id; }
+};
+
+static const auto unitSchema =
+    makeSchema(FIELD(Unit, name), FIELD(Unit, eta));
+
+static string regionName(const char* test) {
+    return "/basetests-" + string(test) + "-" + to_string(getpid());
+}
+
+void SharedSnapshotTest::publish_and_read() {
+    auto name = regionName("publish");
+    SnapshotPublisher publisher;
+    QVERIFY(publisher.create(name, 1024));
+    SnapshotReader reader;
+    QVERIFY(reader.open(name));
+    // Nothing to read before the first snapshot
+    QVERIFY(!reader.read([](Reader&) {}));
+    QCOMPARE(reader.published(), uint64_t(0));
+
+    for (int i = 1; i <= 3; ++i) {
+        QVERIFY(publisher.publish([i](Writer& writer) {
+            writer.write(string("snapshot ") + to_string(i));
+        }));
+    }
+    string text;
+    QVERIFY(reader.read([&text](Reader& r) { text = r.read<string>(); }));
+    QCOMPARE(text, string("snapshot 3"));
+    QCOMPARE(reader.published(), uint64_t(3));
+}
+
+void SharedSnapshotTest::snapshot_too_large() {
+    auto name = regionName("large");
+    SnapshotPublisher publisher;
+    QVERIFY(publisher.create(name, 16));
+    vector<uint8_t> bytes(17, 1);
+    QVERIFY(!publisher.publish(bytes.data(), bytes.size()));
+    QVERIFY(publisher.publish(bytes.data(), 16));
+    QCOMPARE(publisher.published(), uint64_t(1));
+    QVERIFY(!SnapshotReader().open(regionName("missing")));
+}
+
+void SharedSnapshotTest::reader_sees_replaced_region() {
+    auto name = regionName("replaced");
+    SnapshotPublisher publisher;
+    QVERIFY(publisher.create(name, 64));
+    QVERIFY(publisher.publish([](Writer& writer) { writer.write(1); }));
+    SnapshotReader reader;
+    QVERIFY(reader.open(name));
+    QVERIFY(!reader.isClosed());
+
+    // A restarted publisher creates a new region under the same name
+    QVERIFY(publisher.create(name, 64));
+    QVERIFY(publisher.publish([](Writer& writer) { writer.write(2); }));
+    QVERIFY(reader.isClosed());
+    QVERIFY(!reader.read([](Reader&) {}));
+    QVERIFY(reader.open(name));
+    int value = 0;
+    QVERIFY(reader.read([&value](Reader& r) { value = r.read<int>(); }));
+    QCOMPARE(value, 2);
+    publisher.close();
+    QVERIFY(reader.isClosed());
+}
+
+void SharedSnapshotTest::concurrent_reads_are_consistent() {
+    auto name = regionName("concurrent");
+    SnapshotPublisher publisher;
+    QVERIFY(publisher.create(name, 4096));
+    QVERIFY(publisher.publish([](Writer& writer) { writer.writeVarint(0); }));
+    atomic<bool> done{false};
+    // Every snapshot holds a number n followed by n copies of it
+    thread writer([&] {
+        for (uint64_t n = 1; n <= 20000; ++n) {
+            publisher.publish([n](Writer& writer) {
+                writer.writeVarint(n % 200);
+                for (uint64_t i = 0; i < n % 200; ++i) {
+                    writer.writeFixed64(n % 200);
+                }
+            });
+        }
+        done = true;
+    });
+
+    SnapshotReader reader;
+    QVERIFY(reader.open(name));
+    int reads = 0;
+    int torn = 0;
+    while (!done || reads == 0) {
+        bool consistent = true;
+        auto ok = reader.read([&consistent](Reader& r) {
+            consistent = true;
+            auto n = r.readVarint();
+            for (uint64_t i = 0; i < n; ++i) {
+                consistent = consistent && r.readFixed64() == n;
+            }
+        });
+        if (ok) {
+            reads++;
+            torn += consistent ? 0 : 1;
+        }
+    }
+    writer.join();
+    QVERIFY(reads > 0);
+    QCOMPARE(torn, 0);
+}
+
+void SharedSnapshotTest::collection_snapshot() {
+    auto name = regionName("collection");
+    SnapshotPublisher publisher;
+    QVERIFY(publisher.create(name, 4096));
+    Collection<int, Unit> units(&Unit::id);
+    units.add(new Unit(1));
+    units.findById(1).name() = "Ambulance 1";
+    auto source = makeCollectionPublisher(publisher, units, unitSchema);
+    QVERIFY(source->isDirty());
+    QVERIFY(source->flush());
+    QVERIFY(!source->isDirty());
+    QVERIFY(source->flush());
+    QCOMPARE(publisher.published(), uint64_t(1));
+
+    // Changes only mark the publisher dirty; one flush publishes them all
+    units.add(new Unit(2));
+    units.findById(2).name() = "Fire engine 2";
+    units.findById(2).eta() = 7;
+    units.findById(1).eta() = 3;
+    QVERIFY(source->isDirty());
+    QVERIFY(source->flush());
+    QCOMPARE(publisher.published(), uint64_t(2));
+
+    SnapshotReader reader;
+    QVERIFY(reader.open(name));
+    vector<string> rows;
+    QVERIFY(reader.read([&rows](Reader& r) {
+        rows.clear();
+        readCollection<int>(r, unitSchema, [&](int id, const Unit& unit) {
+            rows.push_back(to_string(id) + " " + unit.name().value() + " " +
+                           to_string(unit.eta().value()));
+        });
+    }));
+    QCOMPARE(rows.size(), size_t(2));
+    QCOMPARE(rows[0], string("1 Ambulance 1 3"));
+    QCOMPARE(rows[1], string("2 Fire engine 2 7"));
+
+    units.removeById(1);
+    QVERIFY(source->isDirty());
+    QVERIFY(source->flush());
+    size_t count = 0;
+    QVERIFY(reader.read([&count](Reader& r) {
+        count = 0;
+        readCollection<int>(r, unitSchema,
+                            [&count](int, const Unit&) { count++; });
+    }));
+    QCOMPARE(count, size_t(1));
+}
+
+QTEST_APPLESS_MAIN(SharedSnapshotTest)
+
+#include "tst_sharedsnapshottest.moc"
@@ -0,0 +1,173 @@
+#include <QtTest>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "actor.h"
+#include "event.h"
+#include "threadpool.h"
+
+using namespace Base::Concurrency;
+using namespace Base::Event;
+
+class ThreadPoolTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void runs_higher_priority_first();
+    void nested_wait_does_not_deadlock();
+    void idle_workers_steal();
+    void executor_runs_move_only_functions();
+    void exceptions_go_to_handler();
+    void queued_event_handler();
+};
+
+void ThreadPoolTest::runs_higher_priority_first() {
+    ThreadPool pool(1);
+    atomic<bool> release{false};
+    pool.post([&release] {
+        while (!release.load()) {
+            this_thread::yield();
+        }
+    });
+    mutex orderMutex;
+    vector<int> order;
+    auto record = [&](int value) {
+        return [&, value] {
+            lock_guard<mutex> lock(orderMutex);
+            order.push_back(value);
+        };
+    };
+    pool.post(record(3), Priority::Low);
+    pool.post(record(2), Priority::Normal);
+    pool.post(record(1), Priority::High);
+    pool.post(record(4), Priority::Low);
+    release = true;
+    auto done = pool.submit([] {}, Priority::Low);
+    done.wait();
+    lock_guard<mutex> lock(orderMutex);
+    QVERIFY(order == vector<int>({1, 2, 3, 4}));
+}
+
+void ThreadPoolTest::nested_wait_does_not_deadlock() {
+    ThreadPool pool(1);
+    auto outer = pool.submit([&pool] {
+        vector<future<int>> inner;
+        for (int i = 0; i < 10; ++i) {
+            inner.push_back(pool.submit([i] { return i; }));
+        }
+        int sum = 0;
+        for (auto& future : inner) {
+            sum += pool.wait(future);
+        }
+        return sum;
+    });
+    QCOMPARE(outer.get(), 45);
+}
+
+void ThreadPoolTest::idle_workers_steal() {
+    ThreadPool pool(4);
+    atomic<int> done{0};
+    auto producer = pool.submit([&pool, &done] {
+        // Posted from a worker, so they land in its own queue
+        for (int i = 0; i < 64; ++i) {
+            pool.post([&done] {
+                this_thread::sleep_for(chrono::milliseconds(1));
+                done++;
+            });
+        }
+    });
+    producer.get();
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+    while (done.load() < 64 && chrono::steady_clock::now() < deadline) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    QCOMPARE(done.load(), 64);
+    QVERIFY(pool.steals() > 0);
+}
+
+void ThreadPoolTest::executor_runs_move_only_functions() {
+    ThreadPool pool(2);
+    auto executor = pool.executor(Priority::High);
+    QVERIFY(executor == pool.executor(Priority::High));
+    QVERIFY(executor != pool.executor());
+
+    promise<int> result;
+    auto value = make_unique<int>(42);
+    executor.execute([&result, value = move(value)] {
+        result.set_value(*value);
+    });
+    QCOMPARE(result.get_future().get(), 42);
+
+    // dispatch() runs inline on a worker
+    auto inlined = pool.submit([executor] {
+        bool ran = false;
+        executor.dispatch([&ran] { ran = true; });
+        return ran;
+    });
+    QVERIFY(inlined.get());
+}
+
+void ThreadPoolTest::exceptions_go_to_handler() {
+    ThreadPool pool(1);
+    promise<string> caught;
+    pool.setExceptionHandler([&caught](exception_ptr exception) {
+        try {
+            rethrow_exception(exception);
+        } catch (const runtime_error& e) {
+            caught.set_value(e.what());
+        }
+    });
+    pool.post([] { throw runtime_error("failed"); });
+    QCOMPARE(caught.get_future().get(), string("failed"));
+    QCOMPARE(pool.submit([] { return 1; }).get(), 1);
+}
+
+void ThreadPoolTest::queued_event_handler() {
+    ThreadPool pool(2);
+    Strand strand(pool);
+    Event<int&, const string&> event;
+    atomic<int> calls{0};
+    int sender = 0;
+    bool onStrand = true;
+    string received;
+    {
+        QueuedEventHandler<int&, const string&> handler(
+            strand, [&](int& from, const string& text) {
+                onStrand = onStrand && strand.runningInThisThread();
+                from++;
+                received = text;
+                calls++;
+            });
+        handler.connect(event);
+        for (int i = 0; i < 10; ++i) {
+            // The text is copied, the temporary is gone before the call runs
+            event.fire(sender, string("message ") + to_string(i));
+        }
+        strand.drain();
+    }
+    event.fire(sender, "after");
+    strand.drain();
+    QCOMPARE(calls.load(), 10);
+    QCOMPARE(sender, 10);
+    QCOMPARE(received, string("message 9"));
+    QVERIFY(onStrand);
+
+    QueuedEventHandler<int&, const string&> onPool(
+        pool.executor(), [&calls](int&, const string&) { calls++; });
+    onPool.connect(event);
+    event.fire(sender, "pool");
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (calls.load() < 11 && chrono::steady_clock::now() < deadline) {
+        this_thread::yield();
+    }
+    QCOMPARE(calls.load(), 11);
+}
+
+QTEST_APPLESS_MAIN(ThreadPoolTest)
+
+#include "tst_threadpooltest.moc"
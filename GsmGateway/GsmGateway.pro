@@ -1,6 +1,6 @@
 QT -= gui
 
-CONFIG += c++11 console
+CONFIG += c++17 console
 CONFIG -= app_bundle
 
 # The following define makes your compiler emit warnings if you use
@@ -15,7 +15,37 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
-        main.cpp
+        applink.cpp \
+        atchannel.cpp \
+        cmux.cpp \
+        floodguard.cpp \
+        journal.cpp \
+        log.cpp \
+        main.cpp \
+        modem.cpp \
+        reassembler.cpp \
+        serialport.cpp \
+        smspdu.cpp \
+        smssender.cpp \
+        tenantscheduler.cpp
+
+HEADERS += \
+        applink.h \
+        asiowatchdog.h \
+        atchannel.h \
+        cmux.h \
+        floodguard.h \
+        journal.h \
+        log.h \
+        modem.h \
+        reassembler.h \
+        serialport.h \
+        smspdu.h \
+        smssender.h \
+        tenantscheduler.h
+
+INCLUDEPATH += $$PWD/../Base
+DEPENDPATH += $$PWD/../Base
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
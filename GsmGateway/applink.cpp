@@ -0,0 +1,200 @@
+#include "applink.h"
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+using Base::Gateway::Protocol::FrameType;
+using Base::Serialization::Reader;
+using boost::asio::ip::tcp;
+
+AppLink::AppLink(boost::asio::io_context& context, Journal& journal,
+                 uint16_t port, size_t maxBatchEvents)
+    : _context(context), _journal(journal), _port(port), _acceptor(context),
+      _sender(
+          [&journal](uint64_t from, size_t maxCount,
+                     vector<Base::Gateway::GatewayEvent>& events) {
+              journal.read(from, maxCount, events);
+          },
+          maxBatchEvents) {
+    _sender.published(_journal.lastSequence());
+    _sender.grant(_journal.acknowledged(), 0);
+}
+
+bool AppLink::listen() {
+    boost::system::error_code error;
+    tcp::endpoint endpoint(tcp::v4(), _port);
+    _acceptor.open(endpoint.protocol(), error);
+    if (!error) {
+        _acceptor.set_option(tcp::acceptor::reuse_address(true), error);
+    }
+    if (!error) {
+        _acceptor.bind(endpoint, error);
+    }
+    if (!error) {
+        _acceptor.listen(boost::asio::socket_base::max_listen_connections,
+                         error);
+    }
+    if (error) {
+        GSM_LOG(Log::Level::Error, "Cannot listen for App on port {}: {}",
+                _port, error.message());
+        return false;
+    }
+    GSM_LOG(Log::Level::Info, "Listening for App on port {}", _port);
+    accept();
+    return true;
+}
+
+void AppLink::stop() {
+    boost::system::error_code error;
+    _acceptor.close(error);
+    disconnect("stopping");
+}
+
+void AppLink::publish(int64_t timestamp, const string& sender,
+                      const string& text, Published done) {
+    boost::asio::post(_context, [this, timestamp, sender, text,
+                                 done = move(done)] {
+        auto sequence = _journal.append(timestamp, sender, text);
+        if (done) {
+            done(sequence != 0);
+        }
+        if (sequence == 0) {
+            // The journal has logged why; without it the event cannot be
+            // delivered reliably, so it is not sent either
+            return;
+        }
+        _sender.published(sequence);
+        send();
+    });
+}
+
+void AppLink::accept() {
+    _acceptor.async_accept([this](const boost::system::error_code& error,
+                                  tcp::socket socket) {
+        if (error) {
+            if (error != boost::asio::error::operation_aborted) {
+                GSM_LOG(Log::Level::Warning, "Accepting App failed: {}",
+                        error.message());
+                accept();
+            }
+            return;
+        }
+        disconnect("replaced by a new connection");
+        boost::system::error_code ignored;
+        socket.set_option(tcp::no_delay(true), ignored);
+        GSM_LOG(Log::Level::Info, "App connected from {}",
+                socket.remote_endpoint(ignored).address().to_string());
+        _connection = make_shared<Connection>(move(socket));
+        read(_connection);
+        accept();
+    });
+}
+
+void AppLink::read(const shared_ptr<Connection>& connection) {
+    connection->socket.async_read_some(
+        boost::asio::buffer(connection->readBuffer),
+        [this, connection](const boost::system::error_code& error,
+                           size_t size) {
+            if (connection != _connection) {
+                return;
+            }
+            if (error) {
+                disconnect(error.message());
+                return;
+            }
+            auto ok = connection->parser.feed(
+                connection->readBuffer.data(), size,
+                [this](FrameType type, Reader& reader) {
+                    if (!handleFrame(type, reader)) {
+                        throw Base::Serialization::DecodeError(
+                            "Unexpected frame");
+                    }
+                });
+            if (!ok) {
+                disconnect("protocol error");
+                return;
+            }
+            send();
+            read(connection);
+        });
+}
+
+bool AppLink::handleFrame(FrameType type, Reader& reader) {
+    if (type == FrameType::Send) {
+        auto recipient = reader.read<string>();
+        auto text = reader.read<string>();
+        // Older Apps send alarms only
+        auto alarm = reader.atEnd() || reader.readByte() != 0;
+        if (_sendHandler) {
+            _sendHandler(recipient, text, alarm);
+        } else {
+            GSM_LOG(Log::Level::Warning, "No modem to send SMS to {}",
+                    recipient);
+        }
+        return true;
+    }
+    auto processed = reader.readVarint();
+    auto credits = static_cast<uint32_t>(reader.readVarint());
+    if (type == FrameType::Hello) {
+        _sender.connect(processed, credits);
+        GSM_LOG(Log::Level::Info,
+                "App processed up to {}, {} credits, {} events waiting",
+                processed, credits, _sender.backlog());
+    } else if (type == FrameType::Credit) {
+        if (!_sender.isConnected()) {
+            return false;
+        }
+        _sender.grant(processed, credits);
+    } else {
+        return false;
+    }
+    _journal.acknowledge(_sender.processed());
+    return true;
+}
+
+void AppLink::send() {
+    if (!_connection || _writing) {
+        return;
+    }
+    auto buffer = make_shared<vector<uint8_t>>();
+    // Coalesce every batch that App has credits for into one write
+    while (_sender.nextBatch(*buffer)) {
+    }
+    if (buffer->empty()) {
+        return;
+    }
+    _writing = true;
+    auto connection = _connection;
+    boost::asio::async_write(
+        connection->socket, boost::asio::buffer(*buffer),
+        [this, connection, buffer](const boost::system::error_code& error,
+                                   size_t) {
+            if (connection != _connection) {
+                return;
+            }
+            _writing = false;
+            if (error) {
+                disconnect(error.message());
+                return;
+            }
+            send();
+        });
+}
+
+void AppLink::disconnect(const string& reason) {
+    if (!_connection) {
+        return;
+    }
+    GSM_LOG(Log::Level::Info, "App disconnected: {}", reason);
+    boost::system::error_code ignored;
+    _connection->socket.close(ignored);
+    _connection.reset();
+    _writing = false;
+    _sender.disconnect();
+}
+
+} // namespace GsmGateway
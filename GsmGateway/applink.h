@@ -0,0 +1,102 @@
+#ifndef APPLINK_H
+#define APPLINK_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include "gatewaylink.h"
+#include "journal.h"
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief Delivers the journaled events to App over TCP with credit based flow
+ * control (see Base::Gateway::CreditSender).
+ *
+ * Every event is written to the journal first and only then sent, and only
+ * while App has credits. When App stalls or is disconnected, events pile up
+ * in the journal on disk instead of in memory, and App catches up from there
+ * once it grants credits again. The journal drops events only after App has
+ * reported them as processed.
+ *
+ * App also sends the SMS it wants sent, such as alarms, which are passed to
+ * the send handler.
+ *
+ * Only one App is served at a time; a new connection replaces the current
+ * one. All members must be called on the io_context thread, except
+ * publish(), which may be called from any thread.
+ */
+class AppLink {
+  public:
+    using SendHandler = function<void(const string& recipient,
+                                      const string& text, bool alarm)>;
+    using Published = function<void(bool journaled)>;
+
+    explicit AppLink(boost::asio::io_context& context, Journal& journal,
+                     uint16_t port, size_t maxBatchEvents = 64);
+
+    AppLink(const AppLink&) = delete;
+    AppLink& operator=(const AppLink&) = delete;
+
+    /**
+     * @brief Starts accepting App connections.
+     *
+     * @return true on success, false if the port could not be opened.
+     */
+    bool listen();
+
+    void stop();
+
+    /**
+     * @brief Journals an event and sends it to App when App has credits.
+     *
+     * @param done called on the io_context thread once the event is on disk,
+     * or could not be written to the journal.
+     */
+    void publish(int64_t timestamp, const string& sender, const string& text,
+                 Published done = {});
+
+    void setSendHandler(SendHandler handler) {
+        _sendHandler = move(handler);
+    }
+
+    const Base::Gateway::CreditSender& sender() const { return _sender; }
+
+  private:
+    struct Connection {
+        explicit Connection(boost::asio::ip::tcp::socket socket)
+            : socket(move(socket)), readBuffer(64 * 1024) {}
+
+        boost::asio::ip::tcp::socket socket;
+        vector<uint8_t> readBuffer;
+        Base::Gateway::Protocol::FrameParser parser;
+    };
+
+    void accept();
+    void read(const shared_ptr<Connection>& connection);
+    void send();
+    void disconnect(const string& reason);
+    bool handleFrame(Base::Gateway::Protocol::FrameType type,
+                     Base::Serialization::Reader& reader);
+
+    boost::asio::io_context& _context;
+    Journal& _journal;
+    uint16_t _port;
+    boost::asio::ip::tcp::acceptor _acceptor;
+    shared_ptr<Connection> _connection;
+    Base::Gateway::CreditSender _sender;
+    SendHandler _sendHandler;
+    bool _writing = false;
+};
+
+} // namespace GsmGateway
+
+#endif // APPLINK_H
@@ -0,0 +1,99 @@
+#ifndef ASIOWATCHDOG_H
+#define ASIOWATCHDOG_H
+
+#include <chrono>
+#include <string>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "log.h"
+#include "loopmonitor.h"
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief Monitors the lag of an io_context. A timer is rescheduled from every
+ * tick, so the lateness of each tick is the time the handlers of the context
+ * spent beyond the interval. Stalls are logged with the activity and stack of
+ * the blocked thread as soon as the threshold is exceeded, and the lag
+ * histogram is logged every report interval.
+ *
+ * The io_context must be run by a single thread.
+ */
+class AsioWatchdog {
+  public:
+    explicit AsioWatchdog(boost::asio::io_context& context, const string& name,
+                          chrono::milliseconds interval =
+                              chrono::milliseconds(50),
+                          chrono::milliseconds stallThreshold =
+                              chrono::milliseconds(250),
+                          chrono::seconds reportInterval = chrono::seconds(60))
+        : _context(context), _timer(context), _monitor(name, interval,
+                                                       stallThreshold),
+          _reportInterval(reportInterval) {
+        _monitor.setStallHandler([](const Base::Diagnostics::LoopStall& stall) {
+            GSM_LOG(Log::Level::Warning, "Loop {} stalled for {} us in {}",
+                    stall.loop, stall.lagMicros,
+                    stall.activity.empty() ? "?" : stall.activity);
+            for (const auto& frame : stall.stack) {
+                GSM_LOG(Log::Level::Warning, "  {}", frame);
+            }
+        });
+    }
+
+    ~AsioWatchdog() { stop(); }
+
+    AsioWatchdog(const AsioWatchdog&) = delete;
+    AsioWatchdog& operator=(const AsioWatchdog&) = delete;
+
+    /**
+     * @brief Starts monitoring. The monitor attaches to the thread that runs
+     * the context.
+     */
+    void start() {
+        boost::asio::post(_context, [this] {
+            _monitor.start();
+            _lastReport = chrono::steady_clock::now();
+            schedule();
+        });
+    }
+
+    void stop() {
+        _timer.cancel();
+        _monitor.stop();
+    }
+
+    Base::Diagnostics::LoopMonitor& monitor() { return _monitor; }
+
+  private:
+    void schedule() {
+        _timer.expires_after(_monitor.interval());
+        _timer.async_wait([this](const boost::system::error_code& error) {
+            if (error) {
+                return;
+            }
+            _monitor.tick();
+            auto now = chrono::steady_clock::now();
+            if (now - _lastReport >= _reportInterval) {
+                _lastReport = now;
+                GSM_LOG(Log::Level::Info, "Loop {} lag (us): {}",
+                        _monitor.name(), _monitor.lag().summary());
+            }
+            schedule();
+        });
+    }
+
+    boost::asio::io_context& _context;
+    boost::asio::steady_timer _timer;
+    Base::Diagnostics::LoopMonitor _monitor;
+    chrono::seconds _reportInterval;
+    chrono::steady_clock::time_point _lastReport;
+};
+
+} // namespace GsmGateway
+
+#endif // ASIOWATCHDOG_H
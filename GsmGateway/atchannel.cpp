@@ -0,0 +1,205 @@
+#include "atchannel.h"
+
+#include "log.h"
+
+namespace GsmGateway {
+
+namespace {
+
+constexpr char ctrlZ = 0x1A;
+constexpr char escape = 0x1B;
+
+bool startsWith(const string& text, const char* prefix) {
+    return text.compare(0, char_traits<char>::length(prefix), prefix) == 0;
+}
+
+bool isFinalResult(const string& line) {
+    return line == "OK" || line == "ERROR" || startsWith(line, "+CME ERROR") ||
+           startsWith(line, "+CMS ERROR") || line == "NO CARRIER" ||
+           line == "BUSY" || line == "NO ANSWER" || line == "NO DIALTONE";
+}
+
+bool isUrc(const string& line) {
+    static const char* prefixes[] = {"+CMTI:", "+CMT:",  "+CDSI:", "+CDS:",
+                                     "+CBM:",  "+CREG:", "+CGREG:", "RING",
+                                     "+CLIP:", "+CUSD:"};
+    for (auto prefix : prefixes) {
+        if (startsWith(line, prefix)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Returns whether a URC is followed by a data line.
+ */
+bool hasDataLine(const string& line) {
+    return startsWith(line, "+CMT:") || startsWith(line, "+CDS:") ||
+           startsWith(line, "+CBM:");
+}
+
+string trim(const string& text) {
+    auto first = text.find_first_not_of(" \t");
+    if (first == string::npos) {
+        return string();
+    }
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+} // namespace
+
+AtChannel::AtChannel(boost::asio::io_context& context, Writer writer,
+                     string name)
+    : _writer(move(writer)), _name(move(name)), _timer(context) {}
+
+void AtChannel::command(AtCommand command) {
+    _commands.push_back(move(command));
+    writeNext();
+}
+
+void AtChannel::command(string line, function<void(const AtResponse&)> done,
+                        chrono::milliseconds timeout) {
+    AtCommand command;
+    command.line = move(line);
+    command.timeout = timeout;
+    command.done = move(done);
+    this->command(move(command));
+}
+
+void AtChannel::receive(const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        auto c = static_cast<char>(data[i]);
+        if (c == '\r' || c == '\n') {
+            if (!_line.empty()) {
+                auto line = trim(_line);
+                _line.clear();
+                if (!line.empty()) {
+                    handleLine(line);
+                }
+            }
+            continue;
+        }
+        _line += c;
+        if (_awaitingPrompt && _line == ">") {
+            // The prompt is not terminated by a line break
+            _awaitingPrompt = false;
+            _line.clear();
+            const auto& command = _commands.front();
+            GSM_LOG(Log::Level::Trace, "{}: > {}", _name, command.payload);
+            _writer(command.payload + ctrlZ);
+        }
+    }
+}
+
+void AtChannel::reset(const string& result) {
+    auto commands = move(_commands);
+    _commands.clear();
+    _running = false;
+    _awaitingPrompt = false;
+    _generation++;
+    _lines.clear();
+    _line.clear();
+    _urc.clear();
+    _timer.cancel();
+    AtResponse response;
+    response.result = result;
+    for (auto& command : commands) {
+        if (command.done) {
+            command.done(response);
+        }
+    }
+}
+
+void AtChannel::writeNext() {
+    if (_running || _commands.empty()) {
+        return;
+    }
+    _running = true;
+    auto generation = ++_generation;
+    const auto& command = _commands.front();
+    _awaitingPrompt = !command.payload.empty();
+    _lines.clear();
+    GSM_LOG(Log::Level::Debug, "{}: {}", _name, command.line);
+    _writer(command.line + "\r");
+    _timer.expires_after(command.timeout);
+    _timer.async_wait(
+        [this, generation](const boost::system::error_code& error) {
+            if (error || !_running || generation != _generation) {
+                return;
+            }
+            GSM_LOG(Log::Level::Warning, "{}: {} timed out", _name,
+                    _commands.front().line);
+            if (_awaitingPrompt) {
+                // Leave the prompt, or the next command would become text
+                _writer(string(1, escape));
+            }
+            complete(false, "timeout");
+        });
+}
+
+void AtChannel::handleLine(const string& line) {
+    if (!_urc.empty()) {
+        auto urc = move(_urc);
+        _urc.clear();
+        if (_urcHandler) {
+            _urcHandler(urc, line);
+        }
+        return;
+    }
+    if (_running) {
+        if (line == _commands.front().line) {
+            // Echo, if echo has not been turned off yet
+            return;
+        }
+        if (isFinalResult(line)) {
+            complete(line == "OK", line);
+            return;
+        }
+        if (!isUrc(line) || isSolicited(line)) {
+            _lines.push_back(line);
+            return;
+        }
+    }
+    GSM_LOG(Log::Level::Debug, "{}: URC {}", _name, line);
+    if (hasDataLine(line)) {
+        _urc = line;
+    } else if (_urcHandler) {
+        _urcHandler(line, string());
+    }
+}
+
+void AtChannel::complete(bool ok, const string& result) {
+    if (!_running) {
+        return;
+    }
+    AtResponse response;
+    response.ok = ok;
+    response.result = result;
+    response.lines = move(_lines);
+    _lines.clear();
+    auto done = move(_commands.front().done);
+    _commands.pop_front();
+    _running = false;
+    _awaitingPrompt = false;
+    _timer.cancel();
+    if (!ok) {
+        GSM_LOG(Log::Level::Debug, "{}: {}", _name, result);
+    }
+    // The next command goes out before the caller sees this result
+    writeNext();
+    if (done) {
+        done(response);
+    }
+}
+
+bool AtChannel::isSolicited(const string& line) const {
+    const auto& command = _commands.front().line;
+    if (!startsWith(command, "AT")) {
+        return false;
+    }
+    auto name = command.substr(2, command.find_first_of("=?") - 2);
+    return !name.empty() && startsWith(line, (name + ":").c_str());
+}
+
+} // namespace GsmGateway
@@ -0,0 +1,124 @@
+#ifndef ATCHANNEL_H
+#define ATCHANNEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief The outcome of an AT command.
+ */
+struct AtResponse {
+    bool ok = false;
+    // The final result code, e.g. "OK" or "+CMS ERROR: 38", or "timeout"
+    string result;
+    // The information lines between the command and the result code
+    vector<string> lines;
+};
+
+/**
+ * @brief An AT command with an optional payload, such as the PDU of
+ * AT+CMGS, which is sent when the modem prompts for it.
+ */
+struct AtCommand {
+    // The command without the terminating carriage return
+    string line;
+    // Sent after the "> " prompt and terminated with Ctrl-Z
+    string payload;
+    chrono::milliseconds timeout = chrono::seconds(10);
+    function<void(const AtResponse&)> done;
+};
+
+/**
+ * @brief Runs AT commands on one channel to a modem, one at a time, and
+ * passes unsolicited result codes (URCs) such as +CMTI to a handler.
+ *
+ * The channel does no I/O itself: bytes from the modem are passed to
+ * receive() and the channel writes through the given writer, so it works on
+ * a serial port as well as on a multiplexed channel.
+ *
+ * Queued commands are written as soon as the previous one completes, from
+ * the handler that received its result code, and a payload is written as
+ * soon as its prompt arrives. Queue the next command before the current one
+ * completes to keep the modem busy without round trips through the caller.
+ *
+ * All members must be called on the io_context thread.
+ */
+class AtChannel {
+  public:
+    using Writer = function<void(string data)>;
+
+    /**
+     * @brief Receives a URC. For URCs that are followed by a data line, such
+     * as +CMT with its PDU, data holds that line; otherwise it is empty.
+     */
+    using UrcHandler = function<void(const string& line, const string& data)>;
+
+    explicit AtChannel(boost::asio::io_context& context, Writer writer,
+                       string name = "modem");
+
+    AtChannel(const AtChannel&) = delete;
+    AtChannel& operator=(const AtChannel&) = delete;
+
+    void setUrcHandler(UrcHandler handler) { _urcHandler = move(handler); }
+
+    /**
+     * @brief Queues a command.
+     */
+    void command(AtCommand command);
+
+    void command(string line, function<void(const AtResponse&)> done = {},
+                 chrono::milliseconds timeout = chrono::seconds(10));
+
+    /**
+     * @brief Processes bytes received from the modem.
+     */
+    void receive(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Fails the current and all queued commands with the given
+     * result, e.g. when the connection to the modem is lost.
+     */
+    void reset(const string& result);
+
+    /**
+     * @brief Returns the number of commands that have not completed.
+     */
+    size_t pending() const { return _commands.size(); }
+
+    const string& name() const { return _name; }
+
+  private:
+    void writeNext();
+    void handleLine(const string& line);
+    void complete(bool ok, const string& result);
+    bool isSolicited(const string& line) const;
+
+    Writer _writer;
+    string _name;
+    UrcHandler _urcHandler;
+    deque<AtCommand> _commands;
+    bool _running = false;
+    bool _awaitingPrompt = false;
+    // Bumped for every command, so stale timeouts are ignored
+    uint64_t _generation = 0;
+    vector<string> _lines;
+    string _line;
+    // A URC whose data line has not arrived yet
+    string _urc;
+    boost::asio::steady_timer _timer;
+};
+
+} // namespace GsmGateway
+
+#endif // ATCHANNEL_H
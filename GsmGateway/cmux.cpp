@@ -0,0 +1,314 @@
+#include "cmux.h"
+
+#include <algorithm>
+#include <array>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+namespace {
+
+constexpr uint8_t flag = 0xF9;
+constexpr uint8_t pollFinal = 0x10;
+
+// Frame types, without the poll/final bit
+constexpr uint8_t sabm = 0x2F;
+constexpr uint8_t ua = 0x63;
+constexpr uint8_t dm = 0x0F;
+constexpr uint8_t disc = 0x43;
+constexpr uint8_t ui = 0x03;
+constexpr uint8_t uih = 0xEF;
+
+// Control channel message types, with the EA bit and without the C/R bit
+constexpr uint8_t messageCommand = 0x02;
+constexpr uint8_t parameterNegotiation = 0x81;
+constexpr uint8_t multiplexerCloseDown = 0xC1;
+constexpr uint8_t test = 0x21;
+constexpr uint8_t modemStatus = 0xE1;
+
+// EA, ready to communicate, ready to receive and data valid
+constexpr uint8_t modemSignals = 0x8D;
+
+constexpr chrono::seconds responseTimeout(3);
+constexpr size_t maxInformationSize = 32768;
+
+const array<uint8_t, 256>& crcTable() {
+    // The reflected CRC-8 with polynomial x^8 + x^2 + x + 1
+    static const auto table = [] {
+        array<uint8_t, 256> table{};
+        for (size_t i = 0; i < 256; ++i) {
+            auto crc = static_cast<uint8_t>(i);
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = crc & 1 ? static_cast<uint8_t>((crc >> 1) ^ 0xE0)
+                              : static_cast<uint8_t>(crc >> 1);
+            }
+            table[i] = crc;
+        }
+        return table;
+    }();
+    return table;
+}
+
+/**
+ * @brief Returns whether a control field is one of the frame types, so that
+ * noise after a flag is not taken for the header of a frame whose length
+ * would swallow the frames after it.
+ */
+bool isFrameType(uint8_t control) {
+    switch (control & ~pollFinal) {
+    case sabm:
+    case ua:
+    case dm:
+    case disc:
+    case ui:
+    case uih:
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint8_t crcOf(const uint8_t* data, size_t size) {
+    const auto& table = crcTable();
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[crc ^ data[i]];
+    }
+    return crc;
+}
+
+} // namespace
+
+Cmux::Cmux(boost::asio::io_context& context, Writer writer,
+           size_t maxFrameSize)
+    : _writer(move(writer)), _maxFrameSize(max<size_t>(1, maxFrameSize)),
+      _timer(context) {}
+
+void Cmux::open(const vector<uint8_t>& dlcis, function<void(bool ok)> done) {
+    _opening.assign(1, 0);
+    _opening.insert(_opening.end(), dlcis.begin(), dlcis.end());
+    _openIndex = 0;
+    _openDone = move(done);
+    openNext();
+}
+
+void Cmux::close() {
+    _timer.cancel();
+    _openDone = nullptr;
+    if (isOpen(0)) {
+        uint8_t message[] = {multiplexerCloseDown | messageCommand, 0x01};
+        sendFrame(0, uih, true, message, sizeof(message));
+    }
+    _open = 0;
+    _state = ParseState::Flag;
+}
+
+bool Cmux::isOpen(uint8_t dlci) const {
+    return dlci <= maxDlci && (_open >> dlci & 1) != 0;
+}
+
+void Cmux::write(uint8_t dlci, const string& data) {
+    if (!isOpen(dlci)) {
+        GSM_LOG(Log::Level::Warning, "CMUX channel {} is not open", dlci);
+        return;
+    }
+    auto bytes = reinterpret_cast<const uint8_t*>(data.data());
+    for (size_t offset = 0; offset < data.size(); offset += _maxFrameSize) {
+        sendFrame(dlci, uih, true, bytes + offset,
+                  min(_maxFrameSize, data.size() - offset));
+    }
+}
+
+void Cmux::receive(const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        auto byte = data[i];
+        switch (_state) {
+        case ParseState::Flag:
+            if (byte == flag) {
+                _state = ParseState::Address;
+            }
+            break;
+        case ParseState::Address:
+            if (byte == flag) {
+                break;
+            }
+            // Without the EA bit, this is not the start of a frame
+            if ((byte & 1) == 0) {
+                _state = ParseState::Flag;
+                break;
+            }
+            _address = byte;
+            _header[0] = byte;
+            _state = ParseState::Control;
+            break;
+        case ParseState::Control:
+            if (!isFrameType(byte)) {
+                _state = byte == flag ? ParseState::Address
+                                      : ParseState::Flag;
+                break;
+            }
+            _control = byte;
+            _header[1] = byte;
+            _state = ParseState::Length;
+            break;
+        case ParseState::Length:
+            _header[2] = byte;
+            _length = byte >> 1;
+            _headerSize = 3;
+            _state = byte & 1 ? ParseState::Data : ParseState::Length2;
+            _frame.clear();
+            break;
+        case ParseState::Length2:
+            _header[3] = byte;
+            _length |= size_t(byte) << 7;
+            _headerSize = 4;
+            _state = ParseState::Data;
+            break;
+        case ParseState::Data:
+            _frame.push_back(byte);
+            if (_length > maxInformationSize) {
+                _stats.framesDropped++;
+                _state = ParseState::Flag;
+            } else if (_frame.size() == _length + 2) {
+                // The information, the checksum and the closing flag
+                auto fcs = _frame[_length];
+                auto valid = _frame[_length + 1] == flag &&
+                             static_cast<uint8_t>(0xFF - crcOf(
+                                 _header, _headerSize)) == fcs;
+                if (valid) {
+                    _stats.framesReceived++;
+                    handleFrame();
+                    // The closing flag may open the next frame
+                    _state = ParseState::Address;
+                } else {
+                    _stats.framesDropped++;
+                    _state = byte == flag ? ParseState::Address
+                                          : ParseState::Flag;
+                }
+            }
+            break;
+        }
+    }
+}
+
+void Cmux::openNext() {
+    if (_openIndex == _opening.size()) {
+        _timer.cancel();
+        for (size_t i = 1; i < _opening.size(); ++i) {
+            sendModemStatus(_opening[i]);
+        }
+        auto done = move(_openDone);
+        _openDone = nullptr;
+        if (done) {
+            done(true);
+        }
+        return;
+    }
+    auto dlci = _opening[_openIndex];
+    sendFrame(dlci, sabm | pollFinal, true, nullptr, 0);
+    _timer.expires_after(responseTimeout);
+    _timer.async_wait([this, dlci](const boost::system::error_code& error) {
+        if (error || !_openDone) {
+            return;
+        }
+        GSM_LOG(Log::Level::Error, "CMUX channel {} did not open", dlci);
+        fail();
+    });
+}
+
+void Cmux::fail() {
+    _timer.cancel();
+    auto done = move(_openDone);
+    _openDone = nullptr;
+    if (done) {
+        done(false);
+    }
+}
+
+void Cmux::sendFrame(uint8_t dlci, uint8_t control, bool command,
+                     const uint8_t* data, size_t size) {
+    uint8_t header[4];
+    header[0] = static_cast<uint8_t>(dlci << 2 | (command ? 0x02 : 0) | 1);
+    header[1] = control;
+    size_t headerSize = 3;
+    if (size <= 127) {
+        header[2] = static_cast<uint8_t>(size << 1 | 1);
+    } else {
+        header[2] = static_cast<uint8_t>(size << 1);
+        header[3] = static_cast<uint8_t>(size >> 7);
+        headerSize = 4;
+    }
+    string frame;
+    frame.reserve(size + headerSize + 3);
+    frame += static_cast<char>(flag);
+    frame.append(reinterpret_cast<const char*>(header), headerSize);
+    if (size > 0) {
+        frame.append(reinterpret_cast<const char*>(data), size);
+    }
+    frame += static_cast<char>(0xFF - crcOf(header, headerSize));
+    frame += static_cast<char>(flag);
+    _stats.framesSent++;
+    _writer(move(frame));
+}
+
+void Cmux::sendModemStatus(uint8_t dlci) {
+    uint8_t message[] = {modemStatus | messageCommand, 0x05,
+                         static_cast<uint8_t>(dlci << 2 | 0x03), modemSignals};
+    sendFrame(0, uih, true, message, sizeof(message));
+}
+
+void Cmux::handleFrame() {
+    auto dlci = static_cast<uint8_t>(_address >> 2);
+    auto control = static_cast<uint8_t>(_control & ~pollFinal);
+    if (control == uih) {
+        if (dlci == 0) {
+            handleControlMessage(_frame.data(), _length);
+        } else if (_receiveHandler) {
+            _receiveHandler(dlci, _frame.data(), _length);
+        }
+    } else if (control == ua) {
+        if (_openDone && _openIndex < _opening.size() &&
+            _opening[_openIndex] == dlci) {
+            _open |= uint64_t(1) << dlci;
+            _openIndex++;
+            openNext();
+        }
+    } else if (control == dm) {
+        _open &= ~(uint64_t(1) << dlci);
+        if (_openDone && _openIndex < _opening.size() &&
+            _opening[_openIndex] == dlci) {
+            GSM_LOG(Log::Level::Error, "Modem refused CMUX channel {}", dlci);
+            fail();
+        }
+    } else if (control == disc) {
+        _open &= ~(uint64_t(1) << dlci);
+        sendFrame(dlci, ua | pollFinal, false, nullptr, 0);
+        GSM_LOG(Log::Level::Warning, "Modem closed CMUX channel {}", dlci);
+    } else if (control == sabm) {
+        _open |= uint64_t(1) << dlci;
+        sendFrame(dlci, ua | pollFinal, false, nullptr, 0);
+    }
+}
+
+void Cmux::handleControlMessage(const uint8_t* data, size_t size) {
+    if (size < 2 || (data[0] & messageCommand) == 0) {
+        // Responses to our own commands need no action
+        return;
+    }
+    auto type = static_cast<uint8_t>(data[0] & ~messageCommand);
+    if (type == modemStatus || type == test ||
+        type == parameterNegotiation) {
+        // Accept the modem's signals, echo or parameters as they are
+        vector<uint8_t> response(data, data + size);
+        response[0] = type;
+        sendFrame(0, uih, true, response.data(), response.size());
+    } else if (type == multiplexerCloseDown) {
+        GSM_LOG(Log::Level::Warning,
+                "Modem closed the CMUX multiplexer after {} frames",
+                _stats.framesReceived);
+        _open = 0;
+    }
+}
+
+} // namespace GsmGateway
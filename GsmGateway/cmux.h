@@ -0,0 +1,125 @@
+#ifndef CMUX_H
+#define CMUX_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief Statistics of a Cmux.
+ */
+struct CmuxStats {
+    uint64_t framesSent = 0;
+    uint64_t framesReceived = 0;
+    // Frames dropped for a bad checksum or length
+    uint64_t framesDropped = 0;
+};
+
+/**
+ * @brief The multiplexer of 3GPP TS 27.010 (basic option), which carries
+ * several virtual channels (DLCIs) over the serial line to a modem, each
+ * with its own AT command interpreter, so that a long command on one
+ * channel does not hold up the others.
+ *
+ * The modem must have been switched to multiplexer mode with AT+CMUX=0
+ * before open(). Like AtChannel, the multiplexer does no I/O itself: bytes
+ * from the modem are passed to receive() and frames are written through the
+ * given writer.
+ *
+ * All members must be called on the io_context thread.
+ */
+class Cmux {
+  public:
+    using Writer = function<void(string data)>;
+    using ReceiveHandler =
+        function<void(uint8_t dlci, const uint8_t* data, size_t size)>;
+
+    static constexpr uint8_t maxDlci = 63;
+
+    /**
+     * @brief Creates a new Cmux.
+     *
+     * @param maxFrameSize the maximum information field size (N1) that was
+     * set with AT+CMUX; 31 by default.
+     */
+    explicit Cmux(boost::asio::io_context& context, Writer writer,
+                  size_t maxFrameSize = 31);
+
+    Cmux(const Cmux&) = delete;
+    Cmux& operator=(const Cmux&) = delete;
+
+    void setReceiveHandler(ReceiveHandler handler) {
+        _receiveHandler = move(handler);
+    }
+
+    /**
+     * @brief Opens the control channel and then the given channels, and sets
+     * their modem status so that the modem accepts data on them.
+     *
+     * @param done called with true once every channel is open, or with false
+     * if the modem refused or did not answer.
+     */
+    void open(const vector<uint8_t>& dlcis, function<void(bool ok)> done);
+
+    /**
+     * @brief Closes the multiplexer; the modem returns to plain AT mode.
+     */
+    void close();
+
+    bool isOpen(uint8_t dlci) const;
+
+    /**
+     * @brief Sends data on a channel, split into frames of at most
+     * maxFrameSize bytes.
+     */
+    void write(uint8_t dlci, const string& data);
+
+    /**
+     * @brief Processes bytes received from the modem.
+     */
+    void receive(const uint8_t* data, size_t size);
+
+    const CmuxStats& stats() const { return _stats; }
+
+  private:
+    enum class ParseState { Flag, Address, Control, Length, Length2, Data };
+
+    void openNext();
+    void fail();
+    void sendFrame(uint8_t dlci, uint8_t control, bool command,
+                   const uint8_t* data, size_t size);
+    void sendModemStatus(uint8_t dlci);
+    void handleFrame();
+    void handleControlMessage(const uint8_t* data, size_t size);
+
+    Writer _writer;
+    size_t _maxFrameSize;
+    ReceiveHandler _receiveHandler;
+    boost::asio::steady_timer _timer;
+    // Bit per DLCI
+    uint64_t _open = 0;
+    vector<uint8_t> _opening;
+    size_t _openIndex = 0;
+    function<void(bool ok)> _openDone;
+    ParseState _state = ParseState::Flag;
+    uint8_t _address = 0;
+    uint8_t _control = 0;
+    size_t _length = 0;
+    uint8_t _header[4] = {};
+    size_t _headerSize = 0;
+    vector<uint8_t> _frame;
+    CmuxStats _stats;
+};
+
+} // namespace GsmGateway
+
+#endif // CMUX_H
@@ -0,0 +1,109 @@
+#include "floodguard.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+namespace {
+
+// The weights are rebased before they lose precision or overflow
+constexpr double maxExponent = 64;
+
+uint64_t mix(uint64_t value) {
+    // The splitmix64 finalizer
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+double secondsBetween(FloodGuard::Clock::time_point from,
+                      FloodGuard::Clock::time_point to) {
+    return chrono::duration<double>(to - from).count();
+}
+
+} // namespace
+
+FloodGuard::FloodGuard(double limit, chrono::seconds halfLife,
+                       double responderLimit, size_t width, size_t depth)
+    : _limit(limit), _responderLimit(responderLimit),
+      _decay(log(2.0) / max<double>(1, double(halfLife.count()))),
+      _width(max<size_t>(1, width)), _depth(max<size_t>(1, depth)),
+      _counters(_width * _depth, 0), _epoch(Clock::now()) {}
+
+bool FloodGuard::admit(const string& sender, Clock::time_point now) {
+    auto increment = weight(now);
+    auto hash = std::hash<string>()(sender);
+    // Conservative update: raise the counters only as far as needed for
+    // the smallest one to count the message
+    auto smallest = _counters[slot(0, hash)];
+    for (size_t row = 1; row < _depth; ++row) {
+        smallest = min(smallest, _counters[slot(row, hash)]);
+    }
+    auto count = smallest + increment;
+    for (size_t row = 0; row < _depth; ++row) {
+        auto& counter = _counters[slot(row, hash)];
+        counter = max(counter, count);
+    }
+    auto limit = isResponder(sender) ? _responderLimit : _limit;
+    auto factor = scale(now);
+    if (count * factor <= limit) {
+        _stats.admitted++;
+        return true;
+    }
+    _stats.throttled++;
+    if (smallest * factor <= limit) {
+        // Logged only when a sender goes over the limit
+        _stats.offenders++;
+        GSM_LOG(Log::Level::Warning, "Throttling SMS from {}, {} recently",
+                sender, static_cast<int>(count * factor));
+    }
+    return false;
+}
+
+double FloodGuard::estimate(const string& sender, Clock::time_point now) const {
+    auto hash = std::hash<string>()(sender);
+    auto smallest = _counters[slot(0, hash)];
+    for (size_t row = 1; row < _depth; ++row) {
+        smallest = min(smallest, _counters[slot(row, hash)]);
+    }
+    return smallest * scale(now);
+}
+
+void FloodGuard::addResponder(const string& number) {
+    if (!_responders.insert(number).second) {
+        return;
+    }
+    _responderOrder.push_back(number);
+    if (_responderOrder.size() > maxResponders) {
+        _responders.erase(_responderOrder.front());
+        _responderOrder.pop_front();
+    }
+}
+
+size_t FloodGuard::slot(size_t row, uint64_t hash) const {
+    return row * _width + mix(hash + row * 0x9E3779B97F4A7C15ull) % _width;
+}
+
+double FloodGuard::weight(Clock::time_point now) {
+    auto exponent = _decay * secondsBetween(_epoch, now);
+    if (exponent > maxExponent) {
+        // Rebase every counter on now
+        auto factor = exp(-exponent);
+        for (auto& counter : _counters) {
+            counter *= factor;
+        }
+        _epoch = now;
+        exponent = 0;
+    }
+    return exp(exponent);
+}
+
+double FloodGuard::scale(Clock::time_point now) const {
+    return exp(-_decay * secondsBetween(_epoch, now));
+}
+
+} // namespace GsmGateway
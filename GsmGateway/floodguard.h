@@ -0,0 +1,111 @@
+#ifndef FLOODGUARD_H
+#define FLOODGUARD_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief Statistics of a FloodGuard.
+ */
+struct FloodGuardStats {
+    uint64_t admitted = 0;
+    uint64_t throttled = 0;
+    // Times a sender went over its limit
+    uint64_t offenders = 0;
+};
+
+/**
+ * @brief Limits the rate of incoming SMS per sender, so that a misconfigured
+ * phone or a spam source cannot crowd out the replies of responders.
+ *
+ * Each sender's messages are counted with exponential decay, so the count
+ * is a moving total over about one half-life, and messages over the limit
+ * are throttled. The counts are kept in a count-min sketch, whose memory is
+ * fixed however many senders there are; collisions can only make a count
+ * too high, and conservative updates keep that rare with the default size.
+ *
+ * Responders, the numbers alarms are sent to, get a higher limit of their
+ * own. At most maxResponders are remembered, the least recently added are
+ * forgotten first.
+ *
+ * Not thread safe; the gateway uses it from its io_context thread.
+ */
+class FloodGuard {
+  public:
+    using Clock = chrono::steady_clock;
+
+    static constexpr size_t maxResponders = 4096;
+
+    /**
+     * @brief Creates a new FloodGuard.
+     *
+     * @param limit the decayed count of messages a sender may reach; with
+     * the defaults a burst of 10, or about 7 messages per minute in the long
+     * run.
+     * @param halfLife the time after which a message counts half.
+     * @param responderLimit the limit for responders.
+     * @param width the counters per row of the sketch.
+     * @param depth the rows of the sketch.
+     */
+    explicit FloodGuard(double limit = 10,
+                        chrono::seconds halfLife = chrono::seconds(60),
+                        double responderLimit = 60, size_t width = 2048,
+                        size_t depth = 4);
+
+    FloodGuard(const FloodGuard&) = delete;
+    FloodGuard& operator=(const FloodGuard&) = delete;
+
+    /**
+     * @brief Counts a message from a sender.
+     *
+     * @return false if the sender is over its limit and the message should
+     * be dropped.
+     */
+    bool admit(const string& sender, Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Returns the decayed count of messages from a sender; never too
+     * low, but may be too high.
+     */
+    double estimate(const string& sender,
+                    Clock::time_point now = Clock::now()) const;
+
+    void addResponder(const string& number);
+
+    bool isResponder(const string& number) const {
+        return _responders.count(number) != 0;
+    }
+
+    const FloodGuardStats& stats() const { return _stats; }
+
+  private:
+    size_t slot(size_t row, uint64_t hash) const;
+    double weight(Clock::time_point now);
+    double scale(Clock::time_point now) const;
+
+    double _limit;
+    double _responderLimit;
+    // The decay rate per second
+    double _decay;
+    size_t _width;
+    size_t _depth;
+    // Counters hold weights relative to _epoch (forward decay), so an
+    // update touches only one counter per row
+    vector<double> _counters;
+    Clock::time_point _epoch;
+    unordered_set<string> _responders;
+    deque<string> _responderOrder;
+    FloodGuardStats _stats;
+};
+
+} // namespace GsmGateway
+
+#endif // FLOODGUARD_H
@@ -0,0 +1,412 @@
+#include "journal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+using Base::Serialization::DecodeError;
+using Base::Serialization::Reader;
+using Base::Serialization::Writer;
+
+namespace {
+
+constexpr char segmentExtension[] = ".journal";
+constexpr char acknowledgedFile[] = "acknowledged";
+constexpr uint32_t maxRecordSize = 1024 * 1024;
+constexpr size_t maxFingerprints = 65536;
+// Every 64th record of a segment is indexed, so a read scans at most 63
+// records that it does not return
+constexpr uint64_t indexInterval = 64;
+
+uint32_t checksum(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint64_t fingerprint(int64_t timestamp, const string& sender,
+                     const string& text) {
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](uint8_t byte) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    };
+    for (size_t i = 0; i < 8; ++i) {
+        add(static_cast<uint8_t>(uint64_t(timestamp) >> (8 * i)));
+    }
+    for (auto c : sender) {
+        add(static_cast<uint8_t>(c));
+    }
+    // Keeps "ab" + "c" apart from "a" + "bc"
+    add(0);
+    for (auto c : text) {
+        add(static_cast<uint8_t>(c));
+    }
+    return hash;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        auto written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+string segmentName(uint64_t firstSequence) {
+    auto digits = to_string(firstSequence);
+    return string(20 - min<size_t>(20, digits.size()), '0') + digits +
+           segmentExtension;
+}
+
+/**
+ * @brief Reads the records of a segment file from the given offset, which
+ * must be the start of a record. The callback receives each event and the
+ * offsets of its record and of the next one; reading stops at the first torn
+ * or corrupt record.
+ *
+ * @return the offset after the last record read.
+ */
+template <typename Callback>
+uint64_t scanSegment(const string& path, uint64_t start,
+                     Callback&& callback) {
+    ifstream file(path, ios::binary);
+    file.seekg(static_cast<streamoff>(start));
+    vector<uint8_t> record;
+    uint64_t offset = start;
+    uint8_t header[4];
+    while (file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        auto length = Reader(header, sizeof(header)).readFixed32();
+        if (length < 4 || length > maxRecordSize) {
+            break;
+        }
+        record.resize(length);
+        if (!file.read(reinterpret_cast<char*>(record.data()), length)) {
+            break;
+        }
+        auto payloadSize = length - 4;
+        auto expected = Reader(record.data() + payloadSize, 4).readFixed32();
+        if (checksum(record.data(), payloadSize) != expected) {
+            break;
+        }
+        GatewayEvent event;
+        try {
+            Reader reader(record.data(), payloadSize);
+            event = reader.read<GatewayEvent>();
+        } catch (const DecodeError&) {
+            break;
+        }
+        auto recordStart = offset;
+        offset += 4 + length;
+        if (!callback(event, recordStart, offset)) {
+            break;
+        }
+    }
+    return offset;
+}
+
+} // namespace
+
+Journal::Journal(size_t segmentSize, size_t cacheSize)
+    : _segmentSize(segmentSize), _cacheSize(cacheSize) {}
+
+Journal::~Journal() { close(); }
+
+bool Journal::open(const string& directory) {
+    close();
+    _directory = directory;
+    _segments.clear();
+    _cache.clear();
+    _fingerprintOrder.clear();
+    _fingerprints.clear();
+    _lastSequence = 0;
+    _acknowledged = 0;
+
+    error_code error;
+    filesystem::create_directories(directory, error);
+    if (error) {
+        _error = "Cannot create " + directory + ": " + error.message();
+        return false;
+    }
+    for (const auto& entry : filesystem::directory_iterator(directory, error)) {
+        auto path = entry.path();
+        if (path.extension() != segmentExtension) {
+            continue;
+        }
+        try {
+            auto first = stoull(path.stem().string());
+            _segments.push_back(
+                {first, path.string(), uint64_t(entry.file_size()), {}});
+        } catch (const exception&) {
+            GSM_LOG(Log::Level::Warning, "Ignoring journal file {}",
+                    path.string());
+        }
+    }
+    if (error) {
+        _error = "Cannot read " + directory + ": " + error.message();
+        return false;
+    }
+    sort(_segments.begin(), _segments.end(),
+         [](const Segment& s1, const Segment& s2) {
+             return s1.firstSequence < s2.firstSequence;
+         });
+
+    ifstream acknowledged(filesystem::path(directory) / acknowledgedFile,
+                          ios::binary);
+    uint8_t bytes[8];
+    if (acknowledged.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+        _acknowledged = Reader(bytes, sizeof(bytes)).readFixed64();
+    }
+
+    if (!_segments.empty() && !recover(_segments.back())) {
+        return false;
+    }
+    if (_segments.empty()) {
+        _lastSequence = _acknowledged;
+    }
+    if (!startSegment()) {
+        return false;
+    }
+    GSM_LOG(Log::Level::Info,
+            "Journal {} opened, last event {}, acknowledged {}", directory,
+            _lastSequence, _acknowledged);
+    return true;
+}
+
+void Journal::close() {
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+bool Journal::recover(Segment& segment) {
+    auto last = segment.firstSequence - 1;
+    auto validSize = scanSegment(
+        segment.path, 0,
+        [this, &segment, &last](const GatewayEvent& event, uint64_t start,
+                                uint64_t) {
+            last = event.sequence;
+            addToIndex(segment, event.sequence, start);
+            remember(event);
+            return true;
+        });
+    if (validSize < segment.size) {
+        GSM_LOG(Log::Level::Warning,
+                "Cutting off {} bytes of a torn record in {}",
+                segment.size - validSize, segment.path);
+        error_code error;
+        filesystem::resize_file(segment.path, validSize, error);
+        if (error) {
+            _error = "Cannot repair " + segment.path + ": " + error.message();
+            return false;
+        }
+        segment.size = validSize;
+    }
+    _lastSequence = max(last, _acknowledged);
+    return true;
+}
+
+bool Journal::startSegment() {
+    close();
+    // Continue the last segment while it has room, otherwise start a new one
+    if (_segments.empty() || _segments.back().size >= _segmentSize) {
+        auto path =
+            filesystem::path(_directory) / segmentName(_lastSequence + 1);
+        _segments.push_back({_lastSequence + 1, path.string(), 0, {}});
+    }
+    auto& segment = _segments.back();
+    _fd = ::open(segment.path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (_fd < 0) {
+        _error = "Cannot open " + segment.path + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+uint64_t Journal::append(int64_t timestamp, const string& sender,
+                         const string& text) {
+    if (_fd < 0) {
+        return 0;
+    }
+    if (_segments.back().size >= _segmentSize && !startSegment()) {
+        GSM_LOG(Log::Level::Error, "{}", _error);
+        return 0;
+    }
+    GatewayEvent event{_lastSequence + 1, timestamp, sender, text};
+    _record.clear();
+    Writer writer(_record);
+    writer.writeFixed32(0);
+    writer.write(event);
+    auto payloadSize = _record.size() - 4;
+    writer.writeFixed32(checksum(_record.data() + 4, payloadSize));
+    auto length = static_cast<uint32_t>(payloadSize + 4);
+    for (size_t i = 0; i < 4; ++i) {
+        _record[i] = static_cast<uint8_t>(length >> (8 * i));
+    }
+    if (!writeAll(_fd, _record.data(), _record.size()) ||
+        (_synchronous && ::fdatasync(_fd) != 0)) {
+        GSM_LOG(Log::Level::Error, "Writing the journal failed: {}",
+                strerror(errno));
+        // Drop the partial record, so the next append starts cleanly
+        if (::ftruncate(_fd, static_cast<off_t>(_segments.back().size)) != 0) {
+            close();
+        }
+        return 0;
+    }
+    auto& segment = _segments.back();
+    addToIndex(segment, event.sequence, segment.size);
+    segment.size += _record.size();
+    _lastSequence = event.sequence;
+    remember(event);
+    _cache.push_back(move(event));
+    if (_cache.size() > _cacheSize) {
+        _cache.pop_front();
+    }
+    return _lastSequence;
+}
+
+bool Journal::contains(int64_t timestamp, const string& sender,
+                       const string& text) const {
+    return _fingerprints.count(fingerprint(timestamp, sender, text)) != 0;
+}
+
+void Journal::remember(const GatewayEvent& event) {
+    auto hash = fingerprint(event.timestamp, event.sender, event.text);
+    if (!_fingerprints.insert(hash).second) {
+        return;
+    }
+    _fingerprintOrder.push_back(hash);
+    if (_fingerprintOrder.size() > maxFingerprints) {
+        _fingerprints.erase(_fingerprintOrder.front());
+        _fingerprintOrder.pop_front();
+    }
+}
+
+void Journal::read(uint64_t from, size_t maxCount,
+                   vector<GatewayEvent>& events) {
+    from = max(from, _acknowledged + 1);
+    if (!_cache.empty() && from >= _cache.front().sequence) {
+        for (auto i = from - _cache.front().sequence;
+             i < _cache.size() && events.size() < maxCount; ++i) {
+            events.push_back(_cache[i]);
+        }
+        return;
+    }
+    // Older events: start at the last segment that begins at or before from
+    auto segment = upper_bound(_segments.begin(), _segments.end(), from,
+                               [](uint64_t sequence, const Segment& s) {
+                                   return sequence < s.firstSequence;
+                               });
+    if (segment != _segments.begin()) {
+        --segment;
+    }
+    for (; segment != _segments.end() && events.size() < maxCount;
+         ++segment) {
+        readSegment(*segment, from, maxCount, events);
+    }
+}
+
+void Journal::readSegment(Segment& segment, uint64_t from, size_t maxCount,
+                          vector<GatewayEvent>& events) {
+    // Start at the last indexed record at or before from
+    auto& index = segment.index;
+    auto indexed = upper_bound(index.begin(), index.end(), from,
+                               [](uint64_t sequence,
+                                  const pair<uint64_t, uint64_t>& entry) {
+                                   return sequence < entry.first;
+                               });
+    uint64_t start = 0;
+    if (indexed != index.begin()) {
+        start = prev(indexed)->second;
+    }
+    scanSegment(segment.path, start,
+                [&](GatewayEvent& event, uint64_t recordStart,
+                    uint64_t offset) {
+                    if (offset > segment.size) {
+                        return false;
+                    }
+                    // Segments other than the last are indexed as they are
+                    // read
+                    addToIndex(segment, event.sequence, recordStart);
+                    if (event.sequence >= from) {
+                        events.push_back(move(event));
+                    }
+                    return events.size() < maxCount;
+                });
+}
+
+void Journal::addToIndex(Segment& segment, uint64_t sequence,
+                         uint64_t offset) {
+    auto& index = segment.index;
+    if ((sequence - segment.firstSequence) % indexInterval == 0 &&
+        (index.empty() || index.back().first < sequence)) {
+        index.emplace_back(sequence, offset);
+    }
+}
+
+void Journal::acknowledge(uint64_t sequence) {
+    sequence = min(sequence, _lastSequence);
+    if (sequence <= _acknowledged) {
+        return;
+    }
+    _acknowledged = sequence;
+    writeAcknowledged();
+    // A segment is done when the next one starts at or before the first
+    // unacknowledged event. The active segment is never deleted.
+    size_t done = 0;
+    while (done + 1 < _segments.size() &&
+           _segments[done + 1].firstSequence <= _acknowledged + 1) {
+        error_code error;
+        filesystem::remove(_segments[done].path, error);
+        if (error) {
+            GSM_LOG(Log::Level::Warning, "Cannot delete {}: {}",
+                    _segments[done].path, error.message());
+        }
+        done++;
+    }
+    _segments.erase(_segments.begin(),
+                    _segments.begin() + static_cast<ptrdiff_t>(done));
+}
+
+void Journal::writeAcknowledged() {
+    vector<uint8_t> bytes;
+    Writer(bytes).writeFixed64(_acknowledged);
+    auto path = filesystem::path(_directory) / acknowledgedFile;
+    auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0 || ::pwrite(fd, bytes.data(), bytes.size(), 0) !=
+                      static_cast<ssize_t>(bytes.size())) {
+        GSM_LOG(Log::Level::Warning, "Cannot write {}: {}", path.string(),
+                strerror(errno));
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+uint64_t Journal::diskUsage() const {
+    uint64_t size = 0;
+    for (const auto& segment : _segments) {
+        size += segment.size;
+    }
+    return size;
+}
+
+} // namespace GsmGateway
@@ -0,0 +1,142 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "gatewaylink.h"
+
+using namespace std;
+
+namespace GsmGateway {
+
+using Base::Gateway::GatewayEvent;
+
+/**
+ * @brief A durable, append-only journal of the events the gateway has to
+ * deliver to App. Every event gets the next sequence number and is on disk
+ * before append() returns, so nothing is lost when App is unreachable or the
+ * gateway restarts.
+ *
+ * The journal is a directory of segment files named after the first sequence
+ * number in them. Each record is a fixed32 length, the encoded event and a
+ * fixed32 FNV-1a checksum of the event; a torn record at the end of the last
+ * segment is cut off on open(). Segments whose events have all been
+ * acknowledged are deleted. The most recent events are also kept in a small
+ * cache, so a connected App is usually served without reading the files.
+ * Older events are found through a sparse index of record offsets per
+ * segment, filled in as the segments are written and read, so that an App
+ * catching up batch by batch does not rescan a segment from its start for
+ * every batch.
+ *
+ * Fingerprints of the events in the last segment at open() and of those
+ * appended since, up to a limit, are kept for contains(), so that an SMS
+ * that is read again from the modem after a restart is recognized.
+ *
+ * Not thread safe; the gateway uses it from its io_context thread.
+ */
+class Journal {
+  public:
+    static constexpr size_t defaultSegmentSize = 4 * 1024 * 1024;
+    static constexpr size_t defaultCacheSize = 4096;
+
+    explicit Journal(size_t segmentSize = defaultSegmentSize,
+                     size_t cacheSize = defaultCacheSize);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /**
+     * @brief Opens the journal in the given directory, creating it if needed,
+     * and recovers the existing segments.
+     *
+     * @return true on success, false on failure. See errorString().
+     */
+    bool open(const string& directory);
+
+    void close();
+
+    /**
+     * @brief Appends an event and writes it to disk.
+     *
+     * @return the sequence number of the event, or 0 if writing failed.
+     */
+    uint64_t append(int64_t timestamp, const string& sender,
+                    const string& text);
+
+    /**
+     * @brief Returns whether a recent event has this content.
+     */
+    bool contains(int64_t timestamp, const string& sender,
+                  const string& text) const;
+
+    /**
+     * @brief Reads up to maxCount events, starting at the given sequence
+     * number or the first one after it that still exists.
+     */
+    void read(uint64_t from, size_t maxCount, vector<GatewayEvent>& events);
+
+    /**
+     * @brief Records that App has processed every event up to the given
+     * sequence number and deletes the segments that are no longer needed.
+     */
+    void acknowledge(uint64_t sequence);
+
+    /**
+     * @brief Sets whether append() waits for the event to reach the disk
+     * (fdatasync). On by default.
+     */
+    void setSynchronous(bool synchronous) { _synchronous = synchronous; }
+
+    uint64_t lastSequence() const { return _lastSequence; }
+
+    uint64_t acknowledged() const { return _acknowledged; }
+
+    /**
+     * @brief Returns the number of bytes in the segment files.
+     */
+    uint64_t diskUsage() const;
+
+    string errorString() const { return _error; }
+
+  private:
+    struct Segment {
+        uint64_t firstSequence;
+        string path;
+        uint64_t size;
+        // The offsets of every indexInterval-th record, in sequence order
+        vector<pair<uint64_t, uint64_t>> index;
+    };
+
+    bool recover(Segment& segment);
+    bool startSegment();
+    void readSegment(Segment& segment, uint64_t from, size_t maxCount,
+                     vector<GatewayEvent>& events);
+    static void addToIndex(Segment& segment, uint64_t sequence,
+                           uint64_t offset);
+    void writeAcknowledged();
+    void remember(const GatewayEvent& event);
+
+    size_t _segmentSize;
+    size_t _cacheSize;
+    bool _synchronous = true;
+    string _directory;
+    vector<Segment> _segments;
+    int _fd = -1;
+    uint64_t _lastSequence = 0;
+    uint64_t _acknowledged = 0;
+    deque<GatewayEvent> _cache;
+    // The fingerprints for contains(), oldest first
+    deque<uint64_t> _fingerprintOrder;
+    unordered_set<uint64_t> _fingerprints;
+    vector<uint8_t> _record;
+    string _error;
+};
+
+} // namespace GsmGateway
+
+#endif // JOURNAL_H
@@ -0,0 +1,551 @@
+#include "log.h"
+
+#include <algorithm>
+#include <ctime>
+
+namespace GsmGateway::Log {
+
+using Base::Serialization::DecodeError;
+using Base::Serialization::Reader;
+using Base::Serialization::Writer;
+
+namespace {
+
+// How often the logger thread drains the buffers when nobody asks it to
+constexpr auto drainInterval = chrono::milliseconds(20);
+
+// Upper bounds that protect the decoder from corrupt files
+constexpr uint64_t maxSites = 1u << 20;
+constexpr uint64_t maxThreads = 1u << 16;
+
+/**
+ * @brief Deregisters the buffer of a thread when the thread exits.
+ */
+struct ThreadHandle {
+    shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadHandle() {
+        if (buffer) {
+            buffer->close();
+        }
+    }
+};
+
+thread_local ThreadHandle threadHandle;
+
+template <typename T> T readRaw(const uint8_t*& position) {
+    T value;
+    memcpy(&value, position, sizeof(value));
+    position += sizeof(value);
+    return value;
+}
+
+void appendEscaped(string& line, const uint8_t* data, size_t size) {
+    static const char digits[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < size; ++i) {
+        auto c = static_cast<char>(data[i]);
+        switch (c) {
+        case '\r':
+            line += "\\r";
+            break;
+        case '\n':
+            line += "\\n";
+            break;
+        case '\t':
+            line += "\\t";
+            break;
+        case '\\':
+            line += "\\\\";
+            break;
+        default:
+            if (data[i] < 0x20 || data[i] == 0x7f) {
+                line += "\\x";
+                line += digits[data[i] >> 4];
+                line += digits[data[i] & 0xf];
+            } else {
+                line += c;
+            }
+        }
+    }
+}
+
+void appendHex(string& line, const uint8_t* data, size_t size) {
+    static const char digits[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < size; ++i) {
+        line += digits[data[i] >> 4];
+        line += digits[data[i] & 0xf];
+    }
+}
+
+void appendArg(string& line, ArgType type, Reader& reader) {
+    switch (type) {
+    case ArgType::Int:
+        line += to_string(reader.readSignedVarint());
+        break;
+    case ArgType::UInt:
+        line += to_string(reader.readVarint());
+        break;
+    case ArgType::Double: {
+        char text[32];
+        snprintf(text, sizeof(text), "%g", reader.read<double>());
+        line += text;
+        break;
+    }
+    case ArgType::Bool:
+        line += reader.readByte() != 0 ? "true" : "false";
+        break;
+    case ArgType::Char: {
+        auto c = reader.readByte();
+        appendEscaped(line, &c, 1);
+        break;
+    }
+    case ArgType::String: {
+        auto size = reader.readVarint();
+        appendEscaped(line, reader.readBytes(size), size);
+        break;
+    }
+    case ArgType::Bytes: {
+        auto size = reader.readVarint();
+        appendHex(line, reader.readBytes(size), size);
+        break;
+    }
+    default:
+        throw DecodeError("Unknown argument type");
+    }
+}
+
+} // namespace
+
+const char* levelName(Level level) {
+    switch (level) {
+    case Level::Trace:
+        return "TRACE";
+    case Level::Debug:
+        return "DEBUG";
+    case Level::Info:
+        return "INFO";
+    case Level::Warning:
+        return "WARNING";
+    case Level::Error:
+        return "ERROR";
+    }
+    return "?";
+}
+
+Logger::~Logger() { close(); }
+
+bool Logger::open(const string& fileName) {
+    close();
+    lock_guard<mutex> lock(_mutex);
+    _file.open(fileName, ios::binary | ios::app);
+    if (!_file) {
+        return false;
+    }
+    _decoder = LogDecoder();
+    writeStart();
+    _running = true;
+    _stopping = false;
+    _threshold.store(static_cast<uint8_t>(_level), memory_order_relaxed);
+    _thread = thread(&Logger::run, this);
+    return true;
+}
+
+void Logger::close() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (!_running) {
+            return;
+        }
+        _threshold.store(UINT8_MAX, memory_order_relaxed);
+        _stopping = true;
+    }
+    _wakeUp.notify_one();
+    _thread.join();
+    lock_guard<mutex> lock(_mutex);
+    _running = false;
+    _file.close();
+}
+
+void Logger::flush() {
+    unique_lock<mutex> lock(_mutex);
+    if (!_running) {
+        return;
+    }
+    // Wait for a drain that starts after this call
+    auto target = _drainCount + (_draining ? 2 : 1);
+    _flushRequests++;
+    _wakeUp.notify_one();
+    _drained.wait(lock, [&] { return _drainCount >= target || !_running; });
+}
+
+void Logger::setTextOutput(ostream* stream, Level minimum) {
+    lock_guard<mutex> lock(_mutex);
+    _textStream = stream;
+    _textLevel = minimum;
+    if (_running && stream != nullptr) {
+        // The decoder has not seen the sites and threads so far, so start a
+        // new session in the file that repeats them
+        _decoder = LogDecoder();
+        writeStart();
+    }
+}
+
+void Logger::setLevel(Level level) {
+    lock_guard<mutex> lock(_mutex);
+    _level = level;
+    if (_running) {
+        _threshold.store(static_cast<uint8_t>(level), memory_order_relaxed);
+    }
+}
+
+void Logger::setThreadName(const string& name) {
+    auto& buffer = threadBuffer();
+    lock_guard<mutex> lock(_mutex);
+    for (auto& thread : _threads) {
+        if (thread->buffer.get() == &buffer) {
+            thread->name = name;
+        }
+    }
+}
+
+void Logger::setBufferSize(size_t size) {
+    lock_guard<mutex> lock(_mutex);
+    _bufferSize = 64;
+    while (_bufferSize < size) {
+        _bufferSize *= 2;
+    }
+}
+
+uint64_t Logger::dropped() const {
+    lock_guard<mutex> lock(_mutex);
+    auto dropped = _droppedTotal;
+    for (const auto& thread : _threads) {
+        dropped += thread->buffer->dropped() - thread->writtenDropped;
+    }
+    return dropped;
+}
+
+ThreadBuffer& Logger::threadBuffer() {
+    if (!threadHandle.buffer) {
+        threadHandle.buffer = createThreadBuffer();
+    }
+    return *threadHandle.buffer;
+}
+
+shared_ptr<ThreadBuffer> Logger::createThreadBuffer() {
+    lock_guard<mutex> lock(_mutex);
+    auto buffer = make_shared<ThreadBuffer>(_nextThreadId++, _bufferSize);
+    auto thread = make_unique<ThreadInfo>();
+    thread->buffer = buffer;
+    _threads.push_back(move(thread));
+    return buffer;
+}
+
+uint32_t Logger::registerSite(Site& site, Level level, const char* file,
+                              int line, const char* format,
+                              vector<ArgType> types) {
+    lock_guard<mutex> lock(_mutex);
+    // Another thread may have registered the site in the meantime
+    auto id = site.id.load(memory_order_relaxed);
+    if (id != 0) {
+        return id;
+    }
+    _sites.push_back(SiteInfo{level, file, line, format, move(types)});
+    id = static_cast<uint32_t>(_sites.size());
+    site.id.store(id, memory_order_release);
+    return id;
+}
+
+void Logger::run() {
+    unique_lock<mutex> lock(_mutex);
+    while (true) {
+        _wakeUp.wait_for(lock, drainInterval, [this] {
+            return _stopping || _flushRequests != _flushRequestsHandled;
+        });
+        _flushRequestsHandled = _flushRequests;
+        _draining = true;
+        auto stopping = _stopping;
+        lock.unlock();
+        drain();
+        lock.lock();
+        _draining = false;
+        _drainCount++;
+        _drained.notify_all();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void Logger::drain() {
+    struct Pending {
+        int64_t timestamp;
+        size_t thread;
+        const uint8_t* entry;
+    };
+
+    // Other threads only add to the thread list, so the ThreadInfos stay
+    // put while the entries are read without holding the lock
+    vector<ThreadInfo*> threads;
+    {
+        lock_guard<mutex> lock(_mutex);
+        for (auto& thread : _threads) {
+            threads.push_back(thread.get());
+        }
+    }
+    vector<Pending> pending;
+    vector<size_t> positions(threads.size());
+    for (size_t i = 0; i < threads.size(); ++i) {
+        positions[i] = threads[i]->buffer->forEach(
+            [&](const uint8_t* entry, uint32_t) {
+                int64_t timestamp;
+                memcpy(&timestamp, entry + 8, 8);
+                pending.push_back(Pending{timestamp, i, entry});
+            });
+    }
+    stable_sort(pending.begin(), pending.end(),
+                [](const Pending& p1, const Pending& p2) {
+                    return p1.timestamp < p2.timestamp;
+                });
+
+    lock_guard<mutex> lock(_mutex);
+    Writer writer(_records);
+    for (; _sitesWritten < _sites.size(); ++_sitesWritten) {
+        const auto& site = _sites[_sitesWritten];
+        writer.writeByte(static_cast<uint8_t>(RecordKind::Site));
+        writer.writeVarint(_sitesWritten + 1);
+        writer.writeByte(static_cast<uint8_t>(site.level));
+        writer.write(site.file);
+        writer.writeVarint(static_cast<uint64_t>(site.line));
+        writer.write(site.format);
+        writer.writeVarint(site.types.size());
+        for (auto type : site.types) {
+            writer.writeByte(static_cast<uint8_t>(type));
+        }
+    }
+    for (auto thread : threads) {
+        if (thread->name != thread->writtenName) {
+            writer.writeByte(static_cast<uint8_t>(RecordKind::Thread));
+            writer.writeVarint(thread->buffer->id());
+            writer.write(thread->name);
+            thread->writtenName = thread->name;
+        }
+    }
+    for (const auto& entry : pending) {
+        writeEntryRecord(*threads[entry.thread], entry.entry);
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        auto thread = threads[i];
+        thread->buffer->release(positions[i]);
+        auto dropped = thread->buffer->dropped();
+        if (dropped != thread->writtenDropped) {
+            writer.writeByte(static_cast<uint8_t>(RecordKind::Dropped));
+            writer.writeVarint(thread->buffer->id());
+            writer.writeVarint(dropped - thread->writtenDropped);
+            _droppedTotal += dropped - thread->writtenDropped;
+            thread->writtenDropped = dropped;
+        }
+    }
+    output();
+
+    // Forget the threads that have exited and whose entries are all written
+    _threads.erase(remove_if(_threads.begin(), _threads.end(),
+                             [](const unique_ptr<ThreadInfo>& thread) {
+                                 return thread->buffer->isClosed() &&
+                                        thread->buffer->isEmpty() &&
+                                        thread->buffer->dropped() ==
+                                            thread->writtenDropped;
+                             }),
+                   _threads.end());
+}
+
+void Logger::writeStart() {
+    _sitesWritten = 0;
+    for (auto& thread : _threads) {
+        thread->writtenName.clear();
+    }
+    Writer writer(_records);
+    writer.writeByte(static_cast<uint8_t>(RecordKind::Start));
+    writer.writeFixed32(fileMagic);
+    writer.writeSignedVarint(
+        chrono::duration_cast<chrono::microseconds>(
+            chrono::system_clock::now().time_since_epoch())
+            .count());
+    writer.writeSignedVarint(
+        chrono::steady_clock::now().time_since_epoch().count());
+    output();
+}
+
+void Logger::writeEntryRecord(const ThreadInfo& thread, const uint8_t* entry) {
+    uint32_t site;
+    int64_t timestamp;
+    memcpy(&site, entry + 4, 4);
+    memcpy(&timestamp, entry + 8, 8);
+    Writer writer(_records);
+    writer.writeByte(static_cast<uint8_t>(RecordKind::Entry));
+    writer.writeVarint(site);
+    writer.writeVarint(thread.buffer->id());
+    writer.writeSignedVarint(timestamp);
+    auto position = entry + ThreadBuffer::headerSize;
+    for (auto type : _sites[site - 1].types) {
+        switch (type) {
+        case ArgType::Int:
+            writer.writeSignedVarint(readRaw<int64_t>(position));
+            break;
+        case ArgType::UInt:
+            writer.writeVarint(readRaw<uint64_t>(position));
+            break;
+        case ArgType::Double:
+            writer.write(readRaw<double>(position));
+            break;
+        case ArgType::Bool:
+        case ArgType::Char:
+            writer.writeByte(readRaw<uint8_t>(position));
+            break;
+        case ArgType::String:
+        case ArgType::Bytes: {
+            auto size = readRaw<uint32_t>(position);
+            writer.writeVarint(size);
+            writer.writeBytes(position, size);
+            position += size;
+            break;
+        }
+        }
+    }
+}
+
+void Logger::output() {
+    if (_records.empty()) {
+        return;
+    }
+    _file.write(reinterpret_cast<const char*>(_records.data()),
+                static_cast<streamsize>(_records.size()));
+    _file.flush();
+    if (_textStream != nullptr) {
+        // The text is decoded from the records just written, exactly as the
+        // offline decoder would do it
+        Reader reader(_records.data(), _records.size());
+        Level level;
+        while (!reader.atEnd()) {
+            if (_decoder.decode(reader, level, _text) && level >= _textLevel) {
+                *_textStream << _text << '\n';
+            }
+        }
+        _textStream->flush();
+    }
+    _records.clear();
+}
+
+bool LogDecoder::decode(Reader& reader, Level& level, string& line) {
+    line.clear();
+    auto kind = static_cast<RecordKind>(reader.readByte());
+    switch (kind) {
+    case RecordKind::Start:
+        if (reader.readFixed32() != fileMagic) {
+            throw DecodeError("Not a log file");
+        }
+        _systemMicros = reader.readSignedVarint();
+        _steadyNanos = reader.readSignedVarint();
+        _sites.clear();
+        _threadNames.clear();
+        return false;
+    case RecordKind::Site: {
+        auto id = reader.readVarint();
+        if (id == 0 || id > maxSites) {
+            throw DecodeError("Bad site ID");
+        }
+        SiteInfo site;
+        site.level = static_cast<Level>(reader.readByte());
+        auto file = reader.read<string>();
+        auto slash = file.find_last_of("/\\");
+        auto name = slash == string::npos ? file : file.substr(slash + 1);
+        site.location = name + ":" + to_string(reader.readVarint());
+        site.format = reader.read<string>();
+        auto count = reader.readVarint();
+        auto types = reader.readBytes(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            site.types.push_back(static_cast<ArgType>(types[i]));
+        }
+        if (_sites.size() < id) {
+            _sites.resize(id);
+        }
+        _sites[id - 1] = move(site);
+        return false;
+    }
+    case RecordKind::Thread: {
+        auto id = reader.readVarint();
+        if (id > maxThreads) {
+            throw DecodeError("Bad thread ID");
+        }
+        if (_threadNames.size() <= id) {
+            _threadNames.resize(id + 1);
+        }
+        _threadNames[id] = reader.read<string>();
+        return false;
+    }
+    case RecordKind::Entry: {
+        auto id = reader.readVarint();
+        if (id == 0 || id > _sites.size()) {
+            throw DecodeError("Unknown site");
+        }
+        const auto& site = _sites[id - 1];
+        auto thread = reader.readVarint();
+        appendTime(line, reader.readSignedVarint());
+        line += ' ';
+        line += levelName(site.level);
+        line += ' ';
+        appendThread(line, thread);
+        line += ' ';
+        size_t argument = 0;
+        for (size_t i = 0; i < site.format.size(); ++i) {
+            if (site.format.compare(i, 2, "{}") == 0 &&
+                argument < site.types.size()) {
+                appendArg(line, site.types[argument++], reader);
+                ++i;
+            } else {
+                line += site.format[i];
+            }
+        }
+        for (; argument < site.types.size(); ++argument) {
+            line += ' ';
+            appendArg(line, site.types[argument], reader);
+        }
+        line += " (" + site.location + ")";
+        level = site.level;
+        return true;
+    }
+    case RecordKind::Dropped: {
+        auto thread = reader.readVarint();
+        auto count = reader.readVarint();
+        line = "- WARNING ";
+        appendThread(line, thread);
+        line += " Dropped " + to_string(count) + " entries";
+        level = Level::Warning;
+        return true;
+    }
+    default:
+        throw DecodeError("Unknown record kind");
+    }
+}
+
+void LogDecoder::appendTime(string& line, int64_t timestamp) const {
+    auto micros = _systemMicros + (timestamp - _steadyNanos) / 1000;
+    auto seconds = static_cast<time_t>(micros / 1000000);
+    tm time;
+    gmtime_r(&seconds, &time);
+    char text[40];
+    auto size = strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &time);
+    snprintf(text + size, sizeof(text) - size, ".%06dZ",
+             static_cast<int>(micros % 1000000));
+    line += text;
+}
+
+void LogDecoder::appendThread(string& line, uint64_t thread) const {
+    if (thread < _threadNames.size() && !_threadNames[thread].empty()) {
+        line += "[" + _threadNames[thread] + "]";
+    } else {
+        line += "[" + to_string(thread) + "]";
+    }
+}
+
+} // namespace GsmGateway::Log
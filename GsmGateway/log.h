@@ -0,0 +1,532 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+#include "codec.h"
+
+/*
+ * A binary logger for the hot paths of the gateway. A log statement does not
+ * format anything: it copies a call site ID, a timestamp and its raw
+ * arguments into a lock free buffer owned by the calling thread. A background
+ * thread drains the buffers, writes compact binary records to the log file and,
+ * if enabled, formats text lines. Binary log files are turned into text
+ * offline with GsmLogDecoder.
+ *
+ * GSM_LOG(Level::Debug, "Sent {} to {}", command, port);
+ * GSM_LOG(Level::Trace, "PDU {}", Log::bytes(pdu.data(), pdu.size()));
+ *
+ * Every {} in the format is replaced by the next argument. Strings are escaped
+ * so that AT exchanges with control characters stay on one line, and Bytes
+ * are written as hex.
+ */
+namespace GsmGateway::Log {
+
+enum class Level : uint8_t { Trace, Debug, Info, Warning, Error };
+
+/**
+ * @brief Returns the name of the level, e.g. "INFO".
+ */
+const char* levelName(Level level);
+
+/**
+ * @brief The types that log arguments are stored as.
+ */
+enum class ArgType : uint8_t { Int, UInt, Double, Bool, Char, String, Bytes };
+
+/**
+ * @brief Binary data, such as a PDU, that is logged as hex. The data is copied
+ * when the statement is logged.
+ */
+struct Bytes {
+    const uint8_t* data;
+    size_t size;
+};
+
+inline Bytes bytes(const void* data, size_t size) {
+    return Bytes{static_cast<const uint8_t*>(data), size};
+}
+
+/**
+ * @brief Maps the types of log arguments to the types they are stored as.
+ * convert() turns an argument into its stored representation.
+ */
+template <typename T, typename Enable = void> struct ArgTraits;
+
+template <> struct ArgTraits<bool> {
+    static constexpr ArgType type = ArgType::Bool;
+    static bool convert(bool value) { return value; }
+};
+
+template <> struct ArgTraits<char> {
+    static constexpr ArgType type = ArgType::Char;
+    static char convert(char value) { return value; }
+};
+
+template <typename T>
+struct ArgTraits<T, enable_if_t<is_integral_v<T> && is_signed_v<T> &&
+                                !is_same_v<T, char>>> {
+    static constexpr ArgType type = ArgType::Int;
+    static int64_t convert(T value) { return value; }
+};
+
+template <typename T>
+struct ArgTraits<T, enable_if_t<is_integral_v<T> && is_unsigned_v<T> &&
+                                !is_same_v<T, bool> && !is_same_v<T, char>>> {
+    static constexpr ArgType type = ArgType::UInt;
+    static uint64_t convert(T value) { return value; }
+};
+
+template <typename T> struct ArgTraits<T, enable_if_t<is_enum_v<T>>> {
+    using Underlying = underlying_type_t<T>;
+    static constexpr ArgType type = ArgTraits<Underlying>::type;
+    static auto convert(T value) {
+        return ArgTraits<Underlying>::convert(static_cast<Underlying>(value));
+    }
+};
+
+template <typename T>
+struct ArgTraits<T, enable_if_t<is_floating_point_v<T>>> {
+    static constexpr ArgType type = ArgType::Double;
+    static double convert(T value) { return value; }
+};
+
+template <> struct ArgTraits<const char*> {
+    static constexpr ArgType type = ArgType::String;
+    static string_view convert(const char* value) {
+        return value != nullptr ? string_view(value) : string_view();
+    }
+};
+
+template <> struct ArgTraits<char*> : ArgTraits<const char*> {};
+
+template <> struct ArgTraits<string_view> {
+    static constexpr ArgType type = ArgType::String;
+    static string_view convert(string_view value) { return value; }
+};
+
+template <> struct ArgTraits<string> : ArgTraits<string_view> {};
+
+template <> struct ArgTraits<Bytes> {
+    static constexpr ArgType type = ArgType::Bytes;
+    static Bytes convert(const Bytes& value) { return value; }
+};
+
+/**
+ * @brief The static state of a log statement. Every GSM_LOG expansion has its
+ * own site, which is registered with the logger the first time it is hit.
+ */
+struct Site {
+    atomic<uint32_t> id{0};
+};
+
+/**
+ * @brief A single producer, single consumer ring buffer of log entries. Only
+ * the owning thread writes to it and only the logger thread reads from it.
+ *
+ * Entries are contiguous and 8 byte aligned: fixed32 size (including the
+ * header and padding), fixed32 site ID, 64 bit timestamp, arguments. An entry
+ * with site ID 0 is padding up to the end of the buffer.
+ */
+class ThreadBuffer {
+  public:
+    static constexpr size_t headerSize = 16;
+
+    /**
+     * @brief Creates a new ThreadBuffer.
+     *
+     * @param id the ID of the thread in the log.
+     * @param capacity the capacity in bytes, a power of two.
+     */
+    explicit ThreadBuffer(uint32_t id, size_t capacity)
+        : _id(id), _data(capacity), _mask(capacity - 1) {}
+
+    uint32_t id() const { return _id; }
+
+    /**
+     * @brief Reserves space for an entry. Called by the owning thread.
+     *
+     * @param size the size of the entry, a multiple of 8.
+     * @return the space, or nullptr if the buffer is full. The entry is
+     * dropped in that case.
+     */
+    uint8_t* reserve(size_t size) {
+        auto head = _head.load(memory_order_relaxed);
+        auto offset = head & _mask;
+        auto contiguous = _data.size() - offset;
+        auto padding = size <= contiguous ? 0 : contiguous;
+        if (head + padding + size - _cachedTail > _data.size()) {
+            _cachedTail = _tail.load(memory_order_acquire);
+            if (head + padding + size - _cachedTail > _data.size()) {
+                _dropped.store(_dropped.load(memory_order_relaxed) + 1,
+                               memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        if (padding > 0) {
+            auto paddingSize = static_cast<uint32_t>(padding);
+            memcpy(_data.data() + offset, &paddingSize, 4);
+            memset(_data.data() + offset + 4, 0, 4);
+            offset = 0;
+        }
+        _reserved = padding + size;
+        return _data.data() + offset;
+    }
+
+    /**
+     * @brief Publishes the entry written into the last reserved space.
+     */
+    void commit() {
+        _head.store(_head.load(memory_order_relaxed) + _reserved,
+                    memory_order_release);
+    }
+
+    /**
+     * @brief Calls the given function with every published entry that has
+     * not been released. Called by the logger thread.
+     *
+     * @param function called with the entry and its size.
+     * @return the position to pass to release() when the entries have been
+     * processed.
+     */
+    template <typename Function> size_t forEach(Function&& function) const {
+        auto position = _tail.load(memory_order_relaxed);
+        auto head = _head.load(memory_order_acquire);
+        while (position < head) {
+            auto entry = _data.data() + (position & _mask);
+            uint32_t size, site;
+            memcpy(&size, entry, 4);
+            memcpy(&site, entry + 4, 4);
+            if (site != 0) {
+                function(entry, size);
+            }
+            position += size;
+        }
+        return position;
+    }
+
+    /**
+     * @brief Frees the space of the entries before the given position.
+     */
+    void release(size_t position) {
+        _tail.store(position, memory_order_release);
+    }
+
+    bool isEmpty() const {
+        return _tail.load(memory_order_relaxed) ==
+               _head.load(memory_order_acquire);
+    }
+
+    /**
+     * @brief Returns the number of entries dropped because the buffer was
+     * full.
+     */
+    uint64_t dropped() const { return _dropped.load(memory_order_relaxed); }
+
+    /**
+     * @brief Marks the buffer as closed when its thread exits. The logger
+     * thread discards it once it has been drained.
+     */
+    void close() { _closed.store(true, memory_order_release); }
+
+    bool isClosed() const { return _closed.load(memory_order_acquire); }
+
+  private:
+    uint32_t _id;
+    vector<uint8_t> _data;
+    size_t _mask;
+    atomic<bool> _closed{false};
+
+    // Written by the owning thread
+    alignas(64) atomic<size_t> _head{0};
+    size_t _cachedTail = 0;
+    size_t _reserved = 0;
+    atomic<uint64_t> _dropped{0};
+
+    // Written by the logger thread
+    alignas(64) atomic<size_t> _tail{0};
+};
+
+/**
+ * @brief The kinds of records in a binary log file.
+ */
+enum class RecordKind : uint8_t {
+    // Starts a logging session: fixed32 magic, signed varint wall clock time
+    // in microseconds and signed varint steady clock time in nanoseconds at
+    // the same instant
+    Start = 0,
+    // varint ID, byte level, string file, varint line, string format, varint
+    // argument count, argument types
+    Site = 1,
+    // varint ID, string name
+    Thread = 2,
+    // varint site, varint thread, signed varint steady clock time, arguments
+    Entry = 3,
+    // varint thread, varint number of entries dropped since the last record
+    Dropped = 4,
+};
+
+constexpr uint32_t fileMagic = 0x474f4c47; // "GLOG"
+
+/**
+ * @brief Decodes the records of a binary log file into text lines.
+ */
+class LogDecoder {
+  public:
+    /**
+     * @brief Decodes the next record.
+     *
+     * @param reader the records.
+     * @param level receives the level of the line.
+     * @param line receives the formatted line.
+     * @return true if the record produced a line, false if it only updated
+     * the state of the decoder.
+     * @throws Base::Serialization::DecodeError if the record is truncated or
+     * malformed.
+     */
+    bool decode(Base::Serialization::Reader& reader, Level& level,
+                string& line);
+
+  private:
+    struct SiteInfo {
+        Level level = Level::Info;
+        string location;
+        string format;
+        vector<ArgType> types;
+    };
+
+    void appendTime(string& line, int64_t timestamp) const;
+    void appendThread(string& line, uint64_t thread) const;
+
+    int64_t _systemMicros = 0;
+    int64_t _steadyNanos = 0;
+    vector<SiteInfo> _sites;
+    vector<string> _threadNames;
+};
+
+/**
+ * @brief The process wide logger. Nothing is logged until open() has been
+ * called.
+ */
+class Logger {
+  public:
+    static constexpr size_t defaultBufferSize = 1024 * 1024;
+
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    ~Logger();
+
+    /**
+     * @brief Starts writing binary records to the given file. Records are
+     * appended to an existing file.
+     *
+     * @return true on success, false if the file could not be opened.
+     */
+    bool open(const string& fileName);
+
+    /**
+     * @brief Drains all buffers and stops logging.
+     */
+    void close();
+
+    /**
+     * @brief Blocks until everything logged so far has been written.
+     */
+    void flush();
+
+    /**
+     * @brief Also writes formatted lines to the given stream. The lines are
+     * formatted on the logger thread.
+     *
+     * @param stream the stream, or nullptr to disable text output.
+     * @param minimum the lowest level written to the stream.
+     */
+    void setTextOutput(ostream* stream, Level minimum = Level::Info);
+
+    /**
+     * @brief Sets the lowest level that is logged at all.
+     */
+    void setLevel(Level level);
+
+    /**
+     * @brief Checks if statements of the given level are logged.
+     */
+    bool isEnabled(Level level) const {
+        return static_cast<uint8_t>(level) >=
+               _threshold.load(memory_order_relaxed);
+    }
+
+    /**
+     * @brief Names the calling thread in the log.
+     */
+    void setThreadName(const string& name);
+
+    /**
+     * @brief Sets the size of the buffers of threads that have not logged
+     * anything yet.
+     */
+    void setBufferSize(size_t size);
+
+    /**
+     * @brief Returns the number of entries dropped because a thread logged
+     * faster than the logger thread could drain its buffer.
+     */
+    uint64_t dropped() const;
+
+    /**
+     * @brief Logs a statement. Use GSM_LOG instead of calling this directly.
+     */
+    template <typename... Args>
+    void log(Site& site, Level level, const char* file, int line,
+             const char* format, const Args&... args) {
+        auto id = site.id.load(memory_order_acquire);
+        if (id == 0) {
+            id = registerSite(site, level, file, line, format,
+                              {ArgTraits<decay_t<Args>>::type...});
+        }
+        writeEntry(id, ArgTraits<decay_t<Args>>::convert(args)...);
+    }
+
+  private:
+    struct SiteInfo {
+        Level level;
+        string file;
+        int line;
+        string format;
+        vector<ArgType> types;
+    };
+
+    struct ThreadInfo {
+        shared_ptr<ThreadBuffer> buffer;
+        string name;
+        string writtenName;
+        uint64_t writtenDropped = 0;
+    };
+
+    explicit Logger() = default;
+
+    static size_t argSize(int64_t) { return 8; }
+    static size_t argSize(uint64_t) { return 8; }
+    static size_t argSize(double) { return 8; }
+    static size_t argSize(bool) { return 1; }
+    static size_t argSize(char) { return 1; }
+    static size_t argSize(string_view value) { return 4 + value.size(); }
+    static size_t argSize(const Bytes& value) { return 4 + value.size; }
+
+    template <typename T> static uint8_t* writeArg(uint8_t* position, T value) {
+        memcpy(position, &value, sizeof(value));
+        return position + sizeof(value);
+    }
+
+    static uint8_t* writeArg(uint8_t* position, string_view value) {
+        return writeArg(position, value.data(), value.size());
+    }
+
+    static uint8_t* writeArg(uint8_t* position, const Bytes& value) {
+        return writeArg(position, value.data, value.size);
+    }
+
+    static uint8_t* writeArg(uint8_t* position, const void* data,
+                             size_t size) {
+        auto length = static_cast<uint32_t>(size);
+        memcpy(position, &length, 4);
+        memcpy(position + 4, data, size);
+        return position + 4 + size;
+    }
+
+    template <typename... Values>
+    void writeEntry(uint32_t site, const Values&... values) {
+        auto& buffer = threadBuffer();
+        auto size = (ThreadBuffer::headerSize + ... + argSize(values));
+        size = (size + 7) & ~size_t(7);
+        auto entry = buffer.reserve(size);
+        if (entry == nullptr) {
+            return;
+        }
+        auto size32 = static_cast<uint32_t>(size);
+        int64_t timestamp =
+            chrono::steady_clock::now().time_since_epoch().count();
+        memcpy(entry, &size32, 4);
+        memcpy(entry + 4, &site, 4);
+        memcpy(entry + 8, &timestamp, 8);
+        auto position = entry + ThreadBuffer::headerSize;
+        ((position = writeArg(position, values)), ...);
+        buffer.commit();
+    }
+
+    ThreadBuffer& threadBuffer();
+    shared_ptr<ThreadBuffer> createThreadBuffer();
+    uint32_t registerSite(Site& site, Level level, const char* file, int line,
+                          const char* format, vector<ArgType> types);
+    void run();
+    void drain();
+    void writeStart();
+    void writeEntryRecord(const ThreadInfo& thread, const uint8_t* entry);
+    void output();
+
+    atomic<uint8_t> _threshold{UINT8_MAX};
+    Level _level = Level::Debug;
+
+    // Guards everything below
+    mutable mutex _mutex;
+    condition_variable _wakeUp;
+    condition_variable _drained;
+    vector<SiteInfo> _sites;
+    vector<unique_ptr<ThreadInfo>> _threads;
+    uint32_t _nextThreadId = 1;
+    size_t _bufferSize = defaultBufferSize;
+    ostream* _textStream = nullptr;
+    Level _textLevel = Level::Info;
+    bool _running = false;
+    bool _stopping = false;
+    uint64_t _flushRequests = 0;
+    uint64_t _flushRequestsHandled = 0;
+    bool _draining = false;
+    uint64_t _drainCount = 0;
+    uint64_t _droppedTotal = 0;
+
+    // Only used by the logger thread while it runs
+    thread _thread;
+    ofstream _file;
+    size_t _sitesWritten = 0;
+    vector<uint8_t> _records;
+    LogDecoder _decoder;
+    string _text;
+};
+
+} // namespace GsmGateway::Log
+
+/**
+ * @brief Logs a statement if its level is enabled. The arguments are only
+ * evaluated in that case.
+ */
+#define GSM_LOG(level, ...)                                                    \
+    do {                                                                       \
+        static ::GsmGateway::Log::Site gsmLogSite;                             \
+        auto& gsmLogger = ::GsmGateway::Log::Logger::instance();               \
+        if (gsmLogger.isEnabled(level)) {                                      \
+            gsmLogger.log(gsmLogSite, level, __FILE__, __LINE__,               \
+                          __VA_ARGS__);                                        \
+        }                                                                      \
+    } while (false)
+
+#endif // LOG_H
@@ -0,0 +1,68 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "log.h"
+
+using namespace std;
+using namespace GsmGateway::Log;
+
+/*
+ * Prints a binary log file written by the gateway as text:
+ *
+ * GsmLogDecoder gateway.log [minimum level]
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        cerr << "Usage: " << argv[0]
+             << " <log file> [trace|debug|info|warning|error]" << endl;
+        return 2;
+    }
+    auto minimum = Level::Trace;
+    if (argc == 3) {
+        string name = argv[2];
+        const Level levels[] = {Level::Trace, Level::Debug, Level::Info,
+                                Level::Warning, Level::Error};
+        const char* names[] = {"trace", "debug", "info", "warning", "error"};
+        bool found = false;
+        for (size_t i = 0; i < size(levels); ++i) {
+            if (name == names[i]) {
+                minimum = levels[i];
+                found = true;
+            }
+        }
+        if (!found) {
+            cerr << "Unknown level " << name << endl;
+            return 2;
+        }
+    }
+
+    ifstream file(argv[1], ios::binary);
+    if (!file) {
+        cerr << "Cannot open " << argv[1] << endl;
+        return 1;
+    }
+    vector<uint8_t> data((istreambuf_iterator<char>(file)),
+                         istreambuf_iterator<char>());
+
+    LogDecoder decoder;
+    Base::Serialization::Reader reader(data.data(), data.size());
+    Level level;
+    string line;
+    size_t offset = 0;
+    try {
+        while (!reader.atEnd()) {
+            offset = data.size() - reader.remaining();
+            if (decoder.decode(reader, level, line) && level >= minimum) {
+                cout << line << '\n';
+            }
+        }
+    } catch (const Base::Serialization::DecodeError& error) {
+        // The gateway may have died in the middle of writing a record
+        cerr << "Stopped at offset " << offset << ": " << error.what()
+             << endl;
+        return 1;
+    }
+    return 0;
+}
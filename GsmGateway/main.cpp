@@ -1,9 +1,192 @@
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/signal_set.hpp>
+
+#include "applink.h"
+#include "asiowatchdog.h"
+#include "journal.h"
+#include "log.h"
+#include "modem.h"
+#include "tenantscheduler.h"
 
 using namespace std;
+using namespace GsmGateway;
+
+namespace {
+
+/**
+ * @brief A tenant, such as a brigade, with an App of its own.
+ */
+struct Tenant {
+    string name;
+    uint16_t port = 0;
+    unsigned weight = 1;
+};
+
+/**
+ * @brief Parses the tenants, given as name=port[:weight],... or as a port
+ * alone for a single tenant.
+ *
+ * @return the tenants, or none if the specification is invalid.
+ */
+vector<Tenant> parseTenants(const string& specification) {
+    vector<Tenant> tenants;
+    istringstream stream(specification);
+    string item;
+    while (getline(stream, item, ',')) {
+        Tenant tenant;
+        auto equals = item.find('=');
+        if (equals != string::npos) {
+            tenant.name = item.substr(0, equals);
+            item = item.substr(equals + 1);
+        }
+        auto colon = item.find(':');
+        try {
+            tenant.port = static_cast<uint16_t>(stoi(item.substr(0, colon)));
+            if (colon != string::npos) {
+                tenant.weight =
+                    static_cast<unsigned>(stoi(item.substr(colon + 1)));
+            }
+        } catch (const exception&) {
+            return {};
+        }
+        tenants.push_back(tenant);
+    }
+    if (tenants.size() > 1) {
+        for (const auto& tenant : tenants) {
+            if (tenant.name.empty()) {
+                return {};
+            }
+        }
+    }
+    return tenants;
+}
+
+} // namespace
 
-int main()
+int main(int argc, char* argv[])
 {
-    cout << "Hello world!" << endl;
+    auto& logger = Log::Logger::instance();
+    logger.setThreadName("main");
+    logger.setTextOutput(&cerr, Log::Level::Info);
+    auto logFile = argc > 1 ? argv[1] : "gsmgateway.log";
+    if (!logger.open(logFile)) {
+        cerr << "Cannot open " << logFile << endl;
+        return 1;
+    }
+    GSM_LOG(Log::Level::Info, "GsmGateway started, logging to {}", logFile);
+
+    string journalDirectory = argc > 2 ? argv[2] : "journal";
+    auto tenants = parseTenants(argc > 3 ? argv[3] : "7171");
+    if (tenants.empty()) {
+        GSM_LOG(Log::Level::Error, "Invalid tenants {}", argv[3]);
+        logger.close();
+        return 1;
+    }
+    // A journal per tenant, in a directory of its own if there are several
+    vector<unique_ptr<Journal>> journals;
+    for (const auto& tenant : tenants) {
+        journals.push_back(make_unique<Journal>());
+        auto directory = tenants.size() > 1
+                             ? journalDirectory + "/" + tenant.name
+                             : journalDirectory;
+        if (!journals.back()->open(directory)) {
+            GSM_LOG(Log::Level::Error, "{}", journals.back()->errorString());
+            logger.close();
+            return 1;
+        }
+    }
+
+    boost::asio::io_context context;
+    AsioWatchdog watchdog(context, "main");
+    watchdog.start();
+    vector<unique_ptr<AppLink>> appLinks;
+    for (size_t i = 0; i < tenants.size(); ++i) {
+        appLinks.push_back(
+            make_unique<AppLink>(context, *journals[i], tenants[i].port));
+        if (!appLinks.back()->listen()) {
+            logger.close();
+            return 1;
+        }
+    }
+    auto multiplexed = argc > 5 && string(argv[5]) == "cmux";
+    Modem modem(context, "modem", multiplexed);
+    TenantScheduler scheduler(modem.sender());
+    for (const auto& tenant : tenants) {
+        scheduler.addTenant(tenant.name.empty() ? "default" : tenant.name,
+                            tenant.weight);
+    }
+    // Replies are routed to the tenant that last sent to their number, even
+    // after a restart
+    if (tenants.size() > 1 &&
+        !scheduler.openRoutes(journalDirectory + "/routes")) {
+        logger.close();
+        return 1;
+    }
+    if (argc > 4) {
+        if (!modem.open(argv[4])) {
+            logger.close();
+            return 1;
+        }
+        for (size_t i = 0; i < appLinks.size(); ++i) {
+            appLinks[i]->setSendHandler([&modem, &scheduler, i](
+                                            const string& recipient,
+                                            const string& text, bool alarm) {
+                // Alarms go to responders, whose replies keep their priority
+                if (alarm) {
+                    modem.floodGuard().addResponder(recipient);
+                }
+                scheduler.send(i, recipient, text, alarm);
+            });
+        }
+        modem.setDuplicateFilter([&journals](int64_t timestamp,
+                                             const string& sender,
+                                             const string& text) {
+            for (const auto& journal : journals) {
+                if (journal->contains(timestamp, sender, text)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+        modem.setReceiveHandler([&appLinks, &scheduler](
+                                    int64_t timestamp, const string& sender,
+                                    const string& text,
+                                    Modem::Received done) {
+            // Replies go to the tenant that last sent to the number
+            auto tenant = appLinks.size() == 1 ? 0 : scheduler.tenantOf(sender);
+            if (tenant == TenantScheduler::noTenant) {
+                // Another tenant's App must not see it; deleted from the
+                // modem like a throttled SMS, as no tenant would take it
+                GSM_LOG(Log::Level::Warning,
+                        "Dropping SMS from {}, which no tenant sent to",
+                        sender);
+                done(true);
+                return;
+            }
+            appLinks[tenant]->publish(timestamp, sender, text, move(done));
+        });
+    }
+    boost::asio::signal_set signals(context, SIGINT, SIGTERM);
+    signals.async_wait([&](const boost::system::error_code&, int signal) {
+        GSM_LOG(Log::Level::Info, "Stopping on signal {}", signal);
+        watchdog.stop();
+        for (size_t i = 0; i < scheduler.tenantCount(); ++i) {
+            GSM_LOG(Log::Level::Info, "{}", scheduler.report(i));
+        }
+        for (auto& appLink : appLinks) {
+            appLink->stop();
+        }
+        modem.close();
+        context.stop();
+    });
+    context.run();
+
+    logger.close();
     return 0;
 }
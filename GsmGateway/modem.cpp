@@ -0,0 +1,525 @@
+#include "modem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+
+#include <boost/asio/post.hpp>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+namespace {
+
+// Listing a full storage takes a while at 115200 baud
+constexpr chrono::seconds listTimeout(60);
+// Smaller backlogs are decoded faster than the workers are woken up
+constexpr size_t messagesPerDecodeThread = 8;
+constexpr size_t maxDecodeThreads = 4;
+
+bool startsWith(const string& text, const char* prefix) {
+    return text.compare(0, char_traits<char>::length(prefix), prefix) == 0;
+}
+
+/**
+ * @brief Returns the given comma separated field of a response line such as
+ * "+CMTI: \"SM\",3", without quotes, or an empty string if it is missing.
+ */
+string field(const string& line, size_t field) {
+    auto start = line.find(':');
+    if (start == string::npos) {
+        return string();
+    }
+    start++;
+    for (size_t i = 0; i < field; ++i) {
+        start = line.find(',', start);
+        if (start == string::npos) {
+            return string();
+        }
+        start++;
+    }
+    auto value = line.substr(start, line.find(',', start) - start);
+    value.erase(0, value.find_first_not_of(" \""));
+    value.erase(value.find_last_not_of(" \"") + 1);
+    return value;
+}
+
+/**
+ * @brief Returns the given comma separated field of a response line such as
+ * "+CSQ: 17,99", or -1 if it is missing.
+ */
+int intField(const string& line, size_t index) {
+    try {
+        return stoi(field(line, index));
+    } catch (const exception&) {
+        return -1;
+    }
+}
+
+/**
+ * @brief Decodes the listed PDUs in [first, last); safe to run on several
+ * threads for disjoint ranges.
+ */
+template <typename Backlog>
+void decodeRange(Backlog& backlog, size_t first, size_t last) {
+    for (auto i = first; i < last; ++i) {
+        auto& message = backlog[i];
+        message.valid = !message.throttled &&
+                        Sms::decodeDeliver(message.hex, message.pdu);
+    }
+}
+
+} // namespace
+
+Modem::Modem(boost::asio::io_context& context, const string& name,
+             bool multiplexed, int moreMessagesMode)
+    : _context(context), _name(name), _multiplexed(multiplexed),
+      _port(context),
+      _cmux(context, [this](string data) { _port.write(move(data)); }),
+      _channels{makeChannel(context, 1), makeChannel(context, 2),
+                makeChannel(context, 3)},
+      _sender(channel(Outbound), moreMessagesMode),
+      _reassembler([this](const Sms::DeliverPdu& message,
+                          Reassembler::Done done) {
+          receive(message, move(done));
+      }),
+      _reassemblyTimer(context), _statusTimer(context) {
+    for (auto& channel : _channels) {
+        channel->setUrcHandler(
+            [this](const string& line, const string&) { onUrc(line); });
+    }
+    _port.setReceiveHandler([this](const uint8_t* data, size_t size) {
+        if (_cmuxActive) {
+            _cmux.receive(data, size);
+        } else {
+            _channels[0]->receive(data, size);
+        }
+    });
+    _port.setErrorHandler([this](const string& error) {
+        _cmuxActive = false;
+        for (auto& channel : _channels) {
+            channel->reset(error);
+        }
+    });
+    _cmux.setReceiveHandler(
+        [this](uint8_t dlci, const uint8_t* data, size_t size) {
+            if (dlci >= 1 && dlci <= channelCount) {
+                _channels[dlci - 1]->receive(data, size);
+            }
+        });
+}
+
+unique_ptr<AtChannel> Modem::makeChannel(boost::asio::io_context& context,
+                                         uint8_t dlci) {
+    auto writer = [this, dlci](string data) {
+        if (_cmuxActive) {
+            _cmux.write(dlci, data);
+        } else {
+            _port.write(move(data));
+        }
+    };
+    return make_unique<AtChannel>(
+        context, writer,
+        _multiplexed ? _name + "/" + to_string(dlci) : _name);
+}
+
+bool Modem::open(const string& device, unsigned baudRate) {
+    if (!_port.open(device, baudRate)) {
+        GSM_LOG(Log::Level::Error, "{}", _port.errorString());
+        return false;
+    }
+    initialize();
+    return true;
+}
+
+void Modem::close() {
+    _statusTimer.cancel();
+    _reassemblyTimer.cancel();
+    if (_cmuxActive) {
+        _cmux.close();
+        _cmuxActive = false;
+    }
+    _port.close();
+    for (auto& channel : _channels) {
+        channel->reset("closed");
+    }
+}
+
+void Modem::initialize() {
+    auto& first = *_channels[0];
+    first.command("ATE0");
+    if (!_multiplexed) {
+        initializeChannels();
+        return;
+    }
+    first.command("AT+CMUX=0", [this](const AtResponse& response) {
+        if (!response.ok) {
+            GSM_LOG(Log::Level::Error, "{} cannot multiplex: {}", _name,
+                    response.result);
+            return;
+        }
+        _cmuxActive = true;
+        _cmux.open({1, 2, 3}, [this](bool ok) {
+            if (!ok) {
+                GSM_LOG(Log::Level::Error, "{} cannot open CMUX channels",
+                        _name);
+                return;
+            }
+            GSM_LOG(Log::Level::Info, "{} multiplexed", _name);
+            initializeChannels();
+        });
+    });
+}
+
+void Modem::initializeChannels() {
+    auto logFailure = [this](const string& command) {
+        return [this, command](const AtResponse& response) {
+            if (!response.ok) {
+                GSM_LOG(Log::Level::Warning, "{}: {} failed: {}", _name,
+                        command, response.result);
+            }
+        };
+    };
+    auto used = _multiplexed ? channelCount : 1;
+    for (size_t i = 0; i < used; ++i) {
+        // Echo and result modes are per channel when multiplexed
+        for (auto command : {"ATE0", "AT+CMEE=1", "AT+CMGF=0"}) {
+            _channels[i]->command(command, logFailure(command));
+        }
+    }
+    // Report new messages with +CMTI instead of routing them to us directly
+    channel(Inbound).command("AT+CNMI=2,1,0,0,0",
+                             logFailure("AT+CNMI=2,1,0,0,0"));
+    _sender.start();
+    pollStatus();
+    drainBacklog();
+}
+
+void Modem::onUrc(const string& line) {
+    if (startsWith(line, "+CMTI:")) {
+        auto index = intField(line, 1);
+        if (index >= 0) {
+            readMessage(field(line, 0), index);
+        }
+    }
+}
+
+void Modem::selectStorage(const string& storage,
+                          function<void(bool ok)> done) {
+    _storage = storage;
+    channel(Inbound).command(
+        "AT+CPMS=\"" + storage + "\"",
+        [this, storage, done](const AtResponse& response) {
+            if (!response.ok) {
+                GSM_LOG(Log::Level::Warning, "{}: cannot select storage {}: {}",
+                        _name, storage, response.result);
+            }
+            if (done) {
+                done(response.ok);
+            }
+        });
+}
+
+void Modem::readMessage(const string& storage, int index) {
+    if (!storage.empty() && storage != _storage) {
+        selectStorage(storage);
+    }
+    auto& inbound = channel(Inbound);
+    _unconfirmedReads++;
+    inbound.command(
+        "AT+CMGR=" + to_string(index),
+        [this, storage = _storage, index](const AtResponse& response) {
+            if (!response.ok || response.lines.size() < 2) {
+                GSM_LOG(Log::Level::Warning, "{}: reading SMS {} failed: {}",
+                        _name, index, response.result);
+                _unconfirmedReads--;
+                return;
+            }
+            const auto& hex = response.lines[1];
+            string sender;
+            Sms::DeliverPdu pdu;
+            auto valid = Sms::decodeSender(hex, sender);
+            auto admitted = valid && _floodGuard.admit(sender);
+            valid = valid && (!admitted || Sms::decodeDeliver(hex, pdu));
+            if (!valid) {
+                GSM_LOG(Log::Level::Warning, "{}: SMS {} is not a valid PDU",
+                        _name, index);
+            } else if (admitted) {
+                _reassembler.add(
+                    move(pdu), [this, storage, index](bool journaled) {
+                        _unconfirmedReads--;
+                        if (journaled) {
+                            deleteMessage(storage, index);
+                        } else {
+                            GSM_LOG(Log::Level::Warning,
+                                    "{}: SMS {} was not journaled and stays "
+                                    "on the modem",
+                                    _name, index);
+                        }
+                    });
+                scheduleReassembly();
+                return;
+            }
+            // Invalid and throttled SMS go at once; the flood guard logs
+            // senders when they go over the limit
+            _unconfirmedReads--;
+            deleteMessage(storage, index);
+        });
+}
+
+void Modem::deleteMessage(const string& storage, int index) {
+    // Other SMS may have been read from another storage in the meantime
+    if (!storage.empty() && storage != _storage) {
+        selectStorage(storage);
+    }
+    channel(Inbound).command("AT+CMGD=" + to_string(index));
+}
+
+void Modem::receive(const Sms::DeliverPdu& message, Received done) {
+    if (isDuplicate(message)) {
+        GSM_LOG(Log::Level::Info, "{}: SMS from {} was already received",
+                _name, message.sender);
+        done(true);
+    } else if (_receiveHandler) {
+        _receiveHandler(message.timestamp, message.sender, message.text,
+                        move(done));
+    } else {
+        done(false);
+    }
+}
+
+void Modem::scheduleReassembly() {
+    auto next = _reassembler.nextExpiry();
+    if (next == Reassembler::Clock::time_point::max()) {
+        return;
+    }
+    _reassemblyTimer.expires_at(next);
+    _reassemblyTimer.async_wait([this](const boost::system::error_code& error) {
+        if (!error) {
+            _reassembler.expire();
+            scheduleReassembly();
+        }
+    });
+}
+
+bool Modem::isDuplicate(const Sms::DeliverPdu& pdu) const {
+    return _duplicateFilter &&
+           _duplicateFilter(pdu.timestamp, pdu.sender, pdu.text);
+}
+
+void Modem::drainBacklog() {
+    if (_backlogStorages.empty()) {
+        return;
+    }
+    auto backlog = make_shared<Backlog>();
+    auto started = chrono::steady_clock::now();
+    // Queued at once, so no +CMTI read can switch storages in between
+    for (size_t storage = 0; storage < _backlogStorages.size(); ++storage) {
+        auto selected = make_shared<bool>(false);
+        selectStorage(_backlogStorages[storage],
+                      [selected](bool ok) { *selected = ok; });
+        auto last = storage + 1 == _backlogStorages.size();
+        channel(Inbound).command(
+            "AT+CMGL=4",
+            [this, storage, selected, last, backlog,
+             started](const AtResponse& response) {
+                if (*selected && !response.ok) {
+                    GSM_LOG(Log::Level::Warning,
+                            "{}: listing storage {} failed: {}", _name,
+                            _backlogStorages[storage], response.result);
+                } else if (*selected) {
+                    // Each "+CMGL: index,status,,length" is followed by
+                    // the PDU
+                    const auto& lines = response.lines;
+                    for (size_t i = 0; i + 1 < lines.size(); ++i) {
+                        if (!startsWith(lines[i], "+CMGL:")) {
+                            continue;
+                        }
+                        StoredMessage message;
+                        message.storage = storage;
+                        message.index = intField(lines[i], 0);
+                        message.hex = lines[++i];
+                        string sender;
+                        message.throttled =
+                            Sms::decodeSender(message.hex, sender) &&
+                            !_floodGuard.admit(sender);
+                        if (message.index >= 0) {
+                            backlog->push_back(move(message));
+                        }
+                    }
+                }
+                if (last) {
+                    decodeBacklog(backlog, started);
+                }
+            },
+            listTimeout);
+    }
+}
+
+void Modem::decodeBacklog(const shared_ptr<Backlog>& backlog,
+                          chrono::steady_clock::time_point started) {
+    auto size = backlog->size();
+    auto threads = min(size / messagesPerDecodeThread, maxDecodeThreads);
+    if (threads <= 1) {
+        decodeRange(*backlog, 0, size);
+        publishBacklog(backlog, started);
+        return;
+    }
+    if (!_decodePool) {
+        _decodePool = make_unique<boost::asio::thread_pool>(maxDecodeThreads);
+    }
+    auto remaining = make_shared<atomic<size_t>>(threads);
+    for (size_t thread = 0; thread < threads; ++thread) {
+        auto first = size * thread / threads;
+        auto last = size * (thread + 1) / threads;
+        boost::asio::post(*_decodePool, [this, backlog, started, remaining,
+                                         first, last] {
+            decodeRange(*backlog, first, last);
+            if (--*remaining == 0) {
+                boost::asio::post(_context, [this, backlog, started] {
+                    publishBacklog(backlog, started);
+                });
+            }
+        });
+    }
+}
+
+void Modem::publishBacklog(const shared_ptr<Backlog>& backlog,
+                           chrono::steady_clock::time_point started) {
+    vector<StoredMessage*> messages;
+    messages.reserve(backlog->size());
+    size_t throttled = 0;
+    for (auto& message : *backlog) {
+        if (message.valid) {
+            messages.push_back(&message);
+        } else {
+            // Throttled and invalid SMS are deleted without being passed on
+            message.done = true;
+            if (message.throttled) {
+                throttled++;
+            }
+        }
+    }
+    auto invalid = backlog->size() - messages.size() - throttled;
+    // Copies of one SMS in both storages end up next to each other, and the
+    // parts of a concatenated SMS in order
+    auto key = [](const StoredMessage* message) {
+        const auto& pdu = message->pdu;
+        return tie(pdu.timestamp, pdu.sender, pdu.reference, pdu.part,
+                   pdu.text);
+    };
+    stable_sort(messages.begin(), messages.end(),
+                [&key](const StoredMessage* m1, const StoredMessage* m2) {
+                    return key(m1) < key(m2);
+                });
+    // The storages are cleared once the last SMS passed on is journaled
+    auto pending = make_shared<size_t>(1);
+    auto published = [this, backlog, pending] {
+        if (--*pending == 0) {
+            deleteBacklog(*backlog);
+        }
+    };
+    size_t copies = 0;
+    for (size_t i = 0; i < messages.size(); ++i) {
+        auto message = messages[i];
+        if (i > 0 && key(messages[i - 1]) == key(message)) {
+            copies++;
+            message->done = true;
+            continue;
+        }
+        ++*pending;
+        _reassembler.add(message->pdu, [message, published](bool journaled) {
+            message->done = journaled;
+            published();
+        });
+    }
+    scheduleReassembly();
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - started);
+    GSM_LOG(Log::Level::Info,
+            "{}: drained {} stored SMS in {} ms, {} copies, {} throttled, "
+            "{} invalid",
+            _name, backlog->size(), elapsed.count(), copies, throttled,
+            invalid);
+    published();
+}
+
+void Modem::deleteBacklog(const Backlog& backlog) {
+    size_t kept = 0;
+    for (size_t storage = 0; storage < _backlogStorages.size(); ++storage) {
+        auto indices = make_shared<vector<int>>();
+        auto all = true;
+        for (const auto& message : backlog) {
+            if (message.storage != storage) {
+                continue;
+            }
+            if (message.done) {
+                indices->push_back(message.index);
+            } else {
+                all = false;
+                kept++;
+            }
+        }
+        if (indices->empty()) {
+            continue;
+        }
+        const auto& name = _backlogStorages[storage];
+        selectStorage(name);
+        if (!all || _unconfirmedReads > 0) {
+            for (auto index : *indices) {
+                channel(Inbound).command("AT+CMGD=" + to_string(index));
+            }
+            continue;
+        }
+        // Listing marked every message read; ones that arrived since are
+        // unread and stay
+        channel(Inbound).command(
+            "AT+CMGD=1,1", [this, name, indices](const AtResponse& response) {
+                if (response.ok) {
+                    return;
+                }
+                // Without delete flags, one command per message
+                if (name != _storage) {
+                    selectStorage(name);
+                }
+                for (auto index : *indices) {
+                    channel(Inbound).command("AT+CMGD=" + to_string(index));
+                }
+            });
+    }
+    if (kept > 0) {
+        GSM_LOG(Log::Level::Warning,
+                "{}: {} stored SMS were not journaled and stay on the modem",
+                _name, kept);
+    }
+}
+
+void Modem::pollStatus() {
+    auto& status = channel(Status);
+    status.command("AT+CSQ", [this](const AtResponse& response) {
+        if (response.ok && !response.lines.empty()) {
+            _status.signal = intField(response.lines[0], 0);
+        }
+    });
+    status.command("AT+CREG?", [this](const AtResponse& response) {
+        if (!response.ok || response.lines.empty()) {
+            return;
+        }
+        auto registration = intField(response.lines[0], 1);
+        if (registration != _status.registration) {
+            GSM_LOG(Log::Level::Info,
+                    "{}: registration {}, signal {}", _name, registration,
+                    _status.signal);
+        }
+        _status.registration = registration;
+    });
+    _statusTimer.expires_after(_statusInterval);
+    _statusTimer.async_wait([this](const boost::system::error_code& error) {
+        if (!error) {
+            pollStatus();
+        }
+    });
+}
+
+} // namespace GsmGateway
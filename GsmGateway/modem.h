@@ -0,0 +1,205 @@
+#ifndef MODEM_H
+#define MODEM_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include "atchannel.h"
+#include "cmux.h"
+#include "floodguard.h"
+#include "reassembler.h"
+#include "serialport.h"
+#include "smssender.h"
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief The last status polled from a modem.
+ */
+struct ModemStatus {
+    // The AT+CSQ signal strength, 0 to 31, or 99 if unknown
+    int signal = 99;
+    // The AT+CREG registration state, 1 home and 5 roaming
+    int registration = 0;
+};
+
+/**
+ * @brief A GSM modem on a serial port: the AT channels to it, set up for PDU
+ * mode, the sender of outgoing SMS and the reception of incoming SMS, and a
+ * periodic status poll.
+ *
+ * When multiplexed, the modem is switched to 27.010 CMUX mode and each kind
+ * of traffic gets a channel of its own: incoming SMS are read on one,
+ * outgoing SMS submitted on another and the status polled on a third, so
+ * none of them waits for the others. Otherwise everything shares one
+ * channel.
+ *
+ * Incoming SMS are reported by the modem with +CMTI, then read and passed to
+ * the receive handler. An SMS is deleted from the modem only once the
+ * handler reports it as journaled; one that could not be journaled stays
+ * in the storage and is drained on the next start.
+ *
+ * SMS that were stored while the gateway was down are drained on startup:
+ * each backlog storage is listed with one AT+CMGL, the PDUs are decoded on
+ * a worker pool, and the messages are passed to the receive handler in
+ * timestamp order. Once all of them are journaled, the storage is cleared
+ * with one AT+CMGD; otherwise only the journaled ones are deleted, one by
+ * one. SMS that the duplicate filter reports as already received, such as
+ * those journaled just before a crash, are deleted without being passed on.
+ *
+ * SMS from senders over their rate limit (see FloodGuard) are deleted as
+ * soon as their sender is known, before the rest of the PDU is decoded.
+ *
+ * The parts of concatenated SMS are joined before they are passed on (see
+ * Reassembler), and each part is deleted once the joined SMS is journaled.
+ *
+ * All members must be called on the io_context thread.
+ */
+class Modem {
+  public:
+    enum Channel { Inbound, Outbound, Status };
+
+    // Called with whether the SMS is stored durably, such as in a journal,
+    // or is not to be kept at all; either way it is deleted from the modem
+    using Received = function<void(bool journaled)>;
+    using ReceiveHandler =
+        function<void(int64_t timestamp, const string& sender,
+                      const string& text, Received done)>;
+    using DuplicateFilter = function<bool(
+        int64_t timestamp, const string& sender, const string& text)>;
+
+    explicit Modem(boost::asio::io_context& context,
+                   const string& name = "modem", bool multiplexed = false,
+                   int moreMessagesMode = 1);
+
+    Modem(const Modem&) = delete;
+    Modem& operator=(const Modem&) = delete;
+
+    /**
+     * @brief Opens the serial port and initializes the modem.
+     *
+     * @return true on success, false if the port could not be opened. See
+     * errorString().
+     */
+    bool open(const string& device, unsigned baudRate = 115200);
+
+    void close();
+
+    void setReceiveHandler(ReceiveHandler handler) {
+        _receiveHandler = move(handler);
+    }
+
+    /**
+     * @brief Sets the filter that returns true for SMS that have already
+     * been received.
+     */
+    void setDuplicateFilter(DuplicateFilter filter) {
+        _duplicateFilter = move(filter);
+    }
+
+    /**
+     * @brief Sets the message storages drained on startup, "SM" (SIM) and
+     * "ME" (modem) by default; none disables draining. Must be called before
+     * open().
+     */
+    void setBacklogStorages(vector<string> storages) {
+        _backlogStorages = move(storages);
+    }
+
+    /**
+     * @brief Returns the channel for the given kind of traffic; the same one
+     * for all of them unless multiplexed.
+     */
+    AtChannel& channel(Channel channel = Outbound) {
+        return *_channels[_multiplexed ? channel : 0];
+    }
+
+    SmsSender& sender() { return _sender; }
+
+    FloodGuard& floodGuard() { return _floodGuard; }
+
+    const ModemStatus& status() const { return _status; }
+
+    const CmuxStats& cmuxStats() const { return _cmux.stats(); }
+
+    string errorString() const { return _port.errorString(); }
+
+  private:
+    static constexpr size_t channelCount = 3;
+
+    /**
+     * @brief An SMS listed from a storage by AT+CMGL.
+     */
+    struct StoredMessage {
+        size_t storage = 0;
+        int index = 0;
+        string hex;
+        bool throttled = false;
+        bool valid = false;
+        // Journaled, or not to be journaled at all
+        bool done = false;
+        Sms::DeliverPdu pdu;
+    };
+
+    using Backlog = vector<StoredMessage>;
+
+    unique_ptr<AtChannel> makeChannel(boost::asio::io_context& context,
+                                      uint8_t dlci);
+    void initialize();
+    void initializeChannels();
+    void onUrc(const string& line);
+    void selectStorage(const string& storage,
+                       function<void(bool ok)> done = {});
+    void readMessage(const string& storage, int index);
+    void deleteMessage(const string& storage, int index);
+    void receive(const Sms::DeliverPdu& message, Received done);
+    void scheduleReassembly();
+    bool isDuplicate(const Sms::DeliverPdu& pdu) const;
+    void drainBacklog();
+    void decodeBacklog(const shared_ptr<Backlog>& backlog,
+                       chrono::steady_clock::time_point started);
+    void publishBacklog(const shared_ptr<Backlog>& backlog,
+                        chrono::steady_clock::time_point started);
+    void deleteBacklog(const Backlog& backlog);
+    void pollStatus();
+
+    boost::asio::io_context& _context;
+    string _name;
+    bool _multiplexed;
+    bool _cmuxActive = false;
+    SerialPort _port;
+    Cmux _cmux;
+    unique_ptr<AtChannel> _channels[channelCount];
+    SmsSender _sender;
+    FloodGuard _floodGuard;
+    Reassembler _reassembler;
+    boost::asio::steady_timer _reassemblyTimer;
+    ReceiveHandler _receiveHandler;
+    DuplicateFilter _duplicateFilter;
+    vector<string> _backlogStorages{"SM", "ME"};
+    // The storage selected by the last AT+CPMS queued on the inbound channel
+    string _storage;
+    // SMS read with AT+CMGR and not yet deleted or journaled; they are marked
+    // read, so AT+CMGD=1,1 would delete them too
+    size_t _unconfirmedReads = 0;
+    boost::asio::steady_timer _statusTimer;
+    chrono::seconds _statusInterval{30};
+    ModemStatus _status;
+    // Created for the first large backlog; destroyed first, so that its
+    // threads are joined before the rest of the modem goes
+    unique_ptr<boost::asio::thread_pool> _decodePool;
+};
+
+} // namespace GsmGateway
+
+#endif // MODEM_H
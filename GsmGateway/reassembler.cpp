@@ -0,0 +1,101 @@
+#include "reassembler.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+Reassembler::Reassembler(Handler handler, chrono::seconds timeout)
+    : _handler(move(handler)), _timeout(timeout) {}
+
+void Reassembler::add(Sms::DeliverPdu part, Done done,
+                      Clock::time_point now) {
+    if (part.parts <= 1 || part.part == 0 || part.part > part.parts) {
+        _handler(part, move(done));
+        return;
+    }
+    auto key = Key(part.sender, part.reference, part.parts);
+    auto inserted = _messages.try_emplace(key);
+    auto& message = inserted.first->second;
+    if (inserted.second) {
+        message.deadline = now + _timeout;
+        message.parts.resize(part.parts);
+        message.received.resize(part.parts);
+    }
+    // A copy of a part, such as one in both storages, goes with the message
+    if (done) {
+        message.dones.push_back(move(done));
+    }
+    auto index = size_t(part.part - 1);
+    if (message.received[index]) {
+        return;
+    }
+    message.parts[index] = move(part);
+    message.received[index] = true;
+    if (++message.count == message.parts.size()) {
+        auto complete = move(message);
+        _messages.erase(inserted.first);
+        pass(complete);
+    }
+}
+
+size_t Reassembler::expire(Clock::time_point now) {
+    vector<Message> expired;
+    for (auto message = _messages.begin(); message != _messages.end();) {
+        if (message->second.deadline <= now) {
+            const auto& parts = message->second.parts;
+            GSM_LOG(Log::Level::Warning,
+                    "SMS from {} is missing {} of {} parts",
+                    get<0>(message->first),
+                    parts.size() - message->second.count, parts.size());
+            expired.push_back(move(message->second));
+            message = _messages.erase(message);
+        } else {
+            ++message;
+        }
+    }
+    // Passed on after the map is consistent, as the handler may add parts
+    for (auto& message : expired) {
+        pass(message);
+    }
+    return expired.size();
+}
+
+Reassembler::Clock::time_point Reassembler::nextExpiry() const {
+    auto next = Clock::time_point::max();
+    for (const auto& message : _messages) {
+        next = min(next, message.second.deadline);
+    }
+    return next;
+}
+
+void Reassembler::pass(Message& message) {
+    Sms::DeliverPdu joined;
+    auto first = true;
+    for (size_t i = 0; i < message.parts.size(); ++i) {
+        if (!message.received[i]) {
+            continue;
+        }
+        const auto& part = message.parts[i];
+        if (first) {
+            joined = part;
+            joined.reference = 0;
+            joined.parts = 1;
+            joined.part = 1;
+            first = false;
+        } else {
+            joined.timestamp = min(joined.timestamp, part.timestamp);
+            joined.text += part.text;
+        }
+    }
+    auto dones = make_shared<vector<Done>>(move(message.dones));
+    _handler(joined, [dones](bool journaled) {
+        for (auto& done : *dones) {
+            done(journaled);
+        }
+    });
+}
+
+} // namespace GsmGateway
@@ -0,0 +1,94 @@
+#ifndef REASSEMBLER_H
+#define REASSEMBLER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "smspdu.h"
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief Joins the parts of concatenated SMS into one message.
+ *
+ * Parts are matched by sender, concatenation reference and number of parts,
+ * and joined in part order once all of them have arrived, in whatever order
+ * that was. The message gets the earliest timestamp of its parts. A message
+ * whose parts have not all arrived within the timeout of its first part is
+ * passed on with the parts that did, so that a lost part does not hold back
+ * a reply for good.
+ *
+ * Each part comes with a completion of its own, and all of them are called
+ * with the outcome of the joined message: the modem deletes a part from its
+ * storage only once the whole message is journaled.
+ *
+ * Not thread safe; the gateway uses it from its io_context thread.
+ */
+class Reassembler {
+  public:
+    using Clock = chrono::steady_clock;
+    using Done = function<void(bool journaled)>;
+    using Handler =
+        function<void(const Sms::DeliverPdu& message, Done done)>;
+
+    explicit Reassembler(Handler handler,
+                         chrono::seconds timeout = chrono::seconds(60));
+
+    Reassembler(const Reassembler&) = delete;
+    Reassembler& operator=(const Reassembler&) = delete;
+
+    /**
+     * @brief Adds a received SMS, passing it on at once if it is not a part
+     * of a concatenated one, or together with the other parts once it
+     * completes one.
+     */
+    void add(Sms::DeliverPdu part, Done done,
+             Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Passes on the incomplete messages that have timed out.
+     *
+     * @return the number of messages passed on.
+     */
+    size_t expire(Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Returns when the oldest incomplete message times out, or
+     * Clock::time_point::max() if there is none.
+     */
+    Clock::time_point nextExpiry() const;
+
+    /**
+     * @brief Returns the number of incomplete messages.
+     */
+    size_t pending() const { return _messages.size(); }
+
+  private:
+    using Key = tuple<string, uint16_t, uint8_t>;
+
+    struct Message {
+        Clock::time_point deadline;
+        // Indexed by part number - 1; parts not received yet are empty
+        vector<Sms::DeliverPdu> parts;
+        vector<bool> received;
+        size_t count = 0;
+        vector<Done> dones;
+    };
+
+    void pass(Message& message);
+
+    Handler _handler;
+    chrono::seconds _timeout;
+    map<Key, Message> _messages;
+};
+
+} // namespace GsmGateway
+
+#endif // REASSEMBLER_H
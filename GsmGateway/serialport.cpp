@@ -0,0 +1,142 @@
+#include "serialport.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <boost/asio/write.hpp>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+namespace {
+
+speed_t speedOf(unsigned baudRate) {
+    switch (baudRate) {
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 230400:
+        return B230400;
+    case 460800:
+        return B460800;
+    case 921600:
+        return B921600;
+    default:
+        return B115200;
+    }
+}
+
+} // namespace
+
+SerialPort::SerialPort(boost::asio::io_context& context)
+    : _stream(context), _readBuffer(4096) {}
+
+SerialPort::~SerialPort() { close(); }
+
+bool SerialPort::open(const string& device, unsigned baudRate) {
+    close();
+    auto fd = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        _error = "Cannot open " + device + ": " + strerror(errno);
+        return false;
+    }
+    termios options;
+    if (isatty(fd) && tcgetattr(fd, &options) == 0) {
+        cfmakeraw(&options);
+        cfsetispeed(&options, speedOf(baudRate));
+        cfsetospeed(&options, speedOf(baudRate));
+        options.c_cflag |= CLOCAL | CREAD | CRTSCTS;
+        options.c_cc[VMIN] = 1;
+        options.c_cc[VTIME] = 0;
+        if (tcsetattr(fd, TCSANOW, &options) != 0) {
+            _error = "Cannot configure " + device + ": " + strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        tcflush(fd, TCIOFLUSH);
+    }
+    _stream.assign(fd);
+    _device = device;
+    GSM_LOG(Log::Level::Info, "Opened {} at {} baud", device, baudRate);
+    read();
+    return true;
+}
+
+void SerialPort::close() {
+    if (!_stream.is_open()) {
+        return;
+    }
+    boost::system::error_code ignored;
+    _stream.close(ignored);
+    _writeQueue.clear();
+    _writing = false;
+}
+
+void SerialPort::write(string data) {
+    if (!_stream.is_open()) {
+        return;
+    }
+    _writeQueue.push_back(move(data));
+    writeNext();
+}
+
+void SerialPort::read() {
+    _stream.async_read_some(
+        boost::asio::buffer(_readBuffer),
+        [this](const boost::system::error_code& error, size_t size) {
+            if (error == boost::asio::error::operation_aborted) {
+                return;
+            }
+            if (error) {
+                fail(error.message());
+                return;
+            }
+            if (_receiveHandler) {
+                _receiveHandler(_readBuffer.data(), size);
+            }
+            if (_stream.is_open()) {
+                read();
+            }
+        });
+}
+
+void SerialPort::writeNext() {
+    if (_writing || _writeQueue.empty()) {
+        return;
+    }
+    _writing = true;
+    boost::asio::async_write(
+        _stream, boost::asio::buffer(_writeQueue.front()),
+        [this](const boost::system::error_code& error, size_t) {
+            if (error == boost::asio::error::operation_aborted) {
+                return;
+            }
+            _writing = false;
+            if (error) {
+                fail(error.message());
+                return;
+            }
+            _writeQueue.pop_front();
+            writeNext();
+        });
+}
+
+void SerialPort::fail(const string& error) {
+    _error = error;
+    GSM_LOG(Log::Level::Error, "Serial port {} failed: {}", _device, error);
+    close();
+    if (_errorHandler) {
+        _errorHandler(error);
+    }
+}
+
+} // namespace GsmGateway
@@ -0,0 +1,82 @@
+#ifndef SERIALPORT_H
+#define SERIALPORT_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief The serial line to a modem. Terminals are switched to raw mode with
+ * hardware flow control; other character devices, such as the pseudo
+ * terminal of a modem simulator, are used as they are.
+ *
+ * All members must be called on the io_context thread.
+ */
+class SerialPort {
+  public:
+    using ReceiveHandler = function<void(const uint8_t* data, size_t size)>;
+    using ErrorHandler = function<void(const string& error)>;
+
+    explicit SerialPort(boost::asio::io_context& context);
+    ~SerialPort();
+
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    /**
+     * @brief Opens the device and starts receiving.
+     *
+     * @return true on success, false on failure. See errorString().
+     */
+    bool open(const string& device, unsigned baudRate = 115200);
+
+    void close();
+
+    bool isOpen() const { return _stream.is_open(); }
+
+    void setReceiveHandler(ReceiveHandler handler) {
+        _receiveHandler = move(handler);
+    }
+
+    /**
+     * @brief Sets the handler that is called when reading or writing fails.
+     * The port is closed by then.
+     */
+    void setErrorHandler(ErrorHandler handler) {
+        _errorHandler = move(handler);
+    }
+
+    /**
+     * @brief Queues data for writing.
+     */
+    void write(string data);
+
+    string errorString() const { return _error; }
+
+  private:
+    void read();
+    void writeNext();
+    void fail(const string& error);
+
+    boost::asio::posix::stream_descriptor _stream;
+    ReceiveHandler _receiveHandler;
+    ErrorHandler _errorHandler;
+    vector<uint8_t> _readBuffer;
+    deque<string> _writeQueue;
+    bool _writing = false;
+    string _device;
+    string _error;
+};
+
+} // namespace GsmGateway
+
+#endif // SERIALPORT_H
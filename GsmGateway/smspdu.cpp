@@ -0,0 +1,828 @@
+#include "smspdu.h"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace GsmGateway::Sms {
+
+namespace {
+
+constexpr uint8_t escape = 0x1B;
+constexpr char32_t replacement = 0xFFFD;
+constexpr size_t userDataOctets = 140;
+constexpr size_t languageCount = 4;
+
+// The GSM 7 bit default alphabet; the escape code has no character
+constexpr char32_t defaultAlphabet[128] = {
+    U'@', U'£', U'$', U'¥', U'è', U'é', U'ù', U'ì', U'ò', U'Ç', U'\n', U'Ø',
+    U'ø', U'\r', U'Å', U'å', U'Δ', U'_', U'Φ', U'Γ', U'Λ', U'Ω', U'Π', U'Ψ',
+    U'Σ', U'Θ', U'Ξ', 0, U'Æ', U'æ', U'ß', U'É', U' ', U'!', U'"', U'#',
+    U'¤', U'%', U'&', U'\'', U'(', U')', U'*', U'+', U',', U'-', U'.', U'/',
+    U'0', U'1', U'2', U'3', U'4', U'5', U'6', U'7', U'8', U'9', U':', U';',
+    U'<', U'=', U'>', U'?', U'¡', U'A', U'B', U'C', U'D', U'E', U'F', U'G',
+    U'H', U'I', U'J', U'K', U'L', U'M', U'N', U'O', U'P', U'Q', U'R', U'S',
+    U'T', U'U', U'V', U'W', U'X', U'Y', U'Z', U'Ä', U'Ö', U'Ñ', U'Ü', U'§',
+    U'¿', U'a', U'b', U'c', U'd', U'e', U'f', U'g', U'h', U'i', U'j', U'k',
+    U'l', U'm', U'n', U'o', U'p', U'q', U'r', U's', U't', U'u', U'v', U'w',
+    U'x', U'y', U'z', U'ä', U'ö', U'ñ', U'ü', U'à'};
+
+// The Turkish locking shift table, used instead of the default alphabet
+constexpr char32_t turkishAlphabet[128] = {
+    U'@', U'£', U'$', U'¥', U'€', U'é', U'ù', U'ı', U'ò', U'Ç', U'\n', U'Ğ',
+    U'ğ', U'\r', U'Å', U'å', U'Δ', U'_', U'Φ', U'Γ', U'Λ', U'Ω', U'Π', U'Ψ',
+    U'Σ', U'Θ', U'Ξ', 0, U'Ş', U'ş', U'ß', U'É', U' ', U'!', U'"', U'#',
+    U'¤', U'%', U'&', U'\'', U'(', U')', U'*', U'+', U',', U'-', U'.', U'/',
+    U'0', U'1', U'2', U'3', U'4', U'5', U'6', U'7', U'8', U'9', U':', U';',
+    U'<', U'=', U'>', U'?', U'İ', U'A', U'B', U'C', U'D', U'E', U'F', U'G',
+    U'H', U'I', U'J', U'K', U'L', U'M', U'N', U'O', U'P', U'Q', U'R', U'S',
+    U'T', U'U', U'V', U'W', U'X', U'Y', U'Z', U'Ä', U'Ö', U'Ñ', U'Ü', U'§',
+    U'ç', U'a', U'b', U'c', U'd', U'e', U'f', U'g', U'h', U'i', U'j', U'k',
+    U'l', U'm', U'n', U'o', U'p', U'q', U'r', U's', U't', U'u', U'v', U'w',
+    U'x', U'y', U'z', U'ä', U'ö', U'ñ', U'ü', U'à'};
+
+// The extension table, reached with the escape code
+constexpr pair<uint8_t, char32_t> extensionTable[] = {
+    {0x0A, U'\f'}, {0x14, U'^'}, {0x28, U'{'}, {0x29, U'}'}, {0x2F, U'\\'},
+    {0x3C, U'['},  {0x3D, U'~'}, {0x3E, U']'}, {0x40, U'|'}, {0x65, U'€'}};
+
+// The national language single shift tables, used instead of the extension
+// table
+constexpr pair<uint8_t, char32_t> turkishExtension[] = {
+    {0x0A, U'\f'}, {0x14, U'^'}, {0x28, U'{'}, {0x29, U'}'}, {0x2F, U'\\'},
+    {0x3C, U'['},  {0x3D, U'~'}, {0x3E, U']'}, {0x40, U'|'}, {0x47, U'Ğ'},
+    {0x49, U'İ'},  {0x53, U'Ş'}, {0x63, U'ç'}, {0x65, U'€'}, {0x67, U'ğ'},
+    {0x69, U'ı'},  {0x73, U'ş'}};
+
+constexpr pair<uint8_t, char32_t> spanishExtension[] = {
+    {0x09, U'ç'}, {0x0A, U'\f'}, {0x14, U'^'}, {0x28, U'{'}, {0x29, U'}'},
+    {0x2F, U'\\'}, {0x3C, U'['}, {0x3D, U'~'}, {0x3E, U']'}, {0x40, U'|'},
+    {0x41, U'Á'}, {0x49, U'Í'},  {0x4F, U'Ó'}, {0x55, U'Ú'}, {0x61, U'á'},
+    {0x65, U'€'}, {0x69, U'í'},  {0x6F, U'ó'}, {0x75, U'ú'}};
+
+constexpr pair<uint8_t, char32_t> portugueseExtension[] = {
+    {0x05, U'ê'}, {0x09, U'ç'}, {0x0A, U'\f'}, {0x0B, U'Ô'}, {0x0C, U'ô'},
+    {0x0E, U'Á'}, {0x0F, U'á'}, {0x12, U'Φ'},  {0x13, U'Γ'}, {0x14, U'^'},
+    {0x15, U'Ω'}, {0x16, U'Π'}, {0x17, U'Ψ'},  {0x18, U'Σ'}, {0x19, U'Θ'},
+    {0x1F, U'Ê'}, {0x28, U'{'}, {0x29, U'}'},  {0x2F, U'\\'}, {0x3C, U'['},
+    {0x3D, U'~'}, {0x3E, U']'}, {0x40, U'|'},  {0x41, U'À'}, {0x49, U'Í'},
+    {0x4F, U'Ó'}, {0x55, U'Ú'}, {0x5B, U'Ã'},  {0x5C, U'Õ'}, {0x61, U'Â'},
+    {0x65, U'€'}, {0x69, U'í'}, {0x6F, U'ó'},  {0x75, U'ú'}, {0x7B, U'ã'},
+    {0x7C, U'õ'}, {0x7F, U'â'}};
+
+// Replacements for characters without a GSM-7 representation that keep the
+// meaning of a text. Letters lose their accent only where the tables have
+// no accented form of them.
+constexpr pair<char32_t, const char32_t*> transliterationTable[] = {
+    {U'\t', U" "},     {U'\u00A0', U" "}, {U'\u2002', U" "},
+    {U'\u2003', U" "}, {U'\u2007', U" "}, {U'\u2009', U" "},
+    {U'\u202F', U" "}, {U'\u200B', U""},  {U'\uFEFF', U""},
+    {U'‘', U"'"},      {U'’', U"'"},      {U'‚', U"'"},
+    {U'′', U"'"},      {U'`', U"'"},      {U'´', U"'"},
+    {U'“', U"\""},     {U'”', U"\""},     {U'„', U"\""},
+    {U'″', U"\""},     {U'«', U"\""},     {U'»', U"\""},
+    {U'‐', U"-"},      {U'‑', U"-"},      {U'‒', U"-"},
+    {U'–', U"-"},      {U'—', U"-"},      {U'−', U"-"},
+    {U'…', U"..."},    {U'•', U"*"},      {U'·', U"."},
+    {U'×', U"x"},      {U'÷', U"/"},      {U'©', U"(C)"},
+    {U'®', U"(R)"},    {U'™', U"TM"},     {U'°', U" deg"},
+    {U'á', U"a"},      {U'â', U"a"},      {U'ã', U"a"},
+    {U'ā', U"a"},      {U'ą', U"a"},      {U'Á', U"A"},
+    {U'À', U"A"},      {U'Â', U"A"},      {U'Ã', U"A"},
+    {U'Ā', U"A"},      {U'Ą', U"A"},      {U'ç', U"c"},
+    {U'ć', U"c"},      {U'č', U"c"},      {U'Ć', U"C"},
+    {U'Č', U"C"},      {U'ď', U"d"},      {U'Ď', U"D"},
+    {U'đ', U"d"},      {U'Đ', U"D"},      {U'ð', U"d"},
+    {U'Ð', U"D"},      {U'ê', U"e"},      {U'ë', U"e"},
+    {U'ē', U"e"},      {U'ę', U"e"},      {U'ě', U"e"},
+    {U'È', U"E"},      {U'Ê', U"E"},      {U'Ë', U"E"},
+    {U'Ē', U"E"},      {U'Ę', U"E"},      {U'Ě', U"E"},
+    {U'ğ', U"g"},      {U'Ğ', U"G"},      {U'í', U"i"},
+    {U'î', U"i"},      {U'ï', U"i"},      {U'ī', U"i"},
+    {U'ı', U"i"},      {U'Í', U"I"},      {U'Ì', U"I"},
+    {U'Î', U"I"},      {U'Ï', U"I"},      {U'Ī', U"I"},
+    {U'İ', U"I"},      {U'ł', U"l"},      {U'Ł', U"L"},
+    {U'ń', U"n"},      {U'ň', U"n"},      {U'Ń', U"N"},
+    {U'Ň', U"N"},      {U'ó', U"o"},      {U'ô', U"o"},
+    {U'õ', U"o"},      {U'ō', U"o"},      {U'ő', U"o"},
+    {U'Ó', U"O"},      {U'Ò', U"O"},      {U'Ô', U"O"},
+    {U'Õ', U"O"},      {U'Ō', U"O"},      {U'Ő', U"O"},
+    {U'œ', U"oe"},     {U'Œ', U"OE"},     {U'ř', U"r"},
+    {U'Ř', U"R"},      {U'ś', U"s"},      {U'š', U"s"},
+    {U'ş', U"s"},      {U'Ś', U"S"},      {U'Š', U"S"},
+    {U'Ş', U"S"},      {U'ť', U"t"},      {U'ţ', U"t"},
+    {U'Ť', U"T"},      {U'Ţ', U"T"},      {U'þ', U"th"},
+    {U'Þ', U"Th"},     {U'ú', U"u"},      {U'û', U"u"},
+    {U'ū', U"u"},      {U'ů', U"u"},      {U'ű', U"u"},
+    {U'Ú', U"U"},      {U'Ù', U"U"},      {U'Û', U"U"},
+    {U'Ū', U"U"},      {U'Ů', U"U"},      {U'Ű', U"U"},
+    {U'ý', U"y"},      {U'ÿ', U"y"},      {U'Ý', U"Y"},
+    {U'Ÿ', U"Y"},      {U'ź', U"z"},      {U'ż', U"z"},
+    {U'ž', U"z"},      {U'Ź', U"Z"},      {U'Ż', U"Z"},
+    {U'Ž', U"Z"}};
+
+struct ShiftTable {
+    const pair<uint8_t, char32_t>* entries;
+    size_t size;
+};
+
+/**
+ * @brief Returns the locking shift table of a language, or null if it has
+ * none.
+ */
+const char32_t* lockingShiftTable(Language language) {
+    switch (language) {
+    case Language::Default:
+        return defaultAlphabet;
+    case Language::Turkish:
+        return turkishAlphabet;
+    default:
+        return nullptr;
+    }
+}
+
+ShiftTable singleShiftTable(Language language) {
+    switch (language) {
+    case Language::Turkish:
+        return {turkishExtension, size(turkishExtension)};
+    case Language::Spanish:
+        return {spanishExtension, size(spanishExtension)};
+    case Language::Portuguese:
+        return {portugueseExtension, size(portugueseExtension)};
+    default:
+        return {extensionTable, size(extensionTable)};
+    }
+}
+
+/**
+ * @brief The code points of the tables of a language mapped to their codes.
+ */
+struct Gsm7Codes {
+    unordered_map<char32_t, uint8_t> lockingShift;
+    unordered_map<char32_t, uint8_t> singleShift;
+};
+
+const Gsm7Codes& gsm7Codes(Language language) {
+    static const auto codes = [] {
+        array<Gsm7Codes, languageCount> codes;
+        for (size_t i = 0; i < languageCount; ++i) {
+            auto language = static_cast<Language>(i);
+            if (auto table = lockingShiftTable(language)) {
+                for (uint8_t code = 0; code < 128; ++code) {
+                    if (code != escape) {
+                        codes[i].lockingShift.emplace(table[code], code);
+                    }
+                }
+            }
+            auto table = singleShiftTable(language);
+            for (size_t j = 0; j < table.size; ++j) {
+                codes[i].singleShift.emplace(table.entries[j].second,
+                                             table.entries[j].first);
+            }
+        }
+        return codes;
+    }();
+    return codes[static_cast<size_t>(language)];
+}
+
+/**
+ * @brief Looks up the code of a code point: in the low byte, preceded by the
+ * escape code in the high byte if it is in the single shift table.
+ *
+ * @return false if neither table has the code point.
+ */
+bool gsm7Code(char32_t codePoint, Language lockingShift, Language singleShift,
+              uint16_t& code) {
+    const auto& locking = gsm7Codes(lockingShift).lockingShift;
+    auto found = locking.find(codePoint);
+    if (found != locking.end()) {
+        code = found->second;
+        return true;
+    }
+    const auto& single = gsm7Codes(singleShift).singleShift;
+    found = single.find(codePoint);
+    if (found != single.end()) {
+        code = uint16_t(escape << 8 | found->second);
+        return true;
+    }
+    return false;
+}
+
+const unordered_map<char32_t, const char32_t*>& transliterations() {
+    static const unordered_map<char32_t, const char32_t*> transliterations(
+        begin(transliterationTable), end(transliterationTable));
+    return transliterations;
+}
+
+bool isSupported(Language language) {
+    return static_cast<size_t>(language) < languageCount;
+}
+
+size_t ucs2Units(char32_t codePoint) { return codePoint > 0xFFFF ? 2 : 1; }
+
+/**
+ * @brief Returns the octets of user data header that the national language
+ * tables of a plan take.
+ */
+size_t languageHeaderOctets(const EncodingPlan& plan) {
+    return (plan.lockingShift != Language::Default ? 3 : 0) +
+           (plan.singleShift != Language::Default ? 3 : 0);
+}
+
+/**
+ * @brief Splits a text into the code points of each segment. Characters
+ * that take two septets or units are never split between segments.
+ *
+ * @param unitBits the bits of a septet or unit, 7 or 16.
+ * @param languageHeader the octets of header for the language tables, which
+ * every segment carries.
+ */
+template <typename SizeOf>
+vector<u32string> split(const u32string& text, SizeOf sizeOf, size_t unitBits,
+                        size_t languageHeader) {
+    auto capacity = [unitBits](size_t headerOctets) {
+        // The header length octet comes on top of its elements
+        auto octets = headerOctets == 0 ? 0 : 1 + headerOctets;
+        return (userDataOctets - octets) * 8 / unitBits;
+    };
+    size_t total = 0;
+    for (auto codePoint : text) {
+        total += sizeOf(codePoint);
+    }
+    if (total <= capacity(languageHeader)) {
+        return {text};
+    }
+    // Concatenated messages carry a five octet element with an 8 bit
+    // reference
+    auto perSegment = capacity(languageHeader + 5);
+    vector<u32string> segments(1);
+    size_t used = 0;
+    for (auto codePoint : text) {
+        auto size = sizeOf(codePoint);
+        if (used + size > perSegment) {
+            segments.emplace_back();
+            used = 0;
+        }
+        segments.back() += codePoint;
+        used += size;
+    }
+    return segments;
+}
+
+/**
+ * @brief Plans a text as GSM-7 with the tables of the plan, transliterating
+ * characters that they do not have if allowed.
+ *
+ * @return false if a character cannot be represented.
+ */
+bool planGsm7(const u32string& text, bool transliterate, EncodingPlan& plan) {
+    auto locking = plan.lockingShift;
+    auto single = plan.singleShift;
+    auto sizeOf = [locking, single](char32_t codePoint) {
+        return gsm7Septets(codePoint, locking, single);
+    };
+    u32string encodable;
+    encodable.reserve(text.size());
+    plan.transliterated = 0;
+    for (auto codePoint : text) {
+        if (sizeOf(codePoint) != 0) {
+            encodable += codePoint;
+            continue;
+        }
+        if (!transliterate) {
+            return false;
+        }
+        auto found = transliterations().find(codePoint);
+        if (found == transliterations().end()) {
+            return false;
+        }
+        for (auto c = found->second; *c != 0; ++c) {
+            if (sizeOf(*c) == 0) {
+                return false;
+            }
+            encodable += *c;
+        }
+        plan.transliterated++;
+    }
+    plan.encoding = Encoding::Gsm7;
+    plan.segments = split(encodable, sizeOf, 7, languageHeaderOctets(plan));
+    return true;
+}
+
+void appendAddress(vector<uint8_t>& pdu, const string& number) {
+    auto international = number[0] == '+';
+    auto digits = number.substr(international ? 1 : 0);
+    pdu.push_back(static_cast<uint8_t>(digits.size()));
+    pdu.push_back(international ? 0x91 : 0x81);
+    for (size_t i = 0; i < digits.size(); i += 2) {
+        auto low = static_cast<uint8_t>(digits[i] - '0');
+        auto high = i + 1 < digits.size()
+                        ? static_cast<uint8_t>(digits[i + 1] - '0')
+                        : uint8_t(0x0F);
+        pdu.push_back(static_cast<uint8_t>(high << 4 | low));
+    }
+}
+
+void appendGsm7(vector<uint8_t>& pdu, const u32string& segment,
+                const vector<uint8_t>& header, const EncodingPlan& plan) {
+    vector<uint8_t> septets;
+    for (auto codePoint : segment) {
+        uint16_t code = 0;
+        gsm7Code(codePoint, plan.lockingShift, plan.singleShift, code);
+        if (code >> 8 != 0) {
+            septets.push_back(escape);
+        }
+        septets.push_back(static_cast<uint8_t>(code & 0x7F));
+    }
+    // The header is padded to a septet boundary
+    auto headerSeptets = (header.size() * 8 + 6) / 7;
+    auto totalSeptets = headerSeptets + septets.size();
+    pdu.push_back(static_cast<uint8_t>(totalSeptets));
+    auto start = pdu.size();
+    pdu.resize(start + (totalSeptets * 7 + 7) / 8, 0);
+    copy(header.begin(), header.end(), pdu.begin() + ptrdiff_t(start));
+    auto bit = headerSeptets * 7;
+    for (auto septet : septets) {
+        for (size_t b = 0; b < 7; ++b, ++bit) {
+            if (septet >> b & 1) {
+                pdu[start + bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+            }
+        }
+    }
+}
+
+void appendUcs2(vector<uint8_t>& pdu, const u32string& segment,
+                const vector<uint8_t>& header) {
+    vector<uint8_t> data(header);
+    auto appendUnit = [&data](char32_t unit) {
+        data.push_back(static_cast<uint8_t>(unit >> 8));
+        data.push_back(static_cast<uint8_t>(unit & 0xFF));
+    };
+    for (auto codePoint : segment) {
+        if (codePoint > 0xFFFF) {
+            codePoint -= 0x10000;
+            appendUnit(0xD800 + (codePoint >> 10));
+            appendUnit(0xDC00 + (codePoint & 0x3FF));
+        } else {
+            appendUnit(codePoint);
+        }
+    }
+    pdu.push_back(static_cast<uint8_t>(data.size()));
+    pdu.insert(pdu.end(), data.begin(), data.end());
+}
+
+bool isValidNumber(const string& number) {
+    auto international = !number.empty() && number[0] == '+';
+    auto digits = number.size() - (international ? 1 : 0);
+    if (digits == 0 || digits > 20) {
+        return false;
+    }
+    for (size_t i = international ? 1 : 0; i < number.size(); ++i) {
+        if (number[i] < '0' || number[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+string toHex(const vector<uint8_t>& bytes) {
+    static const char digits[] = "0123456789ABCDEF";
+    string hex;
+    hex.reserve(bytes.size() * 2);
+    for (auto byte : bytes) {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 0x0F];
+    }
+    return hex;
+}
+
+bool fromHex(const string& hex, vector<uint8_t>& bytes) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    auto nibble = [](char c) {
+        return c >= '0' && c <= '9'   ? c - '0'
+               : c >= 'A' && c <= 'F' ? c - 'A' + 10
+               : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                                      : -1;
+    };
+    bytes.clear();
+    bytes.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        auto high = nibble(hex[i]);
+        auto low = nibble(hex[i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        bytes.push_back(static_cast<uint8_t>(high << 4 | low));
+    }
+    return true;
+}
+
+/**
+ * @brief Unpacks septets starting at the given septet of the data and maps
+ * them to code points.
+ */
+u32string unpackGsm7(const uint8_t* data, size_t size, size_t first,
+                     size_t count, Language lockingShift = Language::Default,
+                     Language singleShift = Language::Default) {
+    auto alphabet = lockingShiftTable(lockingShift);
+    if (alphabet == nullptr) {
+        alphabet = defaultAlphabet;
+    }
+    auto extension = singleShiftTable(singleShift);
+    auto extensionEnd = extension.entries + extension.size;
+    u32string text;
+    bool escaped = false;
+    for (size_t i = first; i < first + count; ++i) {
+        auto bit = i * 7;
+        if ((bit + 6) / 8 >= size) {
+            break;
+        }
+        unsigned septet = data[bit / 8] >> (bit % 8);
+        if (bit % 8 > 1) {
+            septet |= unsigned(data[bit / 8 + 1]) << (8 - bit % 8);
+        }
+        septet &= 0x7F;
+        if (escaped) {
+            escaped = false;
+            auto entry = find_if(
+                extension.entries, extensionEnd,
+                [septet](const auto& entry) { return entry.first == septet; });
+            // Unknown extensions fall back to the locking shift table
+            text += entry != extensionEnd ? entry->second : alphabet[septet];
+        } else if (septet == escape) {
+            escaped = true;
+        } else {
+            text += alphabet[septet];
+        }
+    }
+    return text;
+}
+
+u32string decodeUcs2(const uint8_t* data, size_t size) {
+    u32string text;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        char32_t unit = char32_t(data[i]) << 8 | data[i + 1];
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < size) {
+            char32_t low = char32_t(data[i + 2]) << 8 | data[i + 3];
+            if (low >= 0xDC00 && low < 0xE000) {
+                text += 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+                continue;
+            }
+        }
+        text += unit;
+    }
+    return text;
+}
+
+int semiOctet(uint8_t byte) { return (byte & 0x0F) * 10 + (byte >> 4); }
+
+/**
+ * @brief Returns the days since 1970-01-01 of a date in the proleptic
+ * Gregorian calendar.
+ */
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    auto era = (year >= 0 ? year : year - 399) / 400;
+    auto yearOfEra = static_cast<unsigned>(year - era * 400);
+    auto dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    auto dayOfEra =
+        yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+/**
+ * @brief Decodes a service centre time stamp into microseconds since the
+ * epoch.
+ */
+int64_t decodeTimestamp(const uint8_t* data) {
+    auto year = 2000 + semiOctet(data[0]);
+    auto days = daysFromCivil(year, static_cast<unsigned>(semiOctet(data[1])),
+                              static_cast<unsigned>(semiOctet(data[2])));
+    int64_t seconds = days * 86400 + semiOctet(data[3]) * 3600 +
+                      semiOctet(data[4]) * 60 + semiOctet(data[5]);
+    // The time zone in quarters of an hour, with a sign bit
+    auto zone = semiOctet(data[6] & 0xF7) * 15 * 60;
+    seconds -= data[6] & 0x08 ? -zone : zone;
+    return seconds * 1000000;
+}
+
+/**
+ * @brief Decodes the originating address of an SMS-DELIVER and sets the
+ * offset to the protocol identifier after it.
+ *
+ * @return false if the PDU is not an SMS-DELIVER or too short.
+ */
+bool decodeOriginator(const vector<uint8_t>& bytes, size_t& offset,
+                      string& sender) {
+    if (bytes.empty()) {
+        return false;
+    }
+    const auto* data = bytes.data();
+    auto size = bytes.size();
+    // Skip the SMSC address
+    offset = 1 + size_t(data[0]);
+    if (offset + 2 > size || (data[offset] & 0x03) != 0) {
+        return false;
+    }
+    offset++;
+    size_t digits = data[offset];
+    auto type = data[offset + 1];
+    auto addressSize = (digits + 1) / 2;
+    offset += 2;
+    if (offset + addressSize + 10 > size) {
+        return false;
+    }
+    if ((type & 0x70) == 0x50) {
+        // Alphanumeric sender, such as an operator name
+        sender = encodeUtf8(
+            unpackGsm7(data + offset, addressSize, 0, digits * 4 / 7));
+    } else {
+        sender = (type & 0x70) == 0x10 ? "+" : "";
+        for (size_t i = 0; i < digits; ++i) {
+            auto digit = data[offset + i / 2] >> (i % 2 * 4) & 0x0F;
+            if (digit > 9) {
+                break;
+            }
+            sender += static_cast<char>('0' + digit);
+        }
+    }
+    offset += addressSize;
+    return true;
+}
+
+} // namespace
+
+u32string decodeUtf8(const string& text) {
+    u32string decoded;
+    decoded.reserve(text.size());
+    for (size_t i = 0; i < text.size();) {
+        auto byte = static_cast<uint8_t>(text[i]);
+        size_t length = byte < 0x80             ? 1
+                        : (byte & 0xE0) == 0xC0 ? 2
+                        : (byte & 0xF0) == 0xE0 ? 3
+                        : (byte & 0xF8) == 0xF0 ? 4
+                                                : 0;
+        if (length == 0 || i + length > text.size()) {
+            decoded += replacement;
+            i++;
+            continue;
+        }
+        char32_t codePoint =
+            length == 1 ? byte : byte & (0xFF >> (length + 1));
+        bool valid = true;
+        for (size_t j = 1; j < length; ++j) {
+            auto next = static_cast<uint8_t>(text[i + j]);
+            if ((next & 0xC0) != 0x80) {
+                valid = false;
+                break;
+            }
+            codePoint = codePoint << 6 | (next & 0x3F);
+        }
+        if (!valid) {
+            decoded += replacement;
+            i++;
+            continue;
+        }
+        decoded += codePoint > 0x10FFFF ? replacement : codePoint;
+        i += length;
+    }
+    return decoded;
+}
+
+size_t gsm7Septets(char32_t codePoint, Language lockingShift,
+                   Language singleShift) {
+    uint16_t code = 0;
+    if (!gsm7Code(codePoint, lockingShift, singleShift, code)) {
+        return 0;
+    }
+    return code >> 8 != 0 ? 2 : 1;
+}
+
+EncodingPlan planEncoding(const u32string& text,
+                          const EncodingOptions& options) {
+    vector<pair<Language, Language>> tables = {
+        {Language::Default, Language::Default}};
+    for (auto language : options.languages) {
+        if (language == Language::Default || !isSupported(language)) {
+            continue;
+        }
+        tables.emplace_back(Language::Default, language);
+        if (lockingShiftTable(language) != nullptr) {
+            tables.emplace_back(language, Language::Default);
+            tables.emplace_back(language, language);
+        }
+    }
+    auto cost = [](const EncodingPlan& plan) {
+        return make_tuple(plan.segments.size(), plan.transliterated,
+                          languageHeaderOctets(plan));
+    };
+    EncodingPlan best;
+    auto found = false;
+    for (const auto& [locking, single] : tables) {
+        EncodingPlan plan;
+        plan.lockingShift = locking;
+        plan.singleShift = single;
+        if (planGsm7(text, options.transliterate, plan) &&
+            (!found || cost(plan) < cost(best))) {
+            best = move(plan);
+            found = true;
+            if (best.segments.size() == 1 && best.transliterated == 0 &&
+                languageHeaderOctets(best) == 0) {
+                // Nothing beats a single plain message
+                return best;
+            }
+        }
+    }
+    EncodingPlan ucs2;
+    ucs2.encoding = Encoding::Ucs2;
+    ucs2.segments = split(text, ucs2Units, 16, 0);
+    if (!found || cost(ucs2) < cost(best)) {
+        best = move(ucs2);
+    }
+    return best;
+}
+
+size_t segmentCount(const u32string& text, const EncodingOptions& options) {
+    return planEncoding(text, options).segments.size();
+}
+
+vector<SubmitPdu> encodeSubmit(const string& number, const EncodingPlan& plan,
+                               uint8_t reference) {
+    const auto& segments = plan.segments;
+    if (!isValidNumber(number) || segments.size() > maxSegments) {
+        return {};
+    }
+    vector<SubmitPdu> pdus;
+    pdus.reserve(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        vector<uint8_t> header;
+        if (segments.size() > 1) {
+            // Concatenated message with an 8 bit reference
+            header.insert(header.end(),
+                          {0x00, 0x03, reference,
+                           static_cast<uint8_t>(segments.size()),
+                           static_cast<uint8_t>(i + 1)});
+        }
+        if (plan.encoding == Encoding::Gsm7) {
+            if (plan.lockingShift != Language::Default) {
+                header.insert(header.end(),
+                              {0x25, 0x01,
+                               static_cast<uint8_t>(plan.lockingShift)});
+            }
+            if (plan.singleShift != Language::Default) {
+                header.insert(header.end(),
+                              {0x24, 0x01,
+                               static_cast<uint8_t>(plan.singleShift)});
+            }
+        }
+        if (!header.empty()) {
+            header.insert(header.begin(), static_cast<uint8_t>(header.size()));
+        }
+        vector<uint8_t> pdu;
+        // Use the SMSC stored in the modem
+        pdu.push_back(0x00);
+        // SMS-SUBMIT, with the user data header indicator if needed
+        pdu.push_back(header.empty() ? 0x01 : 0x41);
+        // Message reference, assigned by the modem
+        pdu.push_back(0x00);
+        appendAddress(pdu, number);
+        // Protocol identifier
+        pdu.push_back(0x00);
+        // Data coding scheme
+        pdu.push_back(plan.encoding == Encoding::Gsm7 ? 0x00 : 0x08);
+        if (plan.encoding == Encoding::Gsm7) {
+            appendGsm7(pdu, segments[i], header, plan);
+        } else {
+            appendUcs2(pdu, segments[i], header);
+        }
+        pdus.push_back(SubmitPdu{toHex(pdu), pdu.size() - 1});
+    }
+    return pdus;
+}
+
+vector<SubmitPdu> encodeSubmit(const string& number, const string& text,
+                               uint8_t reference,
+                               const EncodingOptions& options) {
+    if (!isValidNumber(number)) {
+        return {};
+    }
+    return encodeSubmit(number, planEncoding(decodeUtf8(text), options),
+                        reference);
+}
+
+string encodeUtf8(const u32string& text) {
+    string encoded;
+    encoded.reserve(text.size());
+    for (auto codePoint : text) {
+        if (codePoint < 0x80) {
+            encoded += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            encoded += static_cast<char>(0xC0 | codePoint >> 6);
+            encoded += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            encoded += static_cast<char>(0xE0 | codePoint >> 12);
+            encoded += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            encoded += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            encoded += static_cast<char>(0xF0 | codePoint >> 18);
+            encoded += static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+            encoded += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            encoded += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+    return encoded;
+}
+
+bool decodeDeliver(const string& hex, DeliverPdu& pdu) {
+    vector<uint8_t> bytes;
+    size_t offset = 0;
+    if (!fromHex(hex, bytes) || !decodeOriginator(bytes, offset, pdu.sender)) {
+        return false;
+    }
+    const auto* data = bytes.data();
+    auto size = bytes.size();
+    auto hasHeader = (data[1 + size_t(data[0])] & 0x40) != 0;
+    auto scheme = data[offset + 1];
+    pdu.timestamp = decodeTimestamp(data + offset + 2);
+    offset += 9;
+    size_t length = data[offset++];
+    auto ucs2 = (scheme & 0xC0) == 0x00   ? (scheme & 0x0C) == 0x08
+                : (scheme & 0xF0) == 0xE0 ? true
+                                          : false;
+    auto eightBit = ((scheme & 0xC0) == 0x00 && (scheme & 0x0C) == 0x04) ||
+                    ((scheme & 0xF0) == 0xF0 && (scheme & 0x04) != 0);
+    const auto* userData = data + offset;
+    auto userDataSize = size - offset;
+    size_t headerSize = 0;
+    pdu.reference = 0;
+    pdu.parts = 1;
+    pdu.part = 1;
+    auto lockingShift = Language::Default;
+    auto singleShift = Language::Default;
+    if (hasHeader && userDataSize > 0) {
+        headerSize = 1 + size_t(userData[0]);
+        if (headerSize > userDataSize) {
+            return false;
+        }
+        for (size_t i = 1; i + 1 < headerSize;) {
+            auto id = userData[i];
+            size_t elementSize = userData[i + 1];
+            const auto* element = userData + i + 2;
+            if (i + 2 + elementSize > headerSize) {
+                break;
+            }
+            if (id == 0x00 && elementSize == 3) {
+                pdu.reference = element[0];
+                pdu.parts = element[1];
+                pdu.part = element[2];
+            } else if (id == 0x08 && elementSize == 4) {
+                pdu.reference = static_cast<uint16_t>(element[0] << 8 |
+                                                      element[1]);
+                pdu.parts = element[2];
+                pdu.part = element[3];
+            } else if ((id == 0x24 || id == 0x25) && elementSize == 1 &&
+                       isSupported(static_cast<Language>(element[0]))) {
+                (id == 0x25 ? lockingShift : singleShift) =
+                    static_cast<Language>(element[0]);
+            }
+            i += 2 + elementSize;
+        }
+    }
+    if (!ucs2 && !eightBit) {
+        // The length counts septets, including the padded header
+        auto headerSeptets = (headerSize * 8 + 6) / 7;
+        if (length < headerSeptets) {
+            return false;
+        }
+        pdu.text = encodeUtf8(unpackGsm7(
+            userData, userDataSize, headerSeptets, length - headerSeptets,
+            lockingShift, singleShift));
+        return true;
+    }
+    length = min(length, userDataSize);
+    if (length < headerSize) {
+        return false;
+    }
+    if (ucs2) {
+        pdu.text = encodeUtf8(
+            decodeUcs2(userData + headerSize, length - headerSize));
+    } else {
+        pdu.text.assign(reinterpret_cast<const char*>(userData) + headerSize,
+                        length - headerSize);
+    }
+    return true;
+}
+
+bool decodeSender(const string& hex, string& sender) {
+    vector<uint8_t> bytes;
+    size_t offset = 0;
+    return fromHex(hex, bytes) && decodeOriginator(bytes, offset, sender);
+}
+
+} // namespace GsmGateway::Sms
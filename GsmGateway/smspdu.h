@@ -0,0 +1,167 @@
+#ifndef SMSPDU_H
+#define SMSPDU_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Encoding of outgoing SMS as SMS-SUBMIT PDUs (3GPP TS 23.040) for AT+CMGS in
+ * PDU mode. Texts are sent as GSM-7 where possible, with the default alphabet
+ * or a national language shift table (3GPP TS 23.038), and as UCS-2
+ * otherwise, which takes more than twice the segments. Texts that do not fit
+ * one message are split into concatenated segments with a user data header.
+ *
+ * Received SMS are decoded from SMS-DELIVER PDUs as listed by AT+CMGR.
+ */
+namespace GsmGateway::Sms {
+
+enum class Encoding : uint8_t { Gsm7, Ucs2 };
+
+/**
+ * @brief The supported national language tables, by their language
+ * identifier in 3GPP TS 23.038. Each has a single shift table, which
+ * replaces the extension table; Turkish also has a locking shift table,
+ * which replaces the default alphabet.
+ */
+enum class Language : uint8_t {
+    Default = 0,
+    Turkish = 1,
+    Spanish = 2,
+    Portuguese = 3
+};
+
+/**
+ * @brief How outgoing texts may be encoded to save segments.
+ */
+struct EncodingOptions {
+    // Replace characters that have no GSM-7 representation with close ones,
+    // such as typographic quotes with plain ones or 'ł' with 'l'
+    bool transliterate = true;
+    // The national language tables that may be used where they save
+    // segments; UCS-2 is preferred otherwise, as every handset shows it
+    vector<Language> languages = {Language::Turkish, Language::Spanish,
+                                  Language::Portuguese};
+};
+
+/**
+ * @brief How a text is sent, as chosen by planEncoding().
+ */
+struct EncodingPlan {
+    Encoding encoding = Encoding::Gsm7;
+    // The GSM-7 tables; each one other than the default costs three octets
+    // of user data header in every segment
+    Language lockingShift = Language::Default;
+    Language singleShift = Language::Default;
+    // The text of each segment, after transliteration
+    vector<u32string> segments;
+    // The number of characters that were transliterated
+    size_t transliterated = 0;
+};
+
+/**
+ * @brief One segment of an outgoing SMS, ready for AT+CMGS.
+ */
+struct SubmitPdu {
+    // The PDU as hex, including the empty SMSC address in front
+    string hex;
+    // The number of octets without the SMSC address, the AT+CMGS argument
+    size_t length = 0;
+};
+
+/**
+ * @brief A received SMS, decoded from an SMS-DELIVER PDU.
+ */
+struct DeliverPdu {
+    string sender;
+    // The SMSC timestamp, in microseconds since the epoch
+    int64_t timestamp = 0;
+    // The text in UTF-8
+    string text;
+    // The concatenation reference, the number of parts and this part
+    uint16_t reference = 0;
+    uint8_t parts = 1;
+    uint8_t part = 1;
+};
+
+constexpr size_t gsm7SingleSeptets = 160;
+constexpr size_t gsm7SegmentSeptets = 153;
+constexpr size_t ucs2SingleUnits = 70;
+constexpr size_t ucs2SegmentUnits = 67;
+constexpr size_t maxSegments = 255;
+
+/**
+ * @brief Decodes UTF-8 into code points. Invalid sequences become U+FFFD.
+ */
+u32string decodeUtf8(const string& text);
+
+string encodeUtf8(const u32string& text);
+
+/**
+ * @brief Returns the GSM-7 septets of a code point: one for the locking
+ * shift table (the default alphabet unless given), two (escape and code) for
+ * the single shift table (the extension table unless given), none if it has
+ * no representation in either.
+ */
+size_t gsm7Septets(char32_t codePoint,
+                   Language lockingShift = Language::Default,
+                   Language singleShift = Language::Default);
+
+/**
+ * @brief Chooses how to send a text with the fewest segments: GSM-7 with the
+ * default or a national language table, or UCS-2, transliterating characters
+ * if allowed. Between plans with as many segments, the one with the fewest
+ * transliterated characters wins, then the one with the shortest header.
+ */
+EncodingPlan planEncoding(const u32string& text,
+                          const EncodingOptions& options = {});
+
+/**
+ * @brief Returns the number of segments a text is sent as.
+ */
+size_t segmentCount(const u32string& text,
+                    const EncodingOptions& options = {});
+
+/**
+ * @brief Encodes a planned text as SMS-SUBMIT PDUs.
+ *
+ * @param number the recipient, international numbers with a leading '+'.
+ * @param plan the plan of the text.
+ * @param reference the reference shared by the segments of a concatenated
+ * message; it should differ between consecutive messages to the same
+ * recipient.
+ * @return the segments, or none if the number is invalid or the text needs
+ * more than maxSegments segments.
+ */
+vector<SubmitPdu> encodeSubmit(const string& number, const EncodingPlan& plan,
+                               uint8_t reference);
+
+/**
+ * @brief Encodes a text in UTF-8 as SMS-SUBMIT PDUs, as planned with the
+ * given options.
+ */
+vector<SubmitPdu> encodeSubmit(const string& number, const string& text,
+                               uint8_t reference,
+                               const EncodingOptions& options = {});
+
+/**
+ * @brief Decodes an SMS-DELIVER PDU given as hex, including the SMSC address.
+ *
+ * @return false if the PDU is not a valid SMS-DELIVER.
+ */
+bool decodeDeliver(const string& hex, DeliverPdu& pdu);
+
+/**
+ * @brief Decodes only the sender of an SMS-DELIVER PDU, without its user
+ * data.
+ *
+ * @return false if the PDU is not a valid SMS-DELIVER.
+ */
+bool decodeSender(const string& hex, string& sender);
+
+} // namespace GsmGateway::Sms
+
+#endif // SMSPDU_H
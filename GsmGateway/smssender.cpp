@@ -0,0 +1,136 @@
+#include "smssender.h"
+
+#include <algorithm>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+namespace {
+
+// Submissions wait for the network, which can take a while under load
+constexpr chrono::seconds submitTimeout(60);
+
+} // namespace
+
+SmsSender::SmsSender(AtChannel& channel, int moreMessagesMode,
+                     size_t maxInFlight)
+    : _channel(channel), _moreMessagesMode(moreMessagesMode),
+      _maxInFlight(max<size_t>(1, maxInFlight)) {}
+
+void SmsSender::start() {
+    if (_moreMessagesMode != 2) {
+        return;
+    }
+    _stats.linkCommands++;
+    _linkKept = true;
+    _channel.command("AT+CMMS=2", [this](const AtResponse& response) {
+        if (!response.ok) {
+            GSM_LOG(Log::Level::Warning, "{} rejected AT+CMMS=2: {}",
+                    _channel.name(), response.result);
+            _moreMessagesMode = 0;
+            _linkKept = false;
+        }
+    });
+}
+
+void SmsSender::send(const string& number, const string& text, Done done) {
+    auto message = make_shared<Message>();
+    message->number = number;
+    auto plan = Sms::planEncoding(Sms::decodeUtf8(text), _encodingOptions);
+    message->pdus = Sms::encodeSubmit(number, plan, ++_reference);
+    message->done = move(done);
+    if (message->pdus.empty()) {
+        GSM_LOG(Log::Level::Warning,
+                "Cannot send SMS to {}: invalid number or text too long",
+                number);
+        finish(message, "invalid number or text too long");
+        return;
+    }
+    if (plan.encoding == Sms::Encoding::Ucs2) {
+        _stats.ucs2Messages++;
+    } else if (plan.lockingShift != Sms::Language::Default ||
+               plan.singleShift != Sms::Language::Default) {
+        _stats.languageMessages++;
+    }
+    _stats.transliterated += plan.transliterated;
+    _backlog += message->pdus.size();
+    _queue.push_back(move(message));
+    submitNext();
+}
+
+void SmsSender::submitNext() {
+    while (_inFlight < _maxInFlight && !_queue.empty()) {
+        auto message = _queue.front();
+        if (_moreMessagesMode == 1 && !_linkKept &&
+            _backlog + _waitingSegments > 1) {
+            // Queued ahead of the first submission of the burst
+            _linkKept = true;
+            _stats.linkCommands++;
+            _channel.command("AT+CMMS=1", [this](const AtResponse& response) {
+                if (!response.ok) {
+                    GSM_LOG(Log::Level::Warning, "{} rejected AT+CMMS=1: {}",
+                            _channel.name(), response.result);
+                    _moreMessagesMode = 0;
+                }
+            });
+        }
+        const auto& pdu = message->pdus[message->submitted++];
+        if (message->submitted == message->pdus.size()) {
+            _queue.pop_front();
+        }
+        _backlog--;
+        _inFlight++;
+        AtCommand command;
+        command.line = "AT+CMGS=" + to_string(pdu.length);
+        command.payload = pdu.hex;
+        command.timeout = submitTimeout;
+        command.done = [this, message](const AtResponse& response) {
+            onSubmitted(message, response);
+        };
+        _channel.command(move(command));
+    }
+}
+
+void SmsSender::onSubmitted(const shared_ptr<Message>& message,
+                            const AtResponse& response) {
+    _inFlight--;
+    message->completed++;
+    if (response.ok) {
+        _stats.segments++;
+    } else if (message->error.empty()) {
+        message->error = response.result;
+        GSM_LOG(Log::Level::Warning, "Sending SMS to {} failed: {}",
+                message->number, response.result);
+        if (message->submitted < message->pdus.size()) {
+            // The rest of a broken concatenated message is not sent; the
+            // message is done once the submitted segments are
+            _backlog -= message->pdus.size() - message->submitted;
+            message->pdus.resize(message->submitted);
+            _queue.erase(find(_queue.begin(), _queue.end(), message));
+        }
+    }
+    if (message->completed == message->submitted &&
+        message->submitted == message->pdus.size()) {
+        finish(message, message->error);
+    }
+    if (_inFlight == 0 && _queue.empty() && _moreMessagesMode == 1) {
+        // The modem closes the link and resets the mode once idle
+        _linkKept = false;
+    }
+    submitNext();
+}
+
+void SmsSender::finish(const shared_ptr<Message>& message,
+                       const string& error) {
+    if (error.empty()) {
+        _stats.messages++;
+    } else {
+        _stats.failures++;
+    }
+    if (message->done) {
+        message->done(error.empty(), error);
+    }
+}
+
+} // namespace GsmGateway
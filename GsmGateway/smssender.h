@@ -0,0 +1,140 @@
+#ifndef SMSSENDER_H
+#define SMSSENDER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "atchannel.h"
+#include "smspdu.h"
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief Statistics of an SmsSender.
+ */
+struct SmsSenderStats {
+    uint64_t messages = 0;
+    uint64_t segments = 0;
+    uint64_t failures = 0;
+    // AT+CMMS commands sent to keep the relay link open
+    uint64_t linkCommands = 0;
+    // Messages sent as UCS-2, and with a national language table
+    uint64_t ucs2Messages = 0;
+    uint64_t languageMessages = 0;
+    // Characters transliterated to keep messages in GSM-7
+    uint64_t transliterated = 0;
+};
+
+/**
+ * @brief Sends SMS through a modem in PDU mode.
+ *
+ * Every AT+CMGS normally sets up and releases the radio link to the SMSC,
+ * which dominates the time per message. When more than one segment is
+ * waiting, the sender first enables "more messages to send" with AT+CMMS, so
+ * the modem keeps the relay link open between the submissions of a burst,
+ * such as an alarm fan-out.
+ *
+ * Messages are encoded when they are queued, in the fewest segments the
+ * encoding options allow, and the command for the next segment is queued on
+ * the channel before the current one completes, so the channel writes it the
+ * moment the modem reports the result and writes its PDU the moment the
+ * modem prompts for it.
+ *
+ * All members must be called on the io_context thread of the channel.
+ */
+class SmsSender {
+  public:
+    using Done = function<void(bool ok, const string& error)>;
+
+    /**
+     * @brief Creates a new SmsSender.
+     *
+     * @param channel the channel to the modem, in PDU mode.
+     * @param moreMessagesMode the AT+CMMS mode for bursts: 1 enables it for
+     * each burst, 2 once on start(), 0 never. Set to 0 when a modem rejects
+     * it.
+     * @param maxInFlight the number of submissions queued on the channel at
+     * a time.
+     */
+    explicit SmsSender(AtChannel& channel, int moreMessagesMode = 1,
+                       size_t maxInFlight = 2);
+
+    SmsSender(const SmsSender&) = delete;
+    SmsSender& operator=(const SmsSender&) = delete;
+
+    void start();
+
+    void setEncodingOptions(Sms::EncodingOptions options) {
+        _encodingOptions = move(options);
+    }
+
+    /**
+     * @brief Queues a message.
+     *
+     * @param number the recipient, international numbers with a leading '+'.
+     * @param text the text in UTF-8.
+     * @param done called once every segment has been submitted, or when the
+     * message could not be sent.
+     */
+    void send(const string& number, const string& text, Done done = {});
+
+    /**
+     * @brief Returns the number of segments a text is sent in.
+     */
+    size_t segmentsOf(const string& text) const {
+        return Sms::segmentCount(Sms::decodeUtf8(text), _encodingOptions);
+    }
+
+    /**
+     * @brief Tells the sender how many segments wait to be queued, such as
+     * in a TenantScheduler, so that it keeps the relay link open for them
+     * too.
+     */
+    void setWaitingSegments(size_t segments) { _waitingSegments = segments; }
+
+    /**
+     * @brief Returns the number of segments that have not been submitted.
+     */
+    size_t backlog() const { return _backlog; }
+
+    const SmsSenderStats& stats() const { return _stats; }
+
+  private:
+    struct Message {
+        string number;
+        vector<Sms::SubmitPdu> pdus;
+        size_t submitted = 0;
+        size_t completed = 0;
+        // The result of the first segment that failed
+        string error;
+        Done done;
+    };
+
+    void submitNext();
+    void onSubmitted(const shared_ptr<Message>& message,
+                     const AtResponse& response);
+    void finish(const shared_ptr<Message>& message, const string& error);
+
+    AtChannel& _channel;
+    int _moreMessagesMode;
+    size_t _maxInFlight;
+    deque<shared_ptr<Message>> _queue;
+    size_t _inFlight = 0;
+    size_t _backlog = 0;
+    size_t _waitingSegments = 0;
+    bool _linkKept = false;
+    uint8_t _reference = 0;
+    Sms::EncodingOptions _encodingOptions;
+    SmsSenderStats _stats;
+};
+
+} // namespace GsmGateway
+
+#endif // SMSSENDER_H
@@ -0,0 +1,213 @@
+#include "tenantscheduler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+#include "log.h"
+
+namespace GsmGateway {
+
+TenantScheduler::TenantScheduler(SmsSender& sender, size_t maxDispatched,
+                                 size_t quantum)
+    : _sender(sender), _maxDispatched(max<size_t>(1, maxDispatched)),
+      _quantum(max<size_t>(1, quantum)) {}
+
+size_t TenantScheduler::addTenant(const string& name, unsigned weight,
+                                  size_t maxBulk) {
+    auto tenant = make_unique<Tenant>();
+    tenant->name = name;
+    tenant->quantum = _quantum * max(1u, weight);
+    tenant->maxBulk = maxBulk;
+    _tenants.push_back(move(tenant));
+    return _tenants.size() - 1;
+}
+
+void TenantScheduler::send(size_t tenant, const string& number,
+                           const string& text, bool alarm,
+                           SmsSender::Done done) {
+    auto& state = *_tenants[tenant];
+    auto& queue = alarm ? state.alarms : state.bulk;
+    if (!alarm && queue.messages.size() >= state.maxBulk) {
+        state.stats.rejected++;
+        GSM_LOG(Log::Level::Warning,
+                "Refusing bulk SMS of {} to {}: {} queued", state.name,
+                number, queue.messages.size());
+        if (done) {
+            done(false, "queue full");
+        }
+        return;
+    }
+    remember(number, tenant);
+    Message message;
+    message.number = number;
+    message.text = text;
+    message.segments = max<size_t>(1, _sender.segmentsOf(text));
+    message.queued = Clock::now();
+    message.done = move(done);
+    _waitingSegments += message.segments;
+    _sender.setWaitingSegments(_waitingSegments);
+    if (queue.messages.empty()) {
+        (alarm ? _alarms : _bulk).active.push_back(tenant);
+    }
+    queue.messages.push_back(move(message));
+    dispatch();
+}
+
+bool TenantScheduler::openRoutes(const string& path) {
+    _routes.close();
+    ifstream saved(path);
+    string number;
+    string name;
+    while (saved >> number >> name) {
+        auto tenant = find_if(_tenants.begin(), _tenants.end(),
+                              [&name](const unique_ptr<Tenant>& tenant) {
+                                  return tenant->name == name;
+                              });
+        if (tenant != _tenants.end()) {
+            remember(number, size_t(tenant - _tenants.begin()));
+        }
+    }
+    saved.close();
+    // Rewritten with the current routes only, so that the file does not
+    // grow with every change over the gateway's lifetime
+    auto temporary = path + ".tmp";
+    {
+        ofstream file(temporary, ios::trunc);
+        for (const auto& [number, stamp] : _recipientOrder) {
+            const auto& recipient = _recipients.at(number);
+            if (recipient.second == stamp) {
+                file << number << ' ' << _tenants[recipient.first]->name
+                     << '\n';
+            }
+        }
+        file.flush();
+        error_code error;
+        if (!file || (filesystem::rename(temporary, path, error), error)) {
+            GSM_LOG(Log::Level::Error, "Cannot write routes to {}", path);
+            return false;
+        }
+    }
+    _routes.open(path, ios::app);
+    GSM_LOG(Log::Level::Info, "Restored {} routes from {}",
+            _recipients.size(), path);
+    return _routes.is_open();
+}
+
+size_t TenantScheduler::tenantOf(const string& number) const {
+    auto recipient = _recipients.find(number);
+    return recipient == _recipients.end() ? noTenant
+                                          : recipient->second.first;
+}
+
+size_t TenantScheduler::queued(size_t tenant) const {
+    const auto& state = *_tenants[tenant];
+    return state.alarms.messages.size() + state.bulk.messages.size();
+}
+
+string TenantScheduler::report(size_t tenant) const {
+    const auto& state = *_tenants[tenant];
+    const auto& stats = state.stats;
+    ostringstream stream;
+    stream << state.name << ": " << stats.alarms << " alarms, " << stats.bulk
+           << " bulk, " << stats.segments << " segments, " << stats.failures
+           << " failed, " << stats.rejected << " rejected, " << queued(tenant)
+           << " queued; alarm wait " << stats.alarmWait.summary()
+           << "; bulk wait " << stats.bulkWait.summary();
+    return stream.str();
+}
+
+void TenantScheduler::dispatch() {
+    if (_dispatching) {
+        // A message that failed at once; the loop below goes on
+        return;
+    }
+    _dispatching = true;
+    while (_dispatched < _maxDispatched &&
+           (dispatchNext(_alarms, true) || dispatchNext(_bulk, false))) {
+    }
+    _dispatching = false;
+}
+
+bool TenantScheduler::dispatchNext(Round& round, bool alarm) {
+    while (!round.active.empty()) {
+        auto tenant = round.active.front();
+        auto& state = *_tenants[tenant];
+        auto& queue = alarm ? state.alarms : state.bulk;
+        if (round.fresh) {
+            queue.deficit += state.quantum;
+            round.fresh = false;
+        }
+        if (queue.messages.front().segments > queue.deficit) {
+            // The tenant's turn is over; the deficit carries over to the next
+            round.active.pop_front();
+            round.active.push_back(tenant);
+            round.fresh = true;
+            continue;
+        }
+        auto message = move(queue.messages.front());
+        queue.messages.pop_front();
+        queue.deficit -= message.segments;
+        if (queue.messages.empty()) {
+            queue.deficit = 0;
+            round.active.pop_front();
+            round.fresh = true;
+        }
+        _waitingSegments -= message.segments;
+        _sender.setWaitingSegments(_waitingSegments);
+        auto wait = chrono::duration_cast<chrono::microseconds>(
+                        Clock::now() - message.queued)
+                        .count();
+        (alarm ? state.stats.alarmWait : state.stats.bulkWait)
+            .record(static_cast<uint64_t>(wait));
+        _dispatched++;
+        auto segments = message.segments;
+        auto done = move(message.done);
+        _sender.send(message.number, message.text,
+                     [this, tenant, alarm, segments,
+                      done = move(done)](bool ok, const string& error) {
+                         _dispatched--;
+                         auto& stats = _tenants[tenant]->stats;
+                         if (!ok) {
+                             stats.failures++;
+                         } else {
+                             (alarm ? stats.alarms : stats.bulk)++;
+                             stats.segments += segments;
+                         }
+                         if (done) {
+                             done(ok, error);
+                         }
+                         dispatch();
+                     });
+        return true;
+    }
+    return false;
+}
+
+void TenantScheduler::remember(const string& number, size_t tenant) {
+    auto stamp = ++_stamp;
+    auto& recipient = _recipients[number];
+    if (_routes.is_open() &&
+        (recipient.second == 0 || recipient.first != tenant)) {
+        _routes << number << ' ' << _tenants[tenant]->name << '\n'
+                << flush;
+        if (!_routes) {
+            GSM_LOG(Log::Level::Error, "Cannot save the route to {}",
+                    number);
+            _routes.clear();
+        }
+    }
+    recipient = {tenant, stamp};
+    _recipientOrder.emplace_back(number, stamp);
+    if (_recipientOrder.size() > maxRecipients) {
+        const auto& oldest = _recipientOrder.front();
+        auto evicted = _recipients.find(oldest.first);
+        if (evicted != _recipients.end() &&
+            evicted->second.second == oldest.second) {
+            _recipients.erase(evicted);
+        }
+        _recipientOrder.pop_front();
+    }
+}
+
+} // namespace GsmGateway
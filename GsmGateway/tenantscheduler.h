@@ -0,0 +1,188 @@
+#ifndef TENANTSCHEDULER_H
+#define TENANTSCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "loopmonitor.h"
+#include "smssender.h"
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief Statistics of one tenant of a TenantScheduler.
+ */
+struct TenantStats {
+    uint64_t alarms = 0;
+    uint64_t bulk = 0;
+    uint64_t segments = 0;
+    uint64_t failures = 0;
+    // Bulk messages refused because the tenant's queue was full
+    uint64_t rejected = 0;
+    // The time messages waited for their turn, in microseconds
+    Base::Diagnostics::Histogram alarmWait;
+    Base::Diagnostics::Histogram bulkWait;
+};
+
+/**
+ * @brief Shares one SmsSender between several tenants, such as the brigades
+ * whose Apps use the same gateway, so that no tenant's traffic holds up
+ * another's.
+ *
+ * Each tenant has a queue for alarms and one for bulk messages. Alarms of
+ * any tenant go before bulk messages of every tenant. Within each class the
+ * tenants take turns by deficit round robin: a tenant may send up to its
+ * weight times the quantum in segments per turn, so a tenant with long
+ * messages gets no more of the modem than one with short ones.
+ *
+ * Only a few messages are handed to the sender at a time, so an alarm waits
+ * for at most those, however much bulk is queued. The bulk queue of each
+ * tenant is bounded; alarms are never refused.
+ *
+ * The scheduler also remembers which tenant last sent to a number, so that
+ * replies can be routed back to it, and saves these routes so that they
+ * survive a restart.
+ *
+ * Not thread safe; the gateway uses it from its io_context thread.
+ */
+class TenantScheduler {
+  public:
+    using Clock = chrono::steady_clock;
+
+    static constexpr size_t noTenant = SIZE_MAX;
+    static constexpr size_t maxRecipients = 65536;
+
+    /**
+     * @brief Creates a new TenantScheduler.
+     *
+     * @param maxDispatched the number of messages handed to the sender at a
+     * time.
+     * @param quantum the segments a tenant of weight 1 may send per turn.
+     */
+    explicit TenantScheduler(SmsSender& sender, size_t maxDispatched = 2,
+                             size_t quantum = 4);
+
+    TenantScheduler(const TenantScheduler&) = delete;
+    TenantScheduler& operator=(const TenantScheduler&) = delete;
+
+    /**
+     * @brief Adds a tenant.
+     *
+     * @param weight the tenant's share of the modem relative to the others.
+     * @param maxBulk the number of bulk messages the tenant may queue.
+     * @return the index of the tenant.
+     */
+    size_t addTenant(const string& name, unsigned weight = 1,
+                     size_t maxBulk = 1000);
+
+    /**
+     * @brief Queues a message of a tenant.
+     *
+     * @param alarm whether the message is an alarm rather than bulk, such as
+     * an informational message to all members.
+     * @param done called once the message has been sent, or when it could
+     * not be sent or was refused.
+     */
+    void send(size_t tenant, const string& number, const string& text,
+              bool alarm, SmsSender::Done done = {});
+
+    /**
+     * @brief Restores the routes of replies saved in a file, and appends
+     * those that change to it from now on. Call after adding the tenants;
+     * routes of tenants that are no longer there are dropped.
+     *
+     * @return false if the file cannot be written.
+     */
+    bool openRoutes(const string& path);
+
+    /**
+     * @brief Returns the tenant that last sent to a number, or noTenant.
+     */
+    size_t tenantOf(const string& number) const;
+
+    size_t tenantCount() const { return _tenants.size(); }
+
+    const string& name(size_t tenant) const { return _tenants[tenant]->name; }
+
+    /**
+     * @brief Returns the number of messages a tenant has queued.
+     */
+    size_t queued(size_t tenant) const;
+
+    const TenantStats& stats(size_t tenant) const {
+        return _tenants[tenant]->stats;
+    }
+
+    /**
+     * @brief Returns a one line summary of a tenant's statistics.
+     */
+    string report(size_t tenant) const;
+
+  private:
+    struct Message {
+        string number;
+        string text;
+        size_t segments = 1;
+        Clock::time_point queued;
+        SmsSender::Done done;
+    };
+
+    /**
+     * @brief The queue of one tenant in one class.
+     */
+    struct Queue {
+        deque<Message> messages;
+        size_t deficit = 0;
+    };
+
+    struct Tenant {
+        string name;
+        size_t quantum = 1;
+        size_t maxBulk = 0;
+        Queue alarms;
+        Queue bulk;
+        TenantStats stats;
+    };
+
+    /**
+     * @brief The tenants with messages of one class, in their turn order.
+     */
+    struct Round {
+        deque<size_t> active;
+        // Whether the tenant in front has not been given its quantum yet
+        bool fresh = true;
+    };
+
+    void dispatch();
+    bool dispatchNext(Round& round, bool alarm);
+    void remember(const string& number, size_t tenant);
+
+    SmsSender& _sender;
+    size_t _maxDispatched;
+    size_t _quantum;
+    vector<unique_ptr<Tenant>> _tenants;
+    Round _alarms;
+    Round _bulk;
+    size_t _dispatched = 0;
+    size_t _waitingSegments = 0;
+    bool _dispatching = false;
+    // The tenant and a stamp per number; the order holds the stamps, the
+    // oldest first, and may hold stale entries of numbers sent to again
+    unordered_map<string, pair<size_t, uint64_t>> _recipients;
+    deque<pair<string, uint64_t>> _recipientOrder;
+    uint64_t _stamp = 0;
+    // One line per changed route, the number and the tenant's name
+    ofstream _routes;
+};
+
+} // namespace GsmGateway
+
+#endif // TENANTSCHEDULER_H
@@ -0,0 +1,194 @@
+#include "modemsimulator.h"
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace GsmGateway {
+
+namespace {
+
+bool startsWith(const string& text, const char* prefix) {
+    return text.compare(0, char_traits<char>::length(prefix), prefix) == 0;
+}
+
+} // namespace
+
+ModemSimulator::ModemSimulator() = default;
+
+ModemSimulator::~ModemSimulator() { stop(); }
+
+bool ModemSimulator::start() {
+    _master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if (_master < 0 || ::grantpt(_master) != 0 || ::unlockpt(_master) != 0) {
+        stop();
+        return false;
+    }
+    termios settings{};
+    if (::tcgetattr(_master, &settings) == 0) {
+        ::cfmakeraw(&settings);
+        ::tcsetattr(_master, TCSANOW, &settings);
+    }
+    _device = ::ptsname(_master);
+    _running = true;
+    _thread = thread(&ModemSimulator::run, this);
+    return true;
+}
+
+void ModemSimulator::stop() {
+    _running = false;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_master >= 0) {
+        ::close(_master);
+        _master = -1;
+    }
+}
+
+void ModemSimulator::store(const string& storage, int index,
+                           const string& pdu) {
+    lock_guard<mutex> lock(_mutex);
+    _storages[storage][index] = Stored{pdu, false};
+}
+
+void ModemSimulator::notify(const string& storage, int index) {
+    lock_guard<mutex> lock(_mutex);
+    write("\r\n+CMTI: \"" + storage + "\"," + to_string(index) + "\r\n");
+}
+
+void ModemSimulator::failSubmissions(size_t count, const string& result) {
+    lock_guard<mutex> lock(_mutex);
+    _failures = count;
+    _failure = result;
+}
+
+vector<string> ModemSimulator::commands() const {
+    lock_guard<mutex> lock(_mutex);
+    return _commands;
+}
+
+vector<string> ModemSimulator::submitted() const {
+    lock_guard<mutex> lock(_mutex);
+    return _submitted;
+}
+
+size_t ModemSimulator::stored(const string& storage) const {
+    lock_guard<mutex> lock(_mutex);
+    auto messages = _storages.find(storage);
+    return messages == _storages.end() ? 0 : messages->second.size();
+}
+
+void ModemSimulator::run() {
+    char data[1024];
+    while (_running) {
+        pollfd descriptor{_master, POLLIN, 0};
+        if (::poll(&descriptor, 1, 20) <= 0) {
+            continue;
+        }
+        auto size = ::read(_master, data, sizeof(data));
+        if (size <= 0) {
+            // EIO while the serial port has not opened the terminal yet
+            this_thread::sleep_for(chrono::milliseconds(5));
+            continue;
+        }
+        _buffer.append(data, static_cast<size_t>(size));
+        while (true) {
+            auto end = _buffer.find(_awaitingPdu ? '\x1a' : '\r');
+            if (end == string::npos) {
+                break;
+            }
+            auto line = _buffer.substr(0, end);
+            _buffer.erase(0, end + 1);
+            if (_awaitingPdu) {
+                _awaitingPdu = false;
+                submit(line);
+                continue;
+            }
+            line.erase(0, line.find_first_not_of("\r\n "));
+            if (!line.empty()) {
+                handle(line);
+            }
+        }
+    }
+}
+
+void ModemSimulator::handle(const string& line) {
+    lock_guard<mutex> lock(_mutex);
+    _commands.push_back(line);
+    auto& storage = _storages[_storage];
+    if (startsWith(line, "AT+CMGS=")) {
+        _awaitingPdu = true;
+        write("\r\n> ");
+    } else if (startsWith(line, "AT+CPMS=\"")) {
+        _storage = line.substr(9, line.find('"', 9) - 9);
+        auto used = to_string(_storages[_storage].size());
+        write("\r\n+CPMS: " + used + ",50," + used + ",50," + used +
+              ",50\r\n\r\nOK\r\n");
+    } else if (line == "AT+CMGL=4") {
+        string response;
+        for (auto& [index, message] : storage) {
+            response += "\r\n+CMGL: " + to_string(index) + "," +
+                        (message.read ? "1" : "0") + ",," +
+                        to_string(message.pdu.size() / 2 - 1) + "\r\n" +
+                        message.pdu;
+            message.read = true;
+        }
+        write(response + "\r\n\r\nOK\r\n");
+    } else if (startsWith(line, "AT+CMGR=")) {
+        auto message = storage.find(atoi(line.c_str() + 8));
+        if (message == storage.end()) {
+            write("\r\n+CMS ERROR: 321\r\n");
+            return;
+        }
+        message->second.read = true;
+        write("\r\n+CMGR: 1,," +
+              to_string(message->second.pdu.size() / 2 - 1) + "\r\n" +
+              message->second.pdu + "\r\n\r\nOK\r\n");
+    } else if (line == "AT+CMGD=1,1") {
+        for (auto message = storage.begin(); message != storage.end();) {
+            message = message->second.read ? storage.erase(message)
+                                           : next(message);
+        }
+        write("\r\nOK\r\n");
+    } else if (startsWith(line, "AT+CMGD=")) {
+        storage.erase(atoi(line.c_str() + 8));
+        write("\r\nOK\r\n");
+    } else {
+        write("\r\nOK\r\n");
+    }
+}
+
+void ModemSimulator::submit(const string& pdu) {
+    this_thread::sleep_for(_submitDelay.load());
+    lock_guard<mutex> lock(_mutex);
+    _submitted.push_back(pdu);
+    if (_failures > 0) {
+        _failures--;
+        write("\r\n" + _failure + "\r\n");
+        return;
+    }
+    _reference = (_reference + 1) % 256;
+    write("\r\n+CMGS: " + to_string(_reference) + "\r\n\r\nOK\r\n");
+}
+
+void ModemSimulator::write(const string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        auto size = ::write(_master, data.data() + written,
+                            data.size() - written);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        written += static_cast<size_t>(size);
+    }
+}
+
+} // namespace GsmGateway
@@ -0,0 +1,114 @@
+#ifndef MODEMSIMULATOR_H
+#define MODEMSIMULATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace GsmGateway {
+
+/**
+ * @brief A GSM modem simulated on a pseudo terminal, so that tests run the
+ * serial port, the AT channels and the SMS handling of the gateway against
+ * something that answers like a modem.
+ *
+ * The simulator answers on a thread of its own. It records every command,
+ * prompts for the PDUs of AT+CMGS and acknowledges them, and keeps message
+ * storages for AT+CPMS, AT+CMGL, AT+CMGR and AT+CMGD, with the read state
+ * that AT+CMGD=1,1 goes by. Other commands are answered with OK.
+ */
+class ModemSimulator {
+  public:
+    ModemSimulator();
+    ~ModemSimulator();
+
+    ModemSimulator(const ModemSimulator&) = delete;
+    ModemSimulator& operator=(const ModemSimulator&) = delete;
+
+    /**
+     * @brief Opens the pseudo terminal and starts answering.
+     *
+     * @return false if no pseudo terminal could be opened.
+     */
+    bool start();
+
+    void stop();
+
+    /**
+     * @brief Returns the device for SerialPort::open().
+     */
+    const string& device() const { return _device; }
+
+    /**
+     * @brief Stores an unread SMS-DELIVER PDU, given as hex.
+     */
+    void store(const string& storage, int index, const string& pdu);
+
+    /**
+     * @brief Reports a stored SMS with +CMTI.
+     */
+    void notify(const string& storage, int index);
+
+    /**
+     * @brief Answers the next submissions with the given result code, such
+     * as "+CMS ERROR: 38", instead of +CMGS.
+     */
+    void failSubmissions(size_t count, const string& result);
+
+    /**
+     * @brief Sets how long a submission takes once its PDU is written.
+     */
+    void setSubmitDelay(chrono::milliseconds delay) { _submitDelay = delay; }
+
+    /**
+     * @brief Returns the commands received, without their PDUs.
+     */
+    vector<string> commands() const;
+
+    /**
+     * @brief Returns the PDUs received after AT+CMGS prompts, as hex.
+     */
+    vector<string> submitted() const;
+
+    /**
+     * @brief Returns the number of SMS in a storage.
+     */
+    size_t stored(const string& storage) const;
+
+  private:
+    struct Stored {
+        string pdu;
+        bool read = false;
+    };
+
+    void run();
+    void handle(const string& line);
+    void submit(const string& pdu);
+    void write(const string& data);
+
+    int _master = -1;
+    string _device;
+    thread _thread;
+    atomic<bool> _running{false};
+    atomic<chrono::milliseconds> _submitDelay{chrono::milliseconds(0)};
+    mutable mutex _mutex;
+    string _buffer;
+    bool _awaitingPdu = false;
+    vector<string> _commands;
+    vector<string> _submitted;
+    map<string, map<int, Stored>> _storages;
+    string _storage = "SM";
+    size_t _failures = 0;
+    string _failure;
+    int _reference = 0;
+};
+
+} // namespace GsmGateway
+
+#endif // MODEMSIMULATOR_H
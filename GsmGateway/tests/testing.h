@@ -0,0 +1,138 @@
+#ifndef TESTING_H
+#define TESTING_H
+
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <boost/asio/io_context.hpp>
+
+using namespace std;
+
+/*
+ * A minimal test harness for the gateway, which is built without Qt. VERIFY
+ * and COMPARE work like their QtTest counterparts: they report a failure and
+ * return from the test function. run() runs the test functions and returns
+ * the exit code for ctest.
+ */
+namespace GsmGateway::Testing {
+
+using Test = pair<const char*, function<void()>>;
+
+inline bool& failed() {
+    static bool failed = false;
+    return failed;
+}
+
+template <typename T, typename = void>
+struct IsRange : false_type {};
+
+template <typename T>
+struct IsRange<T, void_t<decltype(declval<const T&>().begin()),
+                         decltype(declval<const T&>().end())>>
+    : true_type {};
+
+template <typename T>
+string describe(const T& value) {
+    if constexpr (is_same_v<T, uint8_t> || is_same_v<T, int8_t> ||
+                  is_same_v<T, char32_t>) {
+        return to_string(int64_t(value));
+    } else if constexpr (is_enum_v<T>) {
+        return to_string(static_cast<underlying_type_t<T>>(value));
+    } else if constexpr (IsRange<T>::value && !is_same_v<T, string>) {
+        string items;
+        for (const auto& item : value) {
+            items += (items.empty() ? "" : ", ") + describe(item);
+        }
+        return "{" + items + "}";
+    } else {
+        ostringstream stream;
+        stream << value;
+        return stream.str();
+    }
+}
+
+inline bool verify(bool ok, const char* expression, const char* file,
+                   int line) {
+    if (!ok) {
+        failed() = true;
+        cerr << "FAIL: " << expression << " (" << file << ":" << line << ")"
+             << endl;
+    }
+    return ok;
+}
+
+template <typename Actual, typename Expected>
+bool compare(const Actual& actual, const Expected& expected,
+             const char* actualExpression, const char* expectedExpression,
+             const char* file, int line) {
+    if (actual == expected) {
+        return true;
+    }
+    failed() = true;
+    cerr << "FAIL: " << actualExpression << " == " << expectedExpression
+         << " (" << file << ":" << line << ")\n   Actual: "
+         << describe(actual) << "\n   Expected: " << describe(expected)
+         << endl;
+    return false;
+}
+
+/**
+ * @brief Runs the context until the condition holds or the timeout passes.
+ *
+ * @return whether the condition holds.
+ */
+inline bool runUntil(boost::asio::io_context& context,
+                     const function<bool()>& condition,
+                     chrono::milliseconds timeout = chrono::seconds(5)) {
+    auto deadline = chrono::steady_clock::now() + timeout;
+    while (!condition()) {
+        if (chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        context.restart();
+        context.run_for(chrono::milliseconds(5));
+    }
+    return true;
+}
+
+inline int run(const char* name, initializer_list<Test> tests) {
+    size_t failures = 0;
+    for (const auto& test : tests) {
+        failed() = false;
+        test.second();
+        cout << (failed() ? "FAIL   : " : "PASS   : ") << name
+             << "::" << test.first << "()" << endl;
+        failures += failed();
+    }
+    cout << "Totals: " << tests.size() - failures << " passed, " << failures
+         << " failed" << endl;
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace GsmGateway::Testing
+
+#define VERIFY(condition)                                                      \
+    do {                                                                       \
+        if (!GsmGateway::Testing::verify(static_cast<bool>(condition),         \
+                                         #condition, __FILE__, __LINE__)) {    \
+            return;                                                            \
+        }                                                                      \
+    } while (false)
+
+#define COMPARE(actual, expected)                                              \
+    do {                                                                       \
+        if (!GsmGateway::Testing::compare(actual, expected, #actual,           \
+                                          #expected, __FILE__, __LINE__)) {    \
+            return;                                                            \
+        }                                                                      \
+    } while (false)
+
+#define TEST(function) GsmGateway::Testing::Test(#function, function)
+
+#endif // TESTING_H
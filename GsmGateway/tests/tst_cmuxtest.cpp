@@ -0,0 +1,197 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+#include "cmux.h"
+#include "testing.h"
+
+using namespace GsmGateway;
+
+namespace {
+
+string toHex(const string& data) {
+    string hex;
+    char digits[3];
+    for (auto byte : data) {
+        snprintf(digits, sizeof(digits), "%02X", uint8_t(byte));
+        hex += digits;
+    }
+    return hex;
+}
+
+string fromHex(const string& hex) {
+    string data;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        data += static_cast<char>(stoi(hex.substr(i, 2), nullptr, 16));
+    }
+    return data;
+}
+
+// A multiplexer whose frames are collected as hex, and whose channels'
+// data is collected per DLCI
+struct Mux {
+    explicit Mux(size_t maxFrameSize = 31)
+        : cmux(
+              context,
+              [this](string frame) { written.push_back(toHex(frame)); },
+              maxFrameSize) {
+        cmux.setReceiveHandler(
+            [this](uint8_t dlci, const uint8_t* data, size_t size) {
+                received.emplace_back(
+                    dlci, string(reinterpret_cast<const char*>(data), size));
+            });
+    }
+
+    void feed(const string& hex) {
+        auto data = fromHex(hex);
+        cmux.receive(reinterpret_cast<const uint8_t*>(data.data()),
+                     data.size());
+    }
+
+    // Opens DLCI 1 as the modem would accept it
+    void open() {
+        cmux.open({1}, [this](bool ok) { opened = ok ? 1 : 0; });
+        feed("F9037301D7F9");
+        feed("F907730115F9");
+    }
+
+    boost::asio::io_context context;
+    Cmux cmux;
+    vector<string> written;
+    vector<pair<uint8_t, string>> received;
+    int opened = -1;
+};
+
+void opens_with_sabm_and_modem_status() {
+    Mux mux;
+    mux.cmux.open({1}, [&mux](bool ok) { mux.opened = ok ? 1 : 0; });
+    // SABM on the control channel first
+    COMPARE(mux.written, vector<string>{"F9033F011CF9"});
+    mux.feed("F9037301D7F9");
+    COMPARE(mux.written.size(), size_t(2));
+    COMPARE(mux.written[1], string("F9073F01DEF9"));
+    VERIFY(mux.cmux.isOpen(0));
+    COMPARE(mux.opened, -1);
+    mux.feed("F907730115F9");
+    COMPARE(mux.opened, 1);
+    VERIFY(mux.cmux.isOpen(1));
+    // Ready to communicate on DLCI 1
+    COMPARE(mux.written.size(), size_t(3));
+    COMPARE(mux.written[2], string("F903EF09E305078DFBF9"));
+}
+
+void dm_refuses_channel() {
+    Mux mux;
+    mux.cmux.open({1, 2}, [&mux](bool ok) { mux.opened = ok ? 1 : 0; });
+    mux.feed("F9037301D7F9");
+    mux.feed("F9071F01F4F9");
+    COMPARE(mux.opened, 0);
+    VERIFY(mux.cmux.isOpen(0));
+    VERIFY(!mux.cmux.isOpen(1));
+    // No SABM for the channels after the refused one
+    COMPARE(mux.written.size(), size_t(2));
+}
+
+void receives_data() {
+    Mux mux;
+    mux.open();
+    mux.feed("F905EF0D0D0A4F4B0D0A5FF9");
+    COMPARE(mux.received.size(), size_t(1));
+    COMPARE(mux.received[0].first, uint8_t(1));
+    COMPARE(mux.received[0].second, string("\r\nOK\r\n"));
+    COMPARE(mux.cmux.stats().framesReceived, uint64_t(3));
+}
+
+void split_input() {
+    Mux mux;
+    mux.open();
+    // Byte by byte, as a slow serial line may deliver it
+    auto data = fromHex("F905EF0D0D0A4F4B0D0A5FF9F905EF0D0D0A4F4B0D0A5FF9");
+    for (auto byte : data) {
+        mux.cmux.receive(reinterpret_cast<const uint8_t*>(&byte), 1);
+    }
+    COMPARE(mux.received.size(), size_t(2));
+    COMPARE(mux.received[1].second, string("\r\nOK\r\n"));
+}
+
+void garbled_input() {
+    Mux mux;
+    mux.open();
+    // Noise before a flag, a frame with a bad checksum, then frames that
+    // share their flags
+    mux.feed("0102F905EF0D0D0A4F4B0D0A5EF9");
+    COMPARE(mux.cmux.stats().framesDropped, uint64_t(1));
+    VERIFY(mux.received.empty());
+    mux.feed("F905EF0D0D0A4F4B0D0A5FF905EF0D0D0A4F4B0D0A5FF9");
+    COMPARE(mux.received.size(), size_t(2));
+    // A frame without its closing flag is dropped, and the next one found
+    mux.feed("F905EF0D0D0A4F4B0D0A5F00F905EF0D0D0A4F4B0D0A5FF9");
+    COMPARE(mux.cmux.stats().framesDropped, uint64_t(2));
+    COMPARE(mux.received.size(), size_t(3));
+}
+
+void two_byte_length() {
+    Mux mux(256);
+    mux.open();
+    string information;
+    for (int i = 0; i < 200; ++i) {
+        information += static_cast<char>(i);
+    }
+    // 200 does not fit the 7 bits of a one byte length; the checksum of
+    // this header happens to be the flag value
+    mux.feed("F905EF9001" + toHex(information) + "F9F9");
+    COMPARE(mux.received.size(), size_t(1));
+    COMPARE(mux.received[0].second, information);
+
+    mux.written.clear();
+    mux.cmux.write(1, information);
+    COMPARE(mux.written.size(), size_t(1));
+    COMPARE(mux.written[0].substr(0, 10), string("F907EF9001"));
+    COMPARE(mux.written[0].size(), size_t(2 * (200 + 7)));
+}
+
+void write_splits_frames() {
+    Mux mux(2);
+    mux.open();
+    mux.written.clear();
+    mux.cmux.write(1, "AT\r");
+    COMPARE(mux.written,
+            (vector<string>{"F907EF05415430F9", "F907EF030DD4F9"}));
+
+    Mux whole;
+    whole.open();
+    whole.written.clear();
+    whole.cmux.write(1, "AT\r");
+    COMPARE(whole.written, vector<string>{"F907EF0741540DD3F9"});
+    // Nothing is sent on channels that are not open
+    whole.cmux.write(2, "AT\r");
+    COMPARE(whole.written.size(), size_t(1));
+}
+
+void modem_opens_and_closes_channels() {
+    Mux mux;
+    mux.open();
+    mux.written.clear();
+    // The modem's SABM is answered with UA
+    mux.feed("F90B3F0159F9");
+    VERIFY(mux.cmux.isOpen(2));
+    COMPARE(mux.written, vector<string>{"F9097301F3F9"});
+    // And so is its DISC
+    mux.feed("F90753013FF9");
+    VERIFY(!mux.cmux.isOpen(1));
+    COMPARE(mux.written.size(), size_t(2));
+    COMPARE(mux.written[1], string("F905730174F9"));
+}
+
+} // namespace
+
+int main() {
+    return Testing::run("CmuxTest",
+                        {TEST(opens_with_sabm_and_modem_status),
+                         TEST(dm_refuses_channel), TEST(receives_data),
+                         TEST(split_input), TEST(garbled_input),
+                         TEST(two_byte_length), TEST(write_splits_frames),
+                         TEST(modem_opens_and_closes_channels)});
+}
@@ -0,0 +1,122 @@
+#include <chrono>
+#include <cmath>
+#include <string>
+
+#include "floodguard.h"
+#include "testing.h"
+
+using namespace GsmGateway;
+
+namespace {
+
+const string sender = "+46700000001";
+const string other = "+46700000002";
+
+// The limits get half a message of slack, so that rounding in the decayed
+// counts cannot decide whether the last message of a burst is admitted
+constexpr double limit = 10.5;
+constexpr double responderLimit = 60.5;
+
+bool near(double actual, double expected) {
+    return fabs(actual - expected) < 0.01;
+}
+
+size_t admitted(FloodGuard& guard, const string& number, size_t count,
+                FloodGuard::Clock::time_point now) {
+    size_t admitted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        admitted += guard.admit(number, now);
+    }
+    return admitted;
+}
+
+void burst_then_throttled() {
+    FloodGuard guard(limit);
+    auto now = FloodGuard::Clock::now();
+    COMPARE(admitted(guard, sender, 10, now), size_t(10));
+    VERIFY(!guard.admit(sender, now));
+    VERIFY(!guard.admit(sender, now));
+    // Other senders are not held back
+    VERIFY(guard.admit(other, now));
+    COMPARE(guard.stats().admitted, uint64_t(11));
+    COMPARE(guard.stats().throttled, uint64_t(2));
+    COMPARE(guard.stats().offenders, uint64_t(1));
+    // Throttled messages count too, so a flood keeps its sender throttled
+    VERIFY(near(guard.estimate(sender, now), 12));
+}
+
+void decays_over_half_life() {
+    FloodGuard guard(limit);
+    auto start = FloodGuard::Clock::now();
+    COMPARE(admitted(guard, sender, 10, start), size_t(10));
+    VERIFY(near(guard.estimate(sender, start + chrono::seconds(60)), 5));
+    VERIFY(near(guard.estimate(sender, start + chrono::seconds(120)), 2.5));
+    // Room for five more after one half-life
+    auto later = start + chrono::seconds(60);
+    COMPARE(admitted(guard, sender, 6, later), size_t(5));
+    COMPARE(guard.stats().offenders, uint64_t(1));
+    // Senders never seen count nothing
+    VERIFY(near(guard.estimate(other, later), 0));
+}
+
+void responders_get_more() {
+    FloodGuard guard(limit, chrono::seconds(60), responderLimit);
+    guard.addResponder(sender);
+    VERIFY(guard.isResponder(sender));
+    VERIFY(!guard.isResponder(other));
+    auto now = FloodGuard::Clock::now();
+    COMPARE(admitted(guard, sender, 61, now), size_t(60));
+    COMPARE(admitted(guard, other, 11, now), size_t(10));
+
+    // The oldest responders are forgotten first
+    for (size_t i = 0; i < FloodGuard::maxResponders; ++i) {
+        guard.addResponder("+4671" + to_string(i));
+    }
+    VERIFY(!guard.isResponder(sender));
+    VERIFY(guard.isResponder("+46710"));
+}
+
+void estimates_never_too_low() {
+    // A small sketch, so that senders share counters
+    FloodGuard guard(1000, chrono::seconds(60), 1000, 256, 4);
+    auto now = FloodGuard::Clock::now();
+    for (int i = 0; i < 500; ++i) {
+        admitted(guard, "+4672" + to_string(i), size_t(i % 5 + 1), now);
+    }
+    size_t exact = 0;
+    for (int i = 0; i < 500; ++i) {
+        auto estimate = guard.estimate("+4672" + to_string(i), now);
+        VERIFY(estimate > i % 5 + 1 - 0.01);
+        exact += near(estimate, i % 5 + 1);
+    }
+    // Conservative updates keep most of them exact even so
+    VERIFY(exact > 250);
+}
+
+void rebases_over_long_times() {
+    FloodGuard guard(limit);
+    auto start = FloodGuard::Clock::now();
+    COMPARE(admitted(guard, sender, 11, start), size_t(10));
+    // Far past the point where the weights would overflow without a rebase
+    for (auto later : {chrono::hours(2), chrono::hours(24 * 30),
+                       chrono::hours(24 * 365)}) {
+        auto now = start + later;
+        VERIFY(near(guard.estimate(sender, now), 0));
+        COMPARE(admitted(guard, sender, 11, now), size_t(10));
+        auto estimate = guard.estimate(sender, now);
+        VERIFY(isfinite(estimate));
+        VERIFY(near(estimate, 11));
+    }
+    COMPARE(guard.stats().offenders, uint64_t(4));
+}
+
+} // namespace
+
+int main() {
+    return Testing::run("FloodGuardTest",
+                        {TEST(burst_then_throttled),
+                         TEST(decays_over_half_life),
+                         TEST(responders_get_more),
+                         TEST(estimates_never_too_low),
+                         TEST(rebases_over_long_times)});
+}
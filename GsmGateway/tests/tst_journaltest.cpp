@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "journal.h"
+#include "testing.h"
+
+using namespace GsmGateway;
+
+namespace {
+
+const filesystem::path directory =
+    filesystem::temp_directory_path() / "journaltest";
+
+// A fresh, empty directory for each test
+void clear() { filesystem::remove_all(directory); }
+
+vector<filesystem::path> segmentFiles() {
+    vector<filesystem::path> files;
+    for (const auto& entry : filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".journal") {
+            files.push_back(entry.path());
+        }
+    }
+    sort(files.begin(), files.end());
+    return files;
+}
+
+void appendEvents(Journal& journal, uint64_t count) {
+    for (uint64_t i = 0; i < count; ++i) {
+        journal.append(int64_t(journal.lastSequence() + 1) * 1000,
+                       "+4670000000" + to_string(journal.lastSequence() % 10),
+                       "Reply " + to_string(journal.lastSequence() + 1));
+    }
+}
+
+void append_and_read() {
+    clear();
+    Journal journal;
+    VERIFY(journal.open(directory.string()));
+    COMPARE(journal.append(1000, "+46700000001", "Ja"), uint64_t(1));
+    COMPARE(journal.append(2000, "+46700000002", "Nej"), uint64_t(2));
+    vector<GatewayEvent> events;
+    journal.read(1, 10, events);
+    COMPARE(events.size(), size_t(2));
+    COMPARE(events[1].sequence, uint64_t(2));
+    COMPARE(events[1].timestamp, int64_t(2000));
+    COMPARE(events[1].sender, string("+46700000002"));
+    COMPARE(events[1].text, string("Nej"));
+    VERIFY(journal.contains(1000, "+46700000001", "Ja"));
+    VERIFY(!journal.contains(1000, "+46700000001", "Nej"));
+    clear();
+}
+
+void torn_tail_is_cut_off() {
+    clear();
+    uint64_t size = 0;
+    {
+        Journal journal;
+        VERIFY(journal.open(directory.string()));
+        appendEvents(journal, 3);
+        size = journal.diskUsage();
+    }
+    // A record cut short by a crash: its length, but only part of the rest
+    {
+        ofstream file(segmentFiles().back(), ios::binary | ios::app);
+        file.write("\x20\x00\x00\x00\x01\x02\x03", 7);
+    }
+    Journal journal;
+    VERIFY(journal.open(directory.string()));
+    COMPARE(journal.lastSequence(), uint64_t(3));
+    COMPARE(journal.diskUsage(), size);
+    COMPARE(uint64_t(filesystem::file_size(segmentFiles().back())), size);
+    COMPARE(journal.append(4000, "+46700000001", "After"), uint64_t(4));
+    vector<GatewayEvent> events;
+    journal.read(1, 10, events);
+    COMPARE(events.size(), size_t(4));
+    COMPARE(events[3].text, string("After"));
+    // The events recovered on open() are recognized again
+    VERIFY(journal.contains(3000, "+46700000002", "Reply 3"));
+    clear();
+}
+
+void corrupt_tail_is_cut_off() {
+    clear();
+    {
+        Journal journal;
+        VERIFY(journal.open(directory.string()));
+        appendEvents(journal, 3);
+    }
+    // Flip a byte in the checksum of the last record
+    auto path = segmentFiles().back();
+    auto size = filesystem::file_size(path);
+    {
+        fstream file(path, ios::binary | ios::in | ios::out);
+        file.seekp(static_cast<streamoff>(size - 1));
+        file.put('\x55');
+    }
+    Journal journal;
+    VERIFY(journal.open(directory.string()));
+    COMPARE(journal.lastSequence(), uint64_t(2));
+    VERIFY(filesystem::file_size(path) < size);
+    clear();
+}
+
+void rolls_over_and_deletes_acknowledged() {
+    clear();
+    Journal journal(200, 0);
+    VERIFY(journal.open(directory.string()));
+    appendEvents(journal, 40);
+    auto files = segmentFiles();
+    VERIFY(files.size() > 3);
+    // Named after their first sequence number
+    COMPARE(files[0].filename().string(),
+            string("00000000000000000001.journal"));
+
+    journal.acknowledge(20);
+    COMPARE(journal.acknowledged(), uint64_t(20));
+    auto remaining = segmentFiles();
+    VERIFY(remaining.size() < files.size());
+    // What is left starts at or before the first unacknowledged event
+    auto first = stoull(remaining[0].stem().string());
+    VERIFY(first <= 21);
+    VERIFY(stoull(remaining[1].stem().string()) > 21);
+    vector<GatewayEvent> events;
+    journal.read(1, 100, events);
+    COMPARE(events.size(), size_t(20));
+    COMPARE(events[0].sequence, uint64_t(21));
+
+    // The last segment is kept even when everything is acknowledged
+    journal.acknowledge(40);
+    COMPARE(segmentFiles().size(), size_t(1));
+    clear();
+}
+
+void reads_across_segments_in_batches() {
+    clear();
+    {
+        Journal journal(512, 0);
+        VERIFY(journal.open(directory.string()));
+        appendEvents(journal, 300);
+    }
+    // Reopened, so only the last segment has been indexed
+    Journal journal(512, 0);
+    VERIFY(journal.open(directory.string()));
+    VERIFY(segmentFiles().size() > 10);
+    vector<GatewayEvent> events;
+    for (uint64_t from = 1; from <= 300;) {
+        vector<GatewayEvent> batch;
+        journal.read(from, 7, batch);
+        VERIFY(!batch.empty());
+        VERIFY(batch.size() <= 7);
+        from = batch.back().sequence + 1;
+        events.insert(events.end(), batch.begin(), batch.end());
+    }
+    COMPARE(events.size(), size_t(300));
+    for (size_t i = 0; i < events.size(); ++i) {
+        COMPARE(events[i].sequence, uint64_t(i + 1));
+        COMPARE(events[i].text, "Reply " + to_string(i + 1));
+    }
+    // Reads that start in the middle of a segment, now indexed
+    for (uint64_t from : {299, 150, 65, 64, 1}) {
+        vector<GatewayEvent> batch;
+        journal.read(from, 3, batch);
+        COMPARE(batch.size(), size_t(from == 299 ? 2 : 3));
+        COMPARE(batch[0].sequence, from);
+    }
+    clear();
+}
+
+void acknowledged_persists() {
+    clear();
+    {
+        Journal journal;
+        VERIFY(journal.open(directory.string()));
+        appendEvents(journal, 10);
+        journal.acknowledge(6);
+        // Never past the last event
+        journal.acknowledge(99);
+        COMPARE(journal.acknowledged(), uint64_t(10));
+        journal.acknowledge(4);
+        COMPARE(journal.acknowledged(), uint64_t(10));
+    }
+    {
+        Journal journal;
+        VERIFY(journal.open(directory.string()));
+        COMPARE(journal.acknowledged(), uint64_t(10));
+        COMPARE(journal.lastSequence(), uint64_t(10));
+        vector<GatewayEvent> events;
+        journal.read(1, 10, events);
+        VERIFY(events.empty());
+    }
+    // Without segments, numbering goes on after the acknowledged events
+    for (const auto& file : segmentFiles()) {
+        filesystem::remove(file);
+    }
+    Journal journal;
+    VERIFY(journal.open(directory.string()));
+    COMPARE(journal.append(0, "+46700000001", "Next"), uint64_t(11));
+    clear();
+}
+
+} // namespace
+
+int main() {
+    return Testing::run("JournalTest",
+                        {TEST(append_and_read), TEST(torn_tail_is_cut_off),
+                         TEST(corrupt_tail_is_cut_off),
+                         TEST(rolls_over_and_deletes_acknowledged),
+                         TEST(reads_across_segments_in_batches),
+                         TEST(acknowledged_persists)});
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+#include "journal.h"
+#include "modem.h"
+#include "modemsimulator.h"
+#include "smspdu.h"
+#include "testing.h"
+
+using namespace GsmGateway;
+
+namespace {
+
+const filesystem::path directory =
+    filesystem::temp_directory_path() / "modemtest";
+
+// An SMS-DELIVER of "ja" from +4670000000<digit>, sent on 2026-01-15 at
+// 11:02:<second>
+string deliver(char digit, int second) {
+    return "00040B916407000000F" + string(1, digit) + "00006210511020" +
+           char('0' + second % 10) + char('0' + second / 10) + "0002EA30";
+}
+
+int64_t timestampOf(const string& hex) {
+    Sms::DeliverPdu pdu;
+    Sms::decodeDeliver(hex, pdu);
+    return pdu.timestamp;
+}
+
+// A Modem on the simulated modem, which journals what it receives unless
+// the sender is refused
+struct Gateway {
+    Gateway() : modem(context) {
+        modem.setDuplicateFilter([this](int64_t timestamp,
+                                        const string& sender,
+                                        const string& text) {
+            return journal.contains(timestamp, sender, text);
+        });
+        modem.setReceiveHandler([this](int64_t timestamp, const string& sender,
+                                       const string&, Modem::Received done) {
+            received.push_back(sender);
+            timestamps.push_back(timestamp);
+            if (sender == refused) {
+                done(false);
+            } else {
+                done(journal.append(timestamp, sender, "ja") > 0);
+            }
+        });
+    }
+
+    ~Gateway() {
+        modem.close();
+        filesystem::remove_all(directory);
+    }
+
+    bool open() {
+        filesystem::remove_all(directory);
+        return journal.open(directory.string()) && simulator.start() &&
+               modem.open(simulator.device());
+    }
+
+    bool waitFor(const string& command) {
+        return Testing::runUntil(context, [&] {
+            auto commands = simulator.commands();
+            return find(commands.begin(), commands.end(), command) !=
+                   commands.end();
+        });
+    }
+
+    size_t count(const string& command) const {
+        auto commands = simulator.commands();
+        return size_t(::count(commands.begin(), commands.end(), command));
+    }
+
+    ModemSimulator simulator;
+    boost::asio::io_context context;
+    Journal journal;
+    Modem modem;
+    string refused;
+    vector<string> received;
+    vector<int64_t> timestamps;
+};
+
+void drains_in_timestamp_order() {
+    Gateway gateway;
+    gateway.simulator.store("SM", 1, deliver('1', 30));
+    gateway.simulator.store("SM", 2, deliver('2', 10));
+    gateway.simulator.store("ME", 1, deliver('3', 20));
+    // A copy in the other storage is passed on once
+    gateway.simulator.store("ME", 4, deliver('2', 10));
+    VERIFY(gateway.open());
+    VERIFY(gateway.waitFor("AT+CMGL=4"));
+    VERIFY(Testing::runUntil(gateway.context, [&] {
+        auto& simulator = gateway.simulator;
+        return simulator.stored("SM") + simulator.stored("ME") == 0;
+    }));
+    COMPARE(gateway.received, (vector<string>{"+46700000002", "+46700000003",
+                                              "+46700000001"}));
+    COMPARE(gateway.timestamps[0], timestampOf(deliver('2', 10)));
+    // Everything journaled, so each storage is cleared at once
+    COMPARE(gateway.count("AT+CMGD=1,1"), size_t(2));
+    COMPARE(gateway.count("AT+CMGD=1"), size_t(0));
+    COMPARE(gateway.journal.lastSequence(), uint64_t(3));
+}
+
+void journaled_are_not_passed_on() {
+    Gateway gateway;
+    gateway.simulator.store("SM", 1, deliver('1', 30));
+    gateway.simulator.store("SM", 2, deliver('2', 10));
+    gateway.modem.setBacklogStorages({"SM"});
+    VERIFY(gateway.open());
+    // As if the gateway had crashed before deleting it
+    gateway.journal.append(timestampOf(deliver('1', 30)), "+46700000001",
+                           "ja");
+    VERIFY(Testing::runUntil(gateway.context, [&] {
+        return gateway.simulator.stored("SM") == 0;
+    }));
+    COMPARE(gateway.received, vector<string>{"+46700000002"});
+    COMPARE(gateway.journal.lastSequence(), uint64_t(2));
+    COMPARE(gateway.count("AT+CMGD=1,1"), size_t(1));
+}
+
+void unjournaled_stay_on_modem() {
+    Gateway gateway;
+    gateway.refused = "+46700000002";
+    gateway.simulator.store("SM", 1, deliver('1', 30));
+    gateway.simulator.store("SM", 2, deliver('2', 10));
+    gateway.simulator.store("SM", 3, deliver('3', 20));
+    gateway.modem.setBacklogStorages({"SM"});
+    VERIFY(gateway.open());
+    VERIFY(Testing::runUntil(gateway.context, [&] {
+        return gateway.simulator.stored("SM") == 1;
+    }));
+    COMPARE(gateway.received.size(), size_t(3));
+    // Deleted one by one, as AT+CMGD=1,1 would take the refused one too
+    VERIFY(gateway.waitFor("AT+CMGD=3"));
+    COMPARE(gateway.count("AT+CMGD=1"), size_t(1));
+    COMPARE(gateway.count("AT+CMGD=2"), size_t(0));
+    COMPARE(gateway.count("AT+CMGD=1,1"), size_t(0));
+}
+
+void large_backlog_in_timestamp_order() {
+    Gateway gateway;
+    // Enough to be decoded on several threads, listed newest first, from
+    // senders that stay under the flood limit
+    for (int index = 0; index < 40; ++index) {
+        gateway.simulator.store("SM", index,
+                                deliver(char('0' + index % 10), 59 - index));
+    }
+    gateway.modem.setBacklogStorages({"SM"});
+    VERIFY(gateway.open());
+    VERIFY(Testing::runUntil(gateway.context, [&] {
+        return gateway.simulator.stored("SM") == 0;
+    }));
+    COMPARE(gateway.timestamps.size(), size_t(40));
+    VERIFY(is_sorted(gateway.timestamps.begin(), gateway.timestamps.end()));
+    COMPARE(gateway.timestamps[0], timestampOf(deliver('9', 20)));
+    COMPARE(gateway.journal.lastSequence(), uint64_t(40));
+}
+
+} // namespace
+
+int main() {
+    return Testing::run("ModemTest", {TEST(drains_in_timestamp_order),
+                                      TEST(journaled_are_not_passed_on),
+                                      TEST(unjournaled_stay_on_modem),
+                                      TEST(large_backlog_in_timestamp_order)});
+}
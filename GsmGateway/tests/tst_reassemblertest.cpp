@@ -0,0 +1,124 @@
+#include <string>
+#include <vector>
+
+#include "reassembler.h"
+#include "testing.h"
+
+using namespace GsmGateway;
+
+namespace {
+
+// A reassembler whose messages are collected along with their completions
+struct Parts {
+    Parts()
+        : reassembler([this](const Sms::DeliverPdu& message,
+                             Reassembler::Done done) {
+              messages.push_back(message);
+              dones.push_back(move(done));
+          }) {}
+
+    void add(uint8_t part, const string& text, int64_t timestamp = 1000,
+             Reassembler::Clock::time_point now = {}) {
+        Sms::DeliverPdu pdu;
+        pdu.sender = "+46700000001";
+        pdu.timestamp = timestamp;
+        pdu.text = text;
+        pdu.reference = 9;
+        pdu.parts = 3;
+        pdu.part = part;
+        reassembler.add(
+            pdu, [this, part](bool journaled) {
+                completed.emplace_back(part, journaled);
+            },
+            now);
+    }
+
+    Reassembler reassembler;
+    vector<Sms::DeliverPdu> messages;
+    vector<Reassembler::Done> dones;
+    vector<pair<uint8_t, bool>> completed;
+};
+
+void single_passes_at_once() {
+    Parts parts;
+    Sms::DeliverPdu pdu;
+    pdu.text = "ja";
+    auto journaled = false;
+    parts.reassembler.add(pdu, [&journaled](bool ok) { journaled = ok; });
+    COMPARE(parts.messages.size(), size_t(1));
+    COMPARE(parts.messages[0].text, string("ja"));
+    COMPARE(parts.reassembler.pending(), size_t(0));
+    parts.dones[0](true);
+    VERIFY(journaled);
+}
+
+void joins_out_of_order() {
+    Parts parts;
+    parts.add(3, "three", 3000);
+    parts.add(1, "one ", 2000);
+    VERIFY(parts.messages.empty());
+    COMPARE(parts.reassembler.pending(), size_t(1));
+    parts.add(2, "two ", 1000);
+    COMPARE(parts.messages.size(), size_t(1));
+    COMPARE(parts.messages[0].text, string("one two three"));
+    // The earliest timestamp, and no longer a part
+    COMPARE(parts.messages[0].timestamp, int64_t(1000));
+    COMPARE(parts.messages[0].parts, uint8_t(1));
+    COMPARE(parts.reassembler.pending(), size_t(0));
+
+    // Every part learns the outcome of the joined message
+    VERIFY(parts.completed.empty());
+    parts.dones[0](true);
+    COMPARE(parts.completed.size(), size_t(3));
+    for (const auto& part : parts.completed) {
+        VERIFY(part.second);
+    }
+}
+
+void copies_share_the_outcome() {
+    Parts parts;
+    parts.add(1, "one ");
+    // The same part again, as from the other storage
+    parts.add(1, "one ");
+    parts.add(2, "two ");
+    parts.add(3, "three");
+    COMPARE(parts.messages.size(), size_t(1));
+    COMPARE(parts.messages[0].text, string("one two three"));
+    parts.dones[0](false);
+    COMPARE(parts.completed.size(), size_t(4));
+    COMPARE(parts.completed[1].first, uint8_t(1));
+    VERIFY(!parts.completed[1].second);
+}
+
+void incomplete_expires() {
+    Parts parts;
+    auto start = Reassembler::Clock::time_point() + chrono::hours(1);
+    parts.add(1, "one ", 1000, start);
+    parts.add(3, "three", 1000, start + chrono::seconds(30));
+    // Timed out from the first part
+    VERIFY(parts.reassembler.nextExpiry() == start + chrono::seconds(60));
+    COMPARE(parts.reassembler.expire(start + chrono::seconds(59)), size_t(0));
+    VERIFY(parts.messages.empty());
+    COMPARE(parts.reassembler.expire(start + chrono::seconds(60)), size_t(1));
+    COMPARE(parts.messages.size(), size_t(1));
+    COMPARE(parts.messages[0].text, string("one three"));
+    COMPARE(parts.reassembler.pending(), size_t(0));
+    VERIFY(parts.reassembler.nextExpiry() ==
+           Reassembler::Clock::time_point::max());
+    parts.dones[0](true);
+    COMPARE(parts.completed.size(), size_t(2));
+
+    // A part that arrives late starts a message of its own
+    parts.add(2, "two ", 1000, start + chrono::seconds(61));
+    COMPARE(parts.reassembler.pending(), size_t(1));
+}
+
+} // namespace
+
+int main() {
+    return Testing::run("ReassemblerTest",
+                        {TEST(single_passes_at_once),
+                         TEST(joins_out_of_order),
+                         TEST(copies_share_the_outcome),
+                         TEST(incomplete_expires)});
+}
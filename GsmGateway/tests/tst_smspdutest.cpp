@@ -0,0 +1,202 @@
+#include <string>
+#include <vector>
+
+#include "smspdu.h"
+#include "testing.h"
+
+using namespace GsmGateway;
+
+namespace {
+
+const string number = "+46708251358";
+
+void submit_gsm7() {
+    auto pdus = Sms::encodeSubmit(number, "hellohello", 1);
+    COMPARE(pdus.size(), size_t(1));
+    COMPARE(pdus[0].hex,
+            string("0001000B916407281553F800000AE8329BFD4697D9EC37"));
+    // Without the empty SMSC address in front
+    COMPARE(pdus[0].length, pdus[0].hex.size() / 2 - 1);
+}
+
+void submit_gsm7_after_header() {
+    string text;
+    for (int i = 0; i < 17; ++i) {
+        text += "0123456789";
+    }
+    // The septets start after one fill bit that aligns the 6 octet header
+    auto pdus = Sms::encodeSubmit(number, text, 7);
+    COMPARE(pdus.size(), size_t(2));
+    COMPARE(pdus[0].hex,
+            string("0041000B916407281553F80000A00500030702016031D98C56B3DD70"
+                   "39584C36A3D56C375C0E1693CD6835DB0D9783C564335ACD76C3E560"
+                   "31D98C56B3DD7039584C36A3D56C375C0E1693CD6835DB0D9783C564"
+                   "335ACD76C3E56031D98C56B3DD7039584C36A3D56C375C0E1693CD68"
+                   "35DB0D9783C564335ACD76C3E56031D98C56B3DD7039584C36A3D56C"
+                   "375C0E1693CD6835DB0D9783C564"));
+    COMPARE(pdus[1].hex, string("0041000B916407281553F8000018050003070202"
+                                "66B49AED86CBC162B219AD66BBE172"));
+}
+
+void submit_ucs2_surrogates() {
+    // U+1F600 is the surrogate pair D83D DE00
+    auto pdus = Sms::encodeSubmit(number, "Hej \xF0\x9F\x98\x80", 1);
+    COMPARE(pdus.size(), size_t(1));
+    COMPARE(pdus[0].hex, string("0001000B916407281553F800080C00480065006A0020"
+                                "D83DDE00"));
+}
+
+void ucs2_segments_keep_surrogates_together() {
+    // The pair would straddle the 67 units of the first segment
+    auto text = string(66, 'a') + "\xF0\x9F\x98\x80" + string(10, 'b');
+    Sms::EncodingOptions options;
+    options.transliterate = false;
+    auto plan = Sms::planEncoding(Sms::decodeUtf8(text), options);
+    COMPARE(plan.encoding, Sms::Encoding::Ucs2);
+    COMPARE(plan.segments.size(), size_t(2));
+    COMPARE(plan.segments[0].size(), size_t(66));
+    COMPARE(plan.segments[1][0], char32_t(0x1F600));
+    auto pdus = Sms::encodeSubmit(number, plan, 3);
+    COMPARE(pdus.size(), size_t(2));
+    string units;
+    for (int i = 0; i < 66; ++i) {
+        units += "0061";
+    }
+    COMPARE(pdus[0].hex, "0041000B916407281553F800088A050003030201" + units);
+    units = "D83DDE00";
+    for (int i = 0; i < 10; ++i) {
+        units += "0062";
+    }
+    COMPARE(pdus[1].hex, "0041000B916407281553F800081E050003030202" + units);
+}
+
+void gsm7_boundaries() {
+    Sms::EncodingOptions options;
+    auto plan = Sms::planEncoding(u32string(160, U'a'), options);
+    COMPARE(plan.encoding, Sms::Encoding::Gsm7);
+    COMPARE(plan.segments.size(), size_t(1));
+    // The concatenation header leaves 153 septets per segment
+    plan = Sms::planEncoding(u32string(161, U'a'), options);
+    COMPARE(plan.segments.size(), size_t(2));
+    COMPARE(plan.segments[0].size(), size_t(153));
+    COMPARE(plan.segments[1].size(), size_t(8));
+    COMPARE(Sms::segmentCount(u32string(306, U'a'), options), size_t(2));
+    COMPARE(Sms::segmentCount(u32string(307, U'a'), options), size_t(3));
+    // Characters of the extension table take two septets
+    options.languages.clear();
+    COMPARE(Sms::segmentCount(u32string(80, U'€'), options), size_t(1));
+    COMPARE(Sms::segmentCount(u32string(81, U'€'), options), size_t(2));
+}
+
+void escape_not_split() {
+    // The escape code would be the last septet of the first segment
+    auto text = u32string(152, U'a') + U'€' + u32string(10, U'b');
+    auto plan = Sms::planEncoding(text);
+    COMPARE(plan.encoding, Sms::Encoding::Gsm7);
+    COMPARE(plan.segments.size(), size_t(2));
+    COMPARE(plan.segments[0], u32string(152, U'a'));
+    COMPARE(plan.segments[1][0], U'€');
+    auto pdus = Sms::encodeSubmit(number, plan, 4);
+    COMPARE(pdus.size(), size_t(2));
+    // Seven septets of header, then the escape and code and ten more
+    COMPARE(pdus[1].hex.substr(26, 2), string("13"));
+}
+
+void national_language_boundaries() {
+    Sms::EncodingOptions options;
+    options.transliterate = false;
+    options.languages = {Sms::Language::Spanish};
+    // The single shift header of three octets leaves 155 septets
+    auto text = U'á' + u32string(153, U'a');
+    auto plan = Sms::planEncoding(text, options);
+    COMPARE(plan.encoding, Sms::Encoding::Gsm7);
+    COMPARE(plan.singleShift, Sms::Language::Spanish);
+    COMPARE(plan.lockingShift, Sms::Language::Default);
+    COMPARE(plan.segments.size(), size_t(1));
+    auto pdus = Sms::encodeSubmit(number, plan, 1);
+    COMPARE(pdus.size(), size_t(1));
+    // With the header flag, and the Spanish single shift in the header
+    COMPARE(pdus[0].hex.substr(2, 2), string("41"));
+    COMPARE(pdus[0].hex.substr(28, 8), string("03240102"));
+
+    // And 149 per segment with the concatenation header too
+    plan = Sms::planEncoding(text + U'a', options);
+    COMPARE(plan.singleShift, Sms::Language::Spanish);
+    COMPARE(plan.segments.size(), size_t(2));
+    COMPARE(plan.segments[0].size(), size_t(148));
+    COMPARE(plan.segments[1].size(), size_t(7));
+}
+
+void transliteration_choice() {
+    Sms::EncodingOptions options;
+    options.languages = {Sms::Language::Spanish};
+    // A national table beats transliteration at the same segment count
+    auto text = U'á' + u32string(100, U'a');
+    auto plan = Sms::planEncoding(text, options);
+    COMPARE(plan.singleShift, Sms::Language::Spanish);
+    COMPARE(plan.transliterated, size_t(0));
+    COMPARE(plan.segments[0][0], U'á');
+    // But not when transliteration saves a segment
+    text = U'á' + u32string(154, U'a');
+    plan = Sms::planEncoding(text, options);
+    COMPARE(plan.singleShift, Sms::Language::Default);
+    COMPARE(plan.transliterated, size_t(1));
+    COMPARE(plan.segments.size(), size_t(1));
+    COMPARE(plan.segments[0][0], U'a');
+
+    // Typographic quotes need no UCS-2
+    text = U'“' + u32string(158, U'a') + U'”';
+    plan = Sms::planEncoding(text, options);
+    COMPARE(plan.encoding, Sms::Encoding::Gsm7);
+    COMPARE(plan.transliterated, size_t(2));
+    COMPARE(plan.segments.size(), size_t(1));
+    COMPARE(plan.segments[0][0], U'"');
+    options.transliterate = false;
+    plan = Sms::planEncoding(text, options);
+    COMPARE(plan.encoding, Sms::Encoding::Ucs2);
+    COMPARE(plan.segments.size(), size_t(3));
+    COMPARE(plan.transliterated, size_t(0));
+
+    // Without a replacement, UCS-2 it is
+    options.transliterate = true;
+    plan = Sms::planEncoding(U"Привет", options);
+    COMPARE(plan.encoding, Sms::Encoding::Ucs2);
+    COMPARE(plan.segments.size(), size_t(1));
+}
+
+void deliver_concatenated() {
+    Sms::DeliverPdu pdu;
+    VERIFY(Sms::decodeDeliver(
+        "00440B916407000000F100006210511000100012050003090202E6E5F1DB4D06A1"
+        "C36C33",
+        pdu));
+    COMPARE(pdu.sender, string("+46700000001"));
+    COMPARE(pdu.text, string("second half"));
+    COMPARE(pdu.timestamp, int64_t(1768438801000000));
+    COMPARE(pdu.reference, uint16_t(9));
+    COMPARE(pdu.parts, uint8_t(2));
+    COMPARE(pdu.part, uint8_t(2));
+
+    VERIFY(Sms::decodeDeliver("00040B916407000000F200006210511020000002EA30",
+                              pdu));
+    COMPARE(pdu.text, string("ja"));
+    COMPARE(pdu.parts, uint8_t(1));
+    VERIFY(!Sms::decodeDeliver("00040B9164", pdu));
+    string sender;
+    VERIFY(Sms::decodeSender("00040B916407000000F200006210511020000002EA30",
+                             sender));
+    COMPARE(sender, string("+46700000002"));
+}
+
+} // namespace
+
+int main() {
+    return Testing::run("SmsPduTest",
+                        {TEST(submit_gsm7), TEST(submit_gsm7_after_header),
+                         TEST(submit_ucs2_surrogates),
+                         TEST(ucs2_segments_keep_surrogates_together),
+                         TEST(gsm7_boundaries), TEST(escape_not_split),
+                         TEST(national_language_boundaries),
+                         TEST(transliteration_choice),
+                         TEST(deliver_concatenated)});
+}
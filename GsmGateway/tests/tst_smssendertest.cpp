@@ -0,0 +1,166 @@
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+#include "atchannel.h"
+#include "modemsimulator.h"
+#include "serialport.h"
+#include "smssender.h"
+#include "testing.h"
+
+using namespace GsmGateway;
+
+namespace {
+
+const string number = "+46708251358";
+
+// An SmsSender on a serial port to the simulated modem
+struct Link {
+    explicit Link(int moreMessagesMode = 1)
+        : port(context),
+          channel(context, [this](string data) { port.write(move(data)); }),
+          sender(channel, moreMessagesMode) {
+        port.setReceiveHandler([this](const uint8_t* data, size_t size) {
+            channel.receive(data, size);
+        });
+    }
+
+    bool open() { return modem.start() && port.open(modem.device()); }
+
+    void send(const string& text) {
+        sender.send(number, text, [this](bool ok, const string& error) {
+            results.push_back(ok ? "OK" : error);
+        });
+    }
+
+    // Sends the texts as a TenantScheduler would, telling the sender how
+    // many wait behind each one
+    void sendBurst(const vector<string>& texts) {
+        for (size_t i = 0; i < texts.size(); ++i) {
+            sender.setWaitingSegments(texts.size() - i - 1);
+            send(texts[i]);
+        }
+    }
+
+    bool waitForResults(size_t count) {
+        return Testing::runUntil(context,
+                                 [&] { return results.size() >= count; });
+    }
+
+    ModemSimulator modem;
+    boost::asio::io_context context;
+    SerialPort port;
+    AtChannel channel;
+    SmsSender sender;
+    vector<string> results;
+};
+
+string repeat(const string& text, size_t times) {
+    string repeated;
+    for (size_t i = 0; i < times; ++i) {
+        repeated += text;
+    }
+    return repeated;
+}
+
+void single_message() {
+    Link link;
+    VERIFY(link.open());
+    link.send("hellohello");
+    VERIFY(link.waitForResults(1));
+    COMPARE(link.results[0], string("OK"));
+    // No AT+CMMS for a single segment
+    COMPARE(link.modem.commands(), vector<string>{"AT+CMGS=22"});
+    COMPARE(link.modem.submitted(),
+            vector<string>{"0001000B916407281553F800000AE8329BFD4697D9EC37"});
+    COMPARE(link.sender.stats().messages, uint64_t(1));
+    COMPARE(link.sender.stats().linkCommands, uint64_t(0));
+}
+
+void burst_keeps_link_open() {
+    Link link;
+    VERIFY(link.open());
+    link.sendBurst({"one", "two", "three"});
+    VERIFY(link.waitForResults(3));
+    auto commands = link.modem.commands();
+    COMPARE(commands.size(), size_t(4));
+    // Queued ahead of the first submission of the burst
+    COMPARE(commands[0], string("AT+CMMS=1"));
+    for (size_t i = 1; i < commands.size(); ++i) {
+        VERIFY(commands[i].rfind("AT+CMGS=", 0) == 0);
+    }
+    COMPARE(link.sender.stats().linkCommands, uint64_t(1));
+
+    // The modem released the link once idle, so the next burst sets it up
+    // again, but a single message does not
+    link.sendBurst({"four"});
+    VERIFY(link.waitForResults(4));
+    link.sendBurst({"five", "six"});
+    VERIFY(link.waitForResults(6));
+    commands = link.modem.commands();
+    COMPARE(commands.size(), size_t(8));
+    COMPARE(commands[4].rfind("AT+CMGS=", 0), size_t(0));
+    COMPARE(commands[5], string("AT+CMMS=1"));
+    COMPARE(link.sender.stats().linkCommands, uint64_t(2));
+}
+
+void link_kept_from_start() {
+    Link link(2);
+    VERIFY(link.open());
+    link.sender.start();
+    link.sendBurst({"one", "two"});
+    VERIFY(link.waitForResults(2));
+    auto commands = link.modem.commands();
+    COMPARE(commands.size(), size_t(3));
+    COMPARE(commands[0], string("AT+CMMS=2"));
+    COMPARE(link.sender.stats().linkCommands, uint64_t(1));
+}
+
+void concatenated_in_order() {
+    Link link;
+    VERIFY(link.open());
+    auto text = repeat("0123456789", 17);
+    link.send(text);
+    VERIFY(link.waitForResults(1));
+    COMPARE(link.results[0], string("OK"));
+    // The first message gets reference 1
+    vector<string> expected;
+    for (const auto& pdu : Sms::encodeSubmit(number, text, 1)) {
+        expected.push_back(pdu.hex);
+    }
+    COMPARE(expected.size(), size_t(2));
+    COMPARE(link.modem.submitted(), expected);
+    auto commands = link.modem.commands();
+    COMPARE(commands.size(), size_t(3));
+    COMPARE(commands[0], string("AT+CMMS=1"));
+    COMPARE(link.sender.stats().segments, uint64_t(2));
+}
+
+void failed_segment_drops_rest() {
+    Link link;
+    VERIFY(link.open());
+    link.modem.failSubmissions(1, "+CMS ERROR: 38");
+    // Three segments; the second is already queued when the first fails
+    link.send(repeat("0123456789", 32));
+    VERIFY(link.waitForResults(1));
+    COMPARE(link.results[0], string("+CMS ERROR: 38"));
+    COMPARE(link.modem.submitted().size(), size_t(2));
+    COMPARE(link.sender.stats().failures, uint64_t(1));
+    COMPARE(link.sender.backlog(), size_t(0));
+
+    // The next message is sent as usual
+    link.send("hellohello");
+    VERIFY(link.waitForResults(2));
+    COMPARE(link.results[1], string("OK"));
+}
+
+} // namespace
+
+int main() {
+    return Testing::run("SmsSenderTest",
+                        {TEST(single_message), TEST(burst_keeps_link_open),
+                         TEST(link_kept_from_start),
+                         TEST(concatenated_in_order),
+                         TEST(failed_segment_drops_rest)});
+}
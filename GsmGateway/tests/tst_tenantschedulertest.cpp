@@ -0,0 +1,179 @@
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+#include "atchannel.h"
+#include "modemsimulator.h"
+#include "serialport.h"
+#include "smssender.h"
+#include "tenantscheduler.h"
+#include "testing.h"
+
+using namespace GsmGateway;
+
+namespace {
+
+const filesystem::path routes =
+    filesystem::temp_directory_path() / "tenantschedulertest.routes";
+
+// A TenantScheduler on a sender to the simulated modem, which collects the
+// messages in the order they were sent
+struct Link {
+    explicit Link(size_t maxDispatched = 1, size_t quantum = 1)
+        : port(context),
+          channel(context, [this](string data) { port.write(move(data)); }),
+          sender(channel), scheduler(sender, maxDispatched, quantum) {
+        port.setReceiveHandler([this](const uint8_t* data, size_t size) {
+            channel.receive(data, size);
+        });
+    }
+
+    bool open() { return modem.start() && port.open(modem.device()); }
+
+    // Messages are named after their text, which is also sent
+    void send(size_t tenant, const string& text, bool alarm = false,
+              const string& number = "+46700000001") {
+        scheduler.send(tenant, number, text, alarm,
+                       [this, text](bool ok, const string& error) {
+                           sent.push_back(ok ? text : error);
+                       });
+    }
+
+    bool waitForSent(size_t count) {
+        return Testing::runUntil(context,
+                                 [&] { return sent.size() >= count; });
+    }
+
+    ModemSimulator modem;
+    boost::asio::io_context context;
+    SerialPort port;
+    AtChannel channel;
+    SmsSender sender;
+    TenantScheduler scheduler;
+    vector<string> sent;
+};
+
+string repeat(char c, size_t times) { return string(times, c); }
+
+void alarms_go_first() {
+    Link link;
+    VERIFY(link.open());
+    auto a = link.scheduler.addTenant("a");
+    auto b = link.scheduler.addTenant("b");
+    for (auto text : {"a1", "a2", "a3", "a4"}) {
+        link.send(a, text);
+    }
+    // Only the first bulk message was handed to the sender
+    link.send(b, "alarm", true);
+    COMPARE(link.scheduler.queued(a), size_t(3));
+    COMPARE(link.scheduler.queued(b), size_t(1));
+    VERIFY(link.waitForSent(5));
+    COMPARE(link.sent,
+            (vector<string>{"a1", "alarm", "a2", "a3", "a4"}));
+    COMPARE(link.scheduler.stats(a).bulk, uint64_t(4));
+    COMPARE(link.scheduler.stats(b).alarms, uint64_t(1));
+    COMPARE(link.scheduler.stats(b).alarmWait.count(), uint64_t(1));
+}
+
+void tenants_take_turns_by_weight() {
+    Link link;
+    VERIFY(link.open());
+    auto a = link.scheduler.addTenant("a");
+    auto b = link.scheduler.addTenant("b", 2);
+    for (auto text : {"a1", "a2", "a3", "a4"}) {
+        link.send(a, text);
+    }
+    for (auto text : {"b1", "b2", "b3", "b4"}) {
+        link.send(b, text);
+    }
+    VERIFY(link.waitForSent(8));
+    // The first went out alone; then two messages of b per turn, one of a
+    COMPARE(link.sent, (vector<string>{"a1", "a2", "b1", "b2", "a3", "b3",
+                                       "b4", "a4"}));
+}
+
+void turns_count_segments() {
+    Link link(1, 2);
+    VERIFY(link.open());
+    auto a = link.scheduler.addTenant("a");
+    auto b = link.scheduler.addTenant("b");
+    // Two segments each, so a gets one message per turn and b two
+    for (auto c : {'x', 'y', 'z'}) {
+        link.send(a, repeat(c, 200));
+    }
+    for (auto text : {"b1", "b2", "b3", "b4"}) {
+        link.send(b, text);
+    }
+    VERIFY(link.waitForSent(7));
+    COMPARE(link.sent, (vector<string>{repeat('x', 200), repeat('y', 200),
+                                       "b1", "b2", repeat('z', 200), "b3",
+                                       "b4"}));
+    COMPARE(link.scheduler.stats(a).segments, uint64_t(6));
+    COMPARE(link.scheduler.stats(b).segments, uint64_t(4));
+}
+
+void bulk_queue_is_bounded() {
+    Link link;
+    VERIFY(link.open());
+    auto a = link.scheduler.addTenant("a", 1, 2);
+    // One dispatched and two queued, the rest refused
+    for (auto text : {"a1", "a2", "a3", "a4"}) {
+        link.send(a, text);
+    }
+    COMPARE(link.sent, vector<string>{"queue full"});
+    COMPARE(link.scheduler.stats(a).rejected, uint64_t(1));
+    // Alarms are never refused
+    link.send(a, "alarm", true);
+    VERIFY(link.waitForSent(5));
+    COMPARE(link.sent,
+            (vector<string>{"queue full", "a1", "alarm", "a2", "a3"}));
+}
+
+void routes_survive_restart() {
+    filesystem::remove(routes);
+    {
+        Link link;
+        auto a = link.scheduler.addTenant("a");
+        auto b = link.scheduler.addTenant("b");
+        VERIFY(link.scheduler.openRoutes(routes.string()));
+        COMPARE(link.scheduler.tenantOf("+46700000001"),
+                TenantScheduler::noTenant);
+        link.send(a, "one", false, "+46700000001");
+        link.send(b, "two", false, "+46700000002");
+        // The last tenant to send to a number gets its replies
+        link.send(b, "three", false, "+46700000001");
+        link.send(b, "four", false, "+46700000001");
+        COMPARE(link.scheduler.tenantOf("+46700000001"), b);
+        COMPARE(link.scheduler.tenantOf("+46700000002"), b);
+    }
+    {
+        // Tenants added in another order, and one of them gone
+        Link link;
+        auto c = link.scheduler.addTenant("c");
+        auto b = link.scheduler.addTenant("b");
+        VERIFY(link.scheduler.openRoutes(routes.string()));
+        COMPARE(link.scheduler.tenantOf("+46700000001"), b);
+        COMPARE(link.scheduler.tenantOf("+46700000002"), b);
+        link.send(c, "five", false, "+46700000002");
+    }
+    Link link;
+    link.scheduler.addTenant("c");
+    auto b = link.scheduler.addTenant("b");
+    VERIFY(link.scheduler.openRoutes(routes.string()));
+    COMPARE(link.scheduler.tenantOf("+46700000001"), b);
+    COMPARE(link.scheduler.tenantOf("+46700000002"), size_t(0));
+    filesystem::remove(routes);
+}
+
+} // namespace
+
+int main() {
+    return Testing::run("TenantSchedulerTest",
+                        {TEST(alarms_go_first),
+                         TEST(tenants_take_turns_by_weight),
+                         TEST(turns_count_segments),
+                         TEST(bulk_queue_is_bounded),
+                         TEST(routes_survive_restart)});
+}